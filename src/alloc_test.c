@@ -0,0 +1,151 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "alloc_test.h"
+#include "flac.h"
+#include "sound_player.h"
+
+#include <windows.h>
+#include <crtdbg.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The size of the sound player's audio buffers
+#define ALLOC_TEST_OUTPUT_SIZE 8192
+
+typedef struct
+{
+    const char*     name;
+    sample_format_e sample_format;
+    uint8_t         bps; // Bytes per sample
+} alloc_test_output_t;
+
+static const alloc_test_output_t alloc_test_outputs[] =
+{
+    { "16-bit integer", SAMPLE_FORMAT_INT,   sizeof(int16_t) },
+    { "32-bit integer", SAMPLE_FORMAT_INT,   sizeof(int32_t) },
+    { "32-bit float",   SAMPLE_FORMAT_FLOAT, sizeof(float) }
+};
+
+// Heap calls counted while 'alloc_test_counting' is set
+static volatile LONG alloc_test_counting = 0;
+static DWORD alloc_test_thread_id = 0;
+static uint64_t alloc_test_malloc_count = 0;
+static uint64_t alloc_test_realloc_count = 0;
+static uint64_t alloc_test_free_count = 0;
+
+#ifdef _DEBUG
+// Counts the heap calls of the decoding thread, and lets all calls through. Blocks of the CRT itself (e.g. the buffer of
+// a FILE) aren't counted, as they aren't allocated by the decoder.
+static int __cdecl AllocTestHook(int alloc_type, void* user_data, size_t size, int block_type, long request_number, const unsigned char* file_name, int line_number)
+{
+    if ((alloc_test_counting == 1) && (block_type != _CRT_BLOCK) && (GetCurrentThreadId() == alloc_test_thread_id))
+    {
+        switch (alloc_type)
+        {
+            case _HOOK_ALLOC:   { alloc_test_malloc_count++; } break;
+            case _HOOK_REALLOC: { alloc_test_realloc_count++; } break;
+            case _HOOK_FREE:    { alloc_test_free_count++; } break;
+            default: {} break;
+        }
+    }
+
+    return TRUE;
+}
+#endif
+
+uint32_t AllocTestFile(char* file_path)
+{
+    assert(file_path != NULL);
+
+#ifndef _DEBUG
+    printf("alloc_test counts heap calls through the allocation hook of the debug CRT, run it from a Debug build\n");
+    return 1;
+#else
+    alloc_test_thread_id = GetCurrentThreadId();
+    _CRT_ALLOC_HOOK previous_hook = _CrtSetAllocHook(&AllocTestHook);
+    uint64_t heap_call_count = 0;
+    uint32_t failed_count = 0;
+
+    printf("File:           %s\n", file_path);
+    for (uint32_t i = 0; i < sizeof(alloc_test_outputs) / sizeof(alloc_test_outputs[0]); i++)
+    {
+        const alloc_test_output_t* output_format = &alloc_test_outputs[i];
+
+        // Set up playback, as the sound player does before it starts a song
+        song_t song;
+        SongInit(&song);
+        song.song_path_offset = file_path;
+        song.song_type = SONG_TYPE_FLAC;
+        if (FLACLoadHeader(&song) != SONG_ERROR_NO)
+        {
+            printf("Unable to load FLAC file: %s\n", file_path);
+            failed_count++;
+            break;
+        }
+        FLACSetOutputFormat(&song, output_format->sample_format, output_format->bps);
+        song.flac->md5_verify_enabled = 1;
+        playback_data_t playback_data = { 0 };
+        playback_data.song_type = song.song_type;
+        playback_data.file = song.file;
+        playback_data.flac = song.flac;
+        playback_data.file_size = song.file_size;
+        playback_data.sample_rate = song.sample_rate;
+        playback_data.channel_count = song.channel_count;
+        playback_data.bps = song.bps;
+        playback_data.sample_format = song.sample_format;
+        byte_t* output = (byte_t*)malloc(ALLOC_TEST_OUTPUT_SIZE);
+
+        // Decode all of it, counting every heap call made on the way
+        alloc_test_malloc_count = 0;
+        alloc_test_realloc_count = 0;
+        alloc_test_free_count = 0;
+        uint64_t byte_count = 0;
+        InterlockedExchange(&alloc_test_counting, 1);
+        while (1)
+        {
+            uint32_t size = FLACLoadData(&playback_data, ALLOC_TEST_OUTPUT_SIZE, output);
+            if (size == 0)
+            {
+                break;
+            }
+            byte_count += size;
+        }
+        InterlockedExchange(&alloc_test_counting, 0);
+
+        printf("%-16s %llu bytes, %llu malloc, %llu realloc, %llu free, MD5 %s\n", output_format->name, (unsigned long long)byte_count,
+               (unsigned long long)alloc_test_malloc_count, (unsigned long long)alloc_test_realloc_count, (unsigned long long)alloc_test_free_count,
+               (song.flac->md5_result == FLAC_MD5_RESULT_MATCH) ? "match" : ((song.flac->md5_result == FLAC_MD5_RESULT_NO_SIGNATURE) ? "not in file" : "MISMATCH"));
+        heap_call_count += alloc_test_malloc_count + alloc_test_realloc_count + alloc_test_free_count;
+        if ((song.flac->md5_result != FLAC_MD5_RESULT_MATCH) && (song.flac->md5_result != FLAC_MD5_RESULT_NO_SIGNATURE))
+        {
+            failed_count++;
+        }
+
+        free(output);
+        SongFreeAudioData(&song);
+    }
+
+    _CrtSetAllocHook(previous_hook);
+    printf("Heap calls:     %llu after setup\n", (unsigned long long)heap_call_count);
+
+    return (heap_call_count > 0) ? (uint32_t)heap_call_count : failed_count;
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ALLOC_TEST_H
+#define ALLOC_TEST_H
+
+#include <stdint.h>
+
+/**
+ * Checks that decoding a FLAC file makes no heap allocations once it has been set up, as the sound thread mustn't wait on
+ * the heap while playing back.
+ * 
+ * The file is decoded with FLACLoadData() from its first sample to its last, in the buffer size of the sound player, once
+ * for each output format, with CRC checks and MD5 verification enabled. Every malloc, realloc and free made by the
+ * decoding thread after FLACLoadHeader() and FLACSetOutputFormat() is counted. The calls are counted by an allocation
+ * hook of the debug CRT, so the check only runs in a Debug build.
+ * 
+ * Returns number of heap calls made while decoding, or if there were none, number of output formats that couldn't be
+ * decoded or didn't match the MD5 signature
+*/
+uint32_t AllocTestFile(char* file_path);
+
+#endif
\ No newline at end of file
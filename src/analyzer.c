@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "analyzer.h"
+#include "windows_thread.h"
+#include "windows_synchronization.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Set in 'spectrum_middle' when the thread has published the spectrum in it and the render thread hasn't taken it yet
+#define ANALYZER_SPECTRUM_FRESH 0x4
+#define ANALYZER_SPECTRUM_INDEX_MASK 0x3
+
+// Settings are packed into one 64-bit value, so that they change all at once
+static LONG64 AnalyzerPackSettings(uint8_t enabled, uint8_t gpu, uint32_t n, dft_window_e window, uint32_t hop)
+{
+    return (LONG64)((uint64_t)n | (((uint64_t)hop & 0xFFFF) << 32) | (((uint64_t)window & 0xFF) << 48) | ((uint64_t)enabled << 56) | ((uint64_t)gpu << 57));
+}
+
+// Hands the bands of the STFT over to the render thread, or in GPU mode the latest frame of the STFT if 'frame_loaded' is 1
+static void AnalyzerPublish(analyzer_t* analyzer, uint8_t gpu, uint8_t frame_loaded)
+{
+    analyzer_spectrum_t* spectrum = &analyzer->spectra[analyzer->spectrum_back];
+    analyzer->publish_count += 1;
+    spectrum->publish_count = analyzer->publish_count;
+    spectrum->band_count = DFTGetFrequencyBandCount();
+    spectrum->gpu = gpu;
+    spectrum->n = DFTGetN();
+    spectrum->window = DFTGetWindow();
+    spectrum->frame_sample_count = 0;
+    if (gpu == 0)
+    {
+        memcpy(spectrum->bands, analyzer->stft.bands, spectrum->band_count * sizeof(float));
+    }
+    else if (frame_loaded == 1)
+    {
+        spectrum->frame_sample_count = spectrum->n;
+        memcpy(spectrum->frame, analyzer->stft.frame, spectrum->frame_sample_count * sizeof(float));
+    }
+    analyzer->spectrum_back = (uint32_t)InterlockedExchange(&analyzer->spectrum_middle, (LONG)(analyzer->spectrum_back | ANALYZER_SPECTRUM_FRESH)) & ANALYZER_SPECTRUM_INDEX_MASK;
+}
+
+static DWORD WINAPI AnalyzerThreadProc(_In_ LPVOID lpParameter)
+{
+    analyzer_t* analyzer = (analyzer_t*)lpParameter;
+
+    LONG64 settings_applied = 0;
+    uint8_t enabled = 0;
+    uint8_t gpu = 0;
+    // Latest chunk, which playback is somewhere in
+    uint64_t chunk_position = 0;
+    uint64_t chunk_sample_count = 0;
+    uint32_t chunk_sample_rate = 0;
+    LARGE_INTEGER chunk_time;
+    chunk_time.QuadPart = 0;
+    LARGE_INTEGER timer_frequency;
+    QueryPerformanceFrequency(&timer_frequency);
+
+    while (1)
+    {
+        // Apply new settings
+        LONG64 settings = InterlockedCompareExchange64(&analyzer->settings, 0, 0);
+        if (settings != settings_applied)
+        {
+            uint32_t n = (uint32_t)(settings & 0xFFFFFFFF);
+            uint32_t hop = (uint32_t)((settings >> 32) & 0xFFFF);
+            dft_window_e window = (dft_window_e)((settings >> 48) & 0xFF);
+            enabled = (uint8_t)((settings >> 56) & 0x1);
+            gpu = (uint8_t)((settings >> 57) & 0x1);
+            DFTSetAnalysis(n, window);
+            analyzer->stft.hop = hop;
+            STFTClearBands(&analyzer->stft);
+            AnalyzerPublish(analyzer, gpu, 0);
+            settings_applied = settings;
+        }
+
+        // Take the chunks pushed since the last time
+        uint32_t chunk_write_count = (uint32_t)analyzer->chunk_write_count;
+        uint32_t chunk_read_count = (uint32_t)analyzer->chunk_read_count;
+        while (chunk_read_count != chunk_write_count)
+        {
+            const analyzer_chunk_t* chunk = &analyzer->chunks[chunk_read_count % ANALYZER_CHUNK_COUNT];
+            uint32_t bytes_per_sample_all_channels = (uint32_t)chunk->channel_count * chunk->bps;
+            chunk_position = chunk->position;
+            chunk_sample_count = chunk->size / bytes_per_sample_all_channels;
+            chunk_sample_rate = chunk->sample_rate;
+            chunk_time = chunk->time;
+            STFTPush(&analyzer->stft, chunk->position, chunk->data, (uint32_t)chunk_sample_count, chunk->bps, (int16_t)bytes_per_sample_all_channels, chunk->sample_format);
+            chunk_read_count += 1;
+            InterlockedExchange(&analyzer->chunk_read_count, (LONG)chunk_read_count);
+        }
+
+        // Compute the frames playback has reached, and wake up again when the next one ends, unless playback has
+        // reached the end of the latest chunk and the next chunk will wake the thread
+        DWORD wait_time_ms = INFINITE;
+        if ((enabled == 1) &&
+            (chunk_sample_rate > 0))
+        {
+            LARGE_INTEGER time;
+            QueryPerformanceCounter(&time);
+            uint64_t chunk_sample_offset = (uint64_t)((double)(time.QuadPart - chunk_time.QuadPart) * (double)chunk_sample_rate / (double)timer_frequency.QuadPart);
+            if (chunk_sample_offset > chunk_sample_count)
+            {
+                chunk_sample_offset = chunk_sample_count;
+            }
+            if (gpu == 1)
+            {
+                if (STFTLoadLatestFrame(&analyzer->stft, chunk_position + chunk_sample_offset) > 0)
+                {
+                    AnalyzerPublish(analyzer, gpu, 1);
+                }
+            }
+            else if (STFTCompute(&analyzer->stft, chunk_position + chunk_sample_offset) > 0)
+            {
+                AnalyzerPublish(analyzer, gpu, 0);
+            }
+            if (chunk_sample_offset < chunk_sample_count)
+            {
+                wait_time_ms = (DWORD)(((uint64_t)analyzer->stft.hop * 1000) / chunk_sample_rate);
+                if (wait_time_ms == 0)
+                {
+                    wait_time_ms = 1;
+                }
+            }
+        }
+
+        // Waking up because the wait timed out is expected, so this doesn't go through SyncWaitOnEvent()
+        if (WaitForSingleObject(analyzer->event, wait_time_ms) == WAIT_FAILED)
+        {
+            printf("%s:%i Failed to wait on Event\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void AnalyzerStart(analyzer_t* analyzer, uint8_t enabled, uint8_t gpu, uint32_t n, dft_window_e window, uint32_t hop)
+{
+    analyzer->chunks = (analyzer_chunk_t*)malloc(ANALYZER_CHUNK_COUNT * sizeof(analyzer_chunk_t));
+    analyzer->spectra = (analyzer_spectrum_t*)malloc(ANALYZER_SPECTRUM_COUNT * sizeof(analyzer_spectrum_t));
+    uint8_t stft_initialized = STFTInit(&analyzer->stft, hop);
+    if ((analyzer->chunks == NULL) || (analyzer->spectra == NULL) || (stft_initialized == 0))
+    {
+        printf("ERROR(%s:%i): Failed to allocate the analyzer\n", __FILE__, __LINE__);
+        exit(EXIT_FAILURE);
+    }
+    analyzer->chunk_write_count = 0;
+    analyzer->chunk_read_count = 0;
+    analyzer->dropped_chunk_count = 0;
+
+    // Until the thread publishes, the render thread gets silence in as many bands as there are now
+    for (uint32_t i = 0; i < ANALYZER_SPECTRUM_COUNT; i++)
+    {
+        analyzer->spectra[i].publish_count = 0;
+        analyzer->spectra[i].band_count = DFTGetFrequencyBandCount();
+        memset(analyzer->spectra[i].bands, 0, sizeof(analyzer->spectra[i].bands));
+        analyzer->spectra[i].gpu = 0;
+        analyzer->spectra[i].n = DFTGetN();
+        analyzer->spectra[i].window = DFTGetWindow();
+        analyzer->spectra[i].frame_sample_count = 0;
+    }
+    analyzer->publish_count = 0;
+    analyzer->spectrum_back = 0;
+    analyzer->spectrum_middle = 1;
+    analyzer->spectrum_front = 2;
+
+    analyzer->settings = AnalyzerPackSettings(enabled, gpu, n, window, hop);
+    analyzer->event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    assert(analyzer->event != NULL);
+    ThreadCreate(&AnalyzerThreadProc, analyzer, L"AnalyzerThread", &analyzer->thread);
+}
+
+uint8_t AnalyzerPush(analyzer_t* analyzer, uint64_t position, uint32_t sample_rate, uint8_t channel_count, uint8_t bps, sample_format_e sample_format, const byte_t* data, uint32_t size)
+{
+    uint32_t chunk_write_count = (uint32_t)analyzer->chunk_write_count;
+    uint32_t chunk_read_count = (uint32_t)analyzer->chunk_read_count;
+    if ((chunk_write_count - chunk_read_count) >= ANALYZER_CHUNK_COUNT)
+    {
+        analyzer->dropped_chunk_count += 1;
+        return 0;
+    }
+
+    // Only whole samples of all channels that fit
+    uint32_t bytes_per_sample_all_channels = (uint32_t)channel_count * bps;
+    if (size > ANALYZER_CHUNK_SIZE)
+    {
+        size = ANALYZER_CHUNK_SIZE;
+    }
+    size -= size % bytes_per_sample_all_channels;
+
+    analyzer_chunk_t* chunk = &analyzer->chunks[chunk_write_count % ANALYZER_CHUNK_COUNT];
+    chunk->position = position;
+    QueryPerformanceCounter(&chunk->time);
+    chunk->sample_rate = sample_rate;
+    chunk->channel_count = channel_count;
+    chunk->bps = bps;
+    chunk->sample_format = sample_format;
+    chunk->size = size;
+    memcpy(chunk->data, data, size);
+    InterlockedExchange(&analyzer->chunk_write_count, (LONG)(chunk_write_count + 1));
+    SyncSetEvent(analyzer->event, __FILE__, __LINE__);
+
+    return 1;
+}
+
+const analyzer_spectrum_t* AnalyzerAcquireSpectrum(analyzer_t* analyzer)
+{
+    if ((analyzer->spectrum_middle & ANALYZER_SPECTRUM_FRESH) != 0)
+    {
+        analyzer->spectrum_front = (uint32_t)InterlockedExchange(&analyzer->spectrum_middle, (LONG)analyzer->spectrum_front) & ANALYZER_SPECTRUM_INDEX_MASK;
+    }
+    return &analyzer->spectra[analyzer->spectrum_front];
+}
+
+void AnalyzerSetSettings(analyzer_t* analyzer, uint8_t enabled, uint8_t gpu, uint32_t n, dft_window_e window, uint32_t hop)
+{
+    InterlockedExchange64(&analyzer->settings, AnalyzerPackSettings(enabled, gpu, n, window, hop));
+    SyncSetEvent(analyzer->event, __FILE__, __LINE__);
+}
\ No newline at end of file
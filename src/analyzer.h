@@ -0,0 +1,115 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef ANALYZER_H
+#define ANALYZER_H
+
+#include "dft.h"
+#include "macros.h"
+#include "song.h"
+#include "stft.h"
+
+#include <windows.h>
+
+#include <stdint.h>
+
+// Chunks the ring between the audio path and the analysis thread holds, a power of 2
+#define ANALYZER_CHUNK_COUNT 8
+// Largest chunk, which is the size of the sound player's audio buffers
+#define ANALYZER_CHUNK_SIZE 8192
+// Spectra in the triple buffer between the analysis thread and the render thread
+#define ANALYZER_SPECTRUM_COUNT 3
+
+// Samples of one audio buffer, from when it started playing back
+typedef struct
+{
+    uint64_t        position; // Sample in the song the chunk starts at
+    LARGE_INTEGER   time; // When the chunk started playing back
+    uint32_t        sample_rate;
+    uint8_t         channel_count;
+    uint8_t         bps; // Bytes per sample
+    sample_format_e sample_format;
+    uint32_t        size; // Bytes in 'data'
+    byte_t          data[ANALYZER_CHUNK_SIZE];
+} analyzer_chunk_t;
+
+// Bands of the latest frames, or in GPU mode the samples of the latest frame, for the render thread to transform
+typedef struct
+{
+    uint32_t     publish_count; // Counts the spectra the thread published, so that the render thread can tell a new one
+    uint32_t     band_count;
+    float        bands[DFT_MAX_FREQUENCY_BAND_COUNT]; // Unused in GPU mode
+    uint8_t      gpu;
+    uint32_t     n;
+    dft_window_e window;
+    uint32_t     frame_sample_count; // GPU mode: 'n', or 0 if the bands are to be cleared instead
+    float        frame[DFT_MAX_N];
+} analyzer_spectrum_t;
+
+/**
+ * Computes the visualizer's bands on a thread of its own, so that the render thread neither waits on the sound player
+ * nor spends time on the analysis.
+ * 
+ * AnalyzerStart() starts the thread with the given settings, like AnalyzerSetSettings() takes them.
+ * 
+ * AnalyzerPush() is called by the audio path when an audio buffer starts playing back. It copies the buffer's 'size'
+ * bytes of samples into a single-producer/single-consumer ring of chunks, and wakes the thread. It never waits: if the
+ * thread hasn't taken the chunks pushed before and the ring is full, the chunk is dropped, and the history of the STFT
+ * starts over at the next one.
+ * Returns 0 if the chunk was dropped
+ * 
+ * The thread pushes the chunks into an STFT (see stft.h), and computes the frames that playback has reached since the
+ * last time, estimated from when the latest chunk started playing back. It wakes up every hop while there are frames to
+ * come. Each time a frame was computed the bands are published to the triple buffer. In GPU mode the thread doesn't
+ * transform anything: it publishes the samples of the latest frame instead, for the render thread to transform them with
+ * FFTVulkanCmdTransform().
+ * 
+ * AnalyzerAcquireSpectrum() is called by the render thread. It swaps the spectrum it got last time for the one the
+ * thread published since, if any, and returns it. The spectrum stays the render thread's until the next call.
+ * 
+ * AnalyzerSetSettings() asks the thread to change its analysis to 'n' samples multiplied with 'window', with frames
+ * ending every 'hop' samples (see DFTSetAnalysis() and STFTCompute()), or to stop computing frames if 'enabled' is 0.
+ * Frames are left to the GPU if 'gpu' is 1. Spectra published afterwards have the new band count, and the first one
+ * clears the bands.
+*/
+typedef struct analyzer_t
+{
+    // Ring of chunks, in which the audio path only ever writes 'chunk_write_count' and the thread only 'chunk_read_count'
+    analyzer_chunk_t*    chunks; // ANALYZER_CHUNK_COUNT
+    volatile LONG        chunk_write_count;
+    volatile LONG        chunk_read_count;
+    uint32_t             dropped_chunk_count;
+    HANDLE               event; // Set when there are chunks or settings for the thread
+    // Triple buffer, in which the thread writes 'spectrum_back' and the render thread reads 'spectrum_front'. Each swaps
+    // its spectrum with 'spectrum_middle', which has ANALYZER_SPECTRUM_FRESH set when the thread swapped it last
+    analyzer_spectrum_t* spectra; // ANALYZER_SPECTRUM_COUNT
+    uint32_t             spectrum_back;
+    volatile LONG        spectrum_middle;
+    uint32_t             spectrum_front;
+    uint32_t             publish_count;
+    volatile LONG64      settings; // Packed, see AnalyzerSetSettings()
+    HANDLE               thread;
+    stft_t               stft; // Only used by the thread
+} analyzer_t;
+
+void                       AnalyzerStart(analyzer_t* analyzer, uint8_t enabled, uint8_t gpu, uint32_t n, dft_window_e window, uint32_t hop);
+uint8_t                    AnalyzerPush(analyzer_t* analyzer, uint64_t position, uint32_t sample_rate, uint8_t channel_count, uint8_t bps, sample_format_e sample_format, const byte_t* data, uint32_t size);
+const analyzer_spectrum_t* AnalyzerAcquireSpectrum(analyzer_t* analyzer);
+void                       AnalyzerSetSettings(analyzer_t* analyzer, uint8_t enabled, uint8_t gpu, uint32_t n, dft_window_e window, uint32_t hop);
+
+#endif
\ No newline at end of file
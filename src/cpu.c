@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpu.h"
+
+#ifdef CPU_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#ifdef CPU_X86
+static void CPUID(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+{
+#ifdef _MSC_VER
+    __cpuidex((int*)registers, (int)leaf, (int)subleaf);
+#else
+    __cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Returns which register states the OS saves on context switches
+static uint64_t CPUGetExtendedControlRegister(void)
+{
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+const cpu_features_t* CPUGetFeatures(void)
+{
+    // Detecting is idempotent, so threads racing on the first call all write the same values
+    static cpu_features_t features;
+    static volatile uint8_t features_detected = 0;
+    if (features_detected)
+    {
+        return &features;
+    }
+
+#ifdef CPU_X86
+    uint32_t registers[4]; // EAX, EBX, ECX, EDX
+    CPUID(0, 0, registers);
+    uint32_t leaf_max = registers[0];
+
+    CPUID(1, 0, registers);
+    features.sse41 = (registers[2] >> 19) & 1;
+    features.pclmul = (registers[2] >> 1) & 1;
+    uint8_t osxsave = (registers[2] >> 27) & 1;
+    uint8_t avx = (registers[2] >> 28) & 1;
+    // XMM (bit 1) and YMM (bit 2) state must be enabled by the OS for AVX instructions
+    uint8_t os_saves_ymm = osxsave && ((CPUGetExtendedControlRegister() & 0b110) == 0b110);
+
+    if (leaf_max >= 7)
+    {
+        CPUID(7, 0, registers);
+        features.avx2 = avx && os_saves_ymm && ((registers[1] >> 5) & 1);
+    }
+#endif
+
+    features_detected = 1;
+    return &features;
+}
\ No newline at end of file
@@ -0,0 +1,231 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cue.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Copies the value at the start of 'text', either a quoted string or a single word, into 'value'. Values too long for
+// 'value' are truncated.
+// Returns the text after the value
+static const char* CueReadValue(const char* text, char* value, uint32_t value_size)
+{
+    while ((*text == ' ') || (*text == '\t'))
+    {
+        text++;
+    }
+
+    uint8_t is_quoted = (*text == '"') ? 1 : 0;
+    text += is_quoted;
+    uint32_t length = 0;
+    while ((*text != '\0') && (*text != '\n') && (*text != '\r'))
+    {
+        if (((is_quoted == 1) && (*text == '"')) ||
+            ((is_quoted == 0) && ((*text == ' ') || (*text == '\t'))))
+        {
+            break;
+        }
+        if (length < (value_size - 1))
+        {
+            value[length] = *text;
+            length++;
+        }
+        text++;
+    }
+    value[length] = '\0';
+    if ((is_quoted == 1) && (*text == '"'))
+    {
+        text++;
+    }
+
+    return text;
+}
+
+// Paths in a .cue file are relative to the directory of the .cue file, unless they're absolute
+static void CueResolvePath(const char* cue_file_path, const char* path, char* resolved_path)
+{
+    if ((path[0] == '/') || (path[0] == '\\') || ((path[0] != '\0') && (path[1] == ':')))
+    {
+        snprintf(resolved_path, MAX_PATH, "%s", path);
+        return;
+    }
+
+    int directory_length = 0;
+    for (int i = 0; cue_file_path[i] != '\0'; i++)
+    {
+        if ((cue_file_path[i] == '/') || (cue_file_path[i] == '\\'))
+        {
+            directory_length = i + 1;
+        }
+    }
+    snprintf(resolved_path, MAX_PATH, "%.*s%s", directory_length, cue_file_path, path);
+}
+
+cue_error_e CueLoad(const char* cue_file_path, cue_sheet_t* cue_sheet)
+{
+    assert(cue_file_path != NULL);
+    assert(cue_sheet != NULL);
+
+    FILE* cue_file = fopen(cue_file_path, "r");
+    if (cue_file == NULL)
+    {
+        printf("Failed to open file %s\n", cue_file_path);
+        return CUE_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+
+    cue_sheet->title[0] = '\0';
+    cue_sheet->performer[0] = '\0';
+    cue_sheet->tracks = NULL;
+    cue_sheet->track_count = 0;
+    uint32_t track_capacity = 0;
+    char file_path[MAX_PATH];
+    file_path[0] = '\0';
+    // Tracks of other types than AUDIO are parsed, but not kept
+    uint8_t in_track = 0;
+    uint8_t track_is_audio = 0;
+    cue_error_e cue_error = CUE_ERROR_NO;
+
+    char line[2 * MAX_PATH];
+    char keyword[16];
+    char value[MAX_PATH];
+    while ((fgets(line, sizeof(line), cue_file) != NULL) && (cue_error == CUE_ERROR_NO))
+    {
+        // Skip the UTF-8 byte order mark in front of the first line
+        const char* text = line;
+        if (strncmp(text, "\xEF\xBB\xBF", 3) == 0)
+        {
+            text += 3;
+        }
+        text = CueReadValue(text, keyword, sizeof(keyword));
+        cue_track_t* track = ((in_track == 1) && (track_is_audio == 1)) ? &cue_sheet->tracks[cue_sheet->track_count - 1] : NULL;
+
+        if (strcmp(keyword, "FILE") == 0)
+        {
+            CueReadValue(text, value, sizeof(value));
+            CueResolvePath(cue_file_path, value, file_path);
+            in_track = 0;
+        }
+        else if (strcmp(keyword, "TRACK") == 0)
+        {
+            char track_type[16];
+            text = CueReadValue(text, value, sizeof(value));
+            CueReadValue(text, track_type, sizeof(track_type));
+            if (file_path[0] == '\0')
+            {
+                cue_error = CUE_ERROR_INVALID_FILE;
+                break;
+            }
+            in_track = 1;
+            track_is_audio = (strcmp(track_type, "AUDIO") == 0) ? 1 : 0;
+            if (track_is_audio == 0)
+            {
+                continue;
+            }
+
+            if (cue_sheet->track_count == track_capacity)
+            {
+                track_capacity = (track_capacity == 0) ? 16 : (2 * track_capacity);
+                cue_sheet->tracks = (cue_track_t*)realloc(cue_sheet->tracks, track_capacity * sizeof(cue_track_t));
+            }
+            track = &cue_sheet->tracks[cue_sheet->track_count];
+            cue_sheet->track_count++;
+            strcpy(track->file_path, file_path);
+            track->title[0] = '\0';
+            track->performer[0] = '\0';
+            track->frame_start = UINT64_MAX;
+            track->frame_end = 0;
+            track->number = (uint8_t)atoi(value);
+        }
+        else if ((strcmp(keyword, "TITLE") == 0) || (strcmp(keyword, "PERFORMER") == 0))
+        {
+            // Before the first TRACK they're the album's
+            uint8_t is_title = (keyword[0] == 'T') ? 1 : 0;
+            if (in_track == 0)
+            {
+                CueReadValue(text, is_title ? cue_sheet->title : cue_sheet->performer, MAX_PATH);
+            }
+            else if (track != NULL)
+            {
+                CueReadValue(text, is_title ? track->title : track->performer, MAX_PATH);
+            }
+        }
+        else if ((strcmp(keyword, "INDEX") == 0) && (track != NULL))
+        {
+            uint32_t index_number, minutes, seconds, frames;
+            if ((sscanf(text, "%u %u:%u:%u", &index_number, &minutes, &seconds, &frames) != 4) ||
+                (seconds >= 60) ||
+                (frames >= CUE_FRAMES_PER_SECOND))
+            {
+                cue_error = CUE_ERROR_INVALID_FILE;
+                break;
+            }
+            if (index_number == 1)
+            {
+                track->frame_start = ((((uint64_t)minutes * 60) + seconds) * CUE_FRAMES_PER_SECOND) + frames;
+            }
+        }
+        // Everything else (REM, FLAGS, ISRC, PREGAP, ...) doesn't change what's played back
+    }
+    fclose(cue_file);
+
+    // Each track ends where the next one in the same file starts
+    if (cue_sheet->track_count == 0)
+    {
+        cue_error = CUE_ERROR_INVALID_FILE;
+    }
+    for (uint32_t i = 0; (i < cue_sheet->track_count) && (cue_error == CUE_ERROR_NO); i++)
+    {
+        cue_track_t* track = &cue_sheet->tracks[i];
+        if (track->frame_start == UINT64_MAX)
+        {
+            cue_error = CUE_ERROR_INVALID_FILE;
+            break;
+        }
+        if (track->performer[0] == '\0')
+        {
+            strcpy(track->performer, cue_sheet->performer);
+        }
+        if (((i + 1) < cue_sheet->track_count) &&
+            (strcmp(cue_sheet->tracks[i + 1].file_path, track->file_path) == 0))
+        {
+            track->frame_end = cue_sheet->tracks[i + 1].frame_start;
+            if (track->frame_end <= track->frame_start)
+            {
+                cue_error = CUE_ERROR_INVALID_FILE;
+            }
+        }
+    }
+    if (cue_error != CUE_ERROR_NO)
+    {
+        CueFree(cue_sheet);
+    }
+
+    return cue_error;
+}
+
+void CueFree(cue_sheet_t* cue_sheet)
+{
+    assert(cue_sheet != NULL);
+
+    free(cue_sheet->tracks);
+    cue_sheet->tracks = NULL;
+    cue_sheet->track_count = 0;
+}
\ No newline at end of file
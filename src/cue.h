@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CUE_H
+#define CUE_H
+
+#include "macros.h"
+
+#include <stdint.h>
+#include <windows.h>
+
+// Times in a .cue file are in minutes, seconds and CD frames, of which there are 75 per second
+#define CUE_FRAMES_PER_SECOND 75
+
+typedef enum
+{
+    CUE_ERROR_NO = 0, // No error
+    CUE_ERROR_UNABLE_TO_OPEN_FILE = 1, // Unable to open the path supplied
+    CUE_ERROR_INVALID_FILE = 2 // No audio tracks, or tracks without a start or out of order
+} cue_error_e;
+
+typedef struct
+{
+    char     file_path[MAX_PATH]; // Audio file holding the track, relative to the working directory
+    char     title[MAX_PATH]; // Empty if the .cue file doesn't have it
+    char     performer[MAX_PATH]; // The album's performer if the track doesn't have its own
+    uint64_t frame_start; // INDEX 01 of the track
+    uint64_t frame_end; // INDEX 01 of the next track in the same file, 0 if the track plays to the end of the file
+    uint8_t  number;
+} cue_track_t;
+
+/**
+ * The audio tracks of a .cue file, e.g. of an album ripped to a single file.
+ * 
+ * A track plays from its INDEX 01 to the INDEX 01 of the track after it, so the pregap (INDEX 00) of a track is played
+ * at the end of the track before it, as on the CD. Data tracks are left out.
+*/
+typedef struct
+{
+    char         title[MAX_PATH]; // Album title, empty if the .cue file doesn't have it
+    char         performer[MAX_PATH];
+    cue_track_t* tracks;
+    uint32_t     track_count;
+} cue_sheet_t;
+
+cue_error_e CueLoad(const char* cue_file_path, cue_sheet_t* cue_sheet);
+void        CueFree(cue_sheet_t* cue_sheet);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "decode_benchmark.h"
+#include "flac.h"
+#include "sound_player.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define DECODE_BENCHMARK_RUN_COUNT 3
+// The size of the sound player's audio buffers
+#define DECODE_BENCHMARK_OUTPUT_SIZE 8192
+
+typedef struct
+{
+    uint32_t channel_count;
+    uint64_t sample_count;
+    uint64_t checksum;
+} decode_benchmark_data_t;
+
+// Checksums the first and last sample of each channel, which keeps the calling thread's share of the work small next to
+// the decode threads
+static void DecodeBenchmarkFrameCallback(const flac_frame_decoder_t* frame_decoder, void* callback_data)
+{
+    decode_benchmark_data_t* data = (decode_benchmark_data_t*)callback_data;
+    uint32_t sample_count = frame_decoder->frame_header.block_size_inter_channel_sampels;
+    for (uint32_t channel = 0; channel < data->channel_count; channel++)
+    {
+        data->checksum = (data->checksum * 31) + (uint32_t)frame_decoder->subframes[channel].samples[0];
+        data->checksum = (data->checksum * 31) + (uint32_t)frame_decoder->subframes[channel].samples[sample_count - 1];
+    }
+    data->sample_count += sample_count;
+}
+
+// Returns the time taken to decode the whole stream
+static double DecodeBenchmarkRun(flac_t* flac, uint32_t thread_count, decode_benchmark_data_t* data)
+{
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    data->channel_count = flac->streaminfo.channel_count;
+    data->sample_count = 0;
+    data->checksum = 0;
+    QueryPerformanceCounter(&timer_start);
+    FLACDecodeParallel(flac, thread_count, &DecodeBenchmarkFrameCallback, data);
+    QueryPerformanceCounter(&timer_end);
+
+    return (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+}
+
+// Returns the time taken to play back the whole stream with FLACLoadData(), the way the sound thread decodes it
+static double DecodeBenchmarkPlayback(song_t* song, byte_t* output)
+{
+    playback_data_t playback_data = { 0 };
+    playback_data.song_type = song->song_type;
+    playback_data.file = song->file;
+    playback_data.flac = song->flac;
+    playback_data.file_size = song->file_size;
+    playback_data.sample_rate = song->sample_rate;
+    playback_data.channel_count = song->channel_count;
+    playback_data.bps = song->bps;
+    playback_data.sample_format = song->sample_format;
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    FLACSeek(song->flac, 0);
+    QueryPerformanceCounter(&timer_start);
+    while (FLACLoadData(&playback_data, DECODE_BENCHMARK_OUTPUT_SIZE, output) > 0)
+    {
+        // Samples are only decoded
+    }
+    QueryPerformanceCounter(&timer_end);
+
+    return (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+}
+
+uint32_t DecodeBenchmarkFile(char* file_path, uint32_t thread_count_max)
+{
+    assert(file_path != NULL);
+
+    song_t song;
+    SongInit(&song);
+    song.song_path_offset = file_path;
+    song.song_type = SONG_TYPE_FLAC;
+    if (FLACLoadHeader(&song) != SONG_ERROR_NO)
+    {
+        printf("Unable to load FLAC file: %s\n", file_path);
+        return 1;
+    }
+    flac_t* flac = song.flac;
+
+    if (thread_count_max == 0)
+    {
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        thread_count_max = system_info.dwNumberOfProcessors;
+    }
+
+    // Reads the file into the file cache, and gives the checksum every run must match
+    decode_benchmark_data_t reference;
+    DecodeBenchmarkRun(flac, 1, &reference);
+    double seconds = (double)reference.sample_count / flac->streaminfo.sample_rate;
+    double megabytes = (double)flac->file_size / (1024.0 * 1024.0);
+    printf("File:           %s\n", file_path);
+    printf("Stream:         %u Hz, %u-bit, %u channels, %.1f s, %.1f MB\n", flac->streaminfo.sample_rate, flac->streaminfo.bits_per_sample, flac->streaminfo.channel_count, seconds, megabytes);
+
+    uint32_t mismatch_count = 0;
+    double single_thread_seconds = 0.0;
+    for (uint32_t thread_count = 1; thread_count <= thread_count_max; thread_count++)
+    {
+        double fastest_seconds = 0.0;
+        for (uint32_t run = 0; run < DECODE_BENCHMARK_RUN_COUNT; run++)
+        {
+            decode_benchmark_data_t data;
+            double run_seconds = DecodeBenchmarkRun(flac, thread_count, &data);
+            if ((data.sample_count != reference.sample_count) || (data.checksum != reference.checksum))
+            {
+                mismatch_count++;
+            }
+            if ((run == 0) || (run_seconds < fastest_seconds))
+            {
+                fastest_seconds = run_seconds;
+            }
+        }
+        if (thread_count == 1)
+        {
+            single_thread_seconds = fastest_seconds;
+        }
+
+        printf("%2u %-12s %.3f s", thread_count, (thread_count == 1) ? "thread" : "threads", fastest_seconds);
+        if (fastest_seconds > 0.0)
+        {
+            double speedup = single_thread_seconds / fastest_seconds;
+            printf(", %.1f MB/s, %.0fx real-time, speedup %.2fx (%.0f%% of linear)", megabytes / fastest_seconds, seconds / fastest_seconds, speedup, 100.0 * speedup / thread_count);
+        }
+        printf("\n");
+    }
+
+    // The CRC checks are timed on the single-threaded playback path, alternating between them being off and on
+    byte_t* output = (byte_t*)malloc(DECODE_BENCHMARK_OUTPUT_SIZE);
+    double crc_seconds[2] = { 0.0, 0.0 };
+    for (uint32_t run = 0; run < DECODE_BENCHMARK_RUN_COUNT; run++)
+    {
+        for (uint8_t crc_check_enabled = 0; crc_check_enabled <= 1; crc_check_enabled++)
+        {
+            flac->crc_check_enabled = crc_check_enabled;
+            double run_seconds = DecodeBenchmarkPlayback(&song, output);
+            if ((run == 0) || (run_seconds < crc_seconds[crc_check_enabled]))
+            {
+                crc_seconds[crc_check_enabled] = run_seconds;
+            }
+        }
+    }
+    flac->crc_check_enabled = 1;
+    free(output);
+    printf("CRC checks:     off %.3f s, on %.3f s", crc_seconds[0], crc_seconds[1]);
+    if (crc_seconds[0] > 0.0)
+    {
+        printf(", %.1f%% of decode time", 100.0 * (crc_seconds[1] - crc_seconds[0]) / crc_seconds[1]);
+    }
+    printf(" (playback, 16-bit output)\n");
+
+    if (mismatch_count > 0)
+    {
+        printf("Mismatched:     %u runs\n", mismatch_count);
+    }
+
+    SongFreeAudioData(&song);
+    return mismatch_count;
+}
\ No newline at end of file
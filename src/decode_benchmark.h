@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef DECODE_BENCHMARK_H
+#define DECODE_BENCHMARK_H
+
+#include <stdint.h>
+
+/**
+ * Times decoding a FLAC file with FLACDecodeParallel() on every thread count from 1 to 'thread_count_max', and prints
+ * the throughput and the speedup over a single thread. A 'thread_count_max' of 0 goes up to one thread per logical
+ * processor.
+ * 
+ * The file is decoded once before timing, so that it's read from the file cache, and each thread count takes the fastest
+ * of DECODE_BENCHMARK_RUN_COUNT runs. The frames of every run are checksummed, as a check that the threads decode the
+ * same samples no matter how many there are.
+ * 
+ * It then times playing back the file with FLACLoadData() with the CRC checks of 'crc_check_enabled' off and on, and
+ * prints the share of the decode time the checks take.
+ * 
+ * Returns number of runs that didn't decode to the same samples, or 1 if the file couldn't be decoded
+*/
+uint32_t DecodeBenchmarkFile(char* file_path, uint32_t thread_count_max);
+
+#endif
\ No newline at end of file
@@ -18,7 +18,10 @@
 
 #include "macros.h"
 #include "dft.h"
+#include "fft.h"
+#include "sample_convert.h"
 
+#include <assert.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -29,17 +32,17 @@
 // TODO (Daniel): optimize
 void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* frequency_bands)
 {
-    static float dft_real[DFT_N];
-    static float dft_imaginary[DFT_N];
-    memset(dft_real, 0, DFT_N * sizeof(float));
-    memset(dft_imaginary, 0, DFT_N * sizeof(float));
+    static float dft_real[DFT_DEFAULT_N];
+    static float dft_imaginary[DFT_DEFAULT_N];
+    memset(dft_real, 0, DFT_DEFAULT_N * sizeof(float));
+    memset(dft_imaginary, 0, DFT_DEFAULT_N * sizeof(float));
 
     // Offsets into actual audio data
     byte* audio_data_start = wav->audio_data + (sample_start * wav->bps * wav->channel_count);
     byte* audio_data_end = wav->audio_data + (sample_end * wav->bps * wav->channel_count);
 
     const int32_t sample_count = (int32_t)sample_end - (int32_t)sample_start;
-    const int32_t iteration_count = (sample_count + DFT_N - 1) / DFT_N; // Round up
+    const int32_t iteration_count = (sample_count + DFT_DEFAULT_N - 1) / DFT_DEFAULT_N; // Round up
     float sample_max_value;
     if (wav->bps == 1)
     {
@@ -53,14 +56,14 @@ void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* freq
     for (int32_t i = 0; i < iteration_count; i++)
     {
         // For each bin
-        for (int32_t k = 0; k < DFT_N; k++)
+        for (int32_t k = 0; k < DFT_DEFAULT_N; k++)
         {
             float real = 0.0f;
             float imaginary = 0.0f;
             // For each sample
-            for (int32_t n = 0; n < DFT_N; n++)
+            for (int32_t n = 0; n < DFT_DEFAULT_N; n++)
             {
-                int32_t sample_index = (i * DFT_N) + n;
+                int32_t sample_index = (i * DFT_DEFAULT_N) + n;
                 if (sample_index <= sample_count)
                 {
                     int16_t* sample_left = (int16_t*)(audio_data_start + (n * wav->bps * wav->channel_count));
@@ -69,8 +72,8 @@ void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* freq
                     float sample_right_f = (float)*sample_right / sample_max_value;
                     float sample_avg = (sample_left_f + sample_right_f) * 0.5f; // / 2.0f
 
-                    real += sample_avg * cosf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_N);
-                    imaginary -= sample_avg * sinf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_N);
+                    real += sample_avg * cosf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_DEFAULT_N);
+                    imaginary -= sample_avg * sinf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_DEFAULT_N);
                 }
                 else
                 {
@@ -87,11 +90,11 @@ void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* freq
 
     // Compute frequency magnitude for bins
     // i = 1 -> skip DC-term
-    for (int32_t i = 1; i < DFT_BAND_COUNT; i++)
+    for (int32_t i = 1; i < (DFT_DEFAULT_N / 2); i++)
     {
         float real = dft_real[i];
         float imaginary = dft_imaginary[i];
-        float magnitude = 2.0f * sqrtf((real * real) + (imaginary * imaginary)) / (float)DFT_N;
+        float magnitude = 2.0f * sqrtf((real * real) + (imaginary * imaginary)) / (float)DFT_DEFAULT_N;
 
         // In order to get more smooth drops in the magnitude, we don't jump straigt from the current
         // to the next one if it's lower than the current magnitude. Instead we scale down the current
@@ -117,46 +120,218 @@ void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* freq
     }
 }
 
-void DFTComputeRAW(byte* audio_data, int32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, float* frequency_bands)
+// Channels of a window that are converted to floats, which is as many as an audio device is opened with
+#define DFT_MAX_CHANNEL_COUNT 8
+// The benchmark times the reference on few windows, as each takes milliseconds
+#define DFT_BENCHMARK_REFERENCE_ITERATION_COUNT 20
+#define DFT_BENCHMARK_FFT_ITERATION_COUNT 20000
+// Largest difference of a band between the FFT and the reference, which sum in a different order
+#define DFT_BENCHMARK_TOLERANCE 0.0001f
+
+// Current analysis, set by DFTSetAnalysis(). The window table holds the window function for 'dft_n' samples, and the
+// magnitude scale is 2 / the sum of the window, which turns the magnitude of a bin into the amplitude of a tone in it
+static uint32_t dft_n = 0;
+static dft_window_e dft_window_type = DFT_WINDOW_RECTANGULAR;
+static fft_t dft_fft = { 0 };
+static float dft_window_table[DFT_MAX_N];
+static float dft_magnitude_scale = 0.0f;
+
+static const char* dft_window_names[DFT_WINDOW_COUNT] = { "rectangular", "hann", "blackman_harris", "flat_top" };
+
+uint8_t DFTSetAnalysis(uint32_t n, dft_window_e window)
 {
-    static float dft_real[DFT_N];
-    static float dft_imaginary[DFT_N];
-    memset(dft_real, 0, DFT_N * sizeof(float));
-    memset(dft_imaginary, 0, DFT_N * sizeof(float));
+    if ((n < DFT_MIN_N) || (n > DFT_MAX_N) || ((n & (n - 1)) != 0) || ((uint32_t)window >= DFT_WINDOW_COUNT))
+    {
+        return 0;
+    }
 
-    // Offsets into actual audio data
-    const int32_t iteration_count = (sample_count + DFT_N - 1) / DFT_N; // Round up
-    float sample_max_value;
-    if (bps == 1)
+    if (n != dft_n)
     {
-        sample_max_value = (float)UINT8_MAX;
+        fft_t fft;
+        if (FFTInit(&fft, n) == 0)
+        {
+            return 0;
+        }
+        if (dft_fft.size != 0)
+        {
+            FFTFree(&dft_fft);
+        }
+        dft_fft = fft;
     }
-    else // bps == 2
+
+    dft_magnitude_scale = DFTComputeWindowTable(n, window, dft_window_table);
+    dft_n = n;
+    dft_window_type = window;
+    return 1;
+}
+
+float DFTComputeWindowTable(uint32_t n, dft_window_e window, float* window_table)
+{
+    // The windows are periodic over 'n' samples (the "DFT-even" form), like the transform treats the window, so that a
+    // tone in a bin leaks the same into its neighbours on both sides
+    double window_sum = 0.0;
+    for (uint32_t i = 0; i < n; i++)
     {
-        sample_max_value = (float)INT16_MAX;
+        double phase = (2.0 * 3.14159265358979323846 * (double)i) / (double)n;
+        double value = 1.0;
+        switch (window)
+        {
+            case DFT_WINDOW_HANN:
+            {
+                value = 0.5 - (0.5 * cos(phase));
+            } break;
+
+            case DFT_WINDOW_BLACKMAN_HARRIS:
+            {
+                value = 0.35875 - (0.48829 * cos(phase)) + (0.14128 * cos(2.0 * phase)) - (0.01168 * cos(3.0 * phase));
+            } break;
+
+            case DFT_WINDOW_FLAT_TOP:
+            {
+                value = 0.21557895 - (0.41663158 * cos(phase)) + (0.277263158 * cos(2.0 * phase)) - (0.083578947 * cos(3.0 * phase)) + (0.006947368 * cos(4.0 * phase));
+            } break;
+
+            default: {} break;
+        }
+        window_table[i] = (float)value;
+        window_sum += value;
+    }
+
+    return (float)(2.0 / window_sum);
+}
+
+// The analysis is set up the first time it's needed, if nothing has set it before
+static void DFTInitAnalysis(void)
+{
+    if (dft_n == 0)
+    {
+        DFTSetAnalysis(DFT_DEFAULT_N, DFT_WINDOW_RECTANGULAR);
+    }
+}
+
+uint32_t DFTGetN(void)
+{
+    DFTInitAnalysis();
+    return dft_n;
+}
+
+uint32_t DFTGetFrequencyBandCount(void)
+{
+    DFTInitAnalysis();
+    return (dft_n / 2) - 1;
+}
+
+dft_window_e DFTGetWindow(void)
+{
+    return dft_window_type;
+}
+
+const char* DFTGetWindowName(dft_window_e window)
+{
+    return ((uint32_t)window < DFT_WINDOW_COUNT) ? dft_window_names[window] : "";
+}
+
+void DFTComputeColumns(const float* frequency_bands, uint32_t frequency_band_count, float* columns)
+{
+    assert((frequency_band_count > 0) && (frequency_band_count <= DFT_MAX_FREQUENCY_BAND_COUNT));
+
+    for (uint32_t column = 0; column < DFT_COLUMN_COUNT; column++)
+    {
+        // Bands [band_start, band_end), at least the one the column starts in when there are fewer bands than columns
+        uint32_t band_start = (column * frequency_band_count) / DFT_COLUMN_COUNT;
+        uint32_t band_end = ((column + 1) * frequency_band_count) / DFT_COLUMN_COUNT;
+        if (band_end <= band_start)
+        {
+            band_end = band_start + 1;
+        }
+        float column_value = frequency_bands[band_start];
+        for (uint32_t band = band_start + 1; band < band_end; band++)
+        {
+            if (frequency_bands[band] > column_value)
+            {
+                column_value = frequency_bands[band];
+            }
+        }
+        columns[column] = column_value;
+    }
+}
+
+// Loads the first 'dft_n' samples of 'audio_data' into 'window', zero-padded if there are fewer, and multiplied with the
+// window table. The samples are converted to planar floats in one go, whatever format they're played back in, and the
+// first two channels are averaged
+static void DFTLoadWindow(const byte_t* audio_data, int32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, sample_format_e sample_format, float* window)
+{
+    static float dft_samples[DFT_MAX_N * DFT_MAX_CHANNEL_COUNT];
+    uint32_t channel_count = bytes_per_sample_all_channels / bps;
+    assert((channel_count > 0) && (channel_count <= DFT_MAX_CHANNEL_COUNT));
+    int32_t window_sample_count = (sample_count < (int32_t)dft_n) ? sample_count : (int32_t)dft_n;
+    SampleConvert(SampleConvertFormat(bps, sample_format), 0, audio_data, SAMPLE_CONVERT_FORMAT_F32, 1, dft_samples, channel_count, window_sample_count);
+    const float* samples_left = dft_samples;
+    const float* samples_right = (channel_count > 1) ? (dft_samples + window_sample_count) : dft_samples;
+    for (int32_t n = 0; n < window_sample_count; n++)
+    {
+        window[n] = (samples_left[n] + samples_right[n]) * 0.5f * dft_window_table[n]; // / 2.0f
+    }
+    for (int32_t n = window_sample_count; n < (int32_t)dft_n; n++)
+    {
+        window[n] = 0.0f;
+    }
+}
+// Moves band 'i' towards 'magnitude'.
+// In order to get more smooth drops in the magnitude, we don't jump straigt from the current
+// to the next one if it's lower than the current magnitude. Instead we scale down the current
+// magnitude, and check that we haven't gone too far
+static void DFTUpdateBand(float* frequency_bands, int32_t i, float magnitude)
+{
+    float magnitude_scaling = 0.75f;
+    float current_magnitude = frequency_bands[i];
+    if (magnitude >= current_magnitude)
+    {
+        current_magnitude = magnitude;
+    }
+    else
+    {
+        // Scale
+        current_magnitude *= magnitude_scaling;
+
+        // Ensure we haven't gone past the new magnitude
+        if (current_magnitude < magnitude)
+        {
+            current_magnitude = magnitude;
+        }
     }
+    frequency_bands[i] = current_magnitude;
+}
+
+// The DFT as it was computed before the FFT, evaluating every term of every bin, which the benchmark compares against
+static void DFTComputeRAWReference(byte* audio_data, int32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, sample_format_e sample_format, float* frequency_bands)
+{
+    static float dft_real[DFT_MAX_N];
+    static float dft_imaginary[DFT_MAX_N];
+    static float dft_window[DFT_MAX_N];
+    const int32_t n_count = (int32_t)dft_n;
+    memset(dft_real, 0, n_count * sizeof(float));
+    memset(dft_imaginary, 0, n_count * sizeof(float));
+    DFTLoadWindow(audio_data, sample_count, bps, bytes_per_sample_all_channels, sample_format, dft_window);
+
+    // Offsets into actual audio data
+    const int32_t iteration_count = (sample_count + n_count - 1) / n_count; // Round up
     // For each iteration
     for (int32_t i = 0; i < iteration_count; i++)
     {
         // For each bin
-        for (int32_t k = 0; k < DFT_N; k++)
+        for (int32_t k = 0; k < n_count; k++)
         {
             float real = 0.0f;
             float imaginary = 0.0f;
             // For each sample
-            for (int32_t n = 0; n < DFT_N; n++)
+            for (int32_t n = 0; n < n_count; n++)
             {
-                int32_t sample_index = (i * DFT_N) + n;
-                if (sample_index <= sample_count)
+                int32_t sample_index = (i * n_count) + n;
+                if (sample_index < sample_count)
                 {
-                    int16_t* sample_left = (int16_t*)(audio_data + (n * bytes_per_sample_all_channels));
-                    int16_t* sample_right = sample_left + 1;
-                    float sample_left_f = (float)*sample_left / sample_max_value;
-                    float sample_right_f = (float)*sample_right / sample_max_value;
-                    float sample_avg = (sample_left_f + sample_right_f) * 0.5f; // / 2.0f
-
-                    real += sample_avg * cosf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_N);
-                    imaginary -= sample_avg * sinf((MATH_TWO_PI * (float)k * (float)n) / (float)DFT_N);
+                    real += dft_window[n] * cosf((MATH_TWO_PI * (float)k * (float)n) / (float)n_count);
+                    imaginary -= dft_window[n] * sinf((MATH_TWO_PI * (float)k * (float)n) / (float)n_count);
                 }
                 else
                 {
@@ -173,33 +348,135 @@ void DFTComputeRAW(byte* audio_data, int32_t sample_count, int16_t bps, int16_t
 
     // Compute frequency magnitude for bins
     // i = 1 -> skip DC-term
-    for (int32_t i = 1; i < DFT_BAND_COUNT; i++)
+    for (int32_t i = 1; i < (n_count / 2); i++)
     {
         float real = dft_real[i];
         float imaginary = dft_imaginary[i];
-        float magnitude = 2.0f * sqrtf((real * real) + (imaginary * imaginary)) / (float)DFT_N;
+        float magnitude = sqrtf((real * real) + (imaginary * imaginary)) * dft_magnitude_scale;
+        DFTUpdateBand(frequency_bands, i - 1, magnitude);
+    }
+}
 
-        // In order to get more smooth drops in the magnitude, we don't jump straigt from the current
-        // to the next one if it's lower than the current magnitude. Instead we scale down the current
-        // magnitude, and check that we haven't gone too far
-        float magnitude_scaling = 0.75f;
-        float current_magnitude = frequency_bands[i - 1];
-        if (magnitude >= current_magnitude)
+// Transforms the windowed samples in 'window' in place, and writes the magnitude of each band to 'magnitudes'
+static void DFTTransformWindow(float* window, float* magnitudes)
+{
+    FFTForwardReal(&dft_fft, window);
+
+    // Compute frequency magnitude for bins
+    // i = 1 -> skip DC-term
+    const int32_t band_count = (int32_t)(dft_n / 2);
+    for (int32_t i = 1; i < band_count; i++)
+    {
+        float real = window[(i * 2)];
+        float imaginary = window[(i * 2) + 1];
+        magnitudes[i - 1] = sqrtf((real * real) + (imaginary * imaginary)) * dft_magnitude_scale;
+    }
+}
+
+void DFTComputeMagnitudes(const float* samples, float* magnitudes)
+{
+    // The window is transformed in place
+    static float dft_window[DFT_MAX_N];
+    DFTInitAnalysis();
+    for (uint32_t n = 0; n < dft_n; n++)
+    {
+        dft_window[n] = samples[n] * dft_window_table[n];
+    }
+    DFTTransformWindow(dft_window, magnitudes);
+}
+
+void DFTUpdateBands(float* frequency_bands, const float* magnitudes)
+{
+    const int32_t frequency_band_count = (int32_t)DFTGetFrequencyBandCount();
+    for (int32_t i = 0; i < frequency_band_count; i++)
+    {
+        DFTUpdateBand(frequency_bands, i, magnitudes[i]);
+    }
+}
+
+void DFTComputeRAW(byte* audio_data, int32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, sample_format_e sample_format, float* frequency_bands)
+{
+    // The window is transformed in place
+    static float dft_window[DFT_MAX_N];
+    static float dft_magnitudes[DFT_MAX_FREQUENCY_BAND_COUNT];
+    DFTInitAnalysis();
+    DFTLoadWindow(audio_data, sample_count, bps, bytes_per_sample_all_channels, sample_format, dft_window);
+    DFTTransformWindow(dft_window, dft_magnitudes);
+    DFTUpdateBands(frequency_bands, dft_magnitudes);
+}
+
+uint32_t DFTBenchmark(void)
+{
+    // One window of stereo 16-bit samples: a few tones between bins, and noise
+    static int16_t samples[DFT_DEFAULT_N * 2];
+    uint32_t random = 0x9E3779B9u;
+    for (int32_t n = 0; n < DFT_DEFAULT_N; n++)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        float noise = ((float)(random & 0xFFFF) / 65536.0f) - 0.5f;
+        float tones = (0.4f * sinf(MATH_TWO_PI * 10.5f * (float)n / (float)DFT_DEFAULT_N)) +
+                      (0.2f * sinf(MATH_TWO_PI * 63.0f * (float)n / (float)DFT_DEFAULT_N)) +
+                      (0.1f * cosf(MATH_TWO_PI * 200.25f * (float)n / (float)DFT_DEFAULT_N));
+        samples[(n * 2)] = (int16_t)((tones + (0.05f * noise)) * 32767.0f);
+        samples[(n * 2) + 1] = (int16_t)((tones - (0.05f * noise)) * 32767.0f);
+    }
+
+    // Bands start at 0 so that each call sets them to the window's magnitudes
+    static float reference_bands[(DFT_DEFAULT_N / 2) - 1];
+    static float fft_bands[(DFT_DEFAULT_N / 2) - 1];
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    uint32_t previous_n = DFTGetN();
+    dft_window_e previous_window = DFTGetWindow();
+    uint32_t mismatch_count = 0;
+
+    printf("Window:         %i samples, %i bands\n", DFT_DEFAULT_N, (DFT_DEFAULT_N / 2) - 1);
+    for (uint32_t window = 0; window < DFT_WINDOW_COUNT; window++)
+    {
+        DFTSetAnalysis(DFT_DEFAULT_N, (dft_window_e)window);
+
+        QueryPerformanceCounter(&timer_start);
+        for (uint32_t i = 0; i < DFT_BENCHMARK_REFERENCE_ITERATION_COUNT; i++)
         {
-            current_magnitude = magnitude;
+            memset(reference_bands, 0, sizeof(reference_bands));
+            DFTComputeRAWReference((byte*)samples, DFT_DEFAULT_N, sizeof(int16_t), 2 * sizeof(int16_t), SAMPLE_FORMAT_INT, reference_bands);
         }
-        else
+        QueryPerformanceCounter(&timer_end);
+        double reference_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart / DFT_BENCHMARK_REFERENCE_ITERATION_COUNT;
+
+        QueryPerformanceCounter(&timer_start);
+        for (uint32_t i = 0; i < DFT_BENCHMARK_FFT_ITERATION_COUNT; i++)
         {
-            // Scale
-            current_magnitude *= magnitude_scaling;
+            memset(fft_bands, 0, sizeof(fft_bands));
+            DFTComputeRAW((byte*)samples, DFT_DEFAULT_N, sizeof(int16_t), 2 * sizeof(int16_t), SAMPLE_FORMAT_INT, fft_bands);
+        }
+        QueryPerformanceCounter(&timer_end);
+        double fft_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart / DFT_BENCHMARK_FFT_ITERATION_COUNT;
 
-            // Ensure we haven't gone past the new magnitude
-            if (current_magnitude < magnitude)
+        float max_difference = 0.0f;
+        for (int32_t i = 0; i < (DFT_DEFAULT_N / 2) - 1; i++)
+        {
+            float difference = fabsf(fft_bands[i] - reference_bands[i]);
+            if (difference > max_difference)
             {
-                current_magnitude = magnitude;
+                max_difference = difference;
             }
         }
-        current_magnitude = magnitude;
-        frequency_bands[i - 1] = current_magnitude;
+        if (max_difference > DFT_BENCHMARK_TOLERANCE)
+        {
+            mismatch_count += 1;
+        }
+
+        printf("%-16s DFT %.1f us, FFT %.2f us", DFTGetWindowName((dft_window_e)window), reference_seconds * 1000000.0, fft_seconds * 1000000.0);
+        if (fft_seconds > 0.0)
+        {
+            printf(", speedup %.0fx", reference_seconds / fft_seconds);
+        }
+        printf(", max difference %g (tolerance %g)\n", max_difference, DFT_BENCHMARK_TOLERANCE);
     }
+
+    DFTSetAnalysis(previous_n, previous_window);
+    return (mismatch_count == 0) ? 0 : 1;
 }
\ No newline at end of file
@@ -24,17 +24,73 @@
 #include <windows.h>
 
 // To avoid having to compute too many DFT windows per frame (if the frame time is high) we have a maximum
-#define DFT_MAX_WINDOWS 2
-// Number of samples in the window processed through each iteration of the DFT
-#define DFT_N 512
-// Number of frequency bands we get when using DFT_N samples
-// Half of DFT_N because the other half are redundant complex conjugats
-#define DFT_BAND_COUNT 256 // DFT_N / 2
-// Number of "usable" frequency bands
-// Band 0 is the DC-term (the 0Hz term, which is the average of all the other frequency bands in the sample window)
-#define DFT_FREQUENCY_BAND_COUNT 255 // DFT_BAND_COUNT - 1
+#define DFT_MAX_WINDOWS 8
+// Number of samples in the window processed through each iteration of the DFT, which is set at runtime to a power of 2
+// between DFT_MIN_N and DFT_MAX_N
+#define DFT_MIN_N 256
+#define DFT_MAX_N 65536
+#define DFT_DEFAULT_N 512
+// We get N / 2 frequency bands when using N samples, because the other half are redundant complex conjugats.
+// Band 0 is the DC-term (the 0Hz term, which is the average of all the other frequency bands in the sample window),
+// so N / 2 - 1 are "usable", and this many at most
+#define DFT_MAX_FREQUENCY_BAND_COUNT ((DFT_MAX_N / 2) - 1)
+// Columns the visualizer shows, as DFT_FREQUENCY_BAND_COUNT in scene_columns.frag, which are the bands of DFT_DEFAULT_N
+#define DFT_COLUMN_COUNT ((DFT_DEFAULT_N / 2) - 1)
 
-void DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* frequency_bands);
-void DFTComputeRAW(byte* audio_data, int32_t sample_count, int16_t bits_per_sample, int16_t bytes_per_sample_all_channels, float* frequency_bands);
+// Window function the samples are multiplied with before they are transformed. A rectangular window leaves them as they
+// are, which is sharpest but leaks the most between bands. Hann, Blackman-Harris and flat-top leak less and less at the
+// cost of wider peaks, and flat-top measures the amplitude of a tone between two bins best
+typedef enum
+{
+    DFT_WINDOW_RECTANGULAR,
+    DFT_WINDOW_HANN,
+    DFT_WINDOW_BLACKMAN_HARRIS,
+    DFT_WINDOW_FLAT_TOP,
+    DFT_WINDOW_COUNT
+} dft_window_e;
+
+/**
+ * DFTSetAnalysis() sets the number of samples 'n' transformed per window, a power of 2 between DFT_MIN_N and DFT_MAX_N,
+ * and the window function they are multiplied with, and precomputes the FFT and window tables for them. Until it's
+ * called the analysis is DFT_DEFAULT_N samples with a rectangular window. Bands computed before don't line up with the
+ * new ones if 'n' changed, so they should be cleared.
+ * Returns 1 on success, 0 if 'n' or 'window' isn't supported, in which case the analysis is left as it was
+ * 
+ * DFTGetN(), DFTGetFrequencyBandCount() and DFTGetWindow() return the current analysis, which has DFTGetN() / 2 - 1
+ * bands. DFTGetWindowName() returns the name of 'window' as commands spell it.
+ * 
+ * DFTComputeColumns() writes the DFT_COLUMN_COUNT columns the visualizer shows of the 'frequency_band_count' bands in
+ * 'frequency_bands' to 'columns'. Each column covers an equal share of the bands and shows the loudest of them, so a peak
+ * isn't lost between columns. There is one band per column at DFT_DEFAULT_N, and a band spans several columns below it.
+ * 
+ * DFTComputeWindowTable() writes the 'n' values of 'window' that samples are multiplied with to 'window_table', without
+ * changing the analysis, for transforms done elsewhere.
+ * Returns the scale that turns the magnitude of a bin into the amplitude of a tone in it, 2 / the sum of the window
+ * 
+ * DFTComputeRAW() moves the DFTGetFrequencyBandCount() magnitudes in 'frequency_bands' towards those of the first
+ * DFTGetN() samples of 'audio_data', averaged over the first two channels, zero-padded and windowed, with a real-input
+ * FFT. Magnitudes are divided by the window's coherent gain, so a tone has about the same height whatever the window.
+ * Bands jump up to a louder magnitude, and fall off to a quieter one.
+ * 
+ * DFTComputeMagnitudes() writes the DFTGetFrequencyBandCount() magnitudes of the DFTGetN() mono samples in 'samples',
+ * windowed, to 'magnitudes'. DFTUpdateBands() moves 'frequency_bands' towards 'magnitudes' like DFTComputeRAW() does.
+ * 
+ * DFTBenchmark() times DFTComputeRAW() against evaluating the DFT term by term, as it was before, on one window of
+ * DFT_DEFAULT_N stereo 16-bit samples with each window function, and prints both and the speedup. The analysis is
+ * restored afterwards.
+ * Returns 0 if their bands match within tolerance, 1 otherwise
+*/
+uint8_t      DFTSetAnalysis(uint32_t n, dft_window_e window);
+uint32_t     DFTGetN(void);
+uint32_t     DFTGetFrequencyBandCount(void);
+dft_window_e DFTGetWindow(void);
+const char*  DFTGetWindowName(dft_window_e window);
+void         DFTComputeColumns(const float* frequency_bands, uint32_t frequency_band_count, float* columns);
+float        DFTComputeWindowTable(uint32_t n, dft_window_e window, float* window_table);
+void         DFTComputeWAV(wav_t* wav, DWORD sample_start, DWORD sample_end, float* frequency_bands);
+uint32_t     DFTBenchmark(void);
+void         DFTComputeMagnitudes(const float* samples, float* magnitudes);
+void         DFTUpdateBands(float* frequency_bands, const float* magnitudes);
+void         DFTComputeRAW(byte* audio_data, int32_t sample_count, int16_t bits_per_sample, int16_t bytes_per_sample_all_channels, sample_format_e sample_format, float* frequency_bands);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "fft.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+
+#define FFT_TWO_PI 6.283185307179586
+
+uint8_t FFTInit(fft_t* fft, uint32_t size)
+{
+    assert(fft != NULL);
+
+    if ((size < 4) || ((size & (size - 1)) != 0))
+    {
+        return 0;
+    }
+
+    uint32_t point_count = size / 2;
+    uint32_t bit_count = 0;
+    while ((1u << bit_count) < point_count)
+    {
+        bit_count++;
+    }
+
+    fft->size = size;
+    fft->bit_reverse = (uint32_t*)malloc(point_count * sizeof(uint32_t));
+    fft->twiddles = (float*)malloc(point_count * 2 * sizeof(float));
+    fft->real_twiddles = (float*)malloc(((size / 4) + 1) * 2 * sizeof(float));
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        uint32_t reversed = 0;
+        for (uint32_t bit = 0; bit < bit_count; bit++)
+        {
+            reversed |= ((i >> bit) & 1) << (bit_count - 1 - bit);
+        }
+        fft->bit_reverse[i] = reversed;
+
+        // Computed in double so that the error doesn't grow with the index
+        double angle = (FFT_TWO_PI * (double)i) / (double)point_count;
+        fft->twiddles[(i * 2)] = (float)cos(angle);
+        fft->twiddles[(i * 2) + 1] = (float)-sin(angle);
+    }
+    for (uint32_t i = 0; i <= size / 4; i++)
+    {
+        double angle = (FFT_TWO_PI * (double)i) / (double)size;
+        fft->real_twiddles[(i * 2)] = (float)cos(angle);
+        fft->real_twiddles[(i * 2) + 1] = (float)-sin(angle);
+    }
+    return 1;
+}
+
+// Multiplies (real, imaginary) by the twiddle factor at 'twiddle'
+static inline void FFTMultiply(const float* twiddle, float real, float imaginary, float* product_real, float* product_imaginary)
+{
+    *product_real = (real * twiddle[0]) - (imaginary * twiddle[1]);
+    *product_imaginary = (real * twiddle[1]) + (imaginary * twiddle[0]);
+}
+
+// Transforms the 'point_count' complex points in 'points' in place, which are in natural order on the way out
+static void FFTComplex(const fft_t* fft, float* points, uint32_t point_count)
+{
+    // Bit-reversal permutation, each pair swapped once
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        uint32_t j = fft->bit_reverse[i];
+        if (i < j)
+        {
+            float real = points[(i * 2)];
+            float imaginary = points[(i * 2) + 1];
+            points[(i * 2)] = points[(j * 2)];
+            points[(i * 2) + 1] = points[(j * 2) + 1];
+            points[(j * 2)] = real;
+            points[(j * 2) + 1] = imaginary;
+        }
+    }
+
+    // An odd power of 2 starts with a radix-2 pass over pairs of points, which needs no twiddles
+    uint32_t length = 1;
+    uint32_t pass_count = 0;
+    while ((1u << pass_count) < point_count)
+    {
+        pass_count++;
+    }
+    if ((pass_count & 1) == 1)
+    {
+        for (uint32_t i = 0; i < point_count; i += 2)
+        {
+            float* a = points + (i * 2);
+            float* b = a + 2;
+            float real = b[0];
+            float imaginary = b[1];
+            b[0] = a[0] - real;
+            b[1] = a[1] - imaginary;
+            a[0] += real;
+            a[1] += imaginary;
+        }
+        length = 2;
+    }
+
+    // Each radix-4 pass combines 4 transforms of 'length' points into one of 4 * 'length'. After the bit reversal, the
+    // transforms of the points at indices 0, 2, 1 and 3 modulo 4 follow one another, so the second and third are swapped
+    // in the butterfly.
+    for (; length < point_count; length *= 4)
+    {
+        uint32_t twiddle_stride = point_count / (length * 4);
+        for (uint32_t block = 0; block < point_count; block += length * 4)
+        {
+            for (uint32_t j = 0; j < length; j++)
+            {
+                float* x0 = points + ((block + j) * 2);
+                float* x1 = x0 + (length * 2);
+                float* x2 = x1 + (length * 2);
+                float* x3 = x2 + (length * 2);
+
+                float t0_real = x0[0];
+                float t0_imaginary = x0[1];
+                float t1_real, t1_imaginary, t2_real, t2_imaginary, t3_real, t3_imaginary;
+                FFTMultiply(fft->twiddles + (j * twiddle_stride * 2), x2[0], x2[1], &t1_real, &t1_imaginary);
+                FFTMultiply(fft->twiddles + (j * twiddle_stride * 4), x1[0], x1[1], &t2_real, &t2_imaginary);
+                FFTMultiply(fft->twiddles + (j * twiddle_stride * 6), x3[0], x3[1], &t3_real, &t3_imaginary);
+
+                float a_real = t0_real + t2_real;
+                float a_imaginary = t0_imaginary + t2_imaginary;
+                float b_real = t0_real - t2_real;
+                float b_imaginary = t0_imaginary - t2_imaginary;
+                float c_real = t1_real + t3_real;
+                float c_imaginary = t1_imaginary + t3_imaginary;
+                float d_real = t1_real - t3_real;
+                float d_imaginary = t1_imaginary - t3_imaginary;
+
+                // X[j] = a + c, X[j + L] = b - i*d, X[j + 2L] = a - c, X[j + 3L] = b + i*d
+                x0[0] = a_real + c_real;
+                x0[1] = a_imaginary + c_imaginary;
+                x1[0] = b_real + d_imaginary;
+                x1[1] = b_imaginary - d_real;
+                x2[0] = a_real - c_real;
+                x2[1] = a_imaginary - c_imaginary;
+                x3[0] = b_real - d_imaginary;
+                x3[1] = b_imaginary + d_real;
+            }
+        }
+    }
+}
+
+void FFTForwardReal(const fft_t* fft, float* data)
+{
+    assert(fft != NULL);
+    assert(data != NULL);
+
+    uint32_t point_count = fft->size / 2;
+    FFTComplex(fft, data, point_count);
+
+    // The transform Z of the points z[n] = x[2n] + i*x[2n + 1] holds the transforms of the even and odd samples:
+    //  E[k] = (Z[k] + conj(Z[M - k])) / 2
+    //  O[k] = (Z[k] - conj(Z[M - k])) / 2i
+    // and X[k] = E[k] + W^k * O[k], X[M - k] = conj(E[k] - W^k * O[k]) with W = exp(-2*pi*i / N), so bins k and M - k
+    // are computed together from the points they replace
+    float z0_real = data[0];
+    float z0_imaginary = data[1];
+    data[0] = z0_real + z0_imaginary;
+    data[1] = z0_real - z0_imaginary;
+    for (uint32_t k = 1; k <= point_count / 2; k++)
+    {
+        float* a = data + (k * 2);
+        float* b = data + ((point_count - k) * 2);
+        float even_real = (a[0] + b[0]) * 0.5f;
+        float even_imaginary = (a[1] - b[1]) * 0.5f;
+        float odd_real = (a[1] + b[1]) * 0.5f;
+        float odd_imaginary = (b[0] - a[0]) * 0.5f;
+        float odd_twiddled_real, odd_twiddled_imaginary;
+        FFTMultiply(fft->real_twiddles + (k * 2), odd_real, odd_imaginary, &odd_twiddled_real, &odd_twiddled_imaginary);
+
+        a[0] = even_real + odd_twiddled_real;
+        a[1] = even_imaginary + odd_twiddled_imaginary;
+        b[0] = even_real - odd_twiddled_real;
+        b[1] = odd_twiddled_imaginary - even_imaginary;
+    }
+}
+
+void FFTFree(fft_t* fft)
+{
+    assert(fft != NULL);
+
+    free(fft->bit_reverse);
+    free(fft->twiddles);
+    free(fft->real_twiddles);
+    fft->bit_reverse = NULL;
+    fft->twiddles = NULL;
+    fft->real_twiddles = NULL;
+}
\ No newline at end of file
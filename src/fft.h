@@ -0,0 +1,50 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+
+// Tables for transforms of one size, computed once so that a transform does no trigonometry and allocates nothing
+typedef struct
+{
+    uint32_t  size; // Real samples per transform, a power of 2 of at least 4
+    uint32_t* bit_reverse; // Index of each of the 'size' / 2 complex points after the bit-reversal permutation
+    float*    twiddles; // exp(-2*pi*i*k / ('size' / 2)) for k < 'size' / 2, as (real, imaginary) pairs
+    float*    real_twiddles; // exp(-2*pi*i*k / 'size') for k <= 'size' / 4, as (real, imaginary) pairs
+} fft_t;
+
+/**
+ * FFTInit() computes the tables for transforms of 'size' real samples.
+ * Returns 1 on success, 0 if 'size' isn't a power of 2 of at least 4
+ * 
+ * FFTForwardReal() transforms the 'size' real samples in 'data' in place. The samples are read as 'size' / 2 complex
+ * points (even samples real, odd samples imaginary), transformed by radix-4 passes (and a radix-2 pass if the number of
+ * points is an odd power of 2) over the bit-reversed points, and untangled into the spectrum of the real samples. The
+ * spectrum is packed into the same 'size' floats: the real parts of bin 0 and bin 'size' / 2 (whose imaginary parts are
+ * 0) come first, followed by the (real, imaginary) pairs of bins 1 to 'size' / 2 - 1. Bins are unnormalized, a full
+ * scale sine in bin k has a magnitude of 'size' / 2.
+ * 
+ * FFTFree() frees the tables.
+*/
+uint8_t FFTInit(fft_t* fft, uint32_t size);
+void    FFTForwardReal(const fft_t* fft, float* data);
+void    FFTFree(fft_t* fft);
+
+#endif
\ No newline at end of file
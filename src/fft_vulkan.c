@@ -0,0 +1,489 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "fft.h"
+#include "fft_vulkan.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FFT_VULKAN_TWO_PI 6.283185307179586
+// Floats in the buffer for 'n' samples: samples, window, twiddles, two halves of complex points, and the bands
+#define FFT_VULKAN_SAMPLES_OFFSET(n) 0
+#define FFT_VULKAN_WINDOW_OFFSET(n) (n)
+#define FFT_VULKAN_TWIDDLES_OFFSET(n) (2 * (n))
+#define FFT_VULKAN_POINTS_OFFSET(n, half) ((3 * (n)) + ((half) * 2 * (n)))
+#define FFT_VULKAN_BANDS_OFFSET(n) (7 * (n))
+#define FFT_VULKAN_BUFFER_SIZE (((7 * DFT_MAX_N) + (DFT_MAX_N / 2)) * sizeof(float))
+// vkCmdUpdateBuffer() takes at most 65536 bytes at a time
+#define FFT_VULKAN_UPDATE_MAX_FLOAT_COUNT (65536 / sizeof(float))
+// Largest difference of a band between the GPU and the CPU, which sum in a different order
+#define FFT_VULKAN_CHECK_TOLERANCE 0.0001f
+
+typedef enum
+{
+    FFT_VULKAN_PASS_WINDOW = 0,
+    FFT_VULKAN_PASS_BUTTERFLIES = 1,
+    FFT_VULKAN_PASS_MAGNITUDES = 2
+} fft_vulkan_pass_e;
+
+// As PushConstantLayout in fft.comp
+typedef struct
+{
+    uint32_t pass_type;
+    uint32_t n;
+    uint32_t stride;
+    uint32_t input_offset;
+    uint32_t output_offset;
+    float    magnitude_scale;
+} fft_vulkan_push_constants_t;
+
+// Buffers
+static VkBuffer fft_buffer;
+static VkDeviceMemory fft_buffer_memory;
+
+// Descriptor Pools
+static VkDescriptorPool descriptor_pool;
+
+// Descriptor Set Layouts
+static VkDescriptorSetLayout fft_buffer_descriptor_set_layout;
+
+// Descriptor Sets
+static VkDescriptorSet fft_buffer_descriptor_set;
+
+// Shaders
+static VkShaderModule fft_compute_shader;
+
+// Compute Pipeline Layouts
+static VkPipelineLayout fft_compute_pipeline_layout;
+
+// Compute Pipelines
+static VkPipeline fft_compute_pipeline;
+
+// Analysis the tables in the buffer are for, 0 until they have been uploaded
+static uint32_t fft_n = 0;
+static dft_window_e fft_window = DFT_WINDOW_RECTANGULAR;
+static float fft_magnitude_scale = 0.0f;
+// Window followed by twiddles, before they are uploaded
+static float fft_tables[2 * DFT_MAX_N];
+
+// Prints why FFTVulkanInit() failed, and destroys what it created so far
+// Returns 0
+static uint8_t FFTVulkanInitFailed(vulkan_context_t* vulkan, const char* message)
+{
+    printf("FFTVulkan: %s\n", message);
+    FFTVulkanDestroy(vulkan);
+    return 0;
+}
+
+uint8_t FFTVulkanInit(vulkan_context_t* vulkan)
+{
+    VulkanCreateBuffer(vulkan, NULL, FFT_VULKAN_BUFFER_SIZE, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &fft_buffer, &fft_buffer_memory, "FFTVulkan: Buffer", "FFTVulkan: Buffer Memory");
+
+    // Descriptor pool
+    VkDescriptorPoolSize descriptor_pool_size;
+    descriptor_pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    descriptor_pool_size.descriptorCount = 1; // FFT buffer
+    VkDescriptorPoolCreateInfo descriptor_pool_info;
+    descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    descriptor_pool_info.pNext = NULL;
+    descriptor_pool_info.flags = 0;
+    descriptor_pool_info.maxSets = descriptor_pool_size.descriptorCount;
+    descriptor_pool_info.poolSizeCount = 1;
+    descriptor_pool_info.pPoolSizes = &descriptor_pool_size;
+    if (vkCreateDescriptorPool(vulkan->device, &descriptor_pool_info, NULL, &descriptor_pool) != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to create the descriptor pool");
+    }
+    // FFT buffer descriptor set
+    VkDescriptorSetLayoutBinding fft_buffer_descriptor_set_layout_binding;
+    fft_buffer_descriptor_set_layout_binding.binding = 0;
+    fft_buffer_descriptor_set_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    fft_buffer_descriptor_set_layout_binding.descriptorCount = 1;
+    fft_buffer_descriptor_set_layout_binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    fft_buffer_descriptor_set_layout_binding.pImmutableSamplers = NULL;
+    VkDescriptorSetLayoutCreateInfo fft_buffer_descriptor_set_layout_info;
+    fft_buffer_descriptor_set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    fft_buffer_descriptor_set_layout_info.pNext = NULL;
+    fft_buffer_descriptor_set_layout_info.flags = 0;
+    fft_buffer_descriptor_set_layout_info.bindingCount = 1;
+    fft_buffer_descriptor_set_layout_info.pBindings = &fft_buffer_descriptor_set_layout_binding;
+    if (vkCreateDescriptorSetLayout(vulkan->device, &fft_buffer_descriptor_set_layout_info, NULL, &fft_buffer_descriptor_set_layout) != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to create the descriptor set layout");
+    }
+    VkDescriptorSetAllocateInfo fft_buffer_descriptor_set_info;
+    fft_buffer_descriptor_set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    fft_buffer_descriptor_set_info.pNext = NULL;
+    fft_buffer_descriptor_set_info.descriptorPool = descriptor_pool;
+    fft_buffer_descriptor_set_info.descriptorSetCount = 1;
+    fft_buffer_descriptor_set_info.pSetLayouts = &fft_buffer_descriptor_set_layout;
+    if (vkAllocateDescriptorSets(vulkan->device, &fft_buffer_descriptor_set_info, &fft_buffer_descriptor_set) != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to allocate the descriptor set");
+    }
+    VkDescriptorBufferInfo fft_buffer_descriptor_buffer_info;
+    fft_buffer_descriptor_buffer_info.buffer = fft_buffer;
+    fft_buffer_descriptor_buffer_info.offset = 0;
+    fft_buffer_descriptor_buffer_info.range = VK_WHOLE_SIZE;
+    VkWriteDescriptorSet fft_buffer_descriptor_set_write;
+    fft_buffer_descriptor_set_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    fft_buffer_descriptor_set_write.pNext = NULL;
+    fft_buffer_descriptor_set_write.dstSet = fft_buffer_descriptor_set;
+    fft_buffer_descriptor_set_write.dstBinding = 0;
+    fft_buffer_descriptor_set_write.dstArrayElement = 0;
+    fft_buffer_descriptor_set_write.descriptorCount = 1;
+    fft_buffer_descriptor_set_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    fft_buffer_descriptor_set_write.pImageInfo = NULL;
+    fft_buffer_descriptor_set_write.pBufferInfo = &fft_buffer_descriptor_buffer_info;
+    fft_buffer_descriptor_set_write.pTexelBufferView = NULL;
+    vkUpdateDescriptorSets(vulkan->device, 1, &fft_buffer_descriptor_set_write, 0, NULL);
+
+    // Compute shader, loaded here rather than with VulkanCreateShader() so that a missing or invalid file leaves the
+    // visualizer on the CPU instead of exiting
+    FILE* spirv_file = fopen("data/shaders/fft.comp.spv", "rb");
+    if (spirv_file == NULL)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to open data/shaders/fft.comp.spv");
+    }
+    fseek(spirv_file, 0, SEEK_END);
+    long spirv_size = ftell(spirv_file);
+    fseek(spirv_file, 0, SEEK_SET);
+    uint32_t* spirv = (spirv_size > 0) ? (uint32_t*)malloc(spirv_size) : NULL;
+    size_t spirv_size_read = (spirv != NULL) ? fread(spirv, 1, spirv_size, spirv_file) : 0;
+    fclose(spirv_file);
+    VkResult shader_result = VK_ERROR_INITIALIZATION_FAILED;
+    if ((spirv_size_read == (size_t)spirv_size) && ((spirv_size % sizeof(uint32_t)) == 0))
+    {
+        VkShaderModuleCreateInfo shader_info;
+        shader_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        shader_info.pNext = NULL;
+        shader_info.flags = 0;
+        shader_info.codeSize = spirv_size;
+        shader_info.pCode = spirv;
+        shader_result = vkCreateShaderModule(vulkan->device, &shader_info, NULL, &fft_compute_shader);
+    }
+    free(spirv);
+    if (shader_result != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to create the compute shader from data/shaders/fft.comp.spv");
+    }
+    VulkanSetObjectName(vulkan, VK_OBJECT_TYPE_SHADER_MODULE, (uint64_t)fft_compute_shader, "FFTVulkan: Compute Shader");
+
+    // Compute pipeline
+    VkPipelineShaderStageCreateInfo fft_shader_info;
+    fft_shader_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fft_shader_info.pNext = NULL;
+    fft_shader_info.flags = 0;
+    fft_shader_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    fft_shader_info.module = fft_compute_shader;
+    fft_shader_info.pName = "main";
+    fft_shader_info.pSpecializationInfo = NULL;
+    VkPushConstantRange fft_compute_push_constant_range;
+    fft_compute_push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    fft_compute_push_constant_range.size = sizeof(fft_vulkan_push_constants_t);
+    fft_compute_push_constant_range.offset = 0;
+    VkPipelineLayoutCreateInfo fft_compute_pipeline_layout_info;
+    fft_compute_pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    fft_compute_pipeline_layout_info.pNext = NULL;
+    fft_compute_pipeline_layout_info.flags = 0;
+    fft_compute_pipeline_layout_info.setLayoutCount = 1;
+    fft_compute_pipeline_layout_info.pSetLayouts = &fft_buffer_descriptor_set_layout;
+    fft_compute_pipeline_layout_info.pushConstantRangeCount = 1;
+    fft_compute_pipeline_layout_info.pPushConstantRanges = &fft_compute_push_constant_range;
+    if (vkCreatePipelineLayout(vulkan->device, &fft_compute_pipeline_layout_info, NULL, &fft_compute_pipeline_layout) != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to create the compute pipeline layout");
+    }
+    VulkanSetObjectName(vulkan, VK_OBJECT_TYPE_PIPELINE_LAYOUT, (uint64_t)fft_compute_pipeline_layout, "FFTVulkan: Compute Pipeline Layout");
+    VkComputePipelineCreateInfo fft_compute_pipeline_info;
+    fft_compute_pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    fft_compute_pipeline_info.pNext = NULL;
+    fft_compute_pipeline_info.flags = 0;
+    fft_compute_pipeline_info.stage = fft_shader_info;
+    fft_compute_pipeline_info.layout = fft_compute_pipeline_layout;
+    fft_compute_pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    fft_compute_pipeline_info.basePipelineIndex = -1;
+    if (vkCreateComputePipelines(vulkan->device, vulkan->pipeline_cache, 1, &fft_compute_pipeline_info, NULL, &fft_compute_pipeline) != VK_SUCCESS)
+    {
+        return FFTVulkanInitFailed(vulkan, "Unable to create the compute pipeline");
+    }
+    VulkanSetObjectName(vulkan, VK_OBJECT_TYPE_PIPELINE, (uint64_t)fft_compute_pipeline, "FFTVulkan: Compute Pipeline");
+
+    return 1;
+}
+
+// Records the upload of 'count' floats to 'offset' floats into the buffer, in as many updates as it takes
+static void FFTVulkanCmdUpload(VkCommandBuffer command_buffer, uint32_t offset, const float* data, uint32_t count)
+{
+    while (count > 0)
+    {
+        uint32_t update_count = (count > FFT_VULKAN_UPDATE_MAX_FLOAT_COUNT) ? FFT_VULKAN_UPDATE_MAX_FLOAT_COUNT : count;
+        vkCmdUpdateBuffer(command_buffer, fft_buffer, (VkDeviceSize)offset * sizeof(float), update_count * sizeof(float), data);
+        offset += update_count;
+        data += update_count;
+        count -= update_count;
+    }
+}
+
+static void FFTVulkanCmdBarrier(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access)
+{
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = NULL;
+    barrier.srcAccessMask = src_access;
+    barrier.dstAccessMask = dst_access;
+    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+static void FFTVulkanCmdDispatch(VkCommandBuffer command_buffer, fft_vulkan_pass_e pass_type, uint32_t stride, uint32_t input_offset, uint32_t output_offset)
+{
+    fft_vulkan_push_constants_t push_constants;
+    push_constants.pass_type = (uint32_t)pass_type;
+    push_constants.n = fft_n;
+    push_constants.stride = stride;
+    push_constants.input_offset = input_offset;
+    push_constants.output_offset = output_offset;
+    push_constants.magnitude_scale = fft_magnitude_scale;
+    vkCmdPushConstants(command_buffer, fft_compute_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(fft_vulkan_push_constants_t), &push_constants);
+    // Each invocation works on two points
+    vkCmdDispatch(command_buffer, (fft_n / 2) / FFT_VULKAN_LOCAL_SIZE, 1, 1);
+}
+
+void FFTVulkanCmdTransform(vulkan_context_t* vulkan, VkCommandBuffer command_buffer, uint32_t n, dft_window_e window, const float* frame)
+{
+    assert((n >= DFT_MIN_N) && (n <= DFT_MAX_N) && ((n & (n - 1)) == 0));
+
+    VulkanCmdBeginDebugUtilsLabel(vulkan, command_buffer, "FFTVulkan: Transform");
+
+    // The transform or copy of the bands recorded before is done with the buffer before it's written to
+    FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+    // Upload the tables for a new analysis, whose bands don't line up with the ones before
+    uint8_t bands_cleared = (frame == NULL) ? 1 : 0;
+    if ((n != fft_n) || (window != fft_window))
+    {
+        fft_magnitude_scale = DFTComputeWindowTable(n, window, fft_tables);
+        // Computed in double so that the error doesn't grow with the index
+        float* twiddles = fft_tables + n;
+        for (uint32_t k = 0; k < (n / 2); k++)
+        {
+            double angle = (FFT_VULKAN_TWO_PI * (double)k) / (double)n;
+            twiddles[(k * 2)] = (float)cos(angle);
+            twiddles[(k * 2) + 1] = (float)-sin(angle);
+        }
+        FFTVulkanCmdUpload(command_buffer, FFT_VULKAN_WINDOW_OFFSET(n), fft_tables, 2 * n);
+        fft_n = n;
+        fft_window = window;
+        bands_cleared = 1;
+    }
+    if (bands_cleared == 1)
+    {
+        vkCmdFillBuffer(command_buffer, fft_buffer, FFT_VULKAN_BANDS_OFFSET(n) * sizeof(float), ((n / 2) - 1) * sizeof(float), 0);
+    }
+    if (frame != NULL)
+    {
+        FFTVulkanCmdUpload(command_buffer, FFT_VULKAN_SAMPLES_OFFSET(n), frame, n);
+    }
+    FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    if (frame != NULL)
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, fft_compute_pipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, fft_compute_pipeline_layout, 0, 1, &fft_buffer_descriptor_set, 0, NULL);
+
+        // Each pass reads what the one before wrote
+        uint32_t half = 0;
+        FFTVulkanCmdDispatch(command_buffer, FFT_VULKAN_PASS_WINDOW, 0, FFT_VULKAN_SAMPLES_OFFSET(n), FFT_VULKAN_POINTS_OFFSET(n, half));
+        for (uint32_t stride = 1; stride < n; stride *= 2)
+        {
+            FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+            FFTVulkanCmdDispatch(command_buffer, FFT_VULKAN_PASS_BUTTERFLIES, stride, FFT_VULKAN_POINTS_OFFSET(n, half), FFT_VULKAN_POINTS_OFFSET(n, 1 - half));
+            half = 1 - half;
+        }
+        FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+        FFTVulkanCmdDispatch(command_buffer, FFT_VULKAN_PASS_MAGNITUDES, 0, FFT_VULKAN_POINTS_OFFSET(n, half), FFT_VULKAN_BANDS_OFFSET(n));
+    }
+
+    VulkanCmdEndDebugUtilsLabel(vulkan, command_buffer);
+}
+
+// Records the copy of 'region_count' regions of the buffer into 'dft_storage_buffer', after the transform that wrote them
+static void FFTVulkanCmdCopy(VkCommandBuffer command_buffer, VkBuffer dft_storage_buffer, const VkBufferCopy* regions, uint32_t region_count)
+{
+    FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    vkCmdCopyBuffer(command_buffer, fft_buffer, dft_storage_buffer, region_count, regions);
+    FFTVulkanCmdBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_HOST_READ_BIT);
+}
+
+uint32_t FFTVulkanCmdCopyBands(vulkan_context_t* vulkan, VkCommandBuffer command_buffer, VkBuffer dft_storage_buffer)
+{
+    if (fft_n == 0)
+    {
+        return 0;
+    }
+
+    uint32_t band_count = (fft_n / 2) - 1;
+    VkBufferCopy bands_copy_region;
+    bands_copy_region.srcOffset = FFT_VULKAN_BANDS_OFFSET(fft_n) * sizeof(float);
+    bands_copy_region.dstOffset = FFT_VULKAN_COPIED_BANDS_OFFSET * sizeof(float);
+    bands_copy_region.size = band_count * sizeof(float);
+    FFTVulkanCmdCopy(command_buffer, dft_storage_buffer, &bands_copy_region, 1);
+
+    return band_count;
+}
+
+// Writes the n / 2 - 1 magnitudes of 'frame' multiplied with 'window' to 'magnitudes' like DFTComputeMagnitudes() does,
+// with tables of its own so that the analysis the analysis thread uses is left alone
+static void FFTVulkanCheckMagnitudes(const fft_t* fft, dft_window_e window, const float* frame, float* magnitudes)
+{
+    static float window_table[DFT_MAX_N];
+    static float points[DFT_MAX_N];
+    const uint32_t n = fft->size;
+    float magnitude_scale = DFTComputeWindowTable(n, window, window_table);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        points[i] = frame[i] * window_table[i];
+    }
+    FFTForwardReal(fft, points);
+    // i = 1 -> skip DC-term
+    for (uint32_t i = 1; i < (n / 2); i++)
+    {
+        float real = points[(i * 2)];
+        float imaginary = points[(i * 2) + 1];
+        magnitudes[i - 1] = sqrtf((real * real) + (imaginary * imaginary)) * magnitude_scale;
+    }
+}
+
+uint8_t FFTVulkanCheck(vulkan_context_t* vulkan, VkBuffer dft_storage_buffer, VkDeviceMemory dft_storage_buffer_memory)
+{
+    // A few tones between bins, and noise, like DFTBenchmark()
+    static float frame[DFT_MAX_N];
+    static float magnitudes[DFT_MAX_FREQUENCY_BAND_COUNT];
+    const uint32_t sizes[2] = { DFT_MIN_N, DFT_MAX_N };
+    float difference_max = 0.0f;
+    uint8_t check_failed = 0;
+
+    if (vkDeviceWaitIdle(vulkan->device) != VK_SUCCESS)
+    {
+        printf("FFTVulkan: Unable to wait for the device to be idle\n");
+        return 0;
+    }
+    for (uint32_t s = 0; (s < 2) && (check_failed == 0); s++)
+    {
+        const uint32_t n = sizes[s];
+        fft_t fft;
+        if (FFTInit(&fft, n) == 0)
+        {
+            check_failed = 1;
+            break;
+        }
+        uint32_t random = 0x9E3779B9u;
+        for (uint32_t i = 0; i < n; i++)
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            float noise = ((float)(random & 0xFFFF) / 65536.0f) - 0.5f;
+            frame[i] = (float)((0.4 * sin(FFT_VULKAN_TWO_PI * 10.5 * (double)i / (double)n)) +
+                               (0.2 * sin(FFT_VULKAN_TWO_PI * 63.0 * (double)i / (double)n)) +
+                               (0.1 * cos(FFT_VULKAN_TWO_PI * 200.25 * (double)i / (double)n))) + (0.05f * noise);
+        }
+
+        for (uint32_t w = 0; (w < DFT_WINDOW_COUNT) && (check_failed == 0); w++)
+        {
+            FFTVulkanCheckMagnitudes(&fft, (dft_window_e)w, frame, magnitudes);
+
+            // The bands start at 0, so that they are set to the magnitudes
+            VkCommandBuffer command_buffer = vulkan->command_buffers[0];
+            VkCommandBufferBeginInfo command_buffer_begin_info;
+            command_buffer_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            command_buffer_begin_info.pNext = NULL;
+            command_buffer_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            command_buffer_begin_info.pInheritanceInfo = NULL;
+            vkBeginCommandBuffer(command_buffer, &command_buffer_begin_info);
+            FFTVulkanCmdTransform(vulkan, command_buffer, n, (dft_window_e)w, NULL);
+            FFTVulkanCmdTransform(vulkan, command_buffer, n, (dft_window_e)w, frame);
+            // Every band, not only those the columns show
+            VkBufferCopy bands_copy_region;
+            bands_copy_region.srcOffset = FFT_VULKAN_BANDS_OFFSET(n) * sizeof(float);
+            bands_copy_region.dstOffset = 0;
+            bands_copy_region.size = ((n / 2) - 1) * sizeof(float);
+            FFTVulkanCmdCopy(command_buffer, dft_storage_buffer, &bands_copy_region, 1);
+            vkEndCommandBuffer(command_buffer);
+            VkSubmitInfo submit_info;
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = NULL;
+            submit_info.waitSemaphoreCount = 0;
+            submit_info.pWaitSemaphores = NULL;
+            submit_info.pWaitDstStageMask = NULL;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &command_buffer;
+            submit_info.signalSemaphoreCount = 0;
+            submit_info.pSignalSemaphores = NULL;
+            float* bands = NULL;
+            if ((vkQueueSubmit(vulkan->queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) ||
+                (vkQueueWaitIdle(vulkan->queue) != VK_SUCCESS) ||
+                (vkMapMemory(vulkan->device, dft_storage_buffer_memory, 0, VK_WHOLE_SIZE, 0, (void**)&bands) != VK_SUCCESS))
+            {
+                check_failed = 1;
+                break;
+            }
+            for (uint32_t k = 0; k < (n / 2) - 1; k++)
+            {
+                float difference = fabsf(bands[k] - magnitudes[k]);
+                if (difference > difference_max)
+                {
+                    difference_max = difference;
+                }
+            }
+            vkUnmapMemory(vulkan->device, dft_storage_buffer_memory);
+        }
+        FFTFree(&fft);
+    }
+    // The next transform starts over from cleared bands
+    fft_n = 0;
+
+    if (check_failed == 1)
+    {
+        printf("FFTVulkan: Unable to transform the test frames\n");
+        return 0;
+    }
+    uint8_t match = (difference_max <= FFT_VULKAN_CHECK_TOLERANCE) ? 1 : 0;
+    printf("FFTVulkan: largest difference from the CPU %f over %u to %u samples, %s\n", difference_max, DFT_MIN_N, DFT_MAX_N, (match == 1) ? "match" : "MISMATCH");
+    return match;
+}
+
+void FFTVulkanDestroy(vulkan_context_t* vulkan)
+{
+    vkDestroyPipeline(vulkan->device, fft_compute_pipeline, NULL);
+    vkDestroyPipelineLayout(vulkan->device, fft_compute_pipeline_layout, NULL);
+    vkDestroyShaderModule(vulkan->device, fft_compute_shader, NULL);
+    vkDestroyDescriptorSetLayout(vulkan->device, fft_buffer_descriptor_set_layout, NULL);
+    vkDestroyDescriptorPool(vulkan->device, descriptor_pool, NULL);
+    VulkanDestroyBuffer(vulkan, &fft_buffer, &fft_buffer_memory);
+    fft_compute_pipeline = VK_NULL_HANDLE;
+    fft_compute_pipeline_layout = VK_NULL_HANDLE;
+    fft_compute_shader = VK_NULL_HANDLE;
+    fft_buffer_descriptor_set_layout = VK_NULL_HANDLE;
+    descriptor_pool = VK_NULL_HANDLE;
+    fft_n = 0;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FFT_VULKAN_H
+#define FFT_VULKAN_H
+
+#include "dft.h"
+#include "vulkan_engine.h"
+
+// Invocations per workgroup of the compute shader, as its 'local_size_x'
+#define FFT_VULKAN_LOCAL_SIZE 64
+// Offset in floats of the bands FFTVulkanCmdCopyBands() copies into 'dft_storage_buffer', after the columns
+#define FFT_VULKAN_COPIED_BANDS_OFFSET DFT_COLUMN_COUNT
+
+/**
+ * Transforms frames of samples on the GPU with the compute shader in data/shaders/fft.comp, for analyses too large to
+ * transform on the CPU every hop. The samples are uploaded into a storage buffer, windowed, transformed by log2(n) passes
+ * of radix-2 Stockham butterflies that go back and forth between two halves of the buffer, and turned into magnitudes
+ * which the bands, kept in the same buffer, move towards like DFTUpdateBands() moves them. The frames are the mono samples
+ * the analysis thread keeps, with the first two channels averaged as on the CPU, so there is one transform per frame
+ * rather than one per channel. Only the render thread may call these.
+ * 
+ * FFTVulkanInit() creates the buffer, and the compute pipeline through the pipeline cache. It's called the first time the
+ * GPU is asked for, rather than at startup, and a missing or invalid shader isn't fatal.
+ * Returns 1 on success, 0 otherwise, in which case the GPU shouldn't be used (and what was created is destroyed)
+ * 
+ * FFTVulkanCheck() transforms a test frame with each window function at DFT_MIN_N and DFT_MAX_N samples, both on the GPU
+ * and on the CPU like DFTComputeMagnitudes() does, and prints the largest difference between their bands. All the bands
+ * are read back through 'dft_storage_buffer', which has to be host visible and hold DFT_MAX_FREQUENCY_BAND_COUNT floats.
+ * It waits for the device to be idle, and records into the first command buffer, so it must be called between frames.
+ * The CPU side has tables of its own, so the analysis thread can keep running.
+ * Returns 1 if the bands match within tolerance, 0 otherwise, in which case the GPU shouldn't be used
+ * 
+ * FFTVulkanCmdTransform() records the transform of the 'n' samples in 'frame', multiplied with 'window', and the update
+ * of the bands. If 'frame' is NULL the bands are cleared instead. The window and twiddle tables are uploaded when 'n' or
+ * 'window' changed since the last call, which clears the bands too. The samples are recorded into the command buffer,
+ * so 'frame' can change as soon as it returns.
+ * 
+ * FFTVulkanCmdCopyBands() records the copy of all n / 2 - 1 bands into 'dft_storage_buffer' at
+ * FFT_VULKAN_COPIED_BANDS_OFFSET, which has to be host visible and hold that many floats after it. Copy regions can't
+ * take the loudest band of each column, so once the frame is done the CPU turns them into the columns with
+ * DFTComputeColumns(), for the fragment shader of SceneColumnsRender() to read them in a later frame.
+ * Returns number of bands copied, 0 if there are none yet
+*/
+uint8_t  FFTVulkanInit(vulkan_context_t* vulkan);
+uint8_t  FFTVulkanCheck(vulkan_context_t* vulkan, VkBuffer dft_storage_buffer, VkDeviceMemory dft_storage_buffer_memory);
+void     FFTVulkanCmdTransform(vulkan_context_t* vulkan, VkCommandBuffer command_buffer, uint32_t n, dft_window_e window, const float* frame);
+uint32_t FFTVulkanCmdCopyBands(vulkan_context_t* vulkan, VkCommandBuffer command_buffer, VkBuffer dft_storage_buffer);
+void     FFTVulkanDestroy(vulkan_context_t* vulkan);
+
+#endif
\ No newline at end of file
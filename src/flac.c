@@ -16,16 +16,20 @@
  * OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
-#include "wav.h"
+#include "flac.h"
+#include "flac_crc.h"
+#include "flac_lpc.h"
+#include "flac_output.h"
+#include "windows_synchronization.h"
+#include "windows_thread.h"
 
 #include <assert.h>
+#include <ctype.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-typedef uint8_t byte_t;
-
 // Convert N whole bytes to an uint32_t
 // Input byte stream must be big-endian (most significant byte first)
 // Returns uint32_t value
@@ -72,7 +76,7 @@ uint64_t unpack_uint64_big_endian(byte_t* bytes, uint8_t byte_count)
 
 // Convert an UTF-8 byte stream to an uint32_t
 // https://en.wikipedia.org/wiki/UTF-8#Encoding
-// Returns uint32_t value
+// Returns number of bytes read, or 0 if 'bytes' don't start with the first byte of a 1 to 4 byte sequence
 uint64_t unpack_utf8_to_uint32(byte_t* bytes, uint32_t* value)
 {
     uint8_t byte_count = 0;
@@ -97,19 +101,19 @@ uint64_t unpack_utf8_to_uint32(byte_t* bytes, uint32_t* value)
     }
     else
     {
-        printf("%s:%i Invalid length of UTF-8 stream for unpacking into uint32_t\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return 0;
     }
 
-    uint32_t tmp_value = 0;
-    for (uint8_t i = 0; i < byte_count; i++)
+    // The first byte holds the bits after its length prefix, i.e. 7 bits for 1 byte, and 7 - byte_count bits otherwise
+    uint32_t tmp_value = (byte_count == 1) ? *bytes : (*bytes & (0xFF >> (byte_count + 1)));
+    for (uint8_t i = 1; i < byte_count; i++)
     {
         byte_t* byte = bytes + i;
 
         // Make room for 6 bits
         tmp_value = tmp_value << 6;
         // Only use last 6 bits
-        tmp_value |= ((uint64_t)(*byte)) & 0x3F;
+        tmp_value |= ((uint32_t)(*byte)) & 0x3F;
     }
 
     *value = tmp_value;
@@ -118,7 +122,7 @@ uint64_t unpack_utf8_to_uint32(byte_t* bytes, uint32_t* value)
 
 // Convert an UTF-8 byte stream to an uint64_t
 // https://en.wikipedia.org/wiki/UTF-8#Encoding
-// Returns uint64_t value
+// Returns number of bytes read, or 0 if 'bytes' don't start with the first byte of a 1 to 7 byte sequence
 uint64_t unpack_utf8_to_uint64(byte_t* bytes, uint64_t* value)
 {
     uint8_t byte_count = 0;
@@ -158,12 +162,12 @@ uint64_t unpack_utf8_to_uint64(byte_t* bytes, uint64_t* value)
     }
     else
     {
-        printf("%s:%i Invalid length of UTF-8 stream for unpacking into uint64_t\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return 0;
     }
 
-    uint64_t tmp_value = 0;
-    for (uint8_t i = 0; i < byte_count; i++)
+    // The first byte holds the bits after its length prefix, i.e. 7 bits for 1 byte, and 7 - byte_count bits otherwise
+    uint64_t tmp_value = (byte_count == 1) ? *bytes : (*bytes & (0xFF >> (byte_count + 1)));
+    for (uint8_t i = 1; i < byte_count; i++)
     {
         byte_t* byte = bytes + i;
 
@@ -177,271 +181,180 @@ uint64_t unpack_utf8_to_uint64(byte_t* bytes, uint64_t* value)
     return (uint64_t)byte_count;
 }
 
-// Convert N bits to an uint32_t
-// Returns bytes read
-uint64_t unpack_bits_to_uint32(byte_t* bytes, uint32_t bit_count, uint8_t bit_current, uint8_t* bit_end, uint32_t* value)
+#define FLAC_BIT_READER_PADDING sizeof(uint64_t)
+
+// Reads a FLAC bit stream MSB-first through a 64-bit cache
+// The next unread bit is always the most significant bit of 'cache'. Refilling the cache does one unaligned
+// big-endian 64-bit load, so the buffer being read must have FLAC_BIT_READER_PADDING readable bytes after its end.
+// Reading past the end doesn't touch memory past the padding, it returns 1-bits (which ends any unary code)
+// and can be detected through FLACBitReaderHasOverrun()
+typedef struct
 {
-    // Cannot put more than 32 bits into an uint32_t
-    assert(bit_count <= (sizeof(uint32_t) * 8));
+    const byte_t* bytes;
+    uint64_t      byte_count;
+    uint64_t      byte_offset; // Next byte to load into the cache
+    uint64_t      cache;
+    uint32_t      cache_bit_count; // Number of valid bits at the top of the cache
+} flac_bit_reader_t;
+
+static inline void FLACBitReaderInit(flac_bit_reader_t* reader, const byte_t* bytes, uint64_t byte_count)
+{
+    reader->bytes = bytes;
+    reader->byte_count = byte_count;
+    reader->byte_offset = 0;
+    reader->cache = 0;
+    reader->cache_bit_count = 0;
+}
 
-    byte_t* bytes_start = bytes;
-    uint32_t tmp_value = 0;
-    
-    // The starting bit is within a byte
-    if (bit_current > 0)
+// Tops up the cache to 56-63 valid bits
+static inline void FLACBitReaderRefill(flac_bit_reader_t* reader)
+{
+    uint64_t bits;
+    if (reader->byte_offset < reader->byte_count)
     {
-        uint32_t remaining_bits_in_byte = (8 - bit_current);
-        
-        // Determine how many bits to read in byte
-        uint32_t bits_to_read = 0;
-        if (bit_count < remaining_bits_in_byte) // Reading fewer bits than there are left in byte
-        {
-            bits_to_read = bit_count;
-        }
-        else // Reading more bits than there are left in byte
-        {
-            bits_to_read = remaining_bits_in_byte;
-        }
-        
-        // Mask out bits before the current bit
-        uint32_t mask = 0xFF >> bit_current;
-        // Potentially mask out bits at end of byte that aren't to be read
-        for (uint32_t i = bit_current + bits_to_read; i < 8; i++)
-        {
-            mask &= 0xFF << (8 - i);
-        }
-        
-        // 1) Extract bits
-        uint32_t bits = (uint32_t)(*bytes & mask);
-        // 2) Move bits to start
-        bits = bits >> (remaining_bits_in_byte - bits_to_read);
-        // 3) OR with result
-        tmp_value |= bits;
-        // 4) Read N bits
-        bit_count -= bits_to_read;
-        
-        // Check if later readings will start from next btye
-        if (bits_to_read == remaining_bits_in_byte) // Read rest of byte
-        {
-            bytes += 1;
-            bit_current = 0;
-        }
-        else
-        {
-            bit_current += bits_to_read;
-        }
+        uint64_t big_endian_bits;
+        memcpy(&big_endian_bits, reader->bytes + reader->byte_offset, sizeof(uint64_t));
+        bits = BYTE_SWAP_64(big_endian_bits);
+    }
+    else
+    {
+        bits = UINT64_MAX;
     }
+    // Bits already in the cache past 'cache_bit_count' came from the same bytes, so OR-ing them in again is harmless
+    reader->cache |= bits >> reader->cache_bit_count;
+    uint32_t bytes_loaded = (63 - reader->cache_bit_count) >> 3;
+    reader->byte_offset += bytes_loaded;
+    reader->cache_bit_count += bytes_loaded * 8;
+}
 
-    // If there are more bits to read, try reading whole bytes
-    if (bit_count >= 8)
+// Returns the next 1-32 bits without consuming them
+static inline uint32_t FLACBitReaderPeek(flac_bit_reader_t* reader, uint32_t bit_count)
+{
+    assert((bit_count > 0) && (bit_count <= 32));
+
+    if (reader->cache_bit_count < bit_count)
     {
-        uint32_t bytes_to_read = bit_count / 8;
-        
-        // If it's possible to read whole bytes
-        if (bytes_to_read > 0)
-        {
-            uint32_t bits_to_read = (bytes_to_read * 8);
-            
-            // 1) Make room for bytes
-            tmp_value = tmp_value << bits_to_read;
-            // 2) Read whole bytes
-            tmp_value |= unpack_uint32_big_endian(bytes, bytes_to_read);
-            // 3) Read N bits (M bytes)
-            bit_count -= bits_to_read;
-            bytes += bytes_to_read;
-        }
+        FLACBitReaderRefill(reader);
     }
+    return (uint32_t)(reader->cache >> (64 - bit_count));
+}
 
-    // Some remaining bits to read in next byte
-    if (bit_count > 0)
+// Consumes 0-32 bits
+static inline void FLACBitReaderSkip(flac_bit_reader_t* reader, uint32_t bit_count)
+{
+    assert(bit_count <= 32);
+
+    if (reader->cache_bit_count < bit_count)
     {
-        bit_current = bit_count;
-        // 1) Make room for bits
-        tmp_value = tmp_value << bit_count;
-        // 2) Mask out later bits
-        uint32_t mask = 0xFF << (8 - bit_count);
-        // 3) Extrac bits
-        uint32_t bits = (uint32_t)(*bytes & mask);
-        // 4) Move to start
-        bits = bits >> (8 - bit_count);
-        // OR with result
-        tmp_value |= bits;
+        FLACBitReaderRefill(reader);
     }
+    reader->cache <<= bit_count;
+    reader->cache_bit_count -= bit_count;
+}
 
-    // Is not set to 0 by the last reading, so it will contain the position
-    *bit_end = bit_current;
-    *value = tmp_value;
-    return (bytes - bytes_start);
+// Reads 0-32 bits as an unsigned value
+static inline uint32_t FLACBitReaderReadUnsigned(flac_bit_reader_t* reader, uint32_t bit_count)
+{
+    if (bit_count == 0)
+    {
+        return 0;
+    }
+    uint32_t value = FLACBitReaderPeek(reader, bit_count);
+    reader->cache <<= bit_count;
+    reader->cache_bit_count -= bit_count;
+    return value;
 }
 
-// Convert N bits to an int32_t
-uint64_t unpack_bits_to_int32(byte_t* bytes, uint32_t bit_count, uint8_t bit_current, uint8_t* bit_end, int32_t* value)
+// Reads 1-32 bits as a signed two's-complement value
+static inline int32_t FLACBitReaderReadSigned(flac_bit_reader_t* reader, uint32_t bit_count)
 {
-    // Cannot put more than 32 bits into an int32_t
-    assert(bit_count <= (sizeof(int32_t) * 8));
-    
-    uint32_t tmp_value;
-    uint64_t bytes_read = unpack_bits_to_uint32(bytes, bit_count, bit_current, &bit_current, &tmp_value);
-    /* sign-extend *val assuming it is currently bits wide. */
-    /* From: https://graphics.stanford.edu/~seander/bithacks.html#FixedSignExtend */
-    uint32_t mask = 0x01 << (bit_count - 1); // Mark sign bit
-    *value = (tmp_value ^ mask) - mask;
-    return bytes_read;
+    assert(bit_count > 0);
+
+    uint32_t value = FLACBitReaderReadUnsigned(reader, bit_count);
+    // From https://graphics.stanford.edu/~seander/bithacks.html#VariableSignExtend
+    uint32_t mask = 0x01U << (bit_count - 1); // Mark sign bit
+    return (int32_t)((value ^ mask) - mask);
+}
+
+// Reads a unary coded value, i.e. the number of 0-bits before the next 1-bit
+static inline uint32_t FLACBitReaderReadUnary(flac_bit_reader_t* reader)
+{
+    uint32_t value = 0;
+    while (FLACBitReaderPeek(reader, 1) == 0)
+    {
+        reader->cache <<= 1;
+        reader->cache_bit_count -= 1;
+        value += 1;
+    }
+    // Consume the terminating 1-bit
+    reader->cache <<= 1;
+    reader->cache_bit_count -= 1;
+    return value;
 }
 
 // https://michaeldipperstein.github.io/rice.html
-// Convert RICE bit stream to an int32_t
-// k = bit length of r
-uint64_t unpack_rice_to_int32(byte_t* bytes, uint8_t bit_current, uint8_t* bit_end, uint32_t k, int32_t* rice_value)
+// Reads 'count' Rice coded, zig-zag mapped values with a k-bit remainder (one partition of a RESIDUAL)
+static void FLACBitReaderReadRicePartition(flac_bit_reader_t* reader, uint32_t k, uint32_t count, int32_t* values)
 {
-    byte_t* bytes_start = bytes;
-    
-    // Read unary value
-    uint32_t q = 0;
-    while (1)
+    assert(k <= 30);
+
+    for (uint32_t i = 0; i < count; i++)
     {
-        // 1) Mask out all but current bit
-        uint8_t mask = 0x1 << (7 - bit_current);
-        // 2) Extract bit
-        uint8_t bit = (*bytes & mask);
-        // 3) Read 1 bit
-        bit_current += 1;
-        if (bit_current == 8)
+        // Unary coded quotient: the leading 0-bits of the cache, which may continue into the next refill
+        uint32_t q = 0;
+        while (1)
         {
-            bit_current = 0;
-            bytes += 1;
+            uint32_t zero_count = (reader->cache != 0) ? CountLeadingZeros64(reader->cache) : 64;
+            if (zero_count < reader->cache_bit_count)
+            {
+                // Consume the 0-bits and the terminating 1-bit (two shifts as shifting by 64 is undefined)
+                q += zero_count;
+                reader->cache <<= zero_count;
+                reader->cache <<= 1;
+                reader->cache_bit_count -= zero_count + 1;
+                break;
+            }
+            q += reader->cache_bit_count;
+            reader->cache = 0;
+            reader->cache_bit_count = 0;
+            FLACBitReaderRefill(reader);
         }
-        // 4) Check bit is set
-        if (bit != 0)
+
+        // k-bit remainder, shifting in two steps makes k = 0 read 0 without a branch
+        if (reader->cache_bit_count < k)
         {
-            break;
+            FLACBitReaderRefill(reader);
         }
-        // 5) Count bits
-        q += 1;
-    }
-    
-    // Read k bits as r
-    uint32_t r = 0;
-    if (k != 0)
-    {
-        bytes += unpack_bits_to_uint32(bytes, k, bit_current, &bit_current, &r);
-    }
-    
-    // Construct RICE value using k, q and r = (Q * 2^K) + R
-    // (I don't know how this works, but it works)
-    // https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/src/libFLAC/bitreader.c#L741
-    uint32_t val = (q << k) | r;
-    if (val & 1)
-    {
-        val = -((int)(val >> 1)) - 1;
-    }
-    else
-    {
-        val = (int)(val >> 1);
+        uint32_t r = (uint32_t)((reader->cache >> 1) >> (63 - k));
+        reader->cache <<= k;
+        reader->cache_bit_count -= k;
+
+        // Construct RICE value using k, q and r = (Q * 2^K) + R, then undo the zig-zag mapping
+        // (0, -1, 1, -2, 2, ... are stored as 0, 1, 2, 3, 4, ...)
+        uint32_t value = (q << k) | r;
+        values[i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
     }
-    *rice_value = val;
-    
-    *bit_end = bit_current;
-    return (bytes - bytes_start);
 }
 
-// All numbers used in a FLAC bitstream are integers; there are no floating-point representations.
-// All numbers are big-endian coded. All numbers are unsigned unless otherwise specified.
-// https://github.com/ietf-wg-cellar/flac-specification
-// https://xiph.org/flac/format.html
-// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/include/FLAC/format.h
-// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/src/libFLAC/metadata_iterators.c
-// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/src/libFLAC/bitreader.c
-typedef enum
-{
-    FLAC_METADATA_BLOCK_TYPE_STREAMINFO     = 0,
-    FLAC_METADATA_BLOCK_TYPE_PADDING        = 1,
-    FLAC_METADATA_BLOCK_TYPE_APPLICATION    = 2,
-    FLAC_METADATA_BLOCK_TYPE_SEEKTABLE      = 3,
-    FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT = 4,
-    FLAC_METADATA_BLOCK_TYPE_CUESHEET       = 5,
-    FLAC_METADATA_BLOCK_TYPE_PICTURE        = 6
-} flac_metadata_block_type_e;
-
-typedef enum
-{
-    FLAC_SUBFRAME_TYPE_CONSTANT = 0,
-    FLAC_SUBFRAME_TYPE_VERBATIM = 1,
-    FLAC_SUBFRAME_TYPE_FIXED    = 2,
-    FLAC_SUBFRAME_TYPE_LPC      = 3
-} flac_subframe_type_e;
-
-typedef enum
-{
-    FLAC_RESIDUAL_TYPE_RICE  = 0,
-    FLAC_RESIDUAL_TYPE_RICE2 = 1
-} flac_residule_type_e;
-
-typedef enum
-{
-    // 1 channel: mono
-    FLAC_CHANNEL_ASSIGNMENT_MONO = 1,
-    // 2 channels: left, right
-    FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT = 2,
-    // 3 channels: left, right, center
-    FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT_CENTER = 3,
-    // 4 channels: front-left, front-right, back-left, back-right
-    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_BLEFT_BRIGHT = 4,
-    // 5 channels: front-left, front-right, front-center, back-left, back-right
-    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_BLEFT_BRIGHT = 5,
-    // 6 channels: front-left, front-right, front-center, low frequency effects, back-left, back-right
-    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BLEFT_BRIGHT = 6,
-    // 7 channels: front-left, front-right, front-center, low frequency effects, back-center, side-left, side-right
-    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BCENTER_SLEFT_SRIGHT = 7,
-    // 8 channels: front-left, front-right, front-center, low frequency effects, back-left, back-right, side-left, side-right
-    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BLEFT_BRIGHT_SLEFT_SRIGHT = 8,
-    // 2 channels: left, side difference
-    FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF = 9,
-    // 2 channels: side difference, right
-    FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT = 10,
-    // 2 channels: middle (average), side difference (left minus right)
-    FLAC_CHANNEL_ASSIGNMENT_MID_DIFF = 11,
-} flac_channel_assignment_e;
-
-typedef struct
+// Skips to the start of the next byte, if not already at one
+static inline void FLACBitReaderAlignToByte(flac_bit_reader_t* reader)
 {
-    flac_metadata_block_type_e type;
-    uint32_t size;
-    uint8_t is_last;
-} flac_metadata_block_header_t;
+    FLACBitReaderSkip(reader, reader->cache_bit_count & 0b111);
+}
 
-typedef struct
+// Returns the number of bytes consumed, rounded up
+static inline uint64_t FLACBitReaderGetBytesRead(flac_bit_reader_t* reader)
 {
-    uint32_t block_size_min;
-    uint32_t block_size_max;
-    uint32_t frame_size_min;
-    uint32_t frame_size_max;
-    uint32_t sample_rate;
-    uint32_t channel_count;
-    uint32_t bits_per_sample;
-    uint64_t sample_count;
-} flac_metadata_block_streaminfo_t;
+    uint64_t bits_read = (reader->byte_offset * 8) - reader->cache_bit_count;
+    return (bits_read + 7) / 8;
+}
 
-typedef struct
+// Returns 1 if more bits were read than there were in the buffer
+static inline uint8_t FLACBitReaderHasOverrun(flac_bit_reader_t* reader)
 {
-    uint32_t blocking_strategy;
-    uint32_t block_size_inter_channel_sampels;
-    uint32_t sample_rate;
-    flac_channel_assignment_e channel_assignment;
-    uint32_t bits_per_sample;
-    uint64_t sample_number;
-    uint32_t frame_number;
-    uint32_t crc;
-} flac_frame_header_t;
+    return FLACBitReaderGetBytesRead(reader) > reader->byte_count;
+}
 
-typedef struct
-{
-    flac_subframe_type_e type;
-    uint32_t lpc_order; // Only for FLAC_SUBFRAME_TYPE_LPC
-    uint32_t wasted_bits_per_sample;
-    uint32_t sample_count;
-    int32_t* samples;
-} flac_subframe_header_t;
 
 static uint64_t FLACPLoadMetadataBlockHeader(byte_t* bytes, flac_metadata_block_header_t* metadata_block_header)
 {
@@ -462,11 +375,6 @@ static uint64_t FLACPLoadMetadataBlockHeader(byte_t* bytes, flac_metadata_block_
     //  7-126 = reserved
     //  127 = invalid, to avoid confusion with a frame sync code
     tmp_header.type = (flac_metadata_block_type_e)((*bytes) & 0b01111111);
-    if (tmp_header.type > 6)
-    {
-        printf("%s:%i Invalid metadata block type\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
-    }
     bytes += 1;
 
     // 24 : Length (in bytes) of metadata to follow (does not include the size of the METADATA_BLOCK_HEADER)
@@ -511,52 +419,181 @@ static uint64_t FLACLoadMetadataBlockStreaminfo(byte_t* bytes, flac_metadata_blo
     bytes += 1;
     tmp_streaminfo.sample_count |= unpack_uint64_big_endian(bytes, 4);
     bytes += 4;
-    assert(tmp_streaminfo.sample_count != 0);
     // 128 : MD5 signature of the unencoded audio data. This allows the decoder to determine if an error exists in the audio data even when the error does not result in an invalid bitstream.
+    memcpy(tmp_streaminfo.md5, bytes, 16);
     bytes += 16;
 
     *metadata_block_streaminfo = tmp_streaminfo;
     return (bytes - bytes_start); // Always 34
 }
 
-static uint64_t FLACLoadMetadataBlockVorbisComment(byte_t* bytes, song_t* song)
+// Copies the value of a "NAME=value" comment into 'value' if the comment's field name is 'name', ignoring case
+// Returns 1 if the field name matched
+static uint8_t FLACLoadVorbisCommentField(const char* comment, uint32_t comment_length, const char* name, char* value, uint32_t value_size)
 {
-    byte_t* bytes_start = bytes;
+    uint32_t name_length = (uint32_t)strlen(name);
+    if ((comment_length <= name_length) || (comment[name_length] != '='))
+    {
+        return 0;
+    }
+    for (uint32_t i = 0; i < name_length; i++)
+    {
+        if (toupper((unsigned char)comment[i]) != name[i])
+        {
+            return 0;
+        }
+    }
+
+    // Values too long for 'value' are truncated
+    uint32_t value_length = comment_length - name_length - 1;
+    if (value_length >= value_size)
+    {
+        value_length = value_size - 1;
+    }
+    memcpy(value, comment + name_length + 1, value_length);
+    value[value_length] = '\0'; // Null-terminate
+    return 1;
+}
+
+// Lengths in VORBIS_COMMENT are little-endian, unlike the rest of FLAC. A block that claims more bytes than it has is
+// read up to where it ends.
+static void FLACLoadMetadataBlockVorbisComment(byte_t* bytes, uint32_t size, song_t* song)
+{
+    byte_t* bytes_end = bytes + size;
 
+    if (size < 4)
+    {
+        return;
+    }
     uint32_t vendor_string_length = *((uint32_t*)bytes);
     bytes += 4;
+    if ((uint64_t)(bytes_end - bytes) < ((uint64_t)vendor_string_length + 4))
+    {
+        return;
+    }
     bytes += vendor_string_length; // Skip vendor string
     uint32_t comment_field_count = *((uint32_t*)bytes);
     bytes += 4;
-    for (uint32_t i = 0; i < comment_field_count; i++)
+    for (uint32_t i = 0; (i < comment_field_count) && ((bytes_end - bytes) >= 4); i++)
     {
         uint32_t comment_length = *((uint32_t*)bytes);
         bytes += 4;
-        char* comment = (char*)bytes;
-        if (strncmp("TITLE", comment, 5) == 0)
+        if ((uint64_t)(bytes_end - bytes) < comment_length)
         {
-            char* title = comment + 6; // +6 to skip "TITLE="
-            strncpy(song->title, title, comment_length - 6);
-            song->title[comment_length - 6] = '\0'; // Null-terminate
+            return;
+        }
+        char* comment = (char*)bytes;
+        FLACLoadVorbisCommentField(comment, comment_length, "TITLE", song->title, sizeof(song->title));
+        FLACLoadVorbisCommentField(comment, comment_length, "ALBUM", song->album, sizeof(song->album));
+        FLACLoadVorbisCommentField(comment, comment_length, "ARTIST", song->artist, sizeof(song->artist));
+        bytes += comment_length;
+    }
+}
+
+// Keeps only the seek points that aren't placeholders and are in increasing sample order, so that they can be binary-searched
+// 'seek_points' must have room for (metadata block size / 18) points
+// Returns number of seek points kept
+static uint32_t FLACLoadMetadataBlockSeektable(byte_t* bytes, uint32_t size, flac_seek_point_t* seek_points)
+{
+    uint32_t seek_point_count = 0;
+    // Each seek point is 18 bytes
+    for (uint32_t i = 0; i < size / 18; i++)
+    {
+        flac_seek_point_t seek_point;
+        // 64 : Sample number of first sample in the target frame, or 0xFFFFFFFFFFFFFFFF for a placeholder point.
+        seek_point.sample_number = unpack_uint64_big_endian(bytes, 8);
+        bytes += 8;
+        // 64 : Offset (in bytes) from the first byte of the first frame header to the first byte of the target frame's header.
+        seek_point.stream_offset = unpack_uint64_big_endian(bytes, 8);
+        bytes += 8;
+        // 16 : Number of samples in the target frame.
+        seek_point.sample_count = unpack_uint32_big_endian(bytes, 2);
+        bytes += 2;
+
+        if ((seek_point.sample_number == 0xFFFFFFFFFFFFFFFF) ||
+            ((seek_point_count > 0) && (seek_point.sample_number <= seek_points[seek_point_count - 1].sample_number)))
+        {
+            continue;
+        }
+        seek_points[seek_point_count] = seek_point;
+        seek_point_count++;
+    }
+
+    return seek_point_count;
+}
+
+// Loads the first sample of each CUESHEET track, and checks that they are in increasing order, within the stream and end
+// with the lead-out track. 'tracks' must have room for (metadata block size / 36) tracks
+// Returns number of tracks, or 0 if the CUESHEET is invalid
+static uint32_t FLACLoadMetadataBlockCuesheet(byte_t* bytes, uint32_t size, uint64_t sample_count, flac_cuesheet_track_t* tracks)
+{
+    // 128 * 8 : Media catalog number
+    // 64      : Number of lead-in samples
+    // 1       : 1 if the CUESHEET corresponds to a Compact Disc
+    // 7 + 258 * 8 : Reserved
+    // 8       : Number of tracks
+    if (size < 396)
+    {
+        return 0;
+    }
+    uint32_t track_count = bytes[395];
+    uint64_t offset = 396;
+    for (uint32_t i = 0; i < track_count; i++)
+    {
+        // 64     : Track offset in samples, relative to the beginning of the stream
+        // 8      : Track number
+        // 12 * 8 : ISRC
+        // 1      : Track type, 0 for audio
+        // 1      : Pre-emphasis flag
+        // 6 + 13 * 8 : Reserved
+        // 8      : Number of track index points
+        if ((offset + 36) > size)
+        {
+            return 0;
+        }
+        uint64_t track_offset = unpack_uint64_big_endian(bytes + offset, 8);
+        tracks[i].number = bytes[offset + 8];
+        tracks[i].is_audio = ((bytes[offset + 21] & 0x80) == 0) ? 1 : 0;
+        uint32_t index_point_count = bytes[offset + 35];
+        offset += 36;
+
+        // 64 : Offset in samples, relative to the track offset
+        // 8  : Index point number
+        // 3 * 8 : Reserved
+        if ((offset + (index_point_count * 12)) > size)
+        {
+            return 0;
         }
-        else if (strncmp("ALBUM", comment, 5) == 0)
+        uint64_t index_point_offset = (index_point_count > 0) ? unpack_uint64_big_endian(bytes + offset, 8) : 0;
+        for (uint32_t j = 0; j < index_point_count; j++)
         {
-            char* album = comment + 6; // +6 to skip "ALBUM="
-            strncpy(song->album, album, comment_length - 6);
-            song->album[comment_length - 6] = '\0'; // Null-terminate
+            if (bytes[offset + (j * 12) + 8] == 1)
+            {
+                index_point_offset = unpack_uint64_big_endian(bytes + offset + (j * 12), 8);
+                break;
+            }
         }
-        else if (strncmp("ARTIST", comment, 6) == 0)
+        offset += index_point_count * 12;
+        tracks[i].sample_number = track_offset + index_point_offset;
+
+        if (((i > 0) && (tracks[i].sample_number <= tracks[i - 1].sample_number)) ||
+            ((sample_count != 0) && (tracks[i].sample_number > sample_count)))
         {
-            char* artist = comment + 7; // +7 to skip "ARTIST="
-            strncpy(song->artist, artist, comment_length - 6);
-            song->artist[comment_length - 7] = '\0'; // Null-terminate
+            return 0;
         }
-        bytes += comment_length;
+    }
+    if ((track_count < 2) ||
+        ((tracks[track_count - 1].number != FLAC_CUESHEET_LEAD_OUT_TRACK_NUMBER_CDDA) &&
+         (tracks[track_count - 1].number != FLAC_CUESHEET_LEAD_OUT_TRACK_NUMBER)))
+    {
+        return 0;
     }
 
-    return (bytes - bytes_start);
+    return track_count;
 }
 
+// Any FRAME_HEADER that passed FLACCheckFrameHeader() is valid, the checks here only keep a damaged one from being loaded
+// Returns the size of the header, or 0 if it isn't valid
 static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminfo_t* metadata_block_streaminfo, flac_frame_header_t* frame_header)
 {
     byte_t* bytes_start = bytes;
@@ -568,15 +605,13 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
     sync_code |= ((uint32_t)(*bytes & 0b11111100)) >> 2;
     if (sync_code != 0b11111111111110)
     {
-        printf("%s:%i Sync code did not match 0x3FFE: 0x%X4\n", __FILE__, __LINE__, sync_code);
-        exit(EXIT_FAILURE);
+        return 0;
     }
     // 1 : Reserved
     uint32_t reserved = (uint32_t)(*bytes & 0b00000010);
     if (reserved != 0)
     {
-        printf("%s:%i Invalid reserved value\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return 0;
     }
     // 1 : Blocking strategy
     //     0 = fixed-blocksize stream; frame header encodes the frame number
@@ -625,37 +660,26 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
     //     1010 = mid/side stereo: channel 0 is the mid(average) channel, channel 1 is the side(difference) channel
     //     1011-1111 = reserved
     uint32_t channel_assignment = ((uint32_t)(*bytes & 0b11110000)) >> 4;
-    switch (channel_assignment)
+    if (channel_assignment <= 0b0111)
     {
-        //case 0b0000: {} break;
-        case 0b0001:
-        {
-            tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT;
-        } break;
-        //case 0b0010: {} break;
-        //case 0b0011: {} break;
-        //case 0b0100: {} break;
-        //case 0b0101: {} break;
-        //case 0b0110: {} break;
-        //case 0b0111: {} break;
-        case 0b1000:
-        {
-            tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF;
-        } break;
-        case 0b1001:
-        {
-            tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT;
-        } break;
-        case 0b1010:
-        {
-            tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_MID_DIFF;
-        } break;
-            
-        default:
-        {
-            printf("%s:%i Invalid channel assignment: %u\n", __FILE__, __LINE__, channel_assignment);
-            exit(EXIT_FAILURE);
-        }
+        // Independent channels, the enum values match the channel count
+        tmp_header.channel_assignment = (flac_channel_assignment_e)(channel_assignment + 1);
+    }
+    else if (channel_assignment == 0b1000)
+    {
+        tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF;
+    }
+    else if (channel_assignment == 0b1001)
+    {
+        tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT;
+    }
+    else if (channel_assignment == 0b1010)
+    {
+        tmp_header.channel_assignment = FLAC_CHANNEL_ASSIGNMENT_MID_DIFF;
+    }
+    else
+    {
+        return 0;
     }
     // 3 : Sample size in bits
     //     000 = get from STREAMINFO metadata block
@@ -701,31 +725,41 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
 
         default:
         {
-            printf("%s:%i Invalid bits per sample in FLAC frame header: %u\n", __FILE__, __LINE__, tmp_header.bits_per_sample);
-            exit(EXIT_FAILURE);
+            return 0;
         } break;
     }
-    assert(tmp_header.bits_per_sample == metadata_block_streaminfo->bits_per_sample);
+    if (tmp_header.bits_per_sample != metadata_block_streaminfo->bits_per_sample)
+    {
+        return 0;
+    }
     // 1 : Reserved
     reserved = (uint32_t)(*bytes & 0b00000001);
     if (reserved != 0)
     {
-        printf("%s:%i Invalid reserved value\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return 0;
     }
     bytes += 1;
     // if(variable blocksize)
     //     <8-56>:"UTF-8" coded sample number (decoded number is 36 bits) [4]
     // else
     //     <8-48>:"UTF-8" coded frame number (decoded number is 31 bits) [4]
+    uint64_t utf8_byte_count = 0;
     if (tmp_header.blocking_strategy == 1)
     {
-        bytes += unpack_utf8_to_uint64(bytes, &tmp_header.sample_number);
+        utf8_byte_count = unpack_utf8_to_uint64(bytes, &tmp_header.sample_number);
+        tmp_header.frame_number = 0;
     }
     else
     {
-        bytes += unpack_utf8_to_uint32(bytes, &tmp_header.frame_number);
+        utf8_byte_count = unpack_utf8_to_uint32(bytes, &tmp_header.frame_number);
+        // Every frame but the last has the same block size in a fixed-blocksize stream
+        tmp_header.sample_number = (uint64_t)tmp_header.frame_number * metadata_block_streaminfo->block_size_max;
+    }
+    if (utf8_byte_count == 0)
+    {
+        return 0;
     }
+    bytes += utf8_byte_count;
     // Determine block size
     switch (tmp_header.block_size_inter_channel_sampels)
     {
@@ -803,8 +837,7 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
         
         default:
         {
-            printf("%s:%i Invalid block size value: %u\n", __FILE__, __LINE__, tmp_header.block_size_inter_channel_sampels);
-            exit(EXIT_FAILURE);
+            return 0;
         } break;
     }
     // Determine sample rate
@@ -873,28 +906,30 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
         // 1100 = get 8 bit sample rate (in kHz) from end of header
         case 0b1100:
         {
-            tmp_header.sample_rate = unpack_uint32_big_endian(bytes, 1);
+            tmp_header.sample_rate = unpack_uint32_big_endian(bytes, 1) * 1000;
             bytes += 1;
         } break;
         // 1101 = get 16 bit sample rate (in Hz) from end of header
         case 0b1101:
         {
-            tmp_header.sample_rate = unpack_uint32_big_endian(bytes, 16);
+            tmp_header.sample_rate = unpack_uint32_big_endian(bytes, 2);
             bytes += 2;
         } break;
         // 1110 = get 16 bit sample rate (in tens of Hz) from end of header
         case 0b1110:
         {
-            printf("%s:%i What does this mean\n", __FILE__, __LINE__);
+            tmp_header.sample_rate = unpack_uint32_big_endian(bytes, 2) * 10;
             bytes += 2;
         } break;
         default:
         {
-            printf("%s:%i Invalid sample rate value: %u\n", __FILE__, __LINE__, tmp_header.sample_rate);
-            exit(EXIT_FAILURE);
+            return 0;
         } break;
     }
-    assert(tmp_header.sample_rate == metadata_block_streaminfo->sample_rate);
+    if (tmp_header.sample_rate != metadata_block_streaminfo->sample_rate)
+    {
+        return 0;
+    }
     // 8 : CRC-8 (polynomial = x^8 + x^2 + x^1 + x^0, initialized with 0) of everything before the crc, including the sync code
     tmp_header.crc = unpack_uint32_big_endian(bytes, 1);
     bytes += 1;
@@ -903,158 +938,271 @@ static uint64_t FLACLoadFrameHeader(byte_t* bytes, flac_metadata_block_streaminf
     return (bytes - bytes_start);
 }
 
-static uint64_t FLACLoadSubframeHeader(byte_t* bytes, uint8_t bit_current, uint8_t* bit_end, flac_subframe_header_t* subframe)
+// Checks whether 'bytes' start with a FRAME_HEADER that matches STREAMINFO and, if 'check_crc' is set, its own CRC-8.
+// It only reads as far as 'byte_count', so it can be used to find the next frame from an arbitrary position in the
+// stream, where audio data can look like a sync code. Every header it passes can be loaded by FLACLoadFrameHeader().
+// Returns the size of the header, or 0 if it isn't valid
+static uint64_t FLACCheckFrameHeader(byte_t* bytes, uint64_t byte_count, flac_metadata_block_streaminfo_t* metadata_block_streaminfo, uint8_t check_crc)
 {
-    byte_t* bytes_start = bytes;
-    
-    flac_subframe_header_t tmp_header;
-    uint32_t byte = 0;
-    bytes += unpack_bits_to_uint32(bytes, 8, bit_current, &bit_current, &byte);
-    // 1 : Zero bit padding, to prevent sync-fooling string of 1s
-    uint32_t reserved = ((uint32_t)(byte & 0b10000000)) >> 7;
-    if (reserved != 0)
+    // Sync code, reserved bit, blocking strategy, block size, sample rate, channel assignment, sample size and reserved bit,
+    // and the first byte of the frame or sample number, whose leading 1-bits tell how many bytes it takes
+    if ((byte_count < 5) ||
+        (bytes[0] != 0xFF) ||
+        ((bytes[1] & 0b11111110) != 0b11111000))
     {
-        printf("%s:%i Invalid reserved value\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        return 0;
     }
-    // 6 : Subframe type:
-    //      000000 = SUBFRAME_CONSTANT
-    //      000001 = SUBFRAME_VERBATIM
-    //      00001x = reserved
-    //      0001xx = reserved
-    //      001xxx = if(xxx <= 4) SUBFRAME_FIXED, xxx=order ; else reserved
-    //      01xxxx = reserved
-    //      1xxxxx = SUBFRAME_LPC, xxxxx=order-1
-    uint32_t subframe_type = ((uint32_t)(byte & 0b01111110)) >> 1;
-    if (subframe_type == 0b000000)
+    uint32_t block_size_code = ((uint32_t)(bytes[2] & 0b11110000)) >> 4;
+    uint32_t sample_rate_code = (uint32_t)(bytes[2] & 0b00001111);
+    uint32_t channel_assignment = ((uint32_t)(bytes[3] & 0b11110000)) >> 4;
+    uint32_t sample_size_code = ((uint32_t)(bytes[3] & 0b00001110)) >> 1;
+    // Sample sizes for each code, 0 is reserved
+    static const uint32_t sample_sizes[8] = { 0, 8, 12, 0, 16, 20, 24, 0 };
+    uint32_t channel_count = (channel_assignment <= 0b0111) ? (channel_assignment + 1) : 2;
+    if ((block_size_code == 0) ||
+        (sample_rate_code == 0b1111) ||
+        (channel_assignment > 0b1010) ||
+        (channel_count != metadata_block_streaminfo->channel_count) ||
+        ((sample_size_code != 0) && (sample_sizes[sample_size_code] != metadata_block_streaminfo->bits_per_sample)) ||
+        ((bytes[3] & 0b00000001) != 0))
     {
-        tmp_header.type = FLAC_SUBFRAME_TYPE_CONSTANT;
+        return 0;
     }
-    else if ((subframe_type & 0b111111) == 0b000001)
+    uint64_t size = 4;
+
+    // "UTF-8" coded frame or sample number, the number of leading 1-bits of the first byte is the byte count (0 means 1 byte).
+    // A sample number takes up to 7 bytes, and a frame number up to the 4 bytes that unpack_utf8_to_uint32() reads.
+    uint32_t utf8_byte_count = CountLeadingZeros64(~((uint64_t)bytes[size] << 56));
+    uint32_t utf8_byte_count_max = ((bytes[1] & 0b00000001) == 1) ? 7 : 4;
+    if (utf8_byte_count == 0)
     {
-        tmp_header.type = FLAC_SUBFRAME_TYPE_VERBATIM;
-        assert(0);
+        utf8_byte_count = 1;
     }
-    else if (((subframe_type & 0b111000) == 0b001000) &&
-             ((subframe_type & 0b000111) <= 4))
+    else if ((utf8_byte_count == 1) || (utf8_byte_count > utf8_byte_count_max))
     {
-        tmp_header.type = FLAC_SUBFRAME_TYPE_FIXED;
-        tmp_header.lpc_order = (subframe_type & 0b000111);
+        return 0;
     }
-    else if ((subframe_type & 0b100000) == 0b100000)
+    if ((size + utf8_byte_count) > byte_count)
     {
-        tmp_header.type = FLAC_SUBFRAME_TYPE_LPC;
-        tmp_header.lpc_order = (subframe_type & 0b011111) + 1;
+        return 0;
     }
-    else
+    for (uint32_t i = 1; i < utf8_byte_count; i++)
     {
-        printf("%s:%i Invalid subframe header type: %u\n", __FILE__, __LINE__, subframe_type);
-        exit(EXIT_FAILURE);
+        if ((bytes[size + i] & 0b11000000) != 0b10000000)
+        {
+            return 0;
+        }
     }
-    // <1+k> : 'Wasted bits-per-sample' flag:
-    //           0 : no wasted bits-per-sample in source subblock, k=0
-    //           1 : k wasted bits-per-sample in source subblock, k-1 follows, unary coded; e.g. k=3 => 001 follows, k=7 => 0000001 follows.
-    tmp_header.wasted_bits_per_sample = (uint32_t)(byte & 0b00000001);
-    if (tmp_header.wasted_bits_per_sample == 1)
+    size += utf8_byte_count;
+
+    // Block size, which must fit in the frame decoder
+    uint32_t block_size = 0;
+    if (block_size_code == 0b0001)
     {
-        printf("%s:%i Currently not supporting wasted bits\n", __FILE__, __LINE__);
-        exit(EXIT_FAILURE);
+        block_size = 192;
     }
-
-    tmp_header.samples = subframe->samples;
-    *subframe = tmp_header;
-    return (bytes - bytes_start);
-}
-
-uint64_t FLACLoadSubframeConstant(byte_t* bytes, uint32_t bits_per_sample, uint32_t frame_block_size, uint8_t bit_current, uint8_t* bit_end, flac_subframe_header_t* subframe)
-{
-    byte_t* bytes_start = bytes;
-    
-    // <n> : Unencoded constant value of the subblock, n = frame's bits-per-sample
-    int32_t sample = 0;
-    bytes += unpack_bits_to_int32(bytes, bits_per_sample, bit_current, &bit_current, &sample);
-    subframe->sample_count = frame_block_size;
-    for (uint32_t i = 0; i < frame_block_size; i++)
+    else if (block_size_code <= 0b0101)
     {
-        subframe->samples[i] = sample;
+        block_size = 576 << (block_size_code - 2);
     }
-    //printf("Total samples: %u\n", frame_block_size);
-    
-    *bit_end = bit_current;
-    return (bytes - bytes_start);
-}
-
-uint64_t FLACLoadSubframeFixed(byte_t* bytes, uint32_t bits_per_sample, uint32_t order, uint32_t frame_block_size, uint8_t bit_current, uint8_t* bit_end, flac_subframe_header_t* subframe)
-{
-    byte_t* bytes_start = bytes;
-
-    // <n> : Unencoded warm-up samples (n = frame's bits-per-sample * predictor order)
-    int32_t* unencoded_warmup_samples = (int32_t*)malloc(order * sizeof(int32_t));
-    uint32_t mask = 0x01 << (bits_per_sample - 1); // Mark sign bit
-    for (uint32_t i = 0; i < order; i++)
+    else if (block_size_code == 0b0110)
+    {
+        if ((size + 1) > byte_count)
+        {
+            return 0;
+        }
+        block_size = unpack_uint32_big_endian(bytes + size, 1) + 1;
+        size += 1;
+    }
+    else if (block_size_code == 0b0111)
+    {
+        if ((size + 2) > byte_count)
+        {
+            return 0;
+        }
+        block_size = unpack_uint32_big_endian(bytes + size, 2) + 1;
+        size += 2;
+    }
+    else
+    {
+        block_size = 256 << (block_size_code - 8);
+    }
+    if (block_size > metadata_block_streaminfo->block_size_max)
+    {
+        return 0;
+    }
+
+    // Sample rate
+    // Sample rates for each code, 0 means get from STREAMINFO
+    static const uint32_t sample_rates[12] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    uint32_t sample_rate = metadata_block_streaminfo->sample_rate;
+    if ((sample_rate_code > 0) && (sample_rate_code < 0b1100))
+    {
+        sample_rate = sample_rates[sample_rate_code];
+    }
+    else if (sample_rate_code >= 0b1100)
+    {
+        uint32_t sample_rate_size = (sample_rate_code == 0b1100) ? 1 : 2;
+        if ((size + sample_rate_size) > byte_count)
+        {
+            return 0;
+        }
+        sample_rate = unpack_uint32_big_endian(bytes + size, sample_rate_size);
+        if (sample_rate_code == 0b1100)
+        {
+            sample_rate *= 1000;
+        }
+        else if (sample_rate_code == 0b1110)
+        {
+            sample_rate *= 10;
+        }
+        size += sample_rate_size;
+    }
+    if (sample_rate != metadata_block_streaminfo->sample_rate)
+    {
+        return 0;
+    }
+
+    // CRC-8 of everything before it
+    if (((size + 1) > byte_count) ||
+        ((check_crc == 1) && (FLACCRC8(bytes, size) != bytes[size])))
+    {
+        return 0;
+    }
+    size += 1;
+
+    return size;
+}
+
+// Returns 0 if the header is invalid
+static uint8_t FLACLoadSubframeHeader(flac_bit_reader_t* reader, flac_subframe_header_t* subframe)
+{
+    flac_subframe_header_t tmp_header;
+    // 1 : Zero bit padding, to prevent sync-fooling string of 1s
+    uint32_t reserved = FLACBitReaderReadUnsigned(reader, 1);
+    if (reserved != 0)
+    {
+        return 0;
+    }
+    // 6 : Subframe type:
+    //      000000 = SUBFRAME_CONSTANT
+    //      000001 = SUBFRAME_VERBATIM
+    //      00001x = reserved
+    //      0001xx = reserved
+    //      001xxx = if(xxx <= 4) SUBFRAME_FIXED, xxx=order ; else reserved
+    //      01xxxx = reserved
+    //      1xxxxx = SUBFRAME_LPC, xxxxx=order-1
+    uint32_t subframe_type = FLACBitReaderReadUnsigned(reader, 6);
+    if (subframe_type == 0b000000)
+    {
+        tmp_header.type = FLAC_SUBFRAME_TYPE_CONSTANT;
+    }
+    else if ((subframe_type & 0b111111) == 0b000001)
+    {
+        tmp_header.type = FLAC_SUBFRAME_TYPE_VERBATIM;
+    }
+    else if (((subframe_type & 0b111000) == 0b001000) &&
+             ((subframe_type & 0b000111) <= 4))
+    {
+        tmp_header.type = FLAC_SUBFRAME_TYPE_FIXED;
+        tmp_header.lpc_order = (subframe_type & 0b000111);
+    }
+    else if ((subframe_type & 0b100000) == 0b100000)
+    {
+        tmp_header.type = FLAC_SUBFRAME_TYPE_LPC;
+        tmp_header.lpc_order = (subframe_type & 0b011111) + 1;
+    }
+    else
+    {
+        return 0;
+    }
+    // <1+k> : 'Wasted bits-per-sample' flag:
+    //           0 : no wasted bits-per-sample in source subblock, k=0
+    //           1 : k wasted bits-per-sample in source subblock, k-1 follows, unary coded; e.g. k=3 => 001 follows, k=7 => 0000001 follows.
+    tmp_header.wasted_bits_per_sample = FLACBitReaderReadUnsigned(reader, 1);
+    if (tmp_header.wasted_bits_per_sample == 1)
+    {
+        tmp_header.wasted_bits_per_sample += FLACBitReaderReadUnary(reader);
+    }
+
+    tmp_header.samples = subframe->samples;
+    *subframe = tmp_header;
+    return 1;
+}
+
+static void FLACLoadSubframeConstant(flac_bit_reader_t* reader, uint32_t bits_per_sample, uint32_t frame_block_size, flac_subframe_header_t* subframe)
+{
+    // <n> : Unencoded constant value of the subblock, n = frame's bits-per-sample
+    int32_t sample = FLACBitReaderReadSigned(reader, bits_per_sample);
+    subframe->sample_count = frame_block_size;
+    for (uint32_t i = 0; i < frame_block_size; i++)
+    {
+        subframe->samples[i] = sample;
+    }
+}
+
+static void FLACLoadSubframeVerbatim(flac_bit_reader_t* reader, uint32_t bits_per_sample, uint32_t frame_block_size, flac_subframe_header_t* subframe)
+{
+    // <n*i> : Unencoded subblock; n = frame's bits-per-sample, i = frame's blocksize
+    subframe->sample_count = frame_block_size;
+    for (uint32_t i = 0; i < frame_block_size; i++)
     {
-        uint32_t tmp_value = 0;
-        bytes += unpack_bits_to_uint32(bytes, bits_per_sample, bit_current, &bit_current, &tmp_value);
-        // From https://graphics.stanford.edu/~seander/bithacks.html#VariableSignExtend
-        tmp_value = (tmp_value ^ mask) - mask;
-        unencoded_warmup_samples[i] = tmp_value;
+        subframe->samples[i] = FLACBitReaderReadSigned(reader, bits_per_sample);
     }
+}
+
+// Decodes the RESIDUAL section that follows the warm-up samples of a FIXED or LPC subframe, which is
+// frame_block_size - order residuals
+// Returns 0 if the coding method is reserved, or the partitions can't add up to that
+static uint8_t FLACLoadResidual(flac_bit_reader_t* reader, uint32_t order, uint32_t frame_block_size, int32_t* residuals)
+{
     // <2> : Residual coding method:
     //        00 : partitioned Rice coding with 4-bit Rice parameter; RESIDUAL_CODING_METHOD_PARTITIONED_RICE follows
     //        01 : partitioned Rice coding with 5-bit Rice parameter; RESIDUAL_CODING_METHOD_PARTITIONED_RICE2 follows
     //        10-11 : reserved
-    uint32_t residual_type = 0;
-    bytes += unpack_bits_to_uint32(bytes, 2, bit_current, &bit_current, &residual_type);
+    uint32_t residual_type = FLACBitReaderReadUnsigned(reader, 2);
     flac_residule_type_e residual_coding_method = (flac_residule_type_e)residual_type;
+    uint32_t rice_parameter_bits = 0;
+    switch (residual_coding_method)
+    {
+        // <4(+5)> : Encoding parameter:
+        //            0000-1110 : Rice parameter.
+        //            1111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
+        case FLAC_RESIDUAL_TYPE_RICE:
+        {
+            rice_parameter_bits = 4;
+        } break;
+
+        // <5(+5)> : Encoding parameter:
+        //            00000-11110 : Rice parameter.
+        //            11111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
+        case FLAC_RESIDUAL_TYPE_RICE2:
+        {
+            rice_parameter_bits = 5;
+        } break;
+
+        default:
+        {
+            return 0;
+        } break;
+    }
+    uint32_t rice_parameter_escape = (0x1 << rice_parameter_bits) - 1;
     // <4> : Partition order
-    uint32_t residual_partition_order = 0;
-    bytes += unpack_bits_to_uint32(bytes, 4, bit_current, &bit_current, &residual_partition_order);
+    uint32_t residual_partition_order = FLACBitReaderReadUnsigned(reader, 4);
     // There will be 2^order partitions
     uint32_t partition_count = 0x1 << residual_partition_order; // 2^tmp_lpc.residual_partition_order
-    uint32_t* rice_parameters = (uint32_t*)malloc(partition_count * sizeof(uint32_t));
-    int32_t* residuals = (int32_t*)malloc((frame_block_size - order) * sizeof(int32_t));
+    // Each partition must have the same number of samples, and the first one must fit the warm-up samples
+    if (((frame_block_size & (partition_count - 1)) != 0) ||
+        ((frame_block_size >> residual_partition_order) < order))
+    {
+        return 0;
+    }
     uint32_t residual_counter = 0;
 
-    uint32_t total_samples = order;
     for (uint32_t i = 0; i < partition_count; i++)
     {
-        switch (residual_coding_method)
-        {
-            case FLAC_RESIDUAL_TYPE_RICE:
-            {
-                // <4(+5)> : Encoding parameter:
-                //            0000-1110 : Rice parameter.
-                //            1111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
-                bytes += unpack_bits_to_uint32(bytes, 4, bit_current, &bit_current, &rice_parameters[i]);
-                if (rice_parameters[i] == 0b1111)
-                {
-                    //bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &bits_per_sample_tmp);
-                    printf("%s:%i Not supported yet\n", __FILE__, __LINE__);
-                    exit(EXIT_FAILURE);
-                }
-            } break;
-
-            case FLAC_RESIDUAL_TYPE_RICE2:
-            {
-                // <5(+5)> : Encoding parameter:
-                //            00000-11110 : Rice parameter.
-                //            11111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
-                bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &rice_parameters[i]);
-                if (rice_parameters[i] == 0b11111)
-                {
-                    //bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &bits_per_sample_tmp);
-                    printf("%s:%i Not supported yet\n", __FILE__, __LINE__);
-                    exit(EXIT_FAILURE);
-                }
-            } break;
+        uint32_t rice_parameter = FLACBitReaderReadUnsigned(reader, rice_parameter_bits);
 
-            default:
-            {
-                printf("%s:%i Invalid residual type in LPC subframe: %u\n", __FILE__, __LINE__, residual_type);
-                exit(EXIT_FAILURE);
-            } break;
-        }
-        
         // <?> : Encoded residual. The number of samples (n) in the partition is determined as follows:
         //        if the partition order is zero, n = frame's blocksize - predictor order
         //        else if this is not the first partition of the subframe, n = (frame's blocksize / (2^partition order))
@@ -1072,24 +1220,56 @@ uint64_t FLACLoadSubframeFixed(byte_t* bytes, uint32_t bits_per_sample, uint32_t
         {
             samples_in_partition_count = (frame_block_size / (0x1 << residual_partition_order)) - order;
         }
-        total_samples += samples_in_partition_count;
-        //printf("parameter [%u]=%u (%u samples)\n", i, rice_parameters[i], samples_in_partition_count);
-        
-        // For each sample, extract the Rice code
-        for (uint32_t j = 0; j < samples_in_partition_count; j++)
+
+        if (rice_parameter == rice_parameter_escape)
         {
-            bytes += unpack_rice_to_int32(bytes, bit_current, &bit_current, rice_parameters[i], &residuals[residual_counter]);
-            //printf("Residual: %i\n", residuals[residual_counter]);
-            residual_counter += 1;
+            // <5> : Escaped partition, each residual is stored as an n-bit signed value (n = 0 means all residuals are 0)
+            uint32_t escape_bits_per_sample = FLACBitReaderReadUnsigned(reader, 5);
+            if (escape_bits_per_sample == 0)
+            {
+                memset(residuals + residual_counter, 0, samples_in_partition_count * sizeof(int32_t));
+            }
+            else
+            {
+                for (uint32_t j = 0; j < samples_in_partition_count; j++)
+                {
+                    residuals[residual_counter + j] = FLACBitReaderReadSigned(reader, escape_bits_per_sample);
+                }
+            }
+        }
+        else
+        {
+            FLACBitReaderReadRicePartition(reader, rice_parameter, samples_in_partition_count, residuals + residual_counter);
         }
+        residual_counter += samples_in_partition_count;
+    }
+    assert(residual_counter == frame_block_size - order);
+
+    return 1;
+}
+
+// 'residuals' is scratch memory for at least frame_block_size samples
+// Returns 0 if the subframe is invalid
+static uint8_t FLACLoadSubframeFixed(flac_bit_reader_t* reader, uint32_t bits_per_sample, uint32_t order, uint32_t frame_block_size, int32_t* residuals, flac_subframe_header_t* subframe)
+{
+    if (order > frame_block_size)
+    {
+        return 0;
+    }
+
+    // <n> : Unencoded warm-up samples (n = frame's bits-per-sample * predictor order)
+    for (uint32_t i = 0; i < order; i++)
+    {
+        subframe->samples[i] = FLACBitReaderReadSigned(reader, bits_per_sample);
+    }
+    if (FLACLoadResidual(reader, order, frame_block_size, residuals) == 0)
+    {
+        return 0;
     }
-    //printf("Total samples: %u\n", total_samples);
-    assert(frame_block_size == total_samples);
     
     // Decode subframe
     // TODO: understand this
     subframe->sample_count = frame_block_size;
-    memcpy(subframe->samples, unencoded_warmup_samples, order * sizeof(int32_t));
     switch(order) {
 		case 0:
 			memcpy(subframe->samples, residuals, (frame_block_size - order) * sizeof(int32_t));
@@ -1125,14 +1305,7 @@ uint64_t FLACLoadSubframeFixed(byte_t* bytes, uint32_t bits_per_sample, uint32_t
 		default:
 			assert(0);
 	}
-    
-    // Clean-up
-    free(residuals);
-    free(rice_parameters);
-    free(unencoded_warmup_samples);
-    
-    *bit_end = bit_current;
-    return (bytes - bytes_start);
+    return 1;
 }
 
 // A subframe  has
@@ -1141,479 +1314,2062 @@ uint64_t FLACLoadSubframeFixed(byte_t* bytes, uint32_t bits_per_sample, uint32_t
 //  - N partitions, each of which has
 //    - a Rice parameter
 //    - M residual (error) samples
-uint64_t FLACLoadSubframeLPC(byte_t* bytes, uint32_t bits_per_sample, uint32_t lpc_order, uint32_t frame_block_size, uint8_t bit_current, uint8_t* bit_end, flac_subframe_header_t* subframe)
+// 'residuals' is scratch memory for at least frame_block_size samples, and 'unencoded_predictor_coefficients' for FLAC_MAX_LPC_ORDER
+// Returns 0 if the subframe is invalid
+static uint8_t FLACLoadSubframeLPC(flac_bit_reader_t* reader, uint32_t bits_per_sample, uint32_t lpc_order, uint32_t frame_block_size, int32_t* residuals, int32_t* unencoded_predictor_coefficients, flac_subframe_header_t* subframe)
 {
-    byte_t* bytes_start = bytes;
+    assert(lpc_order <= FLAC_MAX_LPC_ORDER);
+    if (lpc_order > frame_block_size)
+    {
+        return 0;
+    }
 
     // <n> : Unencoded warm-up samples (n = frame's bits-per-sample * lpc order)
-    int32_t* unencoded_warmup_samples = (int32_t*)malloc(lpc_order * sizeof(int32_t));
-    uint32_t mask = 0x01 << (bits_per_sample - 1); // Mark sign bit
     for (uint32_t i = 0; i < lpc_order; i++)
     {
-        uint32_t tmp_value = 0;
-        bytes += unpack_bits_to_uint32(bytes, bits_per_sample, bit_current, &bit_current, &tmp_value);
-        // From https://graphics.stanford.edu/~seander/bithacks.html#VariableSignExtend
-        tmp_value = (tmp_value ^ mask) - mask;
-        unencoded_warmup_samples[i] = tmp_value;
-        //printf("warmup[%u]=%i\n", i, unencoded_warmup_samples[i]);
+        subframe->samples[i] = FLACBitReaderReadSigned(reader, bits_per_sample);
     }
     // <4> : (Quantized linear predictor coefficients' precision in bits)-1 (1111 = invalid)
-    uint32_t quantizied_linear_coefficient_bits = 0;
-    bytes += unpack_bits_to_uint32(bytes, 4, bit_current, &bit_current, &quantizied_linear_coefficient_bits);
-    quantizied_linear_coefficient_bits += 1;
+    uint32_t quantizied_linear_coefficient_bits = FLACBitReaderReadUnsigned(reader, 4) + 1;
     // <5> : Quantized linear predictor coefficient shift needed in bits (NOTE: this number is signed two's-complement)
-    uint32_t quantizied_linear_coefficient_shift_bits = 0;
-    bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &quantizied_linear_coefficient_shift_bits);
+    uint32_t quantizied_linear_coefficient_shift_bits = FLACBitReaderReadUnsigned(reader, 5);
+    // Encoders never use a negative shift, and the reference decoder rejects it
+    if ((quantizied_linear_coefficient_bits == 16) ||
+        ((quantizied_linear_coefficient_shift_bits & 0b10000) != 0))
+    {
+        return 0;
+    }
     // <n> : Unencoded predictor coefficients (n = qlp coeff precision * lpc order) (NOTE: the coefficients are signed two's-complement)
-    int32_t* unencoded_predictor_coefficients = (int32_t*)malloc(lpc_order * sizeof(int32_t));
-    mask = 0x01 << (quantizied_linear_coefficient_bits - 1); // Mark sign bit
     for (uint32_t i = 0; i < lpc_order; i++)
     {
-        uint32_t tmp_value = 0;
-        bytes += unpack_bits_to_uint32(bytes, quantizied_linear_coefficient_bits, bit_current, &bit_current, &tmp_value);
-        // From https://graphics.stanford.edu/~seander/bithacks.html#VariableSignExtend
-        tmp_value = (tmp_value ^ mask) - mask;
-        unencoded_predictor_coefficients[i] = tmp_value;
-        //printf("qlp_coeff[%u]=%i\n", i, unencoded_predictor_coefficients[i]);
+        unencoded_predictor_coefficients[i] = FLACBitReaderReadSigned(reader, quantizied_linear_coefficient_bits);
     }
-    // <2> : Residual coding method:
-    //        00 : partitioned Rice coding with 4-bit Rice parameter; RESIDUAL_CODING_METHOD_PARTITIONED_RICE follows
-    //        01 : partitioned Rice coding with 5-bit Rice parameter; RESIDUAL_CODING_METHOD_PARTITIONED_RICE2 follows
-    //        10-11 : reserved
-    uint32_t residual_type = 0;
-    bytes += unpack_bits_to_uint32(bytes, 2, bit_current, &bit_current, &residual_type);
-    flac_residule_type_e residual_coding_method = (flac_residule_type_e)residual_type;
-    // <4> : Partition order
-    uint32_t residual_partition_order = 0;
-    bytes += unpack_bits_to_uint32(bytes, 4, bit_current, &bit_current, &residual_partition_order);
-    // There will be 2^order partitions
-    uint32_t partition_count = 0x1 << residual_partition_order; // 2^tmp_lpc.residual_partition_order
-    uint32_t* rice_parameters = (uint32_t*)malloc(partition_count * sizeof(uint32_t));
-    int32_t* residuals = (int32_t*)malloc((frame_block_size - lpc_order) * sizeof(int32_t));
-    uint32_t residual_counter = 0;
+    if (FLACLoadResidual(reader, lpc_order, frame_block_size, residuals) == 0)
+    {
+        return 0;
+    }
+    
+    // Decode subframe
+    subframe->sample_count = frame_block_size;
+    FLACLPCRestore(residuals, unencoded_predictor_coefficients, lpc_order, quantizied_linear_coefficient_shift_bits, quantizied_linear_coefficient_bits, bits_per_sample, frame_block_size, subframe->samples);
+    return 1;
+}
 
-    uint32_t total_samples = lpc_order;
-    for (uint32_t i = 0; i < partition_count; i++)
+// Decodes a whole frame (FRAME_HEADER, all SUBFRAMEs and FRAME_FOOTER), and undoes any inter-channel decorrelation
+// so that each subframe holds the samples of one actual channel
+// 'bytes' must have at least FLAC_FRAME_HEADER_SIZE_MAX valid bytes starting with a FRAME_HEADER that passed
+// FLACCheckFrameHeader(), and FLAC_BIT_READER_PADDING readable bytes after 'byte_count'. The samples are only valid if FLAC_FRAME_ERROR_NO is returned, but 'frame_header' always is (a header that
+// FLACLoadFrameHeader() rejects anyway returns FLAC_FRAME_ERROR_INVALID with 'frame_size' 0, and leaves it unchanged).
+// 'frame_size' is set to the bytes read, which is larger than 'byte_count' if the frame is truncated
+static flac_frame_error_e FLACLoadFrame(byte_t* bytes, uint64_t byte_count, flac_metadata_block_streaminfo_t* metadata_block_streaminfo, uint8_t check_crc, flac_frame_decoder_t* frame_decoder, uint64_t* frame_size)
+{
+    assert(byte_count >= FLAC_FRAME_HEADER_SIZE_MAX);
+
+    flac_frame_header_t* frame_header = &frame_decoder->frame_header;
+    flac_subframe_header_t* subframes = frame_decoder->subframes;
+
+    // Parse FRAME_HEADER
+    uint64_t frame_header_size = FLACLoadFrameHeader(bytes, metadata_block_streaminfo, frame_header);
+    if (frame_header_size == 0)
+    {
+        *frame_size = 0;
+        return FLAC_FRAME_ERROR_INVALID;
+    }
+    uint32_t frame_block_size = frame_header->block_size_inter_channel_sampels;
+    uint32_t channel_count = 2;
+    if (frame_header->channel_assignment <= FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BLEFT_BRIGHT_SLEFT_SRIGHT)
+    {
+        channel_count = (uint32_t)frame_header->channel_assignment;
+    }
+    if ((frame_block_size > metadata_block_streaminfo->block_size_max) ||
+        (channel_count != metadata_block_streaminfo->channel_count))
+    {
+        *frame_size = frame_header_size;
+        return FLAC_FRAME_ERROR_INVALID;
+    }
+
+    // Parse each subframe header and subframe
+    flac_bit_reader_t reader;
+    FLACBitReaderInit(&reader, bytes + frame_header_size, byte_count - frame_header_size);
+    for (uint32_t i = 0; i < channel_count; i++)
     {
-        switch (residual_coding_method)
+        uint32_t bits_per_sample = frame_header->bits_per_sample;
+        // If the channel assignment includes a side difference, those warm-up samples
+        // require an additioninal bit per sample (see https://hydrogenaud.io/index.php?topic=121900.0)
+        if (((frame_header->channel_assignment == FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF)  && (i == 1)) ||
+            ((frame_header->channel_assignment == FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT) && (i == 0)) ||
+            ((frame_header->channel_assignment == FLAC_CHANNEL_ASSIGNMENT_MID_DIFF)   && (i == 1)))
+        {
+            bits_per_sample += 1;
+        }
+
+        // Parse SUBFRAME_HEADER
+        if ((FLACLoadSubframeHeader(&reader, &subframes[i]) == 0) ||
+            (subframes[i].wasted_bits_per_sample >= bits_per_sample))
+        {
+            *frame_size = frame_header_size + FLACBitReaderGetBytesRead(&reader);
+            return FLACBitReaderHasOverrun(&reader) ? FLAC_FRAME_ERROR_TRUNCATED : FLAC_FRAME_ERROR_INVALID;
+        }
+        // Wasted bits aren't stored in the subframe
+        bits_per_sample -= subframes[i].wasted_bits_per_sample;
+
+        // Parse SUBFRAME
+        uint8_t is_valid = 1;
+        switch (subframes[i].type)
         {
-            case FLAC_RESIDUAL_TYPE_RICE:
+            case FLAC_SUBFRAME_TYPE_CONSTANT:
             {
-                // <4(+5)> : Encoding parameter:
-                //            0000-1110 : Rice parameter.
-                //            1111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
-                bytes += unpack_bits_to_uint32(bytes, 4, bit_current, &bit_current, &rice_parameters[i]);
-                if (rice_parameters[i] == 0b1111)
-                {
-                    //bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &bits_per_sample_tmp);
-                    printf("%s:%i Not supported yet\n", __FILE__, __LINE__);
-                    exit(EXIT_FAILURE);
-                }
+                FLACLoadSubframeConstant(&reader, bits_per_sample, frame_block_size, &subframes[i]);
             } break;
 
-            case FLAC_RESIDUAL_TYPE_RICE2:
+            case FLAC_SUBFRAME_TYPE_VERBATIM:
             {
-                // <5(+5)> : Encoding parameter:
-                //            00000-11110 : Rice parameter.
-                //            11111 : Escape code, meaning the partition is in unencoded binary form using n bits per sample; n follows as a 5-bit number.
-                bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &rice_parameters[i]);
-                if (rice_parameters[i] == 0b11111)
-                {
-                    //bytes += unpack_bits_to_uint32(bytes, 5, bit_current, &bit_current, &bits_per_sample_tmp);
-                    printf("%s:%i Not supported yet\n", __FILE__, __LINE__);
-                    exit(EXIT_FAILURE);
-                }
+                FLACLoadSubframeVerbatim(&reader, bits_per_sample, frame_block_size, &subframes[i]);
             } break;
 
-            default:
+            case FLAC_SUBFRAME_TYPE_FIXED:
             {
-                printf("%s:%i Invalid residual type in LPC subframe: %u\n", __FILE__, __LINE__, residual_type);
-                exit(EXIT_FAILURE);
+                is_valid = FLACLoadSubframeFixed(&reader, bits_per_sample, subframes[i].lpc_order, frame_block_size, frame_decoder->residuals, &subframes[i]);
+            } break;
+
+            case FLAC_SUBFRAME_TYPE_LPC:
+            {
+                is_valid = FLACLoadSubframeLPC(&reader, bits_per_sample, subframes[i].lpc_order, frame_block_size, frame_decoder->residuals, frame_decoder->qlp_coefficients, &subframes[i]);
             } break;
         }
-        
-        // <?> : Encoded residual. The number of samples (n) in the partition is determined as follows:
-        //        if the partition order is zero, n = frame's blocksize - predictor order
-        //        else if this is not the first partition of the subframe, n = (frame's blocksize / (2^partition order))
-        //        else n = (frame's blocksize / (2^partition order)) - predictor order
-        uint32_t samples_in_partition_count = 0;
-        if (residual_partition_order == 0)
-        {
-            samples_in_partition_count = frame_block_size - lpc_order;
-        }
-        else if (i > 0)
-        {
-            samples_in_partition_count = (frame_block_size / (0x1 << residual_partition_order));
-        }
-        else
+        // Running past the end means the subframe is truncated, or damaged in a way that made it look longer
+        if ((is_valid == 0) || FLACBitReaderHasOverrun(&reader))
         {
-            samples_in_partition_count = (frame_block_size / (0x1 << residual_partition_order)) - lpc_order;
+            *frame_size = frame_header_size + FLACBitReaderGetBytesRead(&reader);
+            return FLACBitReaderHasOverrun(&reader) ? FLAC_FRAME_ERROR_TRUNCATED : FLAC_FRAME_ERROR_INVALID;
         }
-        total_samples += samples_in_partition_count;
-        //printf("parameter [%u]=%u (%u samples)\n", i, rice_parameters[i], samples_in_partition_count);
-        
-        // For each sample, extract the Rice code
-        for (uint32_t j = 0; j < samples_in_partition_count; j++)
+
+        // Restore wasted bits
+        if (subframes[i].wasted_bits_per_sample > 0)
         {
-            bytes += unpack_rice_to_int32(bytes, bit_current, &bit_current, rice_parameters[i], &residuals[residual_counter]);
-            residual_counter += 1;
+            for (uint32_t j = 0; j < frame_block_size; j++)
+            {
+                subframes[i].samples[j] = subframes[i].samples[j] << subframes[i].wasted_bits_per_sample;
+            }
         }
     }
-    //printf("Total samples: %u\n", total_samples);
-    assert(frame_block_size == total_samples);
-    
-    // Decode subframe
-    // TODO: understand this
-    subframe->sample_count = frame_block_size;
-    memcpy(subframe->samples, unencoded_warmup_samples, lpc_order * sizeof(int32_t));
-    for (uint32_t i = lpc_order; i < frame_block_size; i++)
+    // <?> : Zero-padding to byte alignment.
+    FLACBitReaderAlignToByte(&reader);
+    // Parse FRAME_FOOTER
+    // <16> : CRC-16 (polynomial = x^16 + x^15 + x^2 + x^0, initialized with 0) of everything before the crc, back to and including the frame header sync code
+    uint16_t crc = (uint16_t)FLACBitReaderReadUnsigned(&reader, FLAC_FRAME_FOOTER_SIZE * 8);
+    *frame_size = frame_header_size + FLACBitReaderGetBytesRead(&reader);
+    if (FLACBitReaderHasOverrun(&reader))
     {
-        uint32_t sample_index = i;
-        uint32_t residual_index = i - lpc_order;
-        int64_t sum = 0;
-        for (uint32_t j = 0; j < lpc_order; j++)
-        {
-            sum += (int64_t)unencoded_predictor_coefficients[j] * (int64_t)subframe->samples[sample_index - j - 1];
-        }
-        subframe->samples[sample_index] = residuals[residual_index] + (int32_t)(sum >> quantizied_linear_coefficient_shift_bits);
-        //printf("[%u]=%i\n", i - lpc_order, subframe->samples[sample_index]);
+        return FLAC_FRAME_ERROR_TRUNCATED;
     }
-    
-    // Clean-up
-    free(residuals);
-    free(rice_parameters);
-    free(unencoded_predictor_coefficients);
-    free(unencoded_warmup_samples);
-    
-    *bit_end = bit_current;
-    return (bytes - bytes_start);
+    if ((check_crc == 1) && (FLACCRC16(bytes, *frame_size - FLAC_FRAME_FOOTER_SIZE) != crc))
+    {
+        return FLAC_FRAME_ERROR_CRC;
+    }
+
+    // Inter-channel decorrelation is undone by the consumer of the samples, fused with converting them for playback
+    switch (frame_header->channel_assignment)
+    {
+        case FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF:  { frame_decoder->stereo = FLAC_STEREO_LEFT_DIFF; } break;
+        case FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT: { frame_decoder->stereo = FLAC_STEREO_DIFF_RIGHT; } break;
+        case FLAC_CHANNEL_ASSIGNMENT_MID_DIFF:   { frame_decoder->stereo = FLAC_STEREO_MID_DIFF; } break;
+        default:                                 { frame_decoder->stereo = FLAC_STEREO_INDEPENDENT; } break;
+    }
+
+    return FLAC_FRAME_ERROR_NO;
 }
 
-/*song_error_e FLACLoad(song_t* song)
+// Sizes all of a frame decoder's buffers for the largest frame the stream can have
+static void FLACFrameDecoderInit(flac_frame_decoder_t* frame_decoder, flac_metadata_block_streaminfo_t* metadata_block_streaminfo)
 {
-    // Load FLAC file into memory
-    FILE* flac_file = fopen(song->song_path_offset, "rb");
-    if (flac_file == NULL)
+    uint32_t block_size_max = metadata_block_streaminfo->block_size_max;
+    frame_decoder->samples = (int32_t*)malloc(block_size_max * metadata_block_streaminfo->channel_count * sizeof(int32_t));
+    frame_decoder->residuals = (int32_t*)malloc(block_size_max * sizeof(int32_t));
+    for (uint32_t i = 0; i < metadata_block_streaminfo->channel_count; i++)
     {
-        printf("Failed to open %s\n", song->song_path_offset);
-        exit(EXIT_FAILURE);
+        frame_decoder->subframes[i].samples = frame_decoder->samples + (i * block_size_max);
     }
-    fseek(flac_file, 0, SEEK_END);
-    long flac_file_size = ftell(flac_file);
-    fseek(flac_file, 0, SEEK_SET);
-    byte_t* flac_memory = (byte_t*)malloc(flac_file_size);
-    fread((void*)flac_memory, flac_file_size, 1, flac_file);
-    fclose(flac_file);
-    byte_t* flac_memory_start = flac_memory;
-    byte_t* flac_memory_end = flac_memory + flac_file_size;
+    frame_decoder->stereo = FLAC_STEREO_INDEPENDENT;
+}
 
-    // Verify FLAC file
-    if (strncmp((char*)flac_memory, "fLaC", 4) != 0)
+static void FLACFrameDecoderFree(flac_frame_decoder_t* frame_decoder)
+{
+    free(frame_decoder->residuals);
+    free(frame_decoder->samples);
+}
+
+// Undoes inter-channel decorrelation in place, for consumers that need the planar samples of each channel
+static void FLACFrameDecoderDecorrelate(flac_frame_decoder_t* frame_decoder)
+{
+    // Only stereo frames are decorrelated, and mono ones have no second channel
+    if (frame_decoder->stereo == FLAC_STEREO_INDEPENDENT)
     {
-        free(flac_memory);
-        exit(EXIT_FAILURE);
+        return;
     }
-    flac_memory += 4;
+    FLACStereoDecorrelate(frame_decoder->stereo, frame_decoder->frame_header.block_size_inter_channel_sampels, frame_decoder->subframes[0].samples, frame_decoder->subframes[1].samples);
+    frame_decoder->stereo = FLAC_STEREO_INDEPENDENT;
+}
 
-    // Parse METADATA_BLOCK_HEADER
-    flac_metadata_block_header_t metadata_block_header;
-    flac_memory += FLACPLoadMetadataBlockHeader(flac_memory, &metadata_block_header);
-    if (metadata_block_header.type != 0)
+// Ensures a whole frame, and the header of the frame after it, is in the input buffer by moving the undecoded bytes to
+// the front, and reading in more after them
+// Returns number of undecoded bytes in the input buffer
+static uint64_t FLACFillInputBuffer(flac_t* flac)
+{
+    uint64_t available_size = flac->input_buffer_size - flac->input_buffer_offset;
+    if ((available_size < (flac->frame_size_bound + FLAC_FRAME_HEADER_SIZE_MAX)) && (flac->input_end_of_file == 0))
     {
-        printf("First metadata block of FLAC file must be of type STREAMINFO: %u\n", metadata_block_header.type);
-        exit(EXIT_FAILURE);
+        memmove(flac->input_buffer, flac->input_buffer + flac->input_buffer_offset, available_size);
+        flac->input_buffer_file_offset += flac->input_buffer_offset;
+        uint64_t size_to_read = flac->input_buffer_capacity - available_size;
+        uint64_t size_read = ReadAheadRead(&flac->read_ahead, flac->input_buffer + available_size, size_to_read);
+        if (size_read < size_to_read)
+        {
+            // Ensure a truncated last frame can't be parsed into the stale bytes after it. 1-bits end any unary
+            // code right away, and make the bytes an invalid sync code. A last frame shorter than the largest frame
+            // header is read with FLAC_FRAME_HEADER_SIZE_MAX of them after it.
+            flac->input_end_of_file = 1;
+            memset(flac->input_buffer + available_size + size_read, 0xFF, size_to_read - size_read + FLAC_FRAME_HEADER_SIZE_MAX);
+        }
+        flac->input_buffer_size = available_size + size_read;
+        flac->input_buffer_offset = 0;
+        available_size = flac->input_buffer_size;
     }
 
-    // Parse STREAMINFO metadata
-    flac_metadata_block_streaminfo_t metadata_block_streaminfo;
-    flac_memory += FLACLoadMetadataBlockStreaminfo(flac_memory, &metadata_block_streaminfo);
-    //printf("[%u,%u]\n", metadata_block_streaminfo.block_size_min, metadata_block_streaminfo.block_size_max);
-    //printf("[%u,%u]\n", metadata_block_streaminfo.frame_size_min, metadata_block_streaminfo.frame_size_max);
+    return available_size;
+}
 
-    // Skip all following METADATA blocks
-    while (metadata_block_header.is_last == 0)
+// Starts hashing the stream over from its first sample
+static void FLACMD5Reset(flac_t* flac)
+{
+    MD5Init(&flac->md5_context);
+    flac->md5_sample_number = 0;
+    flac->md5_result = FLAC_MD5_RESULT_NO_SIGNATURE;
+    for (uint32_t i = 0; i < 16; i++)
     {
-        flac_memory += FLACPLoadMetadataBlockHeader(flac_memory, &metadata_block_header);
-        if (metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT)
-        {
-            flac_memory += FLACLoadMetadataBlockVorbisComment(flac_memory, song);
-        }
-        else
+        if (flac->streaminfo.md5[i] != 0)
         {
-            flac_memory += metadata_block_header.size;
+            flac->md5_result = FLAC_MD5_RESULT_PENDING;
+            break;
         }
     }
-    
-    // Set up WAV info based on FLAC info
-    uint32_t wav_file_channel_count = metadata_block_streaminfo.channel_count;
-    uint32_t wav_file_sample_rate = 0;
-    uint32_t wav_file_bits_per_sample = 16;
-    uint64_t wav_file_sample_count = metadata_block_streaminfo.sample_count;
-    uint64_t wav_file_sample_index = 0;
-    uint64_t wav_file_size = wav_file_sample_count * wav_file_channel_count * (wav_file_bits_per_sample / 8);
-    int16_t* wav_file_samples = (int16_t*)malloc(wav_file_sample_count * wav_file_channel_count * sizeof(int16_t));
-
-    // Parse all FRAME_HEADERs
-#define INT12_MAX 0x7FF
-#define INT20_MAX 0x7FFFF
-#define INT24_MAX 0x7FFFFF
-    int64_t flac_bits_per_sample_max = 0;
-    switch (metadata_block_streaminfo.bits_per_sample)
-    {
-        case 8:
-        {
-            flac_bits_per_sample_max = INT8_MAX;
-        } break;
-        case 12:
+}
+
+// Hashes the samples in 'flac->frame_decoder' the way the MD5 signature is computed over them: interleaved by channel,
+// as signed little-endian integers of the fewest whole bytes that fit the bits per sample
+static void FLACMD5AddFrame(flac_t* flac)
+{
+    if (flac->md5_result != FLAC_MD5_RESULT_PENDING)
+    {
+        return;
+    }
+    if (flac->frame_decoder.frame_header.sample_number != flac->md5_sample_number)
+    {
+        flac->md5_result = FLAC_MD5_RESULT_INCOMPLETE;
+        return;
+    }
+
+    uint32_t channel_count = flac->streaminfo.channel_count;
+    uint32_t bytes_per_sample = (flac->streaminfo.bits_per_sample + 7) / 8;
+    byte_t* bytes = flac->md5_buffer;
+    for (uint32_t i = 0; i < flac->frame_sample_count; i++)
+    {
+        for (uint32_t channel = 0; channel < channel_count; channel++)
         {
-            flac_bits_per_sample_max = INT12_MAX;
-        } break;
-        case 16:
+            uint32_t sample = (uint32_t)flac->frame_decoder.subframes[channel].samples[i];
+            for (uint32_t byte = 0; byte < bytes_per_sample; byte++)
+            {
+                bytes[byte] = (byte_t)(sample >> (byte * 8));
+            }
+            bytes += bytes_per_sample;
+        }
+    }
+    MD5Update(&flac->md5_context, flac->md5_buffer, (uint64_t)(bytes - flac->md5_buffer));
+    flac->md5_sample_number += flac->frame_sample_count;
+}
+
+// Compares the hash of all decoded samples against the MD5 signature in STREAMINFO
+static void FLACMD5Finish(flac_t* flac)
+{
+    if (flac->md5_result != FLAC_MD5_RESULT_PENDING)
+    {
+        return;
+    }
+
+    byte_t md5[16];
+    MD5Final(&flac->md5_context, md5);
+    if (memcmp(md5, flac->streaminfo.md5, 16) == 0)
+    {
+        flac->md5_result = FLAC_MD5_RESULT_MATCH;
+    }
+    else
+    {
+        flac->md5_result = FLAC_MD5_RESULT_MISMATCH;
+    }
+}
+
+// Empties the input buffer and discards the decoded frame, so that the next frame is read from 'file_offset'
+static void FLACResetInput(flac_t* flac, uint64_t file_offset)
+{
+    ReadAheadSeek(&flac->read_ahead, file_offset);
+    flac->input_buffer_file_offset = file_offset;
+    flac->input_buffer_size = 0;
+    flac->input_buffer_offset = 0;
+    flac->input_end_of_file = 0;
+    flac->frame_sample_count = 0;
+    flac->frame_sample_index = 0;
+    flac->next_sample_number = 0;
+    flac->silence_sample_count = 0;
+
+    // Hashing and index recording can only continue if the stream is decoded from the start again, a recording notices
+    // frames being skipped by itself
+    if (file_offset == flac->audio_data_offset)
+    {
+        FLACMD5Reset(flac);
+        FLACIndexRecordStart(&flac->index);
+    }
+    else if (flac->md5_result == FLAC_MD5_RESULT_PENDING)
+    {
+        flac->md5_result = FLAC_MD5_RESULT_INCOMPLETE;
+    }
+}
+
+// Skips forward in the input to the next valid FRAME_HEADER
+// Returns 0 if the end of the stream is reached first
+static uint8_t FLACFindFrame(flac_t* flac)
+{
+    while (1)
+    {
+        // Stop FLAC_FRAME_HEADER_SIZE_MAX bytes short of the end, so that a header there is checked whole after the next
+        // refill. There is none at the end of the file, where the last frame may be shorter than that.
+        uint64_t available_size = FLACFillInputBuffer(flac);
+        uint64_t scan_size = available_size;
+        if (flac->input_end_of_file == 0)
         {
-            flac_bits_per_sample_max = INT16_MAX;
-        } break;
-        case 20:
+            scan_size = (available_size >= FLAC_FRAME_HEADER_SIZE_MAX) ? (available_size - FLAC_FRAME_HEADER_SIZE_MAX + 1) : 0;
+        }
+        if (scan_size == 0)
         {
-            flac_bits_per_sample_max = INT20_MAX;
-        } break;
-        case 24:
+            return 0;
+        }
+
+        byte_t* bytes = flac->input_buffer + flac->input_buffer_offset;
+        for (uint64_t i = 0; i < scan_size; i++)
         {
-            flac_bits_per_sample_max = INT24_MAX;
-        } break;
-        default:
+            if ((bytes[i] == 0xFF) &&
+                (FLACCheckFrameHeader(bytes + i, available_size - i, &flac->streaminfo, 1) != 0))
+            {
+                flac->input_buffer_offset += i;
+                return 1;
+            }
+        }
+        flac->input_buffer_offset += scan_size;
+
+        if (flac->input_end_of_file == 1)
         {
-            assert(0);
-        } break;
+            return 0;
+        }
+    }
+}
+
+// Plays back the next block of silence in place of damaged frames, through 'flac->frame_decoder' as if it was decoded
+static void FLACLoadSilence(flac_t* flac)
+{
+    assert(flac->silence_sample_count > 0);
+
+    uint32_t sample_count = flac->streaminfo.block_size_max;
+    if (flac->silence_sample_count < sample_count)
+    {
+        sample_count = (uint32_t)flac->silence_sample_count;
+    }
+    for (uint32_t channel = 0; channel < flac->streaminfo.channel_count; channel++)
+    {
+        memset(flac->frame_decoder.subframes[channel].samples, 0, sample_count * sizeof(int32_t));
+    }
+    flac->frame_decoder.stereo = FLAC_STEREO_INDEPENDENT;
+    flac->frame_decoder.frame_header.sample_number = flac->next_sample_number;
+    flac->frame_decoder.frame_header.block_size_inter_channel_sampels = sample_count;
+    flac->silence_sample_count -= sample_count;
+    flac->next_sample_number += sample_count;
+    flac->frame_sample_count = sample_count;
+    flac->frame_sample_index = 0;
+}
+
+// Decodes the next frame in the stream into 'flac->frame_decoder'. A damaged frame is replaced by silence, and decoding
+// resyncs to the next valid frame header.
+// Returns 0 if there are no more frames
+static uint8_t FLACDecodeNextFrame(flac_t* flac)
+{
+    if (flac->silence_sample_count > 0)
+    {
+        FLACLoadSilence(flac);
+        return 1;
+    }
+
+    uint64_t available_size = FLACFillInputBuffer(flac);
+    if (available_size == 0)
+    {
+        return 0;
+    }
+
+    byte_t* bytes = flac->input_buffer + flac->input_buffer_offset;
+    if (FLACCheckFrameHeader(bytes, available_size, &flac->streaminfo, flac->crc_check_enabled) == 0)
+    {
+        // Either the bytes after the last frame (e.g. an ID3v1 tag), or a damaged frame header. A header that only fails
+        // its CRC-8 counts as such, any other damaged one as an invalid frame once it is known not to be the end.
+        uint8_t crc8_error = 0;
+        if ((flac->crc_check_enabled == 1) &&
+            (FLACCheckFrameHeader(bytes, available_size, &flac->streaminfo, 0) != 0))
+        {
+            flac->crc8_error_count++;
+            crc8_error = 1;
+        }
+        flac->input_buffer_offset += 1;
+        if (FLACFindFrame(flac) == 0)
+        {
+            // Damaged last frames are still played back as silence, if STREAMINFO has the length of the stream
+            if (flac->next_sample_number < flac->streaminfo.sample_count)
+            {
+                if (crc8_error == 0)
+                {
+                    flac->invalid_frame_count++;
+                }
+                flac->silence_sample_count = flac->streaminfo.sample_count - flac->next_sample_number;
+                FLACLoadSilence(flac);
+                return 1;
+            }
+            return 0;
+        }
+        flac->resync_count++;
+        if (crc8_error == 0)
+        {
+            flac->invalid_frame_count++;
+        }
+
+        // The sample number of the frame found tells how much was lost, unless it is out of the stream's range
+        available_size = FLACFillInputBuffer(flac);
+        bytes = flac->input_buffer + flac->input_buffer_offset;
+        flac_frame_header_t frame_header;
+        FLACLoadFrameHeader(bytes, &flac->streaminfo, &frame_header);
+        if ((frame_header.sample_number > flac->next_sample_number) &&
+            ((flac->streaminfo.sample_count == 0) || (frame_header.sample_number < flac->streaminfo.sample_count)))
+        {
+            flac->silence_sample_count = frame_header.sample_number - flac->next_sample_number;
+            FLACLoadSilence(flac);
+            return 1;
+        }
+    }
+
+    // Only the last frame can be shorter than FLAC_FRAME_HEADER_SIZE_MAX, and the 1-bits after the end of the file make up the rest
+    uint64_t frame_size = 0;
+    uint64_t byte_count = (available_size < FLAC_FRAME_HEADER_SIZE_MAX) ? FLAC_FRAME_HEADER_SIZE_MAX : available_size;
+    flac_frame_error_e frame_error = FLACLoadFrame(bytes, byte_count, &flac->streaminfo, flac->crc_check_enabled, &flac->frame_decoder, &frame_size);
+    if (((frame_error == FLAC_FRAME_ERROR_TRUNCATED) || (frame_size > available_size)) && (flac->input_end_of_file == 1))
+    {
+        // Truncated last frame
+        return 0;
+    }
+    flac_frame_header_t* frame_header = &flac->frame_decoder.frame_header;
+    if (frame_error != FLAC_FRAME_ERROR_NO)
+    {
+        // The header is valid, so the block is replaced by silence and decoding resyncs after the header
+        if (frame_error == FLAC_FRAME_ERROR_CRC)
+        {
+            flac->crc16_error_count++;
+        }
+        else
+        {
+            flac->invalid_frame_count++;
+        }
+        flac->next_sample_number = frame_header->sample_number;
+        flac->silence_sample_count = frame_header->block_size_inter_channel_sampels;
+        flac->input_buffer_offset += 1;
+        if (FLACFindFrame(flac) == 1)
+        {
+            flac->resync_count++;
+        }
+        FLACLoadSilence(flac);
+        return 1;
+    }
+    uint64_t frame_file_offset = flac->input_buffer_file_offset + flac->input_buffer_offset;
+    FLACIndexRecordFrame(&flac->index, frame_header->sample_number, frame_header->block_size_inter_channel_sampels, frame_file_offset - flac->audio_data_offset);
+    flac->input_buffer_offset += frame_size;
+    flac->next_sample_number = frame_header->sample_number + frame_header->block_size_inter_channel_sampels;
+    flac->frame_sample_count = frame_header->block_size_inter_channel_sampels;
+    flac->frame_sample_index = 0;
+
+    return 1;
+}
+
+// Decodes the next frame in the stream, and hashes it if MD5 verification is enabled. Once there are no more frames, a
+// recording of the index of the whole stream is saved.
+// Returns 0 if there are no more frames
+static uint8_t FLACLoadNextFrame(flac_t* flac)
+{
+    uint8_t frame_loaded = FLACDecodeNextFrame(flac);
+    if (frame_loaded == 0)
+    {
+        FLACIndexRecordFinish(&flac->index);
+    }
+    if (flac->md5_verify_enabled == 1)
+    {
+        if (frame_loaded == 1)
+        {
+            FLACFrameDecoderDecorrelate(&flac->frame_decoder);
+            FLACMD5AddFrame(flac);
+        }
+        else
+        {
+            FLACMD5Finish(flac);
+        }
+    }
+
+    return frame_loaded;
+}
+
+// Narrows down the file range [low, high) to a frame at or before 'sample_index', by bisecting it on the sample numbers
+// in the frame headers. 'low' must be the offset of a frame at or before the sample, and any frame at or after 'high'
+// must start after it. Stops once few enough frames are left that decoding through them is cheaper than another probe.
+// Returns file offset of the frame
+static uint64_t FLACBisect(flac_t* flac, uint64_t sample_index, uint64_t low, uint64_t high)
+{
+    while ((high > low) && ((high - low) > (4 * flac->frame_size_bound)))
+    {
+        uint64_t middle = low + ((high - low) / 2);
+        FLACResetInput(flac, middle);
+        if (FLACFindFrame(flac) == 0)
+        {
+            high = middle;
+            continue;
+        }
+
+        flac_frame_header_t frame_header;
+        FLACLoadFrameHeader(flac->input_buffer + flac->input_buffer_offset, &flac->streaminfo, &frame_header);
+        if (frame_header.sample_number <= sample_index)
+        {
+            low = flac->input_buffer_file_offset + flac->input_buffer_offset;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+// Metadata is read through a window of this size, so that one read covers STREAMINFO, SEEKTABLE and VORBIS_COMMENT of
+// most files, and one more read covers the blocks after a large block that is skipped (e.g. PICTURE)
+#define FLAC_METADATA_WINDOW_SIZE 4096
+
+typedef struct
+{
+    FILE*    file;
+    byte_t   window[FLAC_METADATA_WINDOW_SIZE];
+    uint64_t window_offset; // File offset of 'window'
+    uint64_t window_size;
+} flac_metadata_reader_t;
+
+// Returns 'size' bytes at 'offset' in the file. They're read into the window if they fit in it, and otherwise into
+// '*allocation', which the caller must free.
+// Returns NULL if the file ends first
+static byte_t* FLACReadMetadataBytes(flac_metadata_reader_t* reader, uint64_t offset, uint64_t size, byte_t** allocation)
+{
+    *allocation = NULL;
+    if ((offset >= reader->window_offset) && ((offset + size) <= (reader->window_offset + reader->window_size)))
+    {
+        return reader->window + (offset - reader->window_offset);
     }
-    flac_frame_header_t frame_header;
-    flac_subframe_header_t* subframes = (flac_subframe_header_t*)malloc(metadata_block_streaminfo.channel_count * sizeof(flac_subframe_header_t));
-    for (uint32_t i = 0; i < metadata_block_streaminfo.channel_count; i++)
+
+    if (_fseeki64(reader->file, (int64_t)offset, SEEK_SET) != 0)
+    {
+        return NULL;
+    }
+    if (size <= FLAC_METADATA_WINDOW_SIZE)
+    {
+        reader->window_offset = offset;
+        reader->window_size = fread(reader->window, 1, FLAC_METADATA_WINDOW_SIZE, reader->file);
+        return (size <= reader->window_size) ? reader->window : NULL;
+    }
+    *allocation = (byte_t*)malloc(size);
+    if (fread(*allocation, 1, size, reader->file) != size)
+    {
+        free(*allocation);
+        *allocation = NULL;
+        return NULL;
+    }
+    return *allocation;
+}
+
+// Parses the "fLaC" marker and all METADATA_BLOCKs, the first of which must be STREAMINFO. If 'seek_points' isn't NULL,
+// the first SEEKTABLE is loaded into a new array of '*seek_point_count' points, and if 'cuesheet_tracks' isn't NULL the
+// first CUESHEET into a new array of '*cuesheet_track_count' tracks, which the caller must free.
+static song_error_e FLACLoadMetadataBlocks(FILE* file, song_t* song, flac_metadata_block_streaminfo_t* streaminfo, flac_seek_point_t** seek_points, uint32_t* seek_point_count, flac_cuesheet_track_t** cuesheet_tracks, uint32_t* cuesheet_track_count, uint64_t* audio_data_offset)
+{
+    flac_metadata_reader_t reader;
+    reader.file = file;
+    reader.window_offset = 0;
+    reader.window_size = 0;
+    byte_t* allocation = NULL;
+    byte_t* marker = FLACReadMetadataBytes(&reader, 0, 4, &allocation);
+    if ((marker == NULL) ||
+        (strncmp((char*)marker, "fLaC", 4) != 0))
     {
-        // Guaranteed to be enough
-        subframes[i].samples = (int32_t*)malloc(metadata_block_streaminfo.block_size_max * sizeof(int32_t));
+        return SONG_ERROR_INVALID_FILE;
     }
-    uint32_t flac_file_sample_rate = 0;
-    while (flac_memory < flac_memory_end)
+
+    flac_metadata_block_header_t metadata_block_header;
+    uint8_t found_streaminfo = 0;
+    uint64_t offset = 4;
+    do
     {
-        flac_memory += FLACLoadFrameHeader(flac_memory, &metadata_block_streaminfo, &frame_header);
-        if (flac_file_sample_rate != 0)
+        byte_t* metadata_block_header_bytes = FLACReadMetadataBytes(&reader, offset, 4, &allocation);
+        if (metadata_block_header_bytes == NULL)
         {
-            assert(frame_header.sample_rate == flac_file_sample_rate);
+            return SONG_ERROR_INVALID_FILE;
         }
-        flac_file_sample_rate = frame_header.sample_rate;
-        // Parse each subframe header and subframe
-        uint8_t bit_current = 0;
-        for (uint32_t i = 0; i < metadata_block_streaminfo.channel_count; i++)
+        FLACPLoadMetadataBlockHeader(metadata_block_header_bytes, &metadata_block_header);
+        offset += 4;
+        if ((metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_INVALID) ||
+            ((found_streaminfo == 0) && (metadata_block_header.type != FLAC_METADATA_BLOCK_TYPE_STREAMINFO)))
         {
-            uint32_t bits_per_sample = frame_header.bits_per_sample;
-            // If the channel assignment includes a side difference, those warm-up samples
-            // require an additioninal bit per sample (see https://hydrogenaud.io/index.php?topic=121900.0)
-            if (((frame_header.channel_assignment == FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF)  && (i == 1)) ||
-                ((frame_header.channel_assignment == FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT) && (i == 0)) ||
-                ((frame_header.channel_assignment == FLAC_CHANNEL_ASSIGNMENT_MID_DIFF)   && (i == 1)))
+            return SONG_ERROR_INVALID_FILE;
+        }
+
+        // Skip all other METADATA_BLOCKs without reading them, as they can be large (e.g. PICTURE)
+        uint8_t is_needed = (metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_STREAMINFO) ||
+                            ((metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT) && (song->track_number == 0)) ||
+                            ((metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_SEEKTABLE) && (seek_points != NULL) && (*seek_points == NULL)) ||
+                            ((metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_CUESHEET) && (cuesheet_tracks != NULL) && (*cuesheet_tracks == NULL));
+        if (is_needed == 1)
+        {
+            byte_t* metadata_block_bytes = FLACReadMetadataBytes(&reader, offset, metadata_block_header.size, &allocation);
+            if ((metadata_block_bytes == NULL) ||
+                ((metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_STREAMINFO) && (metadata_block_header.size != 34)))
             {
-                bits_per_sample += 1;
+                free(allocation);
+                return SONG_ERROR_INVALID_FILE;
             }
-            
-            // Parse SUBFRAME_HEADER
-            flac_memory += FLACLoadSubframeHeader(flac_memory, bit_current, &bit_current, &subframes[i]);
-            
-            // Parse SUBFRAME
-            switch (subframes[i].type)
+
+            switch (metadata_block_header.type)
             {
-                case FLAC_SUBFRAME_TYPE_CONSTANT:
+                case FLAC_METADATA_BLOCK_TYPE_STREAMINFO:
                 {
-                    flac_memory += FLACLoadSubframeConstant(flac_memory, bits_per_sample, frame_header.block_size_inter_channel_sampels, bit_current, &bit_current, &subframes[i]);
+                    FLACLoadMetadataBlockStreaminfo(metadata_block_bytes, streaminfo);
+                    found_streaminfo = 1;
                 } break;
 
-                case FLAC_SUBFRAME_TYPE_FIXED:
+                case FLAC_METADATA_BLOCK_TYPE_SEEKTABLE:
                 {
-                    flac_memory += FLACLoadSubframeFixed(flac_memory, bits_per_sample, subframes[i].lpc_order, frame_header.block_size_inter_channel_sampels, bit_current, &bit_current, &subframes[i]);
+                    *seek_points = (flac_seek_point_t*)malloc(((metadata_block_header.size / 18) + 1) * sizeof(flac_seek_point_t));
+                    *seek_point_count = FLACLoadMetadataBlockSeektable(metadata_block_bytes, metadata_block_header.size, *seek_points);
                 } break;
 
-                case FLAC_SUBFRAME_TYPE_LPC:
+                case FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT:
                 {
-                    flac_memory += FLACLoadSubframeLPC(flac_memory, bits_per_sample, subframes[i].lpc_order, frame_header.block_size_inter_channel_sampels, bit_current, &bit_current, &subframes[i]);
+                    FLACLoadMetadataBlockVorbisComment(metadata_block_bytes, metadata_block_header.size, song);
                 } break;
 
-                default:
+                case FLAC_METADATA_BLOCK_TYPE_CUESHEET:
                 {
-                    printf("%s:%i Invalid subframe header type: %i\n", __FILE__, __LINE__, subframes[i].type);
-                    exit(EXIT_FAILURE);
-                }
+                    // STREAMINFO is always the first METADATA_BLOCK, so the length of the stream is known
+                    *cuesheet_tracks = (flac_cuesheet_track_t*)malloc(((metadata_block_header.size / 36) + 1) * sizeof(flac_cuesheet_track_t));
+                    *cuesheet_track_count = FLACLoadMetadataBlockCuesheet(metadata_block_bytes, metadata_block_header.size, streaminfo->sample_count, *cuesheet_tracks);
+                    if (*cuesheet_track_count == 0)
+                    {
+                        free(*cuesheet_tracks);
+                        *cuesheet_tracks = NULL;
+                    }
+                } break;
+
+                default: {} break;
             }
+            free(allocation);
         }
-        // <?> : Zero-padding to byte alignment.
-        if (bit_current > 0)
+        offset += metadata_block_header.size;
+    } while (metadata_block_header.is_last == 0);
+
+    *audio_data_offset = offset;
+    return SONG_ERROR_NO;
+}
+
+// Only streams whose samples fit in the int32_t samples of a subframe are supported (side channels require an extra bit)
+// Returns 0 if the stream isn't supported
+static uint8_t FLACStreaminfoIsSupported(flac_metadata_block_streaminfo_t* metadata_block_streaminfo)
+{
+    return (metadata_block_streaminfo->channel_count <= FLAC_MAX_CHANNEL_COUNT) &&
+           (metadata_block_streaminfo->bits_per_sample <= 24) &&
+           (metadata_block_streaminfo->block_size_max >= 16);
+}
+
+// The largest frame an encoder should output is one where every subframe is VERBATIM (side channels have 1 extra bit per sample)
+// Returns the size of the largest frame the stream can have
+static uint64_t FLACFrameSizeBound(flac_metadata_block_streaminfo_t* metadata_block_streaminfo)
+{
+    uint64_t frame_size_bound = FLAC_FRAME_HEADER_SIZE_MAX + FLAC_FRAME_FOOTER_SIZE;
+    frame_size_bound += metadata_block_streaminfo->channel_count * (1 + 4 + (((metadata_block_streaminfo->block_size_max * (metadata_block_streaminfo->bits_per_sample + 1)) + 7) / 8));
+    if (metadata_block_streaminfo->frame_size_max > frame_size_bound)
+    {
+        frame_size_bound = metadata_block_streaminfo->frame_size_max;
+    }
+    return frame_size_bound;
+}
+
+song_error_e FLACProbe(song_t* song, flac_metadata_block_streaminfo_t* streaminfo, flac_cuesheet_track_t** cuesheet_tracks, uint32_t* cuesheet_track_count)
+{
+    assert(song != NULL);
+    assert(song->song_path_offset != NULL);
+    assert(streaminfo != NULL);
+    assert((cuesheet_tracks == NULL) || (cuesheet_track_count != NULL));
+
+    if (cuesheet_tracks != NULL)
+    {
+        *cuesheet_tracks = NULL;
+        *cuesheet_track_count = 0;
+    }
+
+    FILE* flac_file = fopen(song->song_path_offset, "rb");
+    if (flac_file == NULL)
+    {
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+    // Reads are few and already sized, so the FILE doesn't need a buffer of its own
+    setvbuf(flac_file, NULL, _IONBF, 0);
+
+    uint64_t audio_data_offset = 0;
+    song_error_e song_error = FLACLoadMetadataBlocks(flac_file, song, streaminfo, NULL, NULL, cuesheet_tracks, cuesheet_track_count, &audio_data_offset);
+    fclose(flac_file);
+    if (song_error != SONG_ERROR_NO)
+    {
+        if (cuesheet_tracks != NULL)
         {
-            bit_current = 0;
-            flac_memory += 1;
-        }
-        // Parse FRAME_FOOTER
-        // <16> : CRC-16 (polynomial = x^16 + x^15 + x^2 + x^0, initialized with 0) of everything before the crc, back to and including the frame header sync code
-        flac_memory += 2;
-        
-        // Convert to WAV
-        switch (frame_header.channel_assignment)
-        {
-            // Encoding:
-            //  LEFT = LEFT
-            //  RIGHT = RIGHT
-            // Decoding:
-            //  LEFT = LEFT
-            //  RIGHT = RIGHT
-            case FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT:
-            {
-                flac_subframe_header_t* left = &subframes[0];
-                flac_subframe_header_t* right = &subframes[1];
-                assert(left->sample_count == right->sample_count);
-                for (uint32_t i = 0; i < left->sample_count; i++)
-                {
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)left->samples[i] / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)right->samples[i] / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                }
-            } break;
-            
-            // Endocing:
-            //  LEFT = LEFT
-            //  DIFF = LEFT - RIGHT
-            // Decoding:
-            //  LEFT = LEFT
-            //  RIGHT = LEFT - DIFF = LEFT - LEFT + RIGHT = RIGHT
-            case FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF:
-            {
-                flac_subframe_header_t* left = &subframes[0];
-                flac_subframe_header_t* diff = &subframes[1];
-                assert(left->sample_count == diff->sample_count);
-                for (uint32_t i = 0; i < left->sample_count; i++)
-                {
-                    int32_t left_sample = left->samples[i];
-                    int32_t diff_sample = diff->samples[i];
-                    int32_t right_sample = left_sample - diff_sample;
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)left_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)right_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                }
-            } break;
-            
-            // Encoding:
-            //  DIFF = LEFT - RIGHT
-            //  RIGHT = RIGHT
-            // Decoding:
-            //  LEFT = RIGHT + DIFF = RIGHT + LEFT - RIGHT = LEFT
-            //  RIGHT = RIGHT
-            case FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT:
-            {
-                flac_subframe_header_t* diff = &subframes[0];
-                flac_subframe_header_t* right = &subframes[1];
-                assert(diff->sample_count == right->sample_count);
-                for (uint32_t i = 0; i < diff->sample_count; i++)
-                {
-                    int32_t diff_sample = diff->samples[i];
-                    int32_t right_sample = right->samples[i];
-                    int32_t left_sample = (right_sample + diff_sample);
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)left_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)right_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                }
-            } break;
-            
-            // Encoding:
-            //  MID = (LEFT + RIGHT) >> 1
-            //  DIFF = LEFT - RIGHT
-            // Decoding:
-            //  LEFT  = ((MID << 1) + DIFF) >> 1 = (LEFT + RIGHT + LEFT - RIGHT) >> 1 = 2LEFT / 2 = LEFT
-            //  RIGHT = ((MID << 1) - DIFF) >> 1 = (LEFT + RIGHT - LEFT + RIGHT) >> 1 = 2RIGHT / 2 = RIGHT
-            case FLAC_CHANNEL_ASSIGNMENT_MID_DIFF:
-            {
-                flac_subframe_header_t* mid = &subframes[0];
-                flac_subframe_header_t* diff = &subframes[1];
-                assert(mid->sample_count == diff->sample_count);
-                for (uint32_t i = 0; i < mid->sample_count; i++)
-                {
-                    int32_t diff_sample = diff->samples[i];
-                    int32_t mid_sample = mid->samples[i] << 1;
-                    if (diff_sample & 1)
-                    {
-                        mid_sample += 1;
-                    }
-                    int32_t left_sample = (mid_sample + diff_sample) >> 1;
-                    int32_t right_sample = (mid_sample - diff_sample) >> 1;
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)left_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                    wav_file_samples[wav_file_sample_index++] = (int16_t)(((float)right_sample / (float)flac_bits_per_sample_max) * (float)INT16_MAX);
-                }
-            } break;
-                
-            default:
-            {
-                printf("Channel assignment %i\n", frame_header.channel_assignment);
-                assert(0);
-            } break;
+            free(*cuesheet_tracks);
+            *cuesheet_tracks = NULL;
+            *cuesheet_track_count = 0;
         }
+        return song_error;
+    }
+
+    song->sample_rate = streaminfo->sample_rate;
+    song->channel_count = streaminfo->channel_count;
+    song->valid_bits_per_sample = (uint8_t)streaminfo->bits_per_sample;
+    return SONG_ERROR_NO;
+}
+
+song_error_e FLACLoadHeader(song_t* song)
+{
+    assert(song != NULL);
+    assert(song->song_path_offset != NULL);
+
+    // Open FLAC file
+    FILE* flac_file = fopen(song->song_path_offset, "rb");
+    if (flac_file == NULL)
+    {
+        printf("Failed to open %s : \"%s\"\n", song->song_path_offset, strerror(errno));
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
     }
-    for (uint32_t i = 0; i < metadata_block_streaminfo.channel_count; i++)
+
+    // Determine FLAC file size, which may be over the 2 GB a long holds
+    _fseeki64(flac_file, 0, SEEK_END);
+    int64_t flac_file_size = _ftelli64(flac_file);
+    _fseeki64(flac_file, 0, SEEK_SET);
+
+    flac_metadata_block_streaminfo_t metadata_block_streaminfo;
+    flac_seek_point_t* seek_points = NULL;
+    uint32_t seek_point_count = 0;
+    uint64_t audio_data_offset = 0;
+    if (FLACLoadMetadataBlocks(flac_file, song, &metadata_block_streaminfo, &seek_points, &seek_point_count, NULL, NULL, &audio_data_offset) != SONG_ERROR_NO)
     {
-        free(subframes[i].samples);
+        free(seek_points);
+        fclose(flac_file);
+        return SONG_ERROR_INVALID_FILE;
     }
-    free(subframes);
-    free(flac_memory_start);
-    
-    // Create WAV file
-    wav_file_size += 44;
-    byte_t* wav_data = (byte_t*)malloc(wav_file_size * sizeof(byte_t));
-    byte_t* wav_data_current = wav_data;
-    const char* riff_str = "RIFF";
-    memcpy(wav_data_current, riff_str, 4);
-    wav_data_current += 4;
-    uint32_t chunk_size = (uint32_t)(wav_file_size - 8);
-    memcpy(wav_data_current, &chunk_size, 4);
-    wav_data_current += 4;
-    const char* wave_str = "WAVE";
-    memcpy(wav_data_current, wave_str, 4);
-    wav_data_current += 4;
-    const char* fmt_str = "fmt ";
-    memcpy(wav_data_current, fmt_str, 4);
-    wav_data_current += 4;
-    uint32_t subchunk_size1 = 16;
-    memcpy(wav_data_current, &subchunk_size1, 4);
-    wav_data_current += 4;
-    uint16_t audio_format = 1;
-    memcpy(wav_data_current, &audio_format, 2);
-    wav_data_current += 2;
-    uint16_t channel_count = wav_file_channel_count;
-    memcpy(wav_data_current, &channel_count, 2);
-    wav_data_current += 2;
-    wav_file_sample_rate = flac_file_sample_rate;
-    uint32_t sample_rate = wav_file_sample_rate;
-    memcpy(wav_data_current, &channel_count, 4);
-    wav_data_current += 4;
-    uint32_t byte_rate = sample_rate * channel_count * (wav_file_bits_per_sample / 8);
-    memcpy(wav_data_current, &byte_rate, 4);
-    wav_data_current += 4;
-    uint16_t block_align = channel_count * (wav_file_bits_per_sample / 8);
-    memcpy(wav_data_current, &block_align, 2);
-    wav_data_current += 2;
-    uint16_t bits_per_sample = wav_file_bits_per_sample;
-    memcpy(wav_data_current, &bits_per_sample, 2);
-    wav_data_current += 2;
-    const char* data_str = "data";
-    memcpy(wav_data_current, data_str, 4);
-    wav_data_current += 4;
-    uint32_t subchunk_size2 = (uint32_t)(wav_file_size - 44);
-    memcpy(wav_data_current, &subchunk_size2, 4);
-    wav_data_current += 4;
-    memcpy(wav_data_current, wav_file_samples, subchunk_size2);
-    free(wav_file_samples);
-
-    // Set WAV information
-    song->audio_data = (byte_t*)malloc(subchunk_size2);
-    memcpy(song->audio_data, wav_data + 40, subchunk_size2);
-    song->audio_data_size = subchunk_size2;
-    song->sample_rate = sample_rate;
-    song->channel_count = channel_count;
-    song->bits_per_sample = bits_per_sample;
-    
-    // Clean-up
-    free(wav_data);
+
+    if (FLACStreaminfoIsSupported(&metadata_block_streaminfo) == 0)
+    {
+        free(seek_points);
+        fclose(flac_file);
+        return SONG_ERROR_INVALID_FILE;
+    }
+
+    // Set up streaming of frames, which are read ahead of decoding on a thread of their own
+    flac_t* flac = (flac_t*)malloc(sizeof(flac_t));
+    if (ReadAheadOpen(&flac->read_ahead, song->song_path_offset, NULL, audio_data_offset) == 0)
+    {
+        printf("Failed to open %s for reading ahead\n", song->song_path_offset);
+        free(flac);
+        free(seek_points);
+        fclose(flac_file);
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+    flac->file = flac_file;
+    flac->file_size = (uint64_t)flac_file_size;
+    flac->audio_data_offset = audio_data_offset;
+    flac->streaminfo = metadata_block_streaminfo;
+    flac->seek_points = seek_points;
+    flac->seek_point_count = seek_point_count;
+    FLACIndexOpen(&flac->index, song->song_path_offset, audio_data_offset, metadata_block_streaminfo.sample_count, metadata_block_streaminfo.block_size_min);
+    flac->frame_size_bound = FLACFrameSizeBound(&metadata_block_streaminfo);
+    flac->input_buffer_capacity = 2 * flac->frame_size_bound;
+    flac->input_buffer = (byte_t*)malloc(flac->input_buffer_capacity + FLAC_FRAME_HEADER_SIZE_MAX + FLAC_BIT_READER_PADDING);
+    memset(flac->input_buffer + flac->input_buffer_capacity, 0, FLAC_BIT_READER_PADDING);
+    flac->input_buffer_file_offset = flac->audio_data_offset;
+    flac->input_buffer_size = 0;
+    flac->input_buffer_offset = 0;
+    flac->input_end_of_file = 0;
+    FLACFrameDecoderInit(&flac->frame_decoder, &metadata_block_streaminfo);
+    flac->frame_sample_count = 0;
+    flac->frame_sample_index = 0;
+    flac->crc_check_enabled = 1;
+    flac->next_sample_number = 0;
+    flac->silence_sample_count = 0;
+    flac->crc8_error_count = 0;
+    flac->crc16_error_count = 0;
+    flac->invalid_frame_count = 0;
+    flac->resync_count = 0;
+    flac->md5_verify_enabled = 0;
+    // Allocated up front, as MD5 verification can be enabled at any time during playback
+    flac->md5_buffer = (byte_t*)malloc((uint64_t)metadata_block_streaminfo.block_size_max * metadata_block_streaminfo.channel_count * ((metadata_block_streaminfo.bits_per_sample + 7) / 8));
+    FLACMD5Reset(flac);
+    flac->dither_enabled = 1;
+    FLACDitherInit(&flac->dither);
+    flac->output_sample_end = 0;
+    FLACCRCInit();
+
+    // Assign FLAC info to song, played back as 16-bit unless the sink asks for another format
+    song->file = flac_file;
+    song->flac = flac;
+    song->file_size = (uint64_t)flac_file_size;
+    song->sample_rate = metadata_block_streaminfo.sample_rate;
+    song->channel_count = metadata_block_streaminfo.channel_count;
+    FLACSetOutputFormat(song, SAMPLE_FORMAT_INT, sizeof(int16_t));
 
     return SONG_ERROR_NO;
-}*/
+}
+
+void FLACSetOutputFormat(song_t* song, sample_format_e sample_format, uint8_t bps)
+{
+    assert(song != NULL);
+    assert(song->flac != NULL);
+    assert(((sample_format == SAMPLE_FORMAT_INT) && ((bps == sizeof(int16_t)) || (bps == sizeof(int32_t)))) ||
+           ((sample_format == SAMPLE_FORMAT_FLOAT) && (bps == sizeof(float))));
+
+    flac_t* flac = song->flac;
+    flac->output_sample_format = sample_format;
+    flac->output_bps = bps;
+
+    song->audio_data_size = flac->streaminfo.sample_count * flac->streaminfo.channel_count * bps;
+    song->bps = bps;
+    song->sample_format = sample_format;
+    if (sample_format == SAMPLE_FORMAT_FLOAT)
+    {
+        song->valid_bits_per_sample = 32;
+    }
+    else if (flac->streaminfo.bits_per_sample < (uint32_t)(bps * 8))
+    {
+        song->valid_bits_per_sample = (uint8_t)flac->streaminfo.bits_per_sample;
+    }
+    else
+    {
+        song->valid_bits_per_sample = bps * 8;
+    }
+}
+
+uint32_t FLACLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output)
+{
+    assert(audio_thread_data != NULL);
+    assert(audio_thread_data->flac != NULL);
+    assert(audio_thread_data->bps == audio_thread_data->flac->output_bps);
+    assert(audio_thread_data->sample_format == audio_thread_data->flac->output_sample_format);
+    assert(output_size > 0);
+    assert(output != NULL);
+
+    flac_t* flac = audio_thread_data->flac;
+    uint32_t channel_count = flac->streaminfo.channel_count;
+    uint32_t bits_per_sample = flac->streaminfo.bits_per_sample;
+    uint32_t total_bytes_per_sample_all_channels = audio_thread_data->bps * channel_count;
+    uint32_t total_samples_that_fit = (uint32_t)(output_size / total_bytes_per_sample_all_channels);
+    flac_dither_t* dither = (flac->dither_enabled == 1) ? &flac->dither : NULL;
+
+    uint32_t output_sample_count = 0;
+    while (output_sample_count < total_samples_that_fit)
+    {
+        // Decode the next frame once all samples of the current one have been output
+        if (flac->frame_sample_index == flac->frame_sample_count)
+        {
+            if (FLACLoadNextFrame(flac) == 0)
+            {
+                break;
+            }
+        }
 
+        // Convert and interleave as many of the frame's remaining samples as fit, up to the end of the track
+        uint32_t frame_samples_remaining = flac->frame_sample_count - flac->frame_sample_index;
+        uint32_t sample_count = total_samples_that_fit - output_sample_count;
+        if (frame_samples_remaining < sample_count)
+        {
+            sample_count = frame_samples_remaining;
+        }
+        if (flac->output_sample_end != 0)
+        {
+            uint64_t sample_number = flac->frame_decoder.frame_header.sample_number + flac->frame_sample_index;
+            if (sample_number >= flac->output_sample_end)
+            {
+                break;
+            }
+            if ((flac->output_sample_end - sample_number) < sample_count)
+            {
+                sample_count = (uint32_t)(flac->output_sample_end - sample_number);
+            }
+        }
+        const int32_t* channels[FLAC_MAX_CHANNEL_COUNT];
+        for (uint32_t channel = 0; channel < channel_count; channel++)
+        {
+            channels[channel] = flac->frame_decoder.subframes[channel].samples + flac->frame_sample_index;
+        }
+        byte_t* output_samples = output + ((uint64_t)output_sample_count * total_bytes_per_sample_all_channels);
+        if (flac->output_sample_format == SAMPLE_FORMAT_FLOAT)
+        {
+            FLACOutputFloat32(channels, channel_count, flac->frame_decoder.stereo, bits_per_sample, sample_count, (float*)output_samples);
+        }
+        else if (flac->output_bps == sizeof(int32_t))
+        {
+            FLACOutputInt32(channels, channel_count, flac->frame_decoder.stereo, bits_per_sample, sample_count, (int32_t*)output_samples);
+        }
+        else
+        {
+            FLACOutputInt16(channels, channel_count, flac->frame_decoder.stereo, bits_per_sample, sample_count, dither, (int16_t*)output_samples);
+        }
+        flac->frame_sample_index += sample_count;
+        output_sample_count += sample_count;
+    }
+
+    return output_sample_count * total_bytes_per_sample_all_channels;
+}
+
+uint8_t FLACSeek(flac_t* flac, uint64_t sample_index)
+{
+    assert(flac != NULL);
+
+    if ((flac->streaminfo.sample_count != 0) && (sample_index >= flac->streaminfo.sample_count))
+    {
+        return 0;
+    }
+
+    // Find a frame at or before the sample. The index leaves at most FLAC_INDEX_FRAME_INTERVAL frames to bisect, otherwise
+    // the seek points (if any) narrow down the range.
+    uint64_t low = flac->audio_data_offset;
+    uint64_t high = flac->file_size;
+    uint64_t index_offset_low = 0;
+    uint64_t index_offset_high = flac->file_size - flac->audio_data_offset;
+    if (FLACIndexFind(&flac->index, sample_index, &index_offset_low, &index_offset_high) == 1)
+    {
+        low = flac->audio_data_offset + index_offset_low;
+        high = flac->audio_data_offset + index_offset_high;
+    }
+    else if (flac->seek_point_count > 0)
+    {
+        // First seek point after the sample
+        uint32_t seek_point_low = 0;
+        uint32_t seek_point_high = flac->seek_point_count;
+        while (seek_point_low < seek_point_high)
+        {
+            uint32_t seek_point_middle = seek_point_low + ((seek_point_high - seek_point_low) / 2);
+            if (flac->seek_points[seek_point_middle].sample_number <= sample_index)
+            {
+                seek_point_low = seek_point_middle + 1;
+            }
+            else
+            {
+                seek_point_high = seek_point_middle;
+            }
+        }
+        if (seek_point_low > 0)
+        {
+            low = flac->audio_data_offset + flac->seek_points[seek_point_low - 1].stream_offset;
+        }
+        if (seek_point_low < flac->seek_point_count)
+        {
+            high = flac->audio_data_offset + flac->seek_points[seek_point_low].stream_offset;
+        }
+    }
+    uint64_t file_offset = FLACBisect(flac, sample_index, low, high);
+
+    // Decode frames until the one holding the sample, and continue playback from the sample within it
+    FLACResetInput(flac, file_offset);
+    if (FLACFindFrame(flac) == 0)
+    {
+        return 0;
+    }
+    while (FLACLoadNextFrame(flac) == 1)
+    {
+        uint64_t frame_sample_number = flac->frame_decoder.frame_header.sample_number;
+        if (sample_index < (frame_sample_number + flac->frame_sample_count))
+        {
+            if (sample_index > frame_sample_number)
+            {
+                flac->frame_sample_index = (uint32_t)(sample_index - frame_sample_number);
+            }
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint8_t FLACSetTrack(flac_t* flac, uint64_t sample_start, uint64_t sample_end)
+{
+    assert(flac != NULL);
+    assert((sample_end == 0) || (sample_end > sample_start));
+
+    flac->output_sample_end = sample_end;
+
+    // The next sample to be played back is either in the current frame, or the first of the next frame
+    uint64_t sample_number = flac->next_sample_number;
+    if (flac->frame_sample_index < flac->frame_sample_count)
+    {
+        sample_number = flac->frame_decoder.frame_header.sample_number + flac->frame_sample_index;
+    }
+    if (sample_number == sample_start)
+    {
+        return 1;
+    }
+
+    return FLACSeek(flac, sample_start);
+}
+
+// Records the index by walking the frame headers, without decoding any frames. Frames are found the same way as when
+// resyncing, and a header only counts as the next frame if it starts where the previous frame ends in sample numbers, so
+// a sync code in audio data is skipped over. Leaves the stream ready to be played from the start.
+// Returns 1 if the stream has an index
+uint8_t FLACBuildIndex(flac_t* flac)
+{
+    assert(flac != NULL);
+
+    if (flac->index.point_count > 0)
+    {
+        return 1;
+    }
+
+    FLACResetInput(flac, flac->audio_data_offset);
+    uint64_t sample_number = 0;
+    while ((flac->index.recording == 1) && (FLACFindFrame(flac) == 1))
+    {
+        byte_t* bytes = flac->input_buffer + flac->input_buffer_offset;
+        flac_frame_header_t frame_header;
+        uint64_t skip_size = 1;
+        uint64_t frame_header_size = FLACLoadFrameHeader(bytes, &flac->streaminfo, &frame_header);
+        if (frame_header.sample_number == sample_number)
+        {
+            uint64_t frame_file_offset = flac->input_buffer_file_offset + flac->input_buffer_offset;
+            FLACIndexRecordFrame(&flac->index, sample_number, frame_header.block_size_inter_channel_sampels, frame_file_offset - flac->audio_data_offset);
+            sample_number += frame_header.block_size_inter_channel_sampels;
+
+            // No frame is smaller than the smallest one in STREAMINFO, so there's no need to look for the next one before it
+            skip_size = frame_header_size + FLAC_FRAME_FOOTER_SIZE;
+            if (flac->streaminfo.frame_size_min > skip_size)
+            {
+                skip_size = flac->streaminfo.frame_size_min;
+            }
+        }
+        uint64_t available_size = flac->input_buffer_size - flac->input_buffer_offset;
+        flac->input_buffer_offset += (skip_size < available_size) ? skip_size : available_size;
+    }
+    FLACIndexRecordFinish(&flac->index);
+    FLACResetInput(flac, flac->audio_data_offset);
+
+    return (flac->index.point_count > 0) ? 1 : 0;
+}
+
+// A frame decoded by a thread of FLACDecodeParallel()
+typedef struct
+{
+    byte_t*              bytes; // Encoded frame, followed by at least FLAC_BIT_READER_PADDING readable bytes
+    uint64_t             byte_count;
+    uint8_t              is_last; // No valid frame header was found after it
+    flac_frame_decoder_t frame_decoder;
+    flac_frame_error_e   frame_error; // Set by the thread
+    HANDLE               decoded_event; // Set by the thread once 'frame_decoder' holds the samples
+} flac_parallel_frame_t;
+
+/**
+ * Shared between FLACDecodeParallel() and its decode threads.
+ * 
+ * The frames form a ring that is filled in stream order. Each release of 'frames_ready_semaphore' hands one frame to the
+ * threads, and the thread that wakes up claims the next frame in order through 'decode_sequence'. Frames may finish in
+ * any order, so FLACDecodeParallel() waits on the 'decoded_event' of the oldest frame before outputting it and reusing
+ * its slot in the ring.
+*/
+typedef struct
+{
+    flac_metadata_block_streaminfo_t* streaminfo;
+    uint8_t                           crc_check_enabled;
+    flac_parallel_frame_t*            frames;
+    uint32_t                          frame_count;
+    HANDLE                            frames_ready_semaphore;
+    volatile LONG                     decode_sequence; // Number of frames claimed by threads
+    volatile LONG                     stop;
+} flac_parallel_decoder_t;
+
+static DWORD WINAPI FLACDecodeThreadProc(_In_ LPVOID lpParameter)
+{
+    flac_parallel_decoder_t* decoder = (flac_parallel_decoder_t*)lpParameter;
+    while (1)
+    {
+        SyncWaitOnSemaphore(decoder->frames_ready_semaphore, INFINITE, __FILE__, __LINE__);
+        if (decoder->stop == 1)
+        {
+            break;
+        }
+
+        uint32_t sequence = (uint32_t)InterlockedIncrement(&decoder->decode_sequence) - 1;
+        flac_parallel_frame_t* frame = &decoder->frames[sequence % decoder->frame_count];
+        uint64_t frame_size = 0;
+        frame->frame_error = FLACLoadFrame(frame->bytes, frame->byte_count, decoder->streaminfo, decoder->crc_check_enabled, &frame->frame_decoder, &frame_size);
+        if (frame->frame_error == FLAC_FRAME_ERROR_NO)
+        {
+            // Frames are handed to the callback as planar channels
+            FLACFrameDecoderDecorrelate(&frame->frame_decoder);
+        }
+        SyncSetEvent(frame->decoded_event, __FILE__, __LINE__);
+    }
+
+    return 0;
+}
+
+// Outputs silence through 'flac->frame_decoder' up to 'sample_number', in place of frames lost along with their headers
+// Returns number of samples output
+static uint64_t FLACOutputParallelSilence(flac_t* flac, uint64_t sample_number, flac_frame_callback_t frame_callback, void* callback_data)
+{
+    if ((sample_number <= flac->next_sample_number) ||
+        ((flac->streaminfo.sample_count != 0) && (sample_number > flac->streaminfo.sample_count)))
+    {
+        return 0;
+    }
+
+    uint64_t sample_count = sample_number - flac->next_sample_number;
+    flac->silence_sample_count = sample_count;
+    while (flac->silence_sample_count > 0)
+    {
+        FLACLoadSilence(flac);
+        frame_callback(&flac->frame_decoder, callback_data);
+    }
+    return sample_count;
+}
+
+// Waits for a frame to be decoded and outputs it, as silence if it is damaged
+// Returns number of samples output
+static uint64_t FLACOutputParallelFrame(flac_t* flac, flac_parallel_frame_t* frame, flac_frame_callback_t frame_callback, void* callback_data)
+{
+    SyncWaitOnEvent(frame->decoded_event, INFINITE, __FILE__, __LINE__);
+    flac_frame_header_t* frame_header = &frame->frame_decoder.frame_header;
+    if (frame->frame_error != FLAC_FRAME_ERROR_NO)
+    {
+        // A truncated last frame, or a damaged one that doesn't continue the stream (e.g. audio data that looked
+        // like a frame header) is dropped
+        if (((frame->frame_error == FLAC_FRAME_ERROR_TRUNCATED) && (frame->is_last == 1)) ||
+            (frame_header->sample_number < flac->next_sample_number))
+        {
+            return 0;
+        }
+        if (frame->frame_error == FLAC_FRAME_ERROR_CRC)
+        {
+            flac->crc16_error_count++;
+        }
+        else
+        {
+            flac->invalid_frame_count++;
+        }
+        for (uint32_t channel = 0; channel < flac->streaminfo.channel_count; channel++)
+        {
+            memset(frame->frame_decoder.subframes[channel].samples, 0, frame_header->block_size_inter_channel_sampels * sizeof(int32_t));
+        }
+        frame->frame_decoder.stereo = FLAC_STEREO_INDEPENDENT;
+    }
+
+    uint64_t sample_count = FLACOutputParallelSilence(flac, frame_header->sample_number, frame_callback, callback_data);
+    frame_callback(&frame->frame_decoder, callback_data);
+    flac->next_sample_number = frame_header->sample_number + frame_header->block_size_inter_channel_sampels;
+    return sample_count + frame_header->block_size_inter_channel_sampels;
+}
+
+uint64_t FLACDecodeParallel(flac_t* flac, uint32_t thread_count, flac_frame_callback_t frame_callback, void* callback_data)
+{
+    assert(flac != NULL);
+    assert(thread_count > 0);
+    assert(frame_callback != NULL);
+
+    // Enough frames in flight that the threads keep decoding while the oldest frame is output
+    flac_parallel_decoder_t decoder;
+    decoder.streaminfo = &flac->streaminfo;
+    decoder.crc_check_enabled = flac->crc_check_enabled;
+    decoder.frame_count = 4 * thread_count;
+    decoder.frames = (flac_parallel_frame_t*)malloc(decoder.frame_count * sizeof(flac_parallel_frame_t));
+    // A frame is at most 'frame_size_bound' bytes, but is copied with the bytes up to the next frame header when that can't
+    // be found. It also has at least FLAC_FRAME_HEADER_SIZE_MAX bytes for FLACLoadFrame().
+    uint64_t frame_bytes_capacity = flac->frame_size_bound + FLAC_FRAME_HEADER_SIZE_MAX;
+    for (uint32_t i = 0; i < decoder.frame_count; i++)
+    {
+        decoder.frames[i].bytes = (byte_t*)malloc(frame_bytes_capacity + FLAC_BIT_READER_PADDING);
+        decoder.frames[i].byte_count = 0;
+        FLACFrameDecoderInit(&decoder.frames[i].frame_decoder, &flac->streaminfo);
+        decoder.frames[i].frame_error = FLAC_FRAME_ERROR_NO;
+        decoder.frames[i].decoded_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    }
+    decoder.frames_ready_semaphore = CreateSemaphoreA(NULL, 0, decoder.frame_count + thread_count, NULL);
+    decoder.decode_sequence = 0;
+    decoder.stop = 0;
+    HANDLE* threads = (HANDLE*)malloc(thread_count * sizeof(HANDLE));
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        ThreadCreate(&FLACDecodeThreadProc, &decoder, L"FLACDecodeThread", &threads[i]);
+    }
+
+    // Split the stream into frames and hand them to the threads, while outputting decoded frames in order
+    uint64_t sample_count = 0;
+    uint32_t read_sequence = 0;
+    uint32_t output_sequence = 0;
+    FLACResetInput(flac, flac->audio_data_offset);
+    uint8_t found_frame = FLACFindFrame(flac);
+    while (found_frame == 1)
+    {
+        uint64_t available_size = FLACFillInputBuffer(flac);
+        byte_t* bytes = flac->input_buffer + flac->input_buffer_offset;
+        flac_frame_header_t frame_header;
+        FLACLoadFrameHeader(bytes, &flac->streaminfo, &frame_header);
+
+        // The frame ends where the next frame header starts. That header must continue the sample numbering, which makes
+        // it practically impossible for audio data that looks like a frame header, CRC-8 included, to cut the frame short.
+        uint64_t next_sample_number = frame_header.sample_number + frame_header.block_size_inter_channel_sampels;
+        uint64_t frame_size = 0;
+        found_frame = 0;
+        byte_t* search = bytes + ((flac->streaminfo.frame_size_min > 0) ? flac->streaminfo.frame_size_min : 1);
+        byte_t* search_end = bytes + available_size;
+        while ((search < search_end) &&
+               ((search = (byte_t*)memchr(search, 0xFF, search_end - search)) != NULL))
+        {
+            flac_frame_header_t next_frame_header;
+            if ((FLACCheckFrameHeader(search, search_end - search, &flac->streaminfo, 1) != 0) &&
+                (FLACLoadFrameHeader(search, &flac->streaminfo, &next_frame_header) > 0) &&
+                (next_frame_header.sample_number == next_sample_number))
+            {
+                frame_size = search - bytes;
+                found_frame = 1;
+                break;
+            }
+            search++;
+        }
+        if (found_frame == 0)
+        {
+            // Last frame, or a corrupt one that is decoded as far as it goes before finding the next frame
+            frame_size = (available_size < frame_bytes_capacity) ? available_size : frame_bytes_capacity;
+        }
+
+        // Reuse the oldest frame once all are in flight
+        if ((read_sequence - output_sequence) == decoder.frame_count)
+        {
+            sample_count += FLACOutputParallelFrame(flac, &decoder.frames[output_sequence % decoder.frame_count], frame_callback, callback_data);
+            output_sequence++;
+        }
+        flac_parallel_frame_t* frame = &decoder.frames[read_sequence % decoder.frame_count];
+        frame->byte_count = (frame_size < FLAC_FRAME_HEADER_SIZE_MAX) ? FLAC_FRAME_HEADER_SIZE_MAX : frame_size;
+        memcpy(frame->bytes, bytes, frame_size);
+        // As in the input buffer, 1-bits after the frame keep a truncated frame from being parsed into stale bytes
+        memset(frame->bytes + frame_size, 0xFF, frame->byte_count - frame_size + FLAC_BIT_READER_PADDING);
+        read_sequence++;
+        SyncReleaseSemaphore(decoder.frames_ready_semaphore, 1, __FILE__, __LINE__);
+
+        frame->is_last = 0;
+        if (found_frame == 1)
+        {
+            flac->input_buffer_offset += frame_size;
+        }
+        else
+        {
+            // The next frame header may be damaged, so search for any valid one after this frame's header
+            flac->input_buffer_offset += 1;
+            found_frame = FLACFindFrame(flac);
+            frame->is_last = (found_frame == 0);
+            if (found_frame == 1)
+            {
+                // The frame after this one was lost along with its header
+                flac->invalid_frame_count++;
+                flac->resync_count++;
+            }
+        }
+    }
+    while (output_sequence != read_sequence)
+    {
+        sample_count += FLACOutputParallelFrame(flac, &decoder.frames[output_sequence % decoder.frame_count], frame_callback, callback_data);
+        output_sequence++;
+    }
+    // Damaged last frames are still output as silence, if STREAMINFO has the length of the stream
+    if (flac->next_sample_number < flac->streaminfo.sample_count)
+    {
+        flac->invalid_frame_count++;
+        sample_count += FLACOutputParallelSilence(flac, flac->streaminfo.sample_count, frame_callback, callback_data);
+    }
+
+    // All frames have been claimed, so every thread wakes up to see 'stop'
+    decoder.stop = 1;
+    SyncReleaseSemaphore(decoder.frames_ready_semaphore, thread_count, __FILE__, __LINE__);
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    free(threads);
+    CloseHandle(decoder.frames_ready_semaphore);
+    for (uint32_t i = 0; i < decoder.frame_count; i++)
+    {
+        CloseHandle(decoder.frames[i].decoded_event);
+        FLACFrameDecoderFree(&decoder.frames[i].frame_decoder);
+        free(decoder.frames[i].bytes);
+    }
+    free(decoder.frames);
+
+    // Leave the stream ready to be played from the start
+    FLACResetInput(flac, flac->audio_data_offset);
+
+    return sample_count;
+}
+
+flac_md5_result_e FLACVerifyMD5(flac_t* flac)
+{
+    assert(flac != NULL);
+
+    FLACResetInput(flac, flac->audio_data_offset);
+    if (flac->md5_result == FLAC_MD5_RESULT_NO_SIGNATURE)
+    {
+        return FLAC_MD5_RESULT_NO_SIGNATURE;
+    }
+
+    uint8_t md5_verify_enabled = flac->md5_verify_enabled;
+    flac->md5_verify_enabled = 1;
+    while (FLACLoadNextFrame(flac) == 1)
+    {
+        // Each frame is hashed as it is decoded
+    }
+    flac_md5_result_e md5_result = flac->md5_result;
+    flac->md5_verify_enabled = md5_verify_enabled;
+
+    // Leave the stream ready to be played from the start
+    FLACResetInput(flac, flac->audio_data_offset);
+
+    return md5_result;
+}
+
+void FLACFree(flac_t* flac)
+{
+    assert(flac != NULL);
+
+    // The file is owned by the song
+    ReadAheadClose(&flac->read_ahead);
+    FLACFrameDecoderFree(&flac->frame_decoder);
+    free(flac->input_buffer);
+    free(flac->seek_points);
+    FLACIndexFree(&flac->index);
+    free(flac->md5_buffer);
+    free(flac);
+}
+
+void FLACStreamInit(flac_stream_t* stream, flac_frame_callback_t frame_callback, void* callback_data)
+{
+    assert(stream != NULL);
+    assert(frame_callback != NULL);
+
+    stream->state = FLAC_STREAM_STATE_SIGNATURE;
+    stream->frame_callback = frame_callback;
+    stream->callback_data = callback_data;
+    stream->crc_check_enabled = 1;
+    stream->metadata_byte_count = 0;
+    stream->metadata_block_count = 0;
+    stream->metadata_block_remaining_size = 0;
+    stream->input_buffer = NULL;
+    stream->input_buffer_capacity = 0;
+    stream->input_buffer_size = 0;
+    stream->input_buffer_offset = 0;
+    stream->search_offset = 0;
+    stream->frame_found = 0;
+    stream->resyncing = 0;
+    stream->frame_decoder.samples = NULL;
+    stream->frame_decoder.residuals = NULL;
+    stream->next_sample_number = 0;
+    stream->crc16_error_count = 0;
+    stream->invalid_frame_count = 0;
+    stream->resync_count = 0;
+    FLACCRCInit();
+}
+
+// Collects pushed bytes in 'stream->metadata_bytes' until it holds 'size' bytes
+// Returns number of bytes used
+static uint64_t FLACStreamCollectMetadata(flac_stream_t* stream, const byte_t* bytes, uint64_t byte_count, uint32_t size)
+{
+    assert(size <= sizeof(stream->metadata_bytes));
+
+    uint64_t copy_size = size - stream->metadata_byte_count;
+    if (copy_size > byte_count)
+    {
+        copy_size = byte_count;
+    }
+    memcpy(stream->metadata_bytes + stream->metadata_byte_count, bytes, copy_size);
+    stream->metadata_byte_count += (uint32_t)copy_size;
+    return copy_size;
+}
+
+// Moves on to the next METADATA_BLOCK, or to the frames after the last one
+static void FLACStreamEndMetadataBlock(flac_stream_t* stream)
+{
+    stream->metadata_byte_count = 0;
+    if (stream->metadata_block_header.is_last == 0)
+    {
+        stream->state = FLAC_STREAM_STATE_METADATA_BLOCK_HEADER;
+        return;
+    }
+
+    // Room for the largest frame and the header after it, which is all that is ever kept, and for a truncated last frame
+    // to be padded up to FLAC_FRAME_HEADER_SIZE_MAX bytes and FLAC_BIT_READER_PADDING bytes of 1-bits
+    stream->input_buffer_capacity = FLACFrameSizeBound(&stream->streaminfo) + FLAC_FRAME_HEADER_SIZE_MAX;
+    stream->input_buffer = (byte_t*)malloc(stream->input_buffer_capacity + FLAC_FRAME_HEADER_SIZE_MAX + FLAC_BIT_READER_PADDING);
+    FLACFrameDecoderInit(&stream->frame_decoder, &stream->streaminfo);
+    stream->state = FLAC_STREAM_STATE_FRAMES;
+}
+
+// Parses the "fLaC" marker and METADATA_BLOCKs from the pushed bytes, as far as they go
+// Returns number of bytes used
+static uint64_t FLACStreamLoadMetadata(flac_stream_t* stream, const byte_t* bytes, uint64_t byte_count)
+{
+    uint64_t offset = 0;
+    while ((offset < byte_count) && (stream->state < FLAC_STREAM_STATE_FRAMES))
+    {
+        switch (stream->state)
+        {
+            case FLAC_STREAM_STATE_SIGNATURE:
+            {
+                offset += FLACStreamCollectMetadata(stream, bytes + offset, byte_count - offset, 4);
+                if (stream->metadata_byte_count == 4)
+                {
+                    stream->metadata_byte_count = 0;
+                    stream->state = (memcmp(stream->metadata_bytes, "fLaC", 4) == 0) ? FLAC_STREAM_STATE_METADATA_BLOCK_HEADER : FLAC_STREAM_STATE_ERROR;
+                }
+            } break;
+
+            case FLAC_STREAM_STATE_METADATA_BLOCK_HEADER:
+            {
+                offset += FLACStreamCollectMetadata(stream, bytes + offset, byte_count - offset, 4);
+                if (stream->metadata_byte_count < 4)
+                {
+                    break;
+                }
+                stream->metadata_byte_count = 0;
+                FLACPLoadMetadataBlockHeader(stream->metadata_bytes, &stream->metadata_block_header);
+
+                // The first block must be STREAMINFO, and only the first
+                uint8_t is_streaminfo = (stream->metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_STREAMINFO);
+                if ((stream->metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_INVALID) ||
+                    (is_streaminfo != (stream->metadata_block_count == 0)) ||
+                    ((is_streaminfo == 1) && (stream->metadata_block_header.size != 34)))
+                {
+                    stream->state = FLAC_STREAM_STATE_ERROR;
+                    break;
+                }
+                stream->metadata_block_count++;
+                stream->metadata_block_remaining_size = stream->metadata_block_header.size;
+                stream->state = FLAC_STREAM_STATE_METADATA_BLOCK;
+                if (stream->metadata_block_remaining_size == 0)
+                {
+                    FLACStreamEndMetadataBlock(stream);
+                }
+            } break;
+
+            case FLAC_STREAM_STATE_METADATA_BLOCK:
+            {
+                if (stream->metadata_block_header.type == FLAC_METADATA_BLOCK_TYPE_STREAMINFO)
+                {
+                    offset += FLACStreamCollectMetadata(stream, bytes + offset, byte_count - offset, 34);
+                    stream->metadata_block_remaining_size = 34 - stream->metadata_byte_count;
+                    if (stream->metadata_block_remaining_size == 0)
+                    {
+                        FLACLoadMetadataBlockStreaminfo(stream->metadata_bytes, &stream->streaminfo);
+                        if (FLACStreaminfoIsSupported(&stream->streaminfo) == 0)
+                        {
+                            stream->state = FLAC_STREAM_STATE_ERROR;
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    // Other blocks are skipped over without collecting them, as they can be large (e.g. PICTURE)
+                    uint64_t skip_size = stream->metadata_block_remaining_size;
+                    if (skip_size > (byte_count - offset))
+                    {
+                        skip_size = byte_count - offset;
+                    }
+                    offset += skip_size;
+                    stream->metadata_block_remaining_size -= (uint32_t)skip_size;
+                }
+                if (stream->metadata_block_remaining_size == 0)
+                {
+                    FLACStreamEndMetadataBlock(stream);
+                }
+            } break;
+
+            default: {} break;
+        }
+    }
+
+    return offset;
+}
+
+// Outputs silence through 'stream->frame_decoder' up to 'sample_number', in place of frames lost along with their headers
+static void FLACStreamOutputSilence(flac_stream_t* stream, uint64_t sample_number)
+{
+    if ((sample_number <= stream->next_sample_number) ||
+        ((stream->streaminfo.sample_count != 0) && (sample_number > stream->streaminfo.sample_count)))
+    {
+        return;
+    }
+
+    flac_frame_header_t* frame_header = &stream->frame_decoder.frame_header;
+    while (stream->next_sample_number < sample_number)
+    {
+        uint32_t sample_count = stream->streaminfo.block_size_max;
+        if ((sample_number - stream->next_sample_number) < sample_count)
+        {
+            sample_count = (uint32_t)(sample_number - stream->next_sample_number);
+        }
+        for (uint32_t channel = 0; channel < stream->streaminfo.channel_count; channel++)
+        {
+            memset(stream->frame_decoder.subframes[channel].samples, 0, sample_count * sizeof(int32_t));
+        }
+        stream->frame_decoder.stereo = FLAC_STEREO_INDEPENDENT;
+        frame_header->sample_number = stream->next_sample_number;
+        frame_header->block_size_inter_channel_sampels = sample_count;
+        stream->frame_callback(&stream->frame_decoder, stream->callback_data);
+        stream->next_sample_number += sample_count;
+    }
+}
+
+// Decodes and outputs every frame in the input buffer whose end is known. After FLACStreamFinish() that includes the last
+// frame, which ends with the stream.
+static void FLACStreamDecodeFrames(flac_stream_t* stream)
+{
+    uint8_t is_finished = (stream->state == FLAC_STREAM_STATE_FINISHED);
+    while (1)
+    {
+        byte_t* bytes = stream->input_buffer + stream->input_buffer_offset;
+        uint64_t available_size = stream->input_buffer_size - stream->input_buffer_offset;
+        // Until the stream is finished, a header is only checked once it can be checked whole
+        uint64_t search_end = available_size;
+        if (is_finished == 0)
+        {
+            search_end = (available_size >= FLAC_FRAME_HEADER_SIZE_MAX) ? (available_size - FLAC_FRAME_HEADER_SIZE_MAX + 1) : 0;
+        }
+
+        // Skip ahead to the next valid FRAME_HEADER
+        if (stream->frame_found == 0)
+        {
+            uint64_t i = stream->search_offset;
+            while ((i < search_end) &&
+                   ((bytes[i] != 0xFF) || (FLACCheckFrameHeader(bytes + i, available_size - i, &stream->streaminfo, 1) == 0)))
+            {
+                i++;
+            }
+            stream->input_buffer_offset += i;
+            stream->search_offset = 0;
+            if (i == search_end)
+            {
+                return;
+            }
+            stream->frame_found = 1;
+            if (stream->resyncing == 1)
+            {
+                // The frame after the last one output was lost along with its header
+                stream->invalid_frame_count++;
+                stream->resync_count++;
+                stream->resyncing = 0;
+            }
+            continue;
+        }
+
+        // The frame ends where the next frame header starts. That header must continue the sample numbering, which makes
+        // it practically impossible for audio data that looks like a frame header, CRC-8 included, to cut the frame short.
+        flac_frame_header_t frame_header;
+        FLACLoadFrameHeader(bytes, &stream->streaminfo, &frame_header);
+        uint64_t next_sample_number = frame_header.sample_number + frame_header.block_size_inter_channel_sampels;
+        if (stream->search_offset == 0)
+        {
+            stream->search_offset = (stream->streaminfo.frame_size_min > 0) ? stream->streaminfo.frame_size_min : 1;
+        }
+        uint8_t found_next_frame = 0;
+        while (stream->search_offset < search_end)
+        {
+            byte_t* search = (byte_t*)memchr(bytes + stream->search_offset, 0xFF, search_end - stream->search_offset);
+            if (search == NULL)
+            {
+                stream->search_offset = search_end;
+                break;
+            }
+            stream->search_offset = search - bytes;
+            flac_frame_header_t next_frame_header;
+            if ((FLACCheckFrameHeader(search, available_size - stream->search_offset, &stream->streaminfo, 1) != 0) &&
+                (FLACLoadFrameHeader(search, &stream->streaminfo, &next_frame_header) > 0) &&
+                (next_frame_header.sample_number == next_sample_number))
+            {
+                found_next_frame = 1;
+                break;
+            }
+            stream->search_offset++;
+        }
+        uint64_t frame_size = stream->search_offset;
+        if (found_next_frame == 0)
+        {
+            // Without the next frame header, the frame is known to have ended once the largest frame possible has been
+            // pushed (the next header may be damaged), or once the stream has
+            uint64_t frame_bytes_capacity = stream->input_buffer_capacity;
+            if ((is_finished == 0) && (available_size < frame_bytes_capacity))
+            {
+                return;
+            }
+            frame_size = (available_size < frame_bytes_capacity) ? available_size : frame_bytes_capacity;
+        }
+
+        // Frames lost before this one are output first, as the silence is output through the frame decoder too
+        FLACStreamOutputSilence(stream, frame_header.sample_number);
+
+        // As in FLACFillInputBuffer(), 1-bits after the pushed bytes keep a truncated frame from being parsed into stale bytes
+        uint64_t byte_count = (frame_size < FLAC_FRAME_HEADER_SIZE_MAX) ? FLAC_FRAME_HEADER_SIZE_MAX : frame_size;
+        memset(stream->input_buffer + stream->input_buffer_size, 0xFF, FLAC_FRAME_HEADER_SIZE_MAX + FLAC_BIT_READER_PADDING);
+        uint64_t decoded_frame_size = 0;
+        flac_frame_error_e frame_error = FLACLoadFrame(bytes, byte_count, &stream->streaminfo, stream->crc_check_enabled, &stream->frame_decoder, &decoded_frame_size);
+
+        // A truncated last frame, or a damaged one that doesn't continue the stream (e.g. audio data that looked like a
+        // frame header) is dropped. Any other damaged frame is output as silence.
+        uint8_t is_last = (found_next_frame == 0) && (is_finished == 1);
+        if ((frame_error == FLAC_FRAME_ERROR_NO) ||
+            (((frame_error != FLAC_FRAME_ERROR_TRUNCATED) || (is_last == 0)) && (frame_header.sample_number >= stream->next_sample_number)))
+        {
+            if (frame_error == FLAC_FRAME_ERROR_NO)
+            {
+                FLACFrameDecoderDecorrelate(&stream->frame_decoder);
+            }
+            else
+            {
+                if (frame_error == FLAC_FRAME_ERROR_CRC)
+                {
+                    stream->crc16_error_count++;
+                }
+                else
+                {
+                    stream->invalid_frame_count++;
+                }
+                for (uint32_t channel = 0; channel < stream->streaminfo.channel_count; channel++)
+                {
+                    memset(stream->frame_decoder.subframes[channel].samples, 0, frame_header.block_size_inter_channel_sampels * sizeof(int32_t));
+                }
+                stream->frame_decoder.stereo = FLAC_STEREO_INDEPENDENT;
+            }
+            stream->frame_callback(&stream->frame_decoder, stream->callback_data);
+            stream->next_sample_number = frame_header.sample_number + frame_header.block_size_inter_channel_sampels;
+        }
+
+        if (found_next_frame == 1)
+        {
+            stream->input_buffer_offset += frame_size;
+            stream->search_offset = 0;
+        }
+        else
+        {
+            // The next frame header may be damaged, so search for any valid one after this frame's header
+            stream->input_buffer_offset += 1;
+            stream->search_offset = 0;
+            stream->frame_found = 0;
+            stream->resyncing = 1;
+        }
+    }
+}
+
+flac_stream_state_e FLACStreamPush(flac_stream_t* stream, const byte_t* bytes, uint64_t byte_count)
+{
+    assert(stream != NULL);
+    assert((bytes != NULL) || (byte_count == 0));
+    assert(stream->state != FLAC_STREAM_STATE_FINISHED);
+
+    uint64_t offset = FLACStreamLoadMetadata(stream, bytes, byte_count);
+    while ((offset < byte_count) && (stream->state == FLAC_STREAM_STATE_FRAMES))
+    {
+        // Only move the undecoded bytes to the front once there's no room after them, so small pushes don't move them each time
+        if ((stream->input_buffer_size == stream->input_buffer_capacity) && (stream->input_buffer_offset > 0))
+        {
+            uint64_t undecoded_size = stream->input_buffer_size - stream->input_buffer_offset;
+            memmove(stream->input_buffer, stream->input_buffer + stream->input_buffer_offset, undecoded_size);
+            stream->input_buffer_size = undecoded_size;
+            stream->input_buffer_offset = 0;
+        }
+
+        uint64_t copy_size = stream->input_buffer_capacity - stream->input_buffer_size;
+        if (copy_size > (byte_count - offset))
+        {
+            copy_size = byte_count - offset;
+        }
+        memcpy(stream->input_buffer + stream->input_buffer_size, bytes + offset, copy_size);
+        stream->input_buffer_size += copy_size;
+        offset += copy_size;
+        FLACStreamDecodeFrames(stream);
+    }
+
+    return stream->state;
+}
+
+flac_stream_state_e FLACStreamFinish(flac_stream_t* stream)
+{
+    assert(stream != NULL);
+
+    if (stream->state == FLAC_STREAM_STATE_FRAMES)
+    {
+        stream->state = FLAC_STREAM_STATE_FINISHED;
+        FLACStreamDecodeFrames(stream);
+        // Damaged last frames are still output as silence, if STREAMINFO has the length of the stream
+        if (stream->next_sample_number < stream->streaminfo.sample_count)
+        {
+            stream->invalid_frame_count++;
+            FLACStreamOutputSilence(stream, stream->streaminfo.sample_count);
+        }
+    }
+    else if (stream->state != FLAC_STREAM_STATE_FINISHED)
+    {
+        // The stream ended before its first frame
+        stream->state = FLAC_STREAM_STATE_ERROR;
+    }
+
+    return stream->state;
+}
+
+void FLACStreamFree(flac_stream_t* stream)
+{
+    assert(stream != NULL);
+
+    if (stream->input_buffer != NULL)
+    {
+        FLACFrameDecoderFree(&stream->frame_decoder);
+    }
+    free(stream->input_buffer);
+    stream->input_buffer = NULL;
+}
+
+// The benchmark decodes the residuals of this many blocks of mono samples, each with 2^order Rice partitions
+#define FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT 128
+#define FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE 4096
+#define FLAC_BIT_READER_BENCHMARK_PARTITION_ORDER 4
+#define FLAC_BIT_READER_BENCHMARK_ITERATION_COUNT 8
+
+// The bit readers before FLACBitReader*(), kept as the reference FLACBitReaderBenchmark() times the current one against.
+// They read one bit of a unary code at a time, and assemble other values out of whole and partial bytes
+static uint64_t FLACUnpackBitsReference(byte_t* bytes, uint32_t bit_count, uint8_t bit_current, uint8_t* bit_end, uint32_t* value)
+{
+    assert(bit_count <= (sizeof(uint32_t) * 8));
+
+    byte_t* bytes_start = bytes;
+    uint32_t tmp_value = 0;
+
+    // The starting bit is within a byte
+    if (bit_current > 0)
+    {
+        uint32_t remaining_bits_in_byte = (8 - bit_current);
+        uint32_t bits_to_read = (bit_count < remaining_bits_in_byte) ? bit_count : remaining_bits_in_byte;
+
+        // Mask out bits before the current bit, and bits at the end of the byte that aren't to be read
+        uint32_t mask = 0xFF >> bit_current;
+        for (uint32_t i = bit_current + bits_to_read; i < 8; i++)
+        {
+            mask &= 0xFF << (8 - i);
+        }
+        uint32_t bits = (uint32_t)(*bytes & mask);
+        bits = bits >> (remaining_bits_in_byte - bits_to_read);
+        tmp_value |= bits;
+        bit_count -= bits_to_read;
+
+        if (bits_to_read == remaining_bits_in_byte)
+        {
+            bytes += 1;
+            bit_current = 0;
+        }
+        else
+        {
+            bit_current += bits_to_read;
+        }
+    }
+
+    // Whole bytes
+    if (bit_count >= 8)
+    {
+        uint32_t bytes_to_read = bit_count / 8;
+        uint32_t bits_to_read = (bytes_to_read * 8);
+        tmp_value = (bits_to_read < 32) ? (tmp_value << bits_to_read) : 0;
+        tmp_value |= unpack_uint32_big_endian(bytes, (uint8_t)bytes_to_read);
+        bit_count -= bits_to_read;
+        bytes += bytes_to_read;
+    }
+
+    // Some remaining bits to read in next byte
+    if (bit_count > 0)
+    {
+        bit_current = (uint8_t)bit_count;
+        tmp_value = tmp_value << bit_count;
+        uint32_t mask = 0xFF << (8 - bit_count);
+        uint32_t bits = (uint32_t)(*bytes & mask);
+        bits = bits >> (8 - bit_count);
+        tmp_value |= bits;
+    }
+
+    *bit_end = bit_current;
+    *value = tmp_value;
+    return (bytes - bytes_start);
+}
+
+static uint64_t FLACUnpackRiceReference(byte_t* bytes, uint8_t bit_current, uint8_t* bit_end, uint32_t k, int32_t* rice_value)
+{
+    byte_t* bytes_start = bytes;
+
+    // Read unary value
+    uint32_t q = 0;
+    while (1)
+    {
+        uint8_t mask = 0x1 << (7 - bit_current);
+        uint8_t bit = (*bytes & mask);
+        bit_current += 1;
+        if (bit_current == 8)
+        {
+            bit_current = 0;
+            bytes += 1;
+        }
+        if (bit != 0)
+        {
+            break;
+        }
+        q += 1;
+    }
+
+    // Read k bits as r
+    uint32_t r = 0;
+    if (k != 0)
+    {
+        bytes += FLACUnpackBitsReference(bytes, k, bit_current, &bit_current, &r);
+    }
+
+    // Construct RICE value using k, q and r = (Q * 2^K) + R
+    uint32_t val = (q << k) | r;
+    if (val & 1)
+    {
+        *rice_value = -((int32_t)(val >> 1)) - 1;
+    }
+    else
+    {
+        *rice_value = (int32_t)(val >> 1);
+    }
+
+    *bit_end = bit_current;
+    return (bytes - bytes_start);
+}
+
+// FLACLoadResidual() as it was with the reference bit readers, which has no escaped partitions
+// Returns 0 if the coding method is reserved, or a partition is escaped
+static uint8_t FLACLoadResidualReference(byte_t** bytes, uint8_t* bit_current, uint32_t order, uint32_t frame_block_size, int32_t* residuals)
+{
+    uint32_t residual_type = 0;
+    *bytes += FLACUnpackBitsReference(*bytes, 2, *bit_current, bit_current, &residual_type);
+    uint32_t rice_parameter_bits = 0;
+    switch ((flac_residule_type_e)residual_type)
+    {
+        case FLAC_RESIDUAL_TYPE_RICE:
+        {
+            rice_parameter_bits = 4;
+        } break;
+
+        case FLAC_RESIDUAL_TYPE_RICE2:
+        {
+            rice_parameter_bits = 5;
+        } break;
+
+        default:
+        {
+            return 0;
+        } break;
+    }
+    uint32_t residual_partition_order = 0;
+    *bytes += FLACUnpackBitsReference(*bytes, 4, *bit_current, bit_current, &residual_partition_order);
+    uint32_t partition_count = 0x1 << residual_partition_order;
+    uint32_t residual_counter = 0;
+
+    for (uint32_t i = 0; i < partition_count; i++)
+    {
+        uint32_t rice_parameter = 0;
+        *bytes += FLACUnpackBitsReference(*bytes, rice_parameter_bits, *bit_current, bit_current, &rice_parameter);
+        if (rice_parameter == ((0x1U << rice_parameter_bits) - 1))
+        {
+            return 0;
+        }
+
+        uint32_t samples_in_partition_count = 0;
+        if (residual_partition_order == 0)
+        {
+            samples_in_partition_count = frame_block_size - order;
+        }
+        else if (i > 0)
+        {
+            samples_in_partition_count = (frame_block_size / (0x1 << residual_partition_order));
+        }
+        else
+        {
+            samples_in_partition_count = (frame_block_size / (0x1 << residual_partition_order)) - order;
+        }
+
+        for (uint32_t j = 0; j < samples_in_partition_count; j++)
+        {
+            *bytes += FLACUnpackRiceReference(*bytes, *bit_current, bit_current, rice_parameter, &residuals[residual_counter]);
+            residual_counter += 1;
+        }
+    }
+
+    return 1;
+}
+
+// Writes the low 'bit_count' bits of 'value' MSB-first at 'bit_offset' into zeroed 'bytes'
+static void FLACBitReaderBenchmarkWrite(byte_t* bytes, uint64_t* bit_offset, uint32_t value, uint32_t bit_count)
+{
+    for (uint32_t i = bit_count; i > 0; i--)
+    {
+        if ((value >> (i - 1)) & 0x1)
+        {
+            bytes[*bit_offset >> 3] |= (byte_t)(0x80 >> (*bit_offset & 0b111));
+        }
+        *bit_offset += 1;
+    }
+}
+
+uint32_t FLACBitReaderBenchmark(void)
+{
+    typedef struct
+    {
+        const char*          name;
+        uint32_t             bytes_per_sample; // Of the decoded samples the throughput is counted in
+        flac_residule_type_e residual_type;
+        uint32_t             rice_parameter; // Typical for the stream, each partition is within 1 of it
+    } flac_bit_reader_benchmark_stream_t;
+    const flac_bit_reader_benchmark_stream_t streams[] =
+    {
+        { "16-bit/44.1 kHz", 2, FLAC_RESIDUAL_TYPE_RICE,  5 },
+        { "24-bit/96 kHz",   3, FLAC_RESIDUAL_TYPE_RICE2, 9 },
+    };
+    const uint32_t residual_count = FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT * FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE;
+    const uint32_t partition_count = 0x1 << FLAC_BIT_READER_BENCHMARK_PARTITION_ORDER;
+    const uint32_t partition_size = FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE / partition_count;
+    // At most 2 + 4 bits of header and 5 bits of parameter per partition, and a residual is less than 32 bits
+    const uint64_t stream_size_max = ((uint64_t)residual_count * 4) + (FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT * (1 + (partition_count * 5 / 8 + 1)));
+
+    byte_t* stream_bytes = (byte_t*)malloc(stream_size_max + FLAC_BIT_READER_PADDING);
+    int32_t* written_residuals = (int32_t*)malloc(residual_count * sizeof(int32_t));
+    int32_t* reference_residuals = (int32_t*)malloc(residual_count * sizeof(int32_t));
+    int32_t* reader_residuals = (int32_t*)malloc(residual_count * sizeof(int32_t));
+    assert((stream_bytes != NULL) && (written_residuals != NULL) && (reference_residuals != NULL) && (reader_residuals != NULL));
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    uint32_t mismatch_count = 0;
+
+    printf("Stream:          %u blocks of %u residuals, %u partitions each\n", FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT, FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE, partition_count);
+    for (uint32_t s = 0; s < sizeof(streams) / sizeof(streams[0]); s++)
+    {
+        // Residuals of a predictor that fits well: Rice codes with short unary quotients, as an encoder picks the
+        // parameter that makes them so
+        memset(stream_bytes, 0, stream_size_max + FLAC_BIT_READER_PADDING);
+        uint64_t bit_offset = 0;
+        uint32_t random = 0x9E3779B9u;
+        uint32_t rice_parameter_bits = (streams[s].residual_type == FLAC_RESIDUAL_TYPE_RICE) ? 4 : 5;
+        for (uint32_t block = 0; block < FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT; block++)
+        {
+            FLACBitReaderBenchmarkWrite(stream_bytes, &bit_offset, (uint32_t)streams[s].residual_type, 2);
+            FLACBitReaderBenchmarkWrite(stream_bytes, &bit_offset, FLAC_BIT_READER_BENCHMARK_PARTITION_ORDER, 4);
+            for (uint32_t partition = 0; partition < partition_count; partition++)
+            {
+                random ^= random << 13;
+                random ^= random >> 17;
+                random ^= random << 5;
+                uint32_t k = streams[s].rice_parameter + (random % 3) - 1;
+                FLACBitReaderBenchmarkWrite(stream_bytes, &bit_offset, k, rice_parameter_bits);
+                for (uint32_t i = 0; i < partition_size; i++)
+                {
+                    random ^= random << 13;
+                    random ^= random >> 17;
+                    random ^= random << 5;
+                    // Quotient q has a probability of 2^-(q + 1)
+                    uint32_t q = 0;
+                    while ((q < 15) && (((random >> q) & 0x1) == 0))
+                    {
+                        q += 1;
+                    }
+                    uint32_t r = (random >> 16) & ((0x1U << k) - 1);
+                    uint32_t value = (q << k) | r;
+                    written_residuals[(block * FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE) + (partition * partition_size) + i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+                    bit_offset += q;
+                    FLACBitReaderBenchmarkWrite(stream_bytes, &bit_offset, 1, 1);
+                    FLACBitReaderBenchmarkWrite(stream_bytes, &bit_offset, r, k);
+                }
+            }
+        }
+        uint64_t stream_size = (bit_offset + 7) / 8;
+        assert(stream_size <= stream_size_max);
+
+        uint8_t reference_valid = 1;
+        QueryPerformanceCounter(&timer_start);
+        for (uint32_t i = 0; i < FLAC_BIT_READER_BENCHMARK_ITERATION_COUNT; i++)
+        {
+            byte_t* bytes = stream_bytes;
+            uint8_t bit_current = 0;
+            for (uint32_t block = 0; block < FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT; block++)
+            {
+                reference_valid &= FLACLoadResidualReference(&bytes, &bit_current, 0, FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE, reference_residuals + (block * FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE));
+            }
+        }
+        QueryPerformanceCounter(&timer_end);
+        double reference_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart / FLAC_BIT_READER_BENCHMARK_ITERATION_COUNT;
+
+        uint8_t reader_valid = 1;
+        QueryPerformanceCounter(&timer_start);
+        for (uint32_t i = 0; i < FLAC_BIT_READER_BENCHMARK_ITERATION_COUNT; i++)
+        {
+            flac_bit_reader_t reader;
+            FLACBitReaderInit(&reader, stream_bytes, stream_size);
+            for (uint32_t block = 0; block < FLAC_BIT_READER_BENCHMARK_BLOCK_COUNT; block++)
+            {
+                reader_valid &= FLACLoadResidual(&reader, 0, FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE, reader_residuals + (block * FLAC_BIT_READER_BENCHMARK_BLOCK_SIZE));
+            }
+            reader_valid &= !FLACBitReaderHasOverrun(&reader);
+        }
+        QueryPerformanceCounter(&timer_end);
+        double reader_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart / FLAC_BIT_READER_BENCHMARK_ITERATION_COUNT;
+
+        uint8_t match = reference_valid && reader_valid &&
+                        (memcmp(reference_residuals, written_residuals, residual_count * sizeof(int32_t)) == 0) &&
+                        (memcmp(reader_residuals, written_residuals, residual_count * sizeof(int32_t)) == 0);
+        if (!match)
+        {
+            mismatch_count += 1;
+        }
+
+        // Throughput in bytes of the decoded samples the residuals become
+        double decoded_mb = (double)residual_count * streams[s].bytes_per_sample / (1024.0 * 1024.0);
+        printf("%-16s %.2f bits/residual, reference %.1f MB/s, bit reader %.1f MB/s", streams[s].name, (double)bit_offset / residual_count, decoded_mb / reference_seconds, decoded_mb / reader_seconds);
+        if (reader_seconds > 0.0)
+        {
+            printf(", speedup %.1fx", reference_seconds / reader_seconds);
+        }
+        printf(", %s\n", match ? "residuals match" : "RESIDUALS DIFFER");
+    }
+
+    free(stream_bytes);
+    free(written_residuals);
+    free(reference_residuals);
+    free(reader_residuals);
+    return mismatch_count;
+}
@@ -19,6 +19,10 @@
 #ifndef FLAC_H
 #define FLAC_H
 
+#include "flac_index.h"
+#include "flac_output.h"
+#include "md5.h"
+#include "read_ahead.h"
 #include "wav.h"
 
 /**
@@ -42,6 +46,341 @@
  *  - SUBFRAME_CONSTANT or SUBFRAME_FIXED or SUBFRAME_LPC or SUBFRAME_VERBATIM
  * 
 */
-//song_error_e FLACLoad(song_t* song);
+
+#define FLAC_MAX_CHANNEL_COUNT 8
+#define FLAC_MAX_LPC_ORDER 32
+// Frame header: 14 sync + 18 fixed bits + up to 7 bytes UTF-8 number + 2 bytes block size + 2 bytes sample rate + 1 byte CRC-8
+#define FLAC_FRAME_HEADER_SIZE_MAX 16
+// Frame footer: CRC-16
+#define FLAC_FRAME_FOOTER_SIZE 2
+
+// All numbers used in a FLAC bitstream are integers; there are no floating-point representations.
+// All numbers are big-endian coded. All numbers are unsigned unless otherwise specified.
+// https://github.com/ietf-wg-cellar/flac-specification
+// https://xiph.org/flac/format.html
+// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/include/FLAC/format.h
+// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/src/libFLAC/metadata_iterators.c
+// https://github.com/xiph/flac/blob/27c615706cedd252a206dd77e3910dfa395dcc49/src/libFLAC/bitreader.c
+typedef enum
+{
+    FLAC_METADATA_BLOCK_TYPE_STREAMINFO     = 0,
+    FLAC_METADATA_BLOCK_TYPE_PADDING        = 1,
+    FLAC_METADATA_BLOCK_TYPE_APPLICATION    = 2,
+    FLAC_METADATA_BLOCK_TYPE_SEEKTABLE      = 3,
+    FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT = 4,
+    FLAC_METADATA_BLOCK_TYPE_CUESHEET       = 5,
+    FLAC_METADATA_BLOCK_TYPE_PICTURE        = 6,
+    FLAC_METADATA_BLOCK_TYPE_INVALID        = 127 // To avoid confusion with a frame sync code
+} flac_metadata_block_type_e;
+
+typedef enum
+{
+    FLAC_SUBFRAME_TYPE_CONSTANT = 0,
+    FLAC_SUBFRAME_TYPE_VERBATIM = 1,
+    FLAC_SUBFRAME_TYPE_FIXED    = 2,
+    FLAC_SUBFRAME_TYPE_LPC      = 3
+} flac_subframe_type_e;
+
+typedef enum
+{
+    FLAC_RESIDUAL_TYPE_RICE  = 0,
+    FLAC_RESIDUAL_TYPE_RICE2 = 1
+} flac_residule_type_e;
+
+typedef enum
+{
+    FLAC_FRAME_ERROR_NO        = 0,
+    FLAC_FRAME_ERROR_TRUNCATED = 1, // Continues past the end of the bytes it was decoded from
+    FLAC_FRAME_ERROR_INVALID   = 2, // Has reserved or out of range values
+    FLAC_FRAME_ERROR_CRC       = 3  // Doesn't match the CRC-16 in its FRAME_FOOTER
+} flac_frame_error_e;
+
+typedef enum
+{
+    FLAC_MD5_RESULT_PENDING      = 0, // The stream hasn't been decoded to the end yet
+    FLAC_MD5_RESULT_MATCH        = 1,
+    FLAC_MD5_RESULT_MISMATCH     = 2,
+    FLAC_MD5_RESULT_NO_SIGNATURE = 3, // STREAMINFO has no MD5 signature to compare against
+    FLAC_MD5_RESULT_INCOMPLETE   = 4  // The stream wasn't decoded from its first sample, e.g. after a seek
+} flac_md5_result_e;
+
+typedef enum
+{
+    FLAC_STREAM_STATE_SIGNATURE             = 0, // Waiting for the "fLaC" marker
+    FLAC_STREAM_STATE_METADATA_BLOCK_HEADER = 1,
+    FLAC_STREAM_STATE_METADATA_BLOCK        = 2, // Collecting STREAMINFO, or skipping over any other block
+    FLAC_STREAM_STATE_FRAMES                = 3,
+    FLAC_STREAM_STATE_FINISHED              = 4, // FLACStreamFinish() has output the last frame
+    FLAC_STREAM_STATE_ERROR                 = 5  // Not a FLAC stream, or one that isn't supported
+} flac_stream_state_e;
+
+typedef enum
+{
+    // 1 channel: mono
+    FLAC_CHANNEL_ASSIGNMENT_MONO = 1,
+    // 2 channels: left, right
+    FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT = 2,
+    // 3 channels: left, right, center
+    FLAC_CHANNEL_ASSIGNMENT_LEFT_RIGHT_CENTER = 3,
+    // 4 channels: front-left, front-right, back-left, back-right
+    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_BLEFT_BRIGHT = 4,
+    // 5 channels: front-left, front-right, front-center, back-left, back-right
+    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_BLEFT_BRIGHT = 5,
+    // 6 channels: front-left, front-right, front-center, low frequency effects, back-left, back-right
+    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BLEFT_BRIGHT = 6,
+    // 7 channels: front-left, front-right, front-center, low frequency effects, back-center, side-left, side-right
+    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BCENTER_SLEFT_SRIGHT = 7,
+    // 8 channels: front-left, front-right, front-center, low frequency effects, back-left, back-right, side-left, side-right
+    FLAC_CHANNEL_ASSIGNMENT_FLEFT_FRIGHT_FCENTER_LFE_BLEFT_BRIGHT_SLEFT_SRIGHT = 8,
+    // 2 channels: left, side difference
+    FLAC_CHANNEL_ASSIGNMENT_LEFT_DIFF = 9,
+    // 2 channels: side difference, right
+    FLAC_CHANNEL_ASSIGNMENT_DIFF_RIGHT = 10,
+    // 2 channels: middle (average), side difference (left minus right)
+    FLAC_CHANNEL_ASSIGNMENT_MID_DIFF = 11,
+} flac_channel_assignment_e;
+
+typedef struct
+{
+    flac_metadata_block_type_e type;
+    uint32_t size;
+    uint8_t is_last;
+} flac_metadata_block_header_t;
+
+typedef struct
+{
+    uint32_t block_size_min;
+    uint32_t block_size_max;
+    uint32_t frame_size_min;
+    uint32_t frame_size_max;
+    uint32_t sample_rate;
+    uint32_t channel_count;
+    uint32_t bits_per_sample;
+    uint64_t sample_count;
+    byte_t   md5[16]; // All 0 if the encoder didn't compute it
+} flac_metadata_block_streaminfo_t;
+
+typedef struct
+{
+    uint32_t blocking_strategy;
+    uint32_t block_size_inter_channel_sampels;
+    uint32_t sample_rate;
+    flac_channel_assignment_e channel_assignment;
+    uint32_t bits_per_sample;
+    uint64_t sample_number; // First sample in the frame, also for fixed-blocksize streams
+    uint32_t frame_number; // Only for fixed-blocksize streams
+    uint32_t crc;
+} flac_frame_header_t;
+
+typedef struct
+{
+    uint64_t sample_number; // First sample in the target frame
+    uint64_t stream_offset; // Offset (in bytes) from the first byte of the first frame header to the first byte of the target frame's header
+    uint32_t sample_count; // Number of samples in the target frame
+} flac_seek_point_t;
+
+// The lead-out track of a CUESHEET ends the last track, it's numbered 170 for CD-DA and 255 otherwise
+#define FLAC_CUESHEET_LEAD_OUT_TRACK_NUMBER_CDDA 170
+#define FLAC_CUESHEET_LEAD_OUT_TRACK_NUMBER      255
+
+typedef struct
+{
+    uint64_t sample_number; // First sample of the track, at its INDEX 01 (or its first index point if it has no INDEX 01)
+    uint8_t  number;
+    uint8_t  is_audio;
+} flac_cuesheet_track_t;
+
+typedef struct
+{
+    flac_subframe_type_e type;
+    uint32_t lpc_order; // Only for FLAC_SUBFRAME_TYPE_LPC
+    uint32_t wasted_bits_per_sample;
+    uint32_t sample_count;
+    int32_t* samples;
+} flac_subframe_header_t;
+
+/**
+ * Everything needed to decode one frame.
+ * 
+ * All buffers are sized once from STREAMINFO in FLACFrameDecoderInit(), so decoding a frame makes no heap allocations.
+ * Warm-up samples are decoded straight into 'samples', and the Rice parameter of a partition is only needed while
+ * decoding that partition, so neither needs a buffer of its own.
+*/
+typedef struct
+{
+    flac_frame_header_t    frame_header;
+    flac_subframe_header_t subframes[FLAC_MAX_CHANNEL_COUNT];
+    int32_t*               samples; // block_size_max * channel_count, subframes[i].samples points into this
+    flac_stereo_e          stereo; // Inter-channel decorrelation not yet undone in subframes 0 and 1
+    int32_t*               residuals; // block_size_max
+    int32_t                qlp_coefficients[FLAC_MAX_LPC_ORDER];
+} flac_frame_decoder_t;
+
+/**
+ * A FLAC stream that is decoded a frame at a time while playing.
+ * 
+ * Only the bytes for the next few frames are kept in 'input_buffer', and only the samples of the
+ * frame currently being played back are kept in 'frame_decoder'. Samples of a frame that didn't fit in
+ * the previous output buffer are carried over to the next call of FLACLoadData().
+ * 
+ * FLACSeek() looks up the frame holding the sample in 'index' if the file has been indexed, and decodes it. Otherwise it
+ * bisects the file on frame header sample numbers, within the two SEEKTABLE points around the sample if there is a
+ * SEEKTABLE, and then decodes forward to the frame holding the exact sample. The index is recorded the first time the
+ * stream is decoded from its first frame to its last, or by FLACBuildIndex(), and kept in a sidecar file for the next time
+ * the file is opened.
+ * 
+ * FLACLoadData() outputs samples in the format set by FLACSetOutputFormat(): 16-bit integers (the default), or at full
+ * resolution as integers in the most significant bits of 32 bits or as 32-bit floats. Reducing samples of more than 16
+ * bits to 16 bits adds TPDF dither if 'dither_enabled' is set.
+ * 
+ * FLACSetTrack() limits playback to one track of a file holding several, e.g. from its CUESHEET. Playback stops before
+ * 'output_sample_end', and changing to another track of the file is a seek, so the file and decoder stay open.
+ * 
+ * FLACDecodeParallel() decodes the whole stream on several threads, for offline work such as scanning a library.
+ * 
+ * A damaged frame doesn't stop playback. It is played back as silence, and decoding continues from the next valid
+ * frame header. The CRC-16 of each frame is only checked if 'crc_check_enabled' is set, frame headers found while
+ * resyncing are always checked against their CRC-8.
+ * 
+ * If 'md5_verify_enabled' is set, every decoded frame is also hashed, and once the last frame has been decoded the MD5
+ * of the whole stream is compared against the one in STREAMINFO. Only a stream decoded from its first frame to its last
+ * can be verified, so a seek anywhere other than the start of the stream leaves the result incomplete.
+*/
+struct flac_t
+{
+    FILE*                            file; // Only read for the metadata blocks, frames are read through 'read_ahead'
+    uint64_t                         file_size;
+    read_ahead_t                     read_ahead;
+    uint64_t                         audio_data_offset; // File offset of the first frame
+    flac_metadata_block_streaminfo_t streaminfo;
+    flac_seek_point_t*               seek_points; // Sorted by sample number, without placeholder points
+    uint32_t                         seek_point_count;
+    flac_index_t                     index;
+
+    // Encoded frames read from file
+    byte_t*                          input_buffer;
+    uint64_t                         input_buffer_capacity;
+    uint64_t                         input_buffer_file_offset; // File offset of the first byte in 'input_buffer'
+    uint64_t                         input_buffer_size; // Valid bytes in 'input_buffer'
+    uint64_t                         input_buffer_offset; // Bytes in 'input_buffer' already decoded
+    uint64_t                         frame_size_bound; // Largest possible encoded frame
+    uint8_t                          input_end_of_file;
+
+    // Decoded frame
+    flac_frame_decoder_t             frame_decoder;
+    uint32_t                         frame_sample_count;
+    uint32_t                         frame_sample_index; // Next sample in the frame to output
+
+    // Output
+    sample_format_e                  output_sample_format;
+    uint32_t                         output_bps; // Bytes per sample
+    uint8_t                          dither_enabled;
+    flac_dither_t                    dither;
+    uint64_t                         output_sample_end; // Sample where playback stops, 0 to play back to the end of the stream
+
+    // Damaged frames
+    uint8_t                          crc_check_enabled; // Check the CRC-8 of every frame header and the CRC-16 of every frame
+    uint64_t                         next_sample_number; // First sample after the last frame decoded or replaced by silence
+    uint64_t                         silence_sample_count; // Samples of damaged frames still to be played back as silence
+    uint32_t                         crc8_error_count;
+    uint32_t                         crc16_error_count;
+    uint32_t                         invalid_frame_count; // Frames with reserved or out of range values, in their header or after it
+    uint32_t                         resync_count; // Times decoding skipped ahead to the next valid frame header
+
+    // MD5 verification of the decoded samples
+    uint8_t                          md5_verify_enabled;
+    flac_md5_result_e                md5_result;
+    md5_context_t                    md5_context;
+    uint64_t                         md5_sample_number; // First sample not hashed yet
+    byte_t*                          md5_buffer; // One frame of samples packed the way the MD5 signature is computed over them
+};
+typedef struct flac_t flac_t;
+
+// Called by FLACDecodeParallel() with each decoded frame in stream order. The frame header and each channel's samples
+// (subframes[channel].samples) are only valid during the call.
+typedef void (*flac_frame_callback_t)(const flac_frame_decoder_t* frame_decoder, void* callback_data);
+
+/**
+ * A FLAC stream decoded from bytes pushed into it by FLACStreamPush(), in slices of any size down to a single byte, e.g.
+ * as they arrive from asynchronous reads, a pipe or memory. Nothing blocks, and each frame is output through
+ * 'frame_callback' (in the same way as by FLACDecodeParallel()) from within the FLACStreamPush() call that completes it.
+ * 
+ * A frame is complete once the header of the frame after it has been pushed, as a frame has no length of its own. Until
+ * then its bytes are kept in 'input_buffer', which holds no more than the largest frame the stream can have and the next
+ * frame header. The search for the next frame header continues from 'search_offset' with every push, so each byte is
+ * only searched once. The metadata blocks in front of the frames are parsed as they arrive, only STREAMINFO is kept.
+ * 
+ * Once all of the stream has been pushed, FLACStreamFinish() outputs the last frame, which has no frame after it.
+ * 
+ * Damaged frames are output as silence, and decoding continues from the next valid frame header, as in FLACDecodeParallel().
+*/
+typedef struct
+{
+    flac_stream_state_e              state;
+    flac_frame_callback_t            frame_callback;
+    void*                            callback_data;
+    uint8_t                          crc_check_enabled; // Check the CRC-16 of every frame
+
+    // Metadata
+    byte_t                           metadata_bytes[34]; // "fLaC" marker, METADATA_BLOCK_HEADER or STREAMINFO collected so far
+    uint32_t                         metadata_byte_count;
+    flac_metadata_block_header_t     metadata_block_header;
+    uint32_t                         metadata_block_count; // Headers parsed so far
+    uint32_t                         metadata_block_remaining_size; // Bytes of the current block not pushed yet
+    flac_metadata_block_streaminfo_t streaminfo;
+
+    // Frames
+    byte_t*                          input_buffer;
+    uint64_t                         input_buffer_capacity;
+    uint64_t                         input_buffer_size; // Valid bytes in 'input_buffer'
+    uint64_t                         input_buffer_offset; // Bytes in 'input_buffer' already decoded or skipped
+    uint64_t                         search_offset; // Offset from 'input_buffer_offset' where the search for a frame header continues
+    uint8_t                          frame_found; // 'input_buffer_offset' is at a valid frame header
+    uint8_t                          resyncing; // A frame was lost, so the next frame header found is a resync
+    flac_frame_decoder_t             frame_decoder;
+    uint64_t                         next_sample_number; // First sample after the last frame output
+
+    // Damaged frames
+    uint32_t                         crc16_error_count;
+    uint32_t                         invalid_frame_count;
+    uint32_t                         resync_count;
+} flac_stream_t;
+
+/**
+ * Reads a FLAC file's title, artist and album into 'song', and its STREAMINFO into 'streaminfo', without setting it up
+ * for playback. Only the metadata blocks are read, never any audio frames. They're read through a small window, so most
+ * files take a single read, and large blocks that aren't needed (e.g. PICTURE) are skipped over without reading them.
+ * 
+ * If 'cuesheet_tracks' isn't NULL, the tracks of the file's CUESHEET (if it has a valid one) are loaded into a new array
+ * of '*cuesheet_track_count' tracks, which the caller must free. The last track is the lead-out track.
+ * 
+ * Neither FLACProbe() nor FLACLoadHeader() read tags into a virtual track ('song->track_number' isn't 0), as they're
+ * those of the whole file.
+ * 
+ * Returns SONG_ERROR_NO if the file has a valid STREAMINFO
+*/
+song_error_e      FLACProbe(song_t* song, flac_metadata_block_streaminfo_t* streaminfo, flac_cuesheet_track_t** cuesheet_tracks, uint32_t* cuesheet_track_count);
+song_error_e      FLACLoadHeader(song_t* song);
+void              FLACSetOutputFormat(song_t* song, sample_format_e sample_format, uint8_t bps);
+uint32_t          FLACLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output);
+uint8_t           FLACSeek(flac_t* flac, uint64_t sample_index);
+uint8_t           FLACSetTrack(flac_t* flac, uint64_t sample_start, uint64_t sample_end);
+uint8_t           FLACBuildIndex(flac_t* flac);
+uint64_t          FLACDecodeParallel(flac_t* flac, uint32_t thread_count, flac_frame_callback_t frame_callback, void* callback_data);
+flac_md5_result_e FLACVerifyMD5(flac_t* flac);
+void              FLACFree(flac_t* flac);
+
+void                FLACStreamInit(flac_stream_t* stream, flac_frame_callback_t frame_callback, void* callback_data);
+flac_stream_state_e FLACStreamPush(flac_stream_t* stream, const byte_t* bytes, uint64_t byte_count);
+flac_stream_state_e FLACStreamFinish(flac_stream_t* stream);
+void                FLACStreamFree(flac_stream_t* stream);
+
+/**
+ * FLACBitReaderBenchmark() decodes the residuals of a synthetic 16-bit/44.1 kHz stream (4-bit Rice parameters) and a
+ * 24-bit/96 kHz stream (5-bit Rice parameters, larger residuals) with the FLACBitReader*() functions the decoder uses,
+ * and with the byte-at-a-time readers they replaced. Prints both in MB/s of decoded samples and the speedup.
+ * Returns number of streams where either reader didn't decode the residuals that were written
+*/
+uint32_t FLACBitReaderBenchmark(void);
 
 #endif
\ No newline at end of file
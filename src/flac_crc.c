@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpu.h"
+#include "flac_crc.h"
+
+#include <assert.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+#define FLAC_CRC8_POLYNOMIAL 0x07
+#define FLAC_CRC16_POLYNOMIAL 0x8005
+
+// flac_crc16_tables[n][byte] is the CRC-16 of 'byte' followed by n 0-bytes
+static uint8_t flac_crc8_table[256];
+static uint16_t flac_crc16_tables[8][256];
+// x^n mod P(x) for the folding distances of FLACCRC16PCLMUL(), with P(x) being the CRC-16 polynomial
+static uint64_t flac_crc16_x_128;
+static uint64_t flac_crc16_x_192;
+static uint64_t flac_crc16_x_512;
+static uint64_t flac_crc16_x_576;
+
+// Returns x^n mod P(x)
+static uint16_t FLACCRC16PowerOfX(uint32_t n)
+{
+    uint32_t remainder = 1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        remainder <<= 1;
+        if (remainder & 0x10000)
+        {
+            remainder ^= 0x10000 | FLAC_CRC16_POLYNOMIAL;
+        }
+    }
+    return (uint16_t)remainder;
+}
+
+void FLACCRCInit(void)
+{
+    // Building the tables is idempotent, so threads racing on the first call all write the same values
+    static volatile uint8_t tables_built = 0;
+    if (tables_built)
+    {
+        return;
+    }
+
+    for (uint32_t byte = 0; byte < 256; byte++)
+    {
+        uint8_t crc8 = (uint8_t)byte;
+        uint16_t crc16 = (uint16_t)(byte << 8);
+        for (uint32_t bit = 0; bit < 8; bit++)
+        {
+            crc8 = (crc8 & 0x80) ? (uint8_t)((crc8 << 1) ^ FLAC_CRC8_POLYNOMIAL) : (uint8_t)(crc8 << 1);
+            crc16 = (crc16 & 0x8000) ? (uint16_t)((crc16 << 1) ^ FLAC_CRC16_POLYNOMIAL) : (uint16_t)(crc16 << 1);
+        }
+        flac_crc8_table[byte] = crc8;
+        flac_crc16_tables[0][byte] = crc16;
+    }
+    for (uint32_t n = 1; n < 8; n++)
+    {
+        for (uint32_t byte = 0; byte < 256; byte++)
+        {
+            uint16_t crc16 = flac_crc16_tables[n - 1][byte];
+            flac_crc16_tables[n][byte] = (uint16_t)(crc16 << 8) ^ flac_crc16_tables[0][crc16 >> 8];
+        }
+    }
+    flac_crc16_x_128 = FLACCRC16PowerOfX(128);
+    flac_crc16_x_192 = FLACCRC16PowerOfX(192);
+    flac_crc16_x_512 = FLACCRC16PowerOfX(512);
+    flac_crc16_x_576 = FLACCRC16PowerOfX(576);
+
+    tables_built = 1;
+}
+
+uint8_t FLACCRC8(const byte_t* bytes, uint64_t byte_count)
+{
+    uint8_t crc = 0;
+    for (uint64_t i = 0; i < byte_count; i++)
+    {
+        crc = flac_crc8_table[crc ^ bytes[i]];
+    }
+    return crc;
+}
+
+// Continues the CRC-16 'crc' of the bytes before 'bytes'
+static uint16_t FLACCRC16SliceBy8(uint16_t crc, const byte_t* bytes, uint64_t byte_count)
+{
+    uint64_t i = 0;
+    for (; (i + 8) <= byte_count; i += 8)
+    {
+        // The CRC so far is combined with the first 2 bytes, and each byte is then looked up in the table for the
+        // number of bytes after it
+        crc = flac_crc16_tables[7][(crc >> 8) ^ bytes[i]] ^ flac_crc16_tables[6][(crc & 0xFF) ^ bytes[i + 1]] ^
+              flac_crc16_tables[5][bytes[i + 2]] ^ flac_crc16_tables[4][bytes[i + 3]] ^
+              flac_crc16_tables[3][bytes[i + 4]] ^ flac_crc16_tables[2][bytes[i + 5]] ^
+              flac_crc16_tables[1][bytes[i + 6]] ^ flac_crc16_tables[0][bytes[i + 7]];
+    }
+    for (; i < byte_count; i++)
+    {
+        crc = (uint16_t)(crc << 8) ^ flac_crc16_tables[0][(crc >> 8) ^ bytes[i]];
+    }
+    return crc;
+}
+
+#ifdef CPU_X86
+// Treating 'value' as a polynomial H(x) * x^64 + L(x), returns H(x) * x^(n + 64) + L(x) * x^n mod P(x) (not fully
+// reduced, it is below 80 bits) given x^(n + 64) mod P(x) in the high and x^n mod P(x) in the low half of 'powers_of_x'
+TARGET_PCLMUL static inline __m128i FLACCRC16Fold(__m128i value, __m128i powers_of_x)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(value, powers_of_x, 0x11), _mm_clmulepi64_si128(value, powers_of_x, 0x00));
+}
+
+// The CRC-16 of a message M(x) is M(x) * x^16 mod P(x), so any polynomial of the same remainder mod P(x) gives the same
+// CRC. Four 16-byte blocks are kept as running remainders, and each is folded 64 bytes forward (multiplied by x^512)
+// onto the next block of its lane. The products are independent, so they overlap in the multiplier. Finally the lanes
+// are folded into one, and the CRC of its 16 bytes continues over the bytes that didn't fill a block.
+TARGET_PCLMUL static uint16_t FLACCRC16PCLMUL(const byte_t* bytes, uint64_t byte_count)
+{
+    assert(byte_count >= 64);
+
+    // Blocks are loaded byte-reversed, so that the first byte is the most significant as in the CRC's bit order
+    const __m128i byte_reverse = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i fold_64_bytes = _mm_set_epi64x((int64_t)flac_crc16_x_576, (int64_t)flac_crc16_x_512);
+    const __m128i fold_16_bytes = _mm_set_epi64x((int64_t)flac_crc16_x_192, (int64_t)flac_crc16_x_128);
+
+    __m128i lanes[4];
+    for (uint32_t lane = 0; lane < 4; lane++)
+    {
+        lanes[lane] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + (lane * 16))), byte_reverse);
+    }
+    uint64_t i = 64;
+    for (; (i + 64) <= byte_count; i += 64)
+    {
+        for (uint32_t lane = 0; lane < 4; lane++)
+        {
+            __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + i + (lane * 16))), byte_reverse);
+            lanes[lane] = _mm_xor_si128(FLACCRC16Fold(lanes[lane], fold_64_bytes), block);
+        }
+    }
+    __m128i remainder = lanes[0];
+    for (uint32_t lane = 1; lane < 4; lane++)
+    {
+        remainder = _mm_xor_si128(FLACCRC16Fold(remainder, fold_16_bytes), lanes[lane]);
+    }
+    for (; (i + 16) <= byte_count; i += 16)
+    {
+        __m128i block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(bytes + i)), byte_reverse);
+        remainder = _mm_xor_si128(FLACCRC16Fold(remainder, fold_16_bytes), block);
+    }
+
+    byte_t remainder_bytes[16];
+    _mm_storeu_si128((__m128i*)remainder_bytes, _mm_shuffle_epi8(remainder, byte_reverse));
+    uint16_t crc = FLACCRC16SliceBy8(0, remainder_bytes, 16);
+    return FLACCRC16SliceBy8(crc, bytes + i, byte_count - i);
+}
+#endif
+
+uint16_t FLACCRC16(const byte_t* bytes, uint64_t byte_count)
+{
+#ifdef CPU_X86
+    if (byte_count >= 64)
+    {
+        const cpu_features_t* cpu_features = CPUGetFeatures();
+        if (cpu_features->pclmul && cpu_features->sse41)
+        {
+            return FLACCRC16PCLMUL(bytes, byte_count);
+        }
+    }
+#endif
+    return FLACCRC16SliceBy8(0, bytes, byte_count);
+}
\ No newline at end of file
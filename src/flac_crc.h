@@ -0,0 +1,40 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLAC_CRC_H
+#define FLAC_CRC_H
+
+#include "macros.h"
+
+#include <stdint.h>
+
+/**
+ * CRCs that protect FLAC frames, both initialized with 0 and computed MSB-first:
+ * 
+ *   CRC-8  (polynomial = x^8 + x^2 + x^1 + x^0) of the FRAME_HEADER, stored as its last byte
+ *   CRC-16 (polynomial = x^16 + x^15 + x^2 + x^0) of the whole frame, stored in the FRAME_FOOTER
+ * 
+ * FLACCRCInit() builds the lookup tables and must be called before the others. A frame header is at most 16 bytes, so
+ * FLACCRC8() looks up one byte at a time. FLACCRC16() folds 64 bytes at a time with carry-less multiplication when the
+ * CPU has PCLMULQDQ, and looks up 8 bytes at a time in 8 tables (slice-by-8) otherwise.
+*/
+void     FLACCRCInit(void);
+uint8_t  FLACCRC8(const byte_t* bytes, uint64_t byte_count);
+uint16_t FLACCRC16(const byte_t* bytes, uint64_t byte_count);
+
+#endif
\ No newline at end of file
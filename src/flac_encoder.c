@@ -0,0 +1,1200 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "flac_crc.h"
+#include "flac_encoder.h"
+#include "md5.h"
+#include "windows_thread.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FLAC_ENCODER_MAX_PARTITION_ORDER 8
+#define FLAC_ENCODER_SEEK_POINT_SECONDS  10
+// LPC residuals beyond this are rejected, which keeps them and the prediction within 32 bits for the decoder
+#define FLAC_ENCODER_RESIDUAL_LIMIT      (1 << 30)
+#define FLAC_ENCODER_VENDOR              "Bragi"
+#define FLAC_ENCODER_PI                  3.14159265358979323846
+
+// Parameters of a compression level
+typedef struct
+{
+    uint32_t block_size;
+    uint32_t max_lpc_order; // 0 = fixed predictors only
+    uint32_t lpc_precision; // Bits of the quantized LPC coefficients, including the sign
+    uint32_t max_partition_order;
+    uint8_t  stereo; // Try inter-channel decorrelation of stereo input
+    uint8_t  exhaustive_fixed; // Encode every fixed order instead of picking the one with the smallest residuals
+    uint8_t  exhaustive_lpc; // Encode every LPC order instead of picking one from the prediction error
+} flac_encoder_level_t;
+
+static const flac_encoder_level_t flac_encoder_levels[FLAC_ENCODER_LEVEL_MAX + 1] =
+{
+    //  block  LPC  precision  partition  stereo  exhaustive fixed/LPC
+    {   1152,   0,   0,         3,         0,      0, 0 },
+    {   1152,   0,   0,         3,         1,      0, 0 },
+    {   1152,   0,   0,         3,         1,      1, 0 },
+    {   4096,   6,   12,        4,         0,      0, 0 },
+    {   4096,   8,   12,        4,         1,      0, 0 },
+    {   4096,   8,   12,        5,         1,      0, 0 },
+    {   4096,   8,   12,        6,         1,      0, 0 },
+    {   4096,   12,  12,        6,         1,      0, 0 },
+    {   4096,   12,  12,        6,         1,      0, 1 }
+};
+
+// Writes bits MSB-first into a buffer that's large enough for everything written
+typedef struct
+{
+    byte_t*  bytes;
+    uint64_t byte_count; // Whole bytes written to 'bytes'
+    uint64_t cache; // Bits not yet written to 'bytes', in the low 'cache_bit_count' bits
+    uint32_t cache_bit_count;
+} flac_bit_writer_t;
+
+// How a subframe is encoded, and its size in bits
+typedef struct
+{
+    flac_subframe_type_e type;
+    uint32_t             bits_per_sample; // Without the wasted bits
+    uint32_t             wasted_bits_per_sample;
+    uint32_t             order; // Only for FLAC_SUBFRAME_TYPE_FIXED and FLAC_SUBFRAME_TYPE_LPC
+    uint32_t             precision; // Only for FLAC_SUBFRAME_TYPE_LPC
+    uint32_t             shift; // Only for FLAC_SUBFRAME_TYPE_LPC
+    int32_t              coefficients[FLAC_MAX_LPC_ORDER]; // Only for FLAC_SUBFRAME_TYPE_LPC
+    uint32_t             partition_order;
+    uint32_t             rice_parameter_bits; // 4 for FLAC_RESIDUAL_TYPE_RICE, 5 for FLAC_RESIDUAL_TYPE_RICE2
+    uint32_t             rice_parameters[1 << FLAC_ENCODER_MAX_PARTITION_ORDER];
+    int32_t*             samples; // Shifted right by the wasted bits
+    int32_t*             residuals; // block size - order residuals
+    uint64_t             bit_count; // An upper bound, as the Rice coded size is estimated
+} flac_subframe_plan_t;
+
+// Scratch memory of one encoding thread, sized for the level's block size
+typedef struct
+{
+    int32_t*             channels[FLAC_MAX_CHANNEL_COUNT + 2]; // Planar samples, followed by mid and side for stereo
+    flac_subframe_plan_t plans[FLAC_MAX_CHANNEL_COUNT + 2];
+    flac_subframe_plan_t candidate;
+    int32_t*             candidate_residuals; // Swapped with those of a plan when 'candidate' is better
+    uint64_t*            partition_sums;
+    double*              window; // Tukey(0.5) for 'window_size' samples
+    uint32_t             window_size;
+    double*              windowed_samples;
+} flac_encoder_workspace_t;
+
+// Encodes the frames in ['frame_start', 'frame_end') into a buffer of its own
+typedef struct
+{
+    const flac_encoder_input_t* input;
+    const flac_encoder_level_t* level;
+    uint32_t                    frame_start;
+    uint32_t                    frame_end;
+    uint32_t*                   frame_sizes; // Shared by all threads, indexed by frame number
+    byte_t*                     bytes;
+    uint64_t                    byte_count;
+    uint64_t                    byte_capacity;
+} flac_encoder_thread_t;
+
+static void FLACBitWriterFlush(flac_bit_writer_t* writer)
+{
+    while (writer->cache_bit_count >= 8)
+    {
+        writer->cache_bit_count -= 8;
+        writer->bytes[writer->byte_count++] = (byte_t)(writer->cache >> writer->cache_bit_count);
+    }
+}
+
+// Writes the low 'bit_count' bits of 'value', at most 32
+static inline void FLACBitWriterWrite(flac_bit_writer_t* writer, uint32_t bit_count, uint32_t value)
+{
+    assert(bit_count <= 32);
+    if (writer->cache_bit_count > 32)
+    {
+        FLACBitWriterFlush(writer);
+    }
+    writer->cache = (writer->cache << bit_count) | (value & (uint32_t)((1ull << bit_count) - 1));
+    writer->cache_bit_count += bit_count;
+}
+
+// Pads with 0-bits to the next byte boundary, and writes out every bit
+static void FLACBitWriterAlign(flac_bit_writer_t* writer)
+{
+    FLACBitWriterWrite(writer, (8 - (writer->cache_bit_count & 7)) & 7, 0);
+    FLACBitWriterFlush(writer);
+}
+
+static void FLACBitWriterWriteUTF8(flac_bit_writer_t* writer, uint32_t value)
+{
+    if (value < 0x80)
+    {
+        FLACBitWriterWrite(writer, 8, value);
+        return;
+    }
+
+    uint32_t byte_count = 6;
+    if (value < 0x800)
+    {
+        byte_count = 2;
+    }
+    else if (value < 0x10000)
+    {
+        byte_count = 3;
+    }
+    else if (value < 0x200000)
+    {
+        byte_count = 4;
+    }
+    else if (value < 0x4000000)
+    {
+        byte_count = 5;
+    }
+    // A leading 1-bit per byte, then the highest bits of the value, then 6 bits in each continuation byte
+    FLACBitWriterWrite(writer, 8, ((0xFF << (8 - byte_count)) & 0xFF) | (value >> (6 * (byte_count - 1))));
+    for (uint32_t i = byte_count - 1; i > 0; i--)
+    {
+        FLACBitWriterWrite(writer, 8, 0x80 | ((value >> (6 * (i - 1))) & 0x3F));
+    }
+}
+
+// Writes residuals zig-zag mapped (0, -1, 1, -2, 2, ... as 0, 1, 2, 3, 4, ...) and Rice coded with parameter 'k'
+static void FLACBitWriterWriteRicePartition(flac_bit_writer_t* writer, uint32_t k, uint32_t count, const int32_t* residuals)
+{
+    uint32_t remainder_mask = (0x1u << k) - 1;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t value = ((uint32_t)residuals[i] << 1) ^ (uint32_t)(residuals[i] >> 31);
+        uint32_t q = value >> k;
+        // Unary coded quotient as 'q' 0-bits and a 1-bit, followed by the k-bit remainder
+        while ((q + 1 + k) > 32)
+        {
+            uint32_t zero_count = (q < 32) ? q : 32;
+            FLACBitWriterWrite(writer, zero_count, 0);
+            q -= zero_count;
+        }
+        FLACBitWriterWrite(writer, q + 1 + k, (0x1u << k) | (value & remainder_mask));
+    }
+}
+
+// Returns the Rice parameter that codes 'count' residuals summing to 'sum' (zig-zag mapped) in the fewest bits, and sets
+// 'bit_count' to that size. count * (k + 1) + (sum >> k) is never less than the exact size, as (a >> k) + (b >> k) <= (a + b) >> k.
+static uint32_t FLACEncoderRiceParameter(uint64_t sum, uint32_t count, uint64_t* bit_count)
+{
+    // Start from log2 of the mean, then look at its neighbours
+    uint32_t k = 0;
+    if (sum > count)
+    {
+        k = (63 - CountLeadingZeros64(sum)) - (63 - CountLeadingZeros64(count));
+    }
+    uint32_t best_k = 0;
+    uint64_t best_bit_count = UINT64_MAX;
+    uint32_t k_first = (k > 0) ? k - 1 : 0;
+    uint32_t k_last = (k < 30) ? k + 1 : 30;
+    for (k = k_first; k <= k_last; k++)
+    {
+        uint64_t k_bit_count = ((uint64_t)count * (k + 1)) + (sum >> k);
+        if (k_bit_count < best_bit_count)
+        {
+            best_k = k;
+            best_bit_count = k_bit_count;
+        }
+    }
+    *bit_count = best_bit_count;
+    return best_k;
+}
+
+// Picks the partition order and Rice parameters of the 'block_size' - 'order' residuals in 'plan', and returns the size
+// of the RESIDUAL section in bits
+static uint64_t FLACEncoderPlanResidual(flac_subframe_plan_t* plan, uint32_t block_size, uint32_t max_partition_order, uint64_t* partition_sums)
+{
+    // Partitions must split the block evenly, and the first one must fit the warm-up samples
+    uint32_t order = plan->order;
+    uint32_t partition_order = max_partition_order;
+    while ((partition_order > 0) &&
+           (((block_size & ((0x1u << partition_order) - 1)) != 0) || ((block_size >> partition_order) <= order)))
+    {
+        partition_order--;
+    }
+
+    // Sum each partition at the highest order, and the sums of the lower orders by adding pairs of them
+    uint32_t partition_count = 0x1u << partition_order;
+    uint32_t partition_size = block_size >> partition_order;
+    const int32_t* residuals = plan->residuals;
+    uint32_t residual_index = 0;
+    for (uint32_t i = 0; i < partition_count; i++)
+    {
+        uint32_t partition_end = ((i + 1) * partition_size) - order;
+        uint64_t sum = 0;
+        for (; residual_index < partition_end; residual_index++)
+        {
+            sum += ((uint32_t)residuals[residual_index] << 1) ^ (uint32_t)(residuals[residual_index] >> 31);
+        }
+        partition_sums[i] = sum;
+    }
+
+    uint64_t best_bit_count = UINT64_MAX;
+    uint32_t rice_parameters[1 << FLAC_ENCODER_MAX_PARTITION_ORDER];
+    while (1)
+    {
+        partition_count = 0x1u << partition_order;
+        partition_size = block_size >> partition_order;
+        uint64_t bit_count = 2 + 4;
+        uint32_t max_rice_parameter = 0;
+        for (uint32_t i = 0; i < partition_count; i++)
+        {
+            uint64_t partition_bit_count = 0;
+            rice_parameters[i] = FLACEncoderRiceParameter(partition_sums[i], partition_size - ((i == 0) ? order : 0), &partition_bit_count);
+            bit_count += partition_bit_count;
+            max_rice_parameter = (rice_parameters[i] > max_rice_parameter) ? rice_parameters[i] : max_rice_parameter;
+        }
+        // The 4-bit parameters of RICE go up to 14, as 15 is the escape code
+        uint32_t rice_parameter_bits = (max_rice_parameter > 14) ? 5 : 4;
+        bit_count += partition_count * rice_parameter_bits;
+        if (bit_count < best_bit_count)
+        {
+            best_bit_count = bit_count;
+            plan->partition_order = partition_order;
+            plan->rice_parameter_bits = rice_parameter_bits;
+            memcpy(plan->rice_parameters, rice_parameters, partition_count * sizeof(uint32_t));
+        }
+
+        if (partition_order == 0)
+        {
+            break;
+        }
+        partition_order--;
+        for (uint32_t i = 0; i < (partition_count / 2); i++)
+        {
+            partition_sums[i] = partition_sums[2 * i] + partition_sums[(2 * i) + 1];
+        }
+    }
+
+    return best_bit_count;
+}
+
+// Computes the residuals of fixed predictor 'order' into 'residuals'
+static void FLACEncoderFixedResiduals(const int32_t* samples, uint32_t block_size, uint32_t order, int32_t* residuals)
+{
+    switch (order)
+    {
+        case 0:
+        {
+            memcpy(residuals, samples, block_size * sizeof(int32_t));
+        } break;
+
+        case 1:
+        {
+            for (uint32_t i = 1; i < block_size; i++)
+            {
+                residuals[i - 1] = samples[i] - samples[i - 1];
+            }
+        } break;
+
+        case 2:
+        {
+            for (uint32_t i = 2; i < block_size; i++)
+            {
+                residuals[i - 2] = samples[i] - (2 * samples[i - 1]) + samples[i - 2];
+            }
+        } break;
+
+        case 3:
+        {
+            for (uint32_t i = 3; i < block_size; i++)
+            {
+                residuals[i - 3] = samples[i] - (3 * samples[i - 1]) + (3 * samples[i - 2]) - samples[i - 3];
+            }
+        } break;
+
+        case 4:
+        {
+            for (uint32_t i = 4; i < block_size; i++)
+            {
+                residuals[i - 4] = samples[i] - (4 * samples[i - 1]) + (6 * samples[i - 2]) - (4 * samples[i - 3]) + samples[i - 4];
+            }
+        } break;
+
+        default:
+        {
+            assert(0);
+        } break;
+    }
+}
+
+// Replaces 'plan' with the workspace's candidate if that is smaller
+static void FLACEncoderTakeCandidate(flac_encoder_workspace_t* workspace, flac_subframe_plan_t* plan)
+{
+    if (workspace->candidate.bit_count < plan->bit_count)
+    {
+        int32_t* plan_residuals = plan->residuals;
+        *plan = workspace->candidate;
+        workspace->candidate_residuals = plan_residuals;
+    }
+}
+
+static void FLACEncoderPlanFixed(flac_encoder_workspace_t* workspace, const flac_encoder_level_t* level, uint32_t block_size, uint32_t header_bit_count, flac_subframe_plan_t* plan)
+{
+    const int32_t* samples = plan->samples;
+    uint32_t max_order = (block_size > 4) ? 4 : block_size - 1;
+    uint32_t order_first = 0;
+    uint32_t order_last = max_order;
+    if ((level->exhaustive_fixed == 0) && (max_order == 4))
+    {
+        // The order whose residuals have the smallest magnitude, summed over the samples every order predicts
+        uint64_t sums[5] = { 0 };
+        for (uint32_t i = 4; i < block_size; i++)
+        {
+            sums[0] += (uint32_t)abs(samples[i]);
+            sums[1] += (uint32_t)abs(samples[i] - samples[i - 1]);
+            sums[2] += (uint32_t)abs(samples[i] - (2 * samples[i - 1]) + samples[i - 2]);
+            sums[3] += (uint32_t)abs(samples[i] - (3 * samples[i - 1]) + (3 * samples[i - 2]) - samples[i - 3]);
+            sums[4] += (uint32_t)abs(samples[i] - (4 * samples[i - 1]) + (6 * samples[i - 2]) - (4 * samples[i - 3]) + samples[i - 4]);
+        }
+        for (uint32_t order = 1; order <= 4; order++)
+        {
+            if (sums[order] < sums[order_first])
+            {
+                order_first = order;
+            }
+        }
+        order_last = order_first;
+    }
+
+    flac_subframe_plan_t* candidate = &workspace->candidate;
+    for (uint32_t order = order_first; order <= order_last; order++)
+    {
+        candidate->type = FLAC_SUBFRAME_TYPE_FIXED;
+        candidate->bits_per_sample = plan->bits_per_sample;
+        candidate->wasted_bits_per_sample = plan->wasted_bits_per_sample;
+        candidate->order = order;
+        candidate->samples = plan->samples;
+        candidate->residuals = workspace->candidate_residuals;
+        FLACEncoderFixedResiduals(samples, block_size, order, candidate->residuals);
+        candidate->bit_count = header_bit_count + (order * plan->bits_per_sample) + FLACEncoderPlanResidual(candidate, block_size, level->max_partition_order, workspace->partition_sums);
+        FLACEncoderTakeCandidate(workspace, plan);
+    }
+}
+
+// Fills the workspace's window for 'block_size' samples, if it isn't already
+static void FLACEncoderTukeyWindow(flac_encoder_workspace_t* workspace, uint32_t block_size)
+{
+    if (workspace->window_size == block_size)
+    {
+        return;
+    }
+
+    // Tukey(0.5): a raised cosine over the first and last quarter, and flat in between
+    int32_t taper_size = (int32_t)(block_size / 4) - 1;
+    for (uint32_t i = 0; i < block_size; i++)
+    {
+        workspace->window[i] = 1.0;
+    }
+    if (taper_size > 0)
+    {
+        for (int32_t i = 0; i <= taper_size; i++)
+        {
+            workspace->window[i] = 0.5 - (0.5 * cos(FLAC_ENCODER_PI * i / taper_size));
+            workspace->window[block_size - taper_size - 1 + i] = 0.5 - (0.5 * cos(FLAC_ENCODER_PI * (i + taper_size) / taper_size));
+        }
+    }
+    workspace->window_size = block_size;
+}
+
+// Quantizes 'order' LPC coefficients to 'precision' bits, including the sign, and a non-negative shift
+// Returns 0 if every coefficient is 0
+static uint8_t FLACEncoderQuantizeLPC(const double* lpc, uint32_t order, uint32_t precision, int32_t* coefficients, uint32_t* shift)
+{
+    double max_magnitude = 0.0;
+    for (uint32_t i = 0; i < order; i++)
+    {
+        max_magnitude = (fabs(lpc[i]) > max_magnitude) ? fabs(lpc[i]) : max_magnitude;
+    }
+    if (max_magnitude <= 0.0)
+    {
+        return 0;
+    }
+
+    // Largest shift that keeps the largest coefficient within precision - 1 bits of magnitude, as decoders reject a negative shift
+    int exponent = 0;
+    frexp(max_magnitude, &exponent);
+    int32_t signed_shift = (int32_t)precision - 1 - exponent;
+    signed_shift = (signed_shift < 0) ? 0 : ((signed_shift > 15) ? 15 : signed_shift);
+    int32_t coefficient_max = (0x1 << (precision - 1)) - 1;
+    int32_t coefficient_min = -(0x1 << (precision - 1));
+
+    // Carry each coefficient's rounding error into the next one
+    double error = 0.0;
+    uint8_t any_nonzero = 0;
+    for (uint32_t i = 0; i < order; i++)
+    {
+        error += lpc[i] * (double)(0x1 << signed_shift);
+        double rounded = floor(error + 0.5);
+        int32_t coefficient = (rounded > coefficient_max) ? coefficient_max : ((rounded < coefficient_min) ? coefficient_min : (int32_t)rounded);
+        error -= coefficient;
+        coefficients[i] = coefficient;
+        any_nonzero |= (coefficient != 0);
+    }
+    *shift = (uint32_t)signed_shift;
+    return any_nonzero;
+}
+
+// Computes the residuals the decoder adds its prediction to, summed in as many bits as FLACLPCRestore() sums it in
+// Returns 0 if a residual is too large to be coded
+static uint8_t FLACEncoderLPCResiduals(const int32_t* samples, uint32_t block_size, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t precision, uint32_t bits_per_sample, int32_t* residuals)
+{
+    uint32_t residual_count = block_size - order;
+    const int32_t* history = samples + order;
+    uint32_t order_log2 = 63 - CountLeadingZeros64(order);
+    if ((bits_per_sample + precision + order_log2) <= 32)
+    {
+        // The prediction fits in 32 bits, so it's summed one coefficient at a time over the whole block, which vectorizes
+        const int32_t* tap = samples + order - 1;
+        for (uint32_t i = 0; i < residual_count; i++)
+        {
+            residuals[i] = coefficients[0] * tap[i];
+        }
+        for (uint32_t j = 1; j < order; j++)
+        {
+            int32_t coefficient = coefficients[j];
+            tap = samples + order - j - 1;
+            for (uint32_t i = 0; i < residual_count; i++)
+            {
+                residuals[i] += coefficient * tap[i];
+            }
+        }
+        int32_t residual_max = 0;
+        int32_t residual_min = 0;
+        for (uint32_t i = 0; i < residual_count; i++)
+        {
+            int64_t residual = (int64_t)history[i] - (residuals[i] >> shift);
+            residual = (residual > INT32_MAX) ? INT32_MAX : ((residual < INT32_MIN) ? INT32_MIN : residual);
+            residuals[i] = (int32_t)residual;
+            residual_max = (residuals[i] > residual_max) ? residuals[i] : residual_max;
+            residual_min = (residuals[i] < residual_min) ? residuals[i] : residual_min;
+        }
+        return (residual_max <= FLAC_ENCODER_RESIDUAL_LIMIT) && (residual_min >= -FLAC_ENCODER_RESIDUAL_LIMIT);
+    }
+
+    for (uint32_t i = 0; i < residual_count; i++)
+    {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; j++)
+        {
+            sum += (int64_t)coefficients[j] * samples[order + i - j - 1];
+        }
+        int64_t residual = (int64_t)history[i] - (sum >> shift);
+        if ((residual > FLAC_ENCODER_RESIDUAL_LIMIT) || (residual < -FLAC_ENCODER_RESIDUAL_LIMIT))
+        {
+            return 0;
+        }
+        residuals[i] = (int32_t)residual;
+    }
+    return 1;
+}
+
+static void FLACEncoderPlanLPC(flac_encoder_workspace_t* workspace, const flac_encoder_level_t* level, uint32_t block_size, uint32_t header_bit_count, flac_subframe_plan_t* plan)
+{
+    uint32_t max_order = (level->max_lpc_order < block_size) ? level->max_lpc_order : block_size - 1;
+    if (max_order == 0)
+    {
+        return;
+    }
+
+    // Autocorrelation of the windowed samples
+    const int32_t* samples = plan->samples;
+    FLACEncoderTukeyWindow(workspace, block_size);
+    double* windowed_samples = workspace->windowed_samples;
+    for (uint32_t i = 0; i < block_size; i++)
+    {
+        windowed_samples[i] = samples[i] * workspace->window[i];
+    }
+    // All lags are summed in the same pass, as independent sums
+    double autocorrelation[FLAC_MAX_LPC_ORDER + 1] = { 0.0 };
+    for (uint32_t i = 0; i < block_size; i++)
+    {
+        uint32_t lag_count = (i < max_order) ? i : max_order;
+        for (uint32_t lag = 0; lag <= lag_count; lag++)
+        {
+            autocorrelation[lag] += windowed_samples[i] * windowed_samples[i - lag];
+        }
+    }
+    if (autocorrelation[0] <= 0.0)
+    {
+        return;
+    }
+
+    // Levinson-Durbin recursion, keeping the predictor and prediction error of every order
+    double lpc[FLAC_MAX_LPC_ORDER][FLAC_MAX_LPC_ORDER];
+    double errors[FLAC_MAX_LPC_ORDER];
+    double reflection_lpc[FLAC_MAX_LPC_ORDER];
+    double error = autocorrelation[0];
+    uint32_t order_count = 0;
+    for (uint32_t i = 0; i < max_order; i++)
+    {
+        double reflection = -autocorrelation[i + 1];
+        for (uint32_t j = 0; j < i; j++)
+        {
+            reflection -= reflection_lpc[j] * autocorrelation[i - j];
+        }
+        reflection /= error;
+
+        reflection_lpc[i] = reflection;
+        for (uint32_t j = 0; j < (i / 2); j++)
+        {
+            double tmp = reflection_lpc[j];
+            reflection_lpc[j] += reflection * reflection_lpc[i - 1 - j];
+            reflection_lpc[i - 1 - j] += reflection * tmp;
+        }
+        if ((i & 1) != 0)
+        {
+            reflection_lpc[i / 2] += reflection_lpc[i / 2] * reflection;
+        }
+        error *= 1.0 - (reflection * reflection);
+
+        // The predictor of order i + 1 predicts with the negated coefficients
+        for (uint32_t j = 0; j <= i; j++)
+        {
+            lpc[i][j] = -reflection_lpc[j];
+        }
+        errors[i] = error;
+        order_count = i + 1;
+        if (error <= 0.0)
+        {
+            break;
+        }
+    }
+
+    uint32_t order_first = 1;
+    uint32_t order_last = order_count;
+    if (level->exhaustive_lpc == 0)
+    {
+        // The order with the smallest expected size, from the bits per residual of Gaussian residuals with that error
+        double best_bits = 0.0;
+        for (uint32_t order = 1; order <= order_count; order++)
+        {
+            double residual_bits = (errors[order - 1] > 0.0) ? 0.5 * log2(0.5 * errors[order - 1] / block_size) : 0.0;
+            residual_bits = (residual_bits > 0.0) ? residual_bits : 0.0;
+            double bits = (residual_bits * (block_size - order)) + (order * (level->lpc_precision + plan->bits_per_sample));
+            if ((order == 1) || (bits < best_bits))
+            {
+                best_bits = bits;
+                order_first = order;
+            }
+        }
+        order_last = order_first;
+    }
+
+    flac_subframe_plan_t* candidate = &workspace->candidate;
+    for (uint32_t order = order_first; order <= order_last; order++)
+    {
+        candidate->type = FLAC_SUBFRAME_TYPE_LPC;
+        candidate->bits_per_sample = plan->bits_per_sample;
+        candidate->wasted_bits_per_sample = plan->wasted_bits_per_sample;
+        candidate->order = order;
+        candidate->precision = level->lpc_precision;
+        candidate->samples = plan->samples;
+        candidate->residuals = workspace->candidate_residuals;
+        if ((FLACEncoderQuantizeLPC(lpc[order - 1], order, candidate->precision, candidate->coefficients, &candidate->shift) == 0) ||
+            (FLACEncoderLPCResiduals(samples, block_size, candidate->coefficients, order, candidate->shift, candidate->precision, plan->bits_per_sample, candidate->residuals) == 0))
+        {
+            continue;
+        }
+        candidate->bit_count = header_bit_count + (order * plan->bits_per_sample) + 4 + 5 + (order * candidate->precision) +
+                               FLACEncoderPlanResidual(candidate, block_size, level->max_partition_order, workspace->partition_sums);
+        FLACEncoderTakeCandidate(workspace, plan);
+    }
+}
+
+// Picks the smallest encoding of the 'block_size' samples of one channel, whose samples are shifted in place if they have wasted bits
+static void FLACEncoderPlanSubframe(flac_encoder_workspace_t* workspace, const flac_encoder_level_t* level, int32_t* samples, uint32_t block_size, uint32_t bits_per_sample, flac_subframe_plan_t* plan)
+{
+    plan->samples = samples;
+    plan->wasted_bits_per_sample = 0;
+    plan->bits_per_sample = bits_per_sample;
+
+    uint32_t sample_bits = 0;
+    uint8_t is_constant = 1;
+    for (uint32_t i = 0; i < block_size; i++)
+    {
+        sample_bits |= (uint32_t)samples[i];
+        is_constant &= (samples[i] == samples[0]);
+    }
+    // SUBFRAME_HEADER: 1 padding bit, 6 type bits and 1 wasted bits flag
+    if (is_constant == 1)
+    {
+        plan->type = FLAC_SUBFRAME_TYPE_CONSTANT;
+        plan->bit_count = 8 + bits_per_sample;
+        return;
+    }
+
+    // Trailing 0-bits that every sample has are stored once in the header, followed by 'wasted_bits_per_sample' - 1 unary coded
+    uint32_t wasted_bits_per_sample = 0;
+    while (((sample_bits >> wasted_bits_per_sample) & 1) == 0)
+    {
+        wasted_bits_per_sample++;
+    }
+    if (wasted_bits_per_sample > 0)
+    {
+        for (uint32_t i = 0; i < block_size; i++)
+        {
+            samples[i] >>= wasted_bits_per_sample;
+        }
+    }
+    plan->wasted_bits_per_sample = wasted_bits_per_sample;
+    plan->bits_per_sample = bits_per_sample - wasted_bits_per_sample;
+    uint32_t header_bit_count = 8 + wasted_bits_per_sample;
+
+    plan->type = FLAC_SUBFRAME_TYPE_VERBATIM;
+    plan->bit_count = header_bit_count + ((uint64_t)block_size * plan->bits_per_sample);
+    FLACEncoderPlanFixed(workspace, level, block_size, header_bit_count, plan);
+    if (level->max_lpc_order > 0)
+    {
+        FLACEncoderPlanLPC(workspace, level, block_size, header_bit_count, plan);
+    }
+}
+
+static void FLACEncoderWriteSubframe(flac_bit_writer_t* writer, const flac_subframe_plan_t* plan, uint32_t block_size)
+{
+    uint32_t type_code = 0b000000;
+    switch (plan->type)
+    {
+        case FLAC_SUBFRAME_TYPE_CONSTANT: { type_code = 0b000000; } break;
+        case FLAC_SUBFRAME_TYPE_VERBATIM: { type_code = 0b000001; } break;
+        case FLAC_SUBFRAME_TYPE_FIXED:    { type_code = 0b001000 | plan->order; } break;
+        case FLAC_SUBFRAME_TYPE_LPC:      { type_code = 0b100000 | (plan->order - 1); } break;
+        default:
+        {
+            assert(0);
+        } break;
+    }
+    FLACBitWriterWrite(writer, 8, (type_code << 1) | ((plan->wasted_bits_per_sample > 0) ? 1 : 0));
+    if (plan->wasted_bits_per_sample > 0)
+    {
+        FLACBitWriterWrite(writer, plan->wasted_bits_per_sample - 1, 0);
+        FLACBitWriterWrite(writer, 1, 1);
+    }
+
+    uint32_t bits_per_sample = plan->bits_per_sample;
+    if (plan->type == FLAC_SUBFRAME_TYPE_CONSTANT)
+    {
+        FLACBitWriterWrite(writer, bits_per_sample, (uint32_t)plan->samples[0]);
+        return;
+    }
+    if (plan->type == FLAC_SUBFRAME_TYPE_VERBATIM)
+    {
+        for (uint32_t i = 0; i < block_size; i++)
+        {
+            FLACBitWriterWrite(writer, bits_per_sample, (uint32_t)plan->samples[i]);
+        }
+        return;
+    }
+
+    // Warm-up samples
+    for (uint32_t i = 0; i < plan->order; i++)
+    {
+        FLACBitWriterWrite(writer, bits_per_sample, (uint32_t)plan->samples[i]);
+    }
+    if (plan->type == FLAC_SUBFRAME_TYPE_LPC)
+    {
+        FLACBitWriterWrite(writer, 4, plan->precision - 1);
+        FLACBitWriterWrite(writer, 5, plan->shift);
+        for (uint32_t i = 0; i < plan->order; i++)
+        {
+            FLACBitWriterWrite(writer, plan->precision, (uint32_t)plan->coefficients[i]);
+        }
+    }
+
+    // RESIDUAL
+    FLACBitWriterWrite(writer, 2, (plan->rice_parameter_bits == 5) ? FLAC_RESIDUAL_TYPE_RICE2 : FLAC_RESIDUAL_TYPE_RICE);
+    FLACBitWriterWrite(writer, 4, plan->partition_order);
+    uint32_t partition_count = 0x1u << plan->partition_order;
+    uint32_t partition_size = block_size >> plan->partition_order;
+    const int32_t* residuals = plan->residuals;
+    for (uint32_t i = 0; i < partition_count; i++)
+    {
+        uint32_t count = partition_size - ((i == 0) ? plan->order : 0);
+        FLACBitWriterWrite(writer, plan->rice_parameter_bits, plan->rice_parameters[i]);
+        FLACBitWriterWriteRicePartition(writer, plan->rice_parameters[i], count, residuals);
+        residuals += count;
+    }
+}
+
+// Largest frame of 'block_size' samples, when every subframe is VERBATIM with the extra bit of a side channel
+static uint64_t FLACEncoderFrameSizeBound(const flac_encoder_input_t* input, uint32_t block_size)
+{
+    return FLAC_FRAME_HEADER_SIZE_MAX + FLAC_FRAME_FOOTER_SIZE + (input->channel_count * (1 + 4 + ((((uint64_t)block_size * (input->bits_per_sample + 1)) + 7) / 8)));
+}
+
+// Reads one block of interleaved samples into the workspace's planar channels, as signed samples
+static void FLACEncoderLoadBlock(flac_encoder_workspace_t* workspace, const flac_encoder_input_t* input, uint64_t sample_start, uint32_t block_size)
+{
+    uint32_t channel_count = input->channel_count;
+    uint32_t bytes_per_sample = input->bits_per_sample / 8;
+    const byte_t* bytes = input->samples + (sample_start * channel_count * bytes_per_sample);
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        int32_t* samples = workspace->channels[channel];
+        const byte_t* sample_bytes = bytes + (channel * bytes_per_sample);
+        uint32_t stride = channel_count * bytes_per_sample;
+        switch (bytes_per_sample)
+        {
+            case 1:
+            {
+                for (uint32_t i = 0; i < block_size; i++, sample_bytes += stride)
+                {
+                    samples[i] = (int32_t)sample_bytes[0] - 128;
+                }
+            } break;
+
+            case 2:
+            {
+                for (uint32_t i = 0; i < block_size; i++, sample_bytes += stride)
+                {
+                    samples[i] = (int16_t)(sample_bytes[0] | (sample_bytes[1] << 8));
+                }
+            } break;
+
+            case 3:
+            {
+                for (uint32_t i = 0; i < block_size; i++, sample_bytes += stride)
+                {
+                    // Sign-extend from the top of 32 bits
+                    samples[i] = (int32_t)(((uint32_t)sample_bytes[0] << 8) | ((uint32_t)sample_bytes[1] << 16) | ((uint32_t)sample_bytes[2] << 24)) >> 8;
+                }
+            } break;
+
+            default:
+            {
+                assert(0);
+            } break;
+        }
+    }
+}
+
+// Writes one frame of 'block_size' samples starting at sample 'frame_number' * level block size
+static void FLACEncoderWriteFrame(flac_encoder_workspace_t* workspace, const flac_encoder_input_t* input, const flac_encoder_level_t* level, uint32_t frame_number, uint32_t block_size, flac_bit_writer_t* writer)
+{
+    uint32_t channel_count = input->channel_count;
+    uint32_t bits_per_sample = input->bits_per_sample;
+    FLACEncoderLoadBlock(workspace, input, (uint64_t)frame_number * level->block_size, block_size);
+
+    // Mid and side are computed before any channel is shifted by its wasted bits
+    uint8_t try_stereo = (channel_count == 2) && (level->stereo == 1);
+    if (try_stereo == 1)
+    {
+        int32_t* left = workspace->channels[0];
+        int32_t* right = workspace->channels[1];
+        int32_t* mid = workspace->channels[2];
+        int32_t* side = workspace->channels[3];
+        for (uint32_t i = 0; i < block_size; i++)
+        {
+            mid[i] = (left[i] + right[i]) >> 1;
+            side[i] = left[i] - right[i];
+        }
+    }
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        FLACEncoderPlanSubframe(workspace, level, workspace->channels[channel], block_size, bits_per_sample, &workspace->plans[channel]);
+    }
+
+    // Channel assignment codes 0-7 are independent channels, 8 left/side, 9 side/right and 10 mid/side
+    uint32_t channel_assignment = channel_count - 1;
+    const flac_subframe_plan_t* subframes[FLAC_MAX_CHANNEL_COUNT];
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        subframes[channel] = &workspace->plans[channel];
+    }
+    if (try_stereo == 1)
+    {
+        flac_subframe_plan_t* left = &workspace->plans[0];
+        flac_subframe_plan_t* right = &workspace->plans[1];
+        flac_subframe_plan_t* mid = &workspace->plans[2];
+        flac_subframe_plan_t* side = &workspace->plans[3];
+        FLACEncoderPlanSubframe(workspace, level, workspace->channels[2], block_size, bits_per_sample, mid);
+        FLACEncoderPlanSubframe(workspace, level, workspace->channels[3], block_size, bits_per_sample + 1, side);
+
+        uint64_t best_bit_count = left->bit_count + right->bit_count;
+        if ((left->bit_count + side->bit_count) < best_bit_count)
+        {
+            best_bit_count = left->bit_count + side->bit_count;
+            channel_assignment = 8;
+            subframes[0] = left;
+            subframes[1] = side;
+        }
+        if ((side->bit_count + right->bit_count) < best_bit_count)
+        {
+            best_bit_count = side->bit_count + right->bit_count;
+            channel_assignment = 9;
+            subframes[0] = side;
+            subframes[1] = right;
+        }
+        if ((mid->bit_count + side->bit_count) < best_bit_count)
+        {
+            channel_assignment = 10;
+            subframes[0] = mid;
+            subframes[1] = side;
+        }
+    }
+
+    // FRAME_HEADER
+    // Block size codes: 0001 = 192, 0010-0101 = 576 * 2^(n-2), 1000-1111 = 256 * 2^(n-8), 0110/0111 = 8/16-bit size - 1 at the end of the header
+    uint64_t frame_start = writer->byte_count;
+    uint32_t block_size_code = 0b0111;
+    if (block_size == 192)
+    {
+        block_size_code = 0b0001;
+    }
+    else if ((block_size % 576 == 0) && ((block_size / 576) <= 8) && (((block_size / 576) & ((block_size / 576) - 1)) == 0))
+    {
+        block_size_code = 0b0010 + (63 - CountLeadingZeros64(block_size / 576));
+    }
+    else if ((block_size % 256 == 0) && ((block_size / 256) <= 128) && (((block_size / 256) & ((block_size / 256) - 1)) == 0))
+    {
+        block_size_code = 0b1000 + (63 - CountLeadingZeros64(block_size / 256));
+    }
+    else if (block_size <= 256)
+    {
+        block_size_code = 0b0110;
+    }
+    // Sample rate codes: 0001-1011 from a table, 1100 = 8-bit kHz, 1101 = 16-bit Hz, 1110 = 16-bit tens of Hz at the end of the header, 0000 = from STREAMINFO
+    static const uint32_t sample_rates[12] = { 0, 88200, 176400, 192000, 8000, 16000, 22050, 24000, 32000, 44100, 48000, 96000 };
+    uint32_t sample_rate = input->sample_rate;
+    uint32_t sample_rate_code = 0b0000;
+    for (uint32_t i = 1; i < 12; i++)
+    {
+        if (sample_rates[i] == sample_rate)
+        {
+            sample_rate_code = i;
+        }
+    }
+    if (sample_rate_code == 0b0000)
+    {
+        if ((sample_rate % 1000 == 0) && (sample_rate / 1000 <= 0xFF))
+        {
+            sample_rate_code = 0b1100;
+        }
+        else if (sample_rate <= 0xFFFF)
+        {
+            sample_rate_code = 0b1101;
+        }
+        else if ((sample_rate % 10 == 0) && (sample_rate / 10 <= 0xFFFF))
+        {
+            sample_rate_code = 0b1110;
+        }
+    }
+    // Sample size codes: 001 = 8, 100 = 16, 110 = 24 bits
+    uint32_t sample_size_code = (bits_per_sample == 8) ? 0b001 : ((bits_per_sample == 16) ? 0b100 : 0b110);
+    // 14 sync bits, 1 reserved bit and a fixed-blocksize blocking strategy
+    FLACBitWriterWrite(writer, 16, 0xFFF8);
+    FLACBitWriterWrite(writer, 4, block_size_code);
+    FLACBitWriterWrite(writer, 4, sample_rate_code);
+    FLACBitWriterWrite(writer, 4, channel_assignment);
+    FLACBitWriterWrite(writer, 3, sample_size_code);
+    FLACBitWriterWrite(writer, 1, 0);
+    FLACBitWriterWriteUTF8(writer, frame_number);
+    if (block_size_code == 0b0110)
+    {
+        FLACBitWriterWrite(writer, 8, block_size - 1);
+    }
+    else if (block_size_code == 0b0111)
+    {
+        FLACBitWriterWrite(writer, 16, block_size - 1);
+    }
+    if (sample_rate_code == 0b1100)
+    {
+        FLACBitWriterWrite(writer, 8, sample_rate / 1000);
+    }
+    else if (sample_rate_code == 0b1101)
+    {
+        FLACBitWriterWrite(writer, 16, sample_rate);
+    }
+    else if (sample_rate_code == 0b1110)
+    {
+        FLACBitWriterWrite(writer, 16, sample_rate / 10);
+    }
+    FLACBitWriterFlush(writer);
+    FLACBitWriterWrite(writer, 8, FLACCRC8(writer->bytes + frame_start, writer->byte_count - frame_start));
+
+    // SUBFRAMEs
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        FLACEncoderWriteSubframe(writer, subframes[channel], block_size);
+    }
+
+    // FRAME_FOOTER
+    FLACBitWriterAlign(writer);
+    FLACBitWriterWrite(writer, 16, FLACCRC16(writer->bytes + frame_start, writer->byte_count - frame_start));
+    FLACBitWriterFlush(writer);
+}
+
+static DWORD WINAPI FLACEncodeThreadProc(_In_ LPVOID lpParameter)
+{
+    flac_encoder_thread_t* thread = (flac_encoder_thread_t*)lpParameter;
+    const flac_encoder_input_t* input = thread->input;
+    const flac_encoder_level_t* level = thread->level;
+    uint32_t block_size = level->block_size;
+
+    flac_encoder_workspace_t workspace;
+    memset(&workspace, 0, sizeof(flac_encoder_workspace_t));
+    uint32_t channel_buffer_count = input->channel_count + ((input->channel_count == 2) ? 2 : 0);
+    int32_t* samples = (int32_t*)malloc((uint64_t)block_size * (channel_buffer_count * 2 + 1) * sizeof(int32_t));
+    for (uint32_t i = 0; i < channel_buffer_count; i++)
+    {
+        workspace.channels[i] = samples + ((uint64_t)i * block_size);
+        workspace.plans[i].residuals = samples + ((uint64_t)(channel_buffer_count + i) * block_size);
+    }
+    workspace.candidate_residuals = samples + ((uint64_t)channel_buffer_count * 2 * block_size);
+    workspace.partition_sums = (uint64_t*)malloc((1 << FLAC_ENCODER_MAX_PARTITION_ORDER) * sizeof(uint64_t));
+    workspace.window = (double*)malloc(block_size * 2 * sizeof(double));
+    workspace.windowed_samples = workspace.window + block_size;
+
+    uint64_t frame_size_bound = FLACEncoderFrameSizeBound(input, block_size);
+    flac_bit_writer_t writer = { 0 };
+    for (uint32_t frame_number = thread->frame_start; frame_number < thread->frame_end; frame_number++)
+    {
+        // Every frame is smaller than the bound, as a subframe is only coded if that's smaller than VERBATIM
+        if ((thread->byte_capacity - thread->byte_count) < frame_size_bound)
+        {
+            thread->byte_capacity = (thread->byte_capacity * 2) + frame_size_bound;
+            thread->bytes = (byte_t*)realloc(thread->bytes, thread->byte_capacity);
+        }
+        writer.bytes = thread->bytes;
+        writer.byte_count = thread->byte_count;
+
+        uint64_t sample_start = (uint64_t)frame_number * block_size;
+        uint64_t remaining_samples = input->sample_count - sample_start;
+        uint32_t frame_block_size = (remaining_samples < block_size) ? (uint32_t)remaining_samples : block_size;
+        FLACEncoderWriteFrame(&workspace, input, level, frame_number, frame_block_size, &writer);
+        thread->frame_sizes[frame_number] = (uint32_t)(writer.byte_count - thread->byte_count);
+        thread->byte_count = writer.byte_count;
+    }
+
+    free(samples);
+    free(workspace.partition_sums);
+    free(workspace.window);
+    return 0;
+}
+
+// Computes the MD5 of the samples as FLAC defines it: signed little-endian samples, so 8-bit samples are moved from unsigned
+static void FLACEncoderMD5(const flac_encoder_input_t* input, byte_t md5[16])
+{
+    md5_context_t context;
+    MD5Init(&context);
+    uint64_t byte_count = input->sample_count * input->channel_count * (input->bits_per_sample / 8);
+    if (input->bits_per_sample == 8)
+    {
+        byte_t signed_bytes[4096];
+        for (uint64_t offset = 0; offset < byte_count; offset += sizeof(signed_bytes))
+        {
+            uint64_t chunk_size = ((byte_count - offset) < sizeof(signed_bytes)) ? (byte_count - offset) : sizeof(signed_bytes);
+            for (uint64_t i = 0; i < chunk_size; i++)
+            {
+                signed_bytes[i] = input->samples[offset + i] ^ 0x80;
+            }
+            MD5Update(&context, signed_bytes, chunk_size);
+        }
+    }
+    else
+    {
+        MD5Update(&context, input->samples, byte_count);
+    }
+    MD5Final(&context, md5);
+}
+
+// METADATA_BLOCK_HEADER: 1 bit last-metadata-block flag, 7 bits type and 24 bits size
+static uint64_t FLACEncoderWriteMetadataBlockHeader(byte_t* bytes, flac_metadata_block_type_e type, uint8_t is_last, uint32_t size)
+{
+    bytes[0] = (byte_t)((is_last << 7) | type);
+    bytes[1] = (byte_t)(size >> 16);
+    bytes[2] = (byte_t)(size >> 8);
+    bytes[3] = (byte_t)size;
+    return 4;
+}
+
+static void FLACEncoderWriteBigEndian(byte_t* bytes, uint64_t value, uint32_t byte_count)
+{
+    for (uint32_t i = 0; i < byte_count; i++)
+    {
+        bytes[i] = (byte_t)(value >> (8 * (byte_count - 1 - i)));
+    }
+}
+
+flac_encoder_error_e FLACEncode(const flac_encoder_input_t* input, uint32_t level, uint32_t thread_count, FILE* output_file, uint64_t* output_size)
+{
+    assert(input != NULL);
+    assert(level <= FLAC_ENCODER_LEVEL_MAX);
+    assert(output_file != NULL);
+    assert(output_size != NULL);
+
+    if (((input->bits_per_sample != 8) && (input->bits_per_sample != 16) && (input->bits_per_sample != 24)) ||
+        (input->channel_count == 0) || (input->channel_count > FLAC_MAX_CHANNEL_COUNT) ||
+        (input->sample_rate == 0) || (input->sample_rate >= (1 << 20)) ||
+        (input->sample_count >= (1ull << 36)))
+    {
+        return FLAC_ENCODER_ERROR_UNSUPPORTED_FORMAT;
+    }
+    FLACCRCInit();
+
+    const flac_encoder_level_t* encoder_level = &flac_encoder_levels[level];
+    uint32_t block_size = encoder_level->block_size;
+    uint32_t frame_count = (uint32_t)((input->sample_count + block_size - 1) / block_size);
+    if (thread_count == 0)
+    {
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        thread_count = system_info.dwNumberOfProcessors;
+    }
+    if (thread_count > frame_count)
+    {
+        thread_count = (frame_count > 0) ? frame_count : 1;
+    }
+
+    // Each thread encodes an equal share of the frames, which start out in a buffer about the size of half their samples
+    uint32_t* frame_sizes = (uint32_t*)malloc(((uint64_t)frame_count + 1) * sizeof(uint32_t));
+    flac_encoder_thread_t* threads = (flac_encoder_thread_t*)calloc(thread_count, sizeof(flac_encoder_thread_t));
+    HANDLE* thread_handles = (HANDLE*)malloc(thread_count * sizeof(HANDLE));
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        threads[i].input = input;
+        threads[i].level = encoder_level;
+        threads[i].frame_start = (uint32_t)(((uint64_t)frame_count * i) / thread_count);
+        threads[i].frame_end = (uint32_t)(((uint64_t)frame_count * (i + 1)) / thread_count);
+        threads[i].frame_sizes = frame_sizes;
+        threads[i].byte_capacity = ((uint64_t)(threads[i].frame_end - threads[i].frame_start) * block_size * input->channel_count * (input->bits_per_sample / 8)) / 2;
+        threads[i].bytes = (byte_t*)malloc(threads[i].byte_capacity);
+        ThreadCreate(&FLACEncodeThreadProc, &threads[i], L"FLACEncodeThread", &thread_handles[i]);
+    }
+
+    flac_metadata_block_streaminfo_t streaminfo;
+    memset(&streaminfo, 0, sizeof(flac_metadata_block_streaminfo_t));
+    FLACEncoderMD5(input, streaminfo.md5);
+
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        WaitForSingleObject(thread_handles[i], INFINITE);
+        CloseHandle(thread_handles[i]);
+    }
+    free(thread_handles);
+
+    streaminfo.block_size_min = block_size;
+    streaminfo.block_size_max = block_size;
+    streaminfo.frame_size_min = (frame_count > 0) ? UINT32_MAX : 0;
+    for (uint32_t i = 0; i < frame_count; i++)
+    {
+        streaminfo.frame_size_min = (frame_sizes[i] < streaminfo.frame_size_min) ? frame_sizes[i] : streaminfo.frame_size_min;
+        streaminfo.frame_size_max = (frame_sizes[i] > streaminfo.frame_size_max) ? frame_sizes[i] : streaminfo.frame_size_max;
+    }
+
+    // SEEKTABLE: the frame that holds every 10th second, each point 18 bytes
+    uint64_t seek_point_interval = (uint64_t)input->sample_rate * FLAC_ENCODER_SEEK_POINT_SECONDS;
+    uint32_t seek_point_count = 0;
+    uint32_t last_seek_frame = UINT32_MAX;
+    for (uint64_t sample = 0; sample < input->sample_count; sample += seek_point_interval)
+    {
+        if ((uint32_t)(sample / block_size) != last_seek_frame)
+        {
+            last_seek_frame = (uint32_t)(sample / block_size);
+            seek_point_count++;
+        }
+    }
+    uint32_t vendor_length = (uint32_t)strlen(FLAC_ENCODER_VENDOR);
+    uint32_t vorbis_comment_size = 4 + vendor_length + 4;
+    uint64_t header_size = 4 + (4 + 34) + ((seek_point_count > 0) ? (4 + (18 * (uint64_t)seek_point_count)) : 0) + (4 + vorbis_comment_size);
+    byte_t* header = (byte_t*)malloc(header_size);
+    byte_t* bytes = header;
+
+    // "fLaC" marker
+    memcpy(bytes, "fLaC", 4);
+    bytes += 4;
+
+    // STREAMINFO
+    bytes += FLACEncoderWriteMetadataBlockHeader(bytes, FLAC_METADATA_BLOCK_TYPE_STREAMINFO, 0, 34);
+    FLACEncoderWriteBigEndian(bytes, streaminfo.block_size_min, 2);
+    FLACEncoderWriteBigEndian(bytes + 2, streaminfo.block_size_max, 2);
+    FLACEncoderWriteBigEndian(bytes + 4, streaminfo.frame_size_min, 3);
+    FLACEncoderWriteBigEndian(bytes + 7, streaminfo.frame_size_max, 3);
+    // 20 bits sample rate, 3 bits channel count - 1, 5 bits bits per sample - 1 and 36 bits sample count
+    uint64_t packed = ((uint64_t)input->sample_rate << 44) | ((uint64_t)(input->channel_count - 1) << 41) | ((uint64_t)(input->bits_per_sample - 1) << 36) | input->sample_count;
+    FLACEncoderWriteBigEndian(bytes + 10, packed, 8);
+    memcpy(bytes + 18, streaminfo.md5, 16);
+    bytes += 34;
+
+    // SEEKTABLE: sample number, offset from the first frame and sample count of each point's frame
+    if (seek_point_count > 0)
+    {
+        bytes += FLACEncoderWriteMetadataBlockHeader(bytes, FLAC_METADATA_BLOCK_TYPE_SEEKTABLE, 0, 18 * seek_point_count);
+        uint64_t frame_offset = 0;
+        uint32_t frame_number = 0;
+        last_seek_frame = UINT32_MAX;
+        for (uint64_t sample = 0; sample < input->sample_count; sample += seek_point_interval)
+        {
+            uint32_t seek_frame = (uint32_t)(sample / block_size);
+            if (seek_frame == last_seek_frame)
+            {
+                continue;
+            }
+            for (; frame_number < seek_frame; frame_number++)
+            {
+                frame_offset += frame_sizes[frame_number];
+            }
+            uint64_t seek_sample = (uint64_t)seek_frame * block_size;
+            uint64_t seek_sample_count = input->sample_count - seek_sample;
+            FLACEncoderWriteBigEndian(bytes, seek_sample, 8);
+            FLACEncoderWriteBigEndian(bytes + 8, frame_offset, 8);
+            FLACEncoderWriteBigEndian(bytes + 16, (seek_sample_count < block_size) ? seek_sample_count : block_size, 2);
+            bytes += 18;
+            last_seek_frame = seek_frame;
+        }
+    }
+
+    // VORBIS_COMMENT: little-endian vendor string length, vendor string and comment count
+    bytes += FLACEncoderWriteMetadataBlockHeader(bytes, FLAC_METADATA_BLOCK_TYPE_VORBIS_COMMENT, 1, vorbis_comment_size);
+    memcpy(bytes, &vendor_length, 4);
+    memcpy(bytes + 4, FLAC_ENCODER_VENDOR, vendor_length);
+    memset(bytes + 4 + vendor_length, 0, 4);
+    bytes += vorbis_comment_size;
+    assert((uint64_t)(bytes - header) == header_size);
+
+    flac_encoder_error_e error = FLAC_ENCODER_ERROR_NO;
+    *output_size = header_size;
+    if (fwrite(header, header_size, 1, output_file) != 1)
+    {
+        error = FLAC_ENCODER_ERROR_UNABLE_TO_WRITE;
+    }
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        if ((error == FLAC_ENCODER_ERROR_NO) && (threads[i].byte_count > 0))
+        {
+            if (fwrite(threads[i].bytes, threads[i].byte_count, 1, output_file) != 1)
+            {
+                error = FLAC_ENCODER_ERROR_UNABLE_TO_WRITE;
+            }
+            *output_size += threads[i].byte_count;
+        }
+        free(threads[i].bytes);
+    }
+    free(header);
+    free(threads);
+    free(frame_sizes);
+
+    return error;
+}
\ No newline at end of file
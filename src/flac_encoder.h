@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLAC_ENCODER_H
+#define FLAC_ENCODER_H
+
+#include "macros.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define FLAC_ENCODER_LEVEL_MIN     0
+#define FLAC_ENCODER_LEVEL_MAX     8
+#define FLAC_ENCODER_LEVEL_DEFAULT 5
+
+typedef enum
+{
+    FLAC_ENCODER_ERROR_NO                 = 0,
+    FLAC_ENCODER_ERROR_UNSUPPORTED_FORMAT = 1, // Sample size, channel count or sample rate that can't be encoded
+    FLAC_ENCODER_ERROR_UNABLE_TO_WRITE    = 2
+} flac_encoder_error_e;
+
+/**
+ * PCM samples to encode, laid out like the 'data' chunk of a WAV file: interleaved, little-endian, 8-bit samples
+ * unsigned and 16/24-bit samples signed.
+*/
+typedef struct
+{
+    uint32_t      sample_rate;
+    uint32_t      channel_count;
+    uint32_t      bits_per_sample; // 8, 16 or 24
+    uint64_t      sample_count; // Inter-channel samples
+    const byte_t* samples;
+} flac_encoder_input_t;
+
+/**
+ * Encodes 'input' into a FLAC stream written to 'output_file', and sets 'output_size' to the bytes written.
+ * 
+ * 'level' trades encoding time for compression like the reference encoder's levels, from FLAC_ENCODER_LEVEL_MIN (fixed
+ * predictors only, 1152-sample blocks) to FLAC_ENCODER_LEVEL_MAX (LPC up to order 12 with an exhaustive order search,
+ * 4096-sample blocks). Every level searches the Rice partition order and parameters per subframe, and from level 1 stereo
+ * input is stored as left/right, left/side, side/right or mid/side, whichever is smallest.
+ * 
+ * The blocks are split into 'thread_count' contiguous ranges that are encoded in parallel, while the calling thread
+ * computes the MD5 signature. A 'thread_count' of 0 starts one thread per logical processor. The stream has a fixed block
+ * size, a SEEKTABLE with a point about every 10 seconds, and an empty VORBIS_COMMENT.
+*/
+flac_encoder_error_e FLACEncode(const flac_encoder_input_t* input, uint32_t level, uint32_t thread_count, FILE* output_file, uint64_t* output_size);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,259 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac_index.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const byte_t flac_index_magic[8] = { 'B', 'r', 'a', 'g', 'i', 'I', 'd', 'x' };
+
+// Checks that the mapped sidecar was written for this FLAC file, and that its points can be trusted by FLACSeek()
+// Returns 0 if it is stale or damaged
+static uint8_t FLACIndexCheck(flac_index_t* index)
+{
+    const byte_t* bytes = index->file_map.bytes;
+    uint64_t size = index->file_map.size;
+    if (size < sizeof(flac_index_header_t))
+    {
+        return 0;
+    }
+
+    flac_index_header_t header;
+    memcpy(&header, bytes, sizeof(flac_index_header_t));
+    if ((memcmp(header.magic, flac_index_magic, sizeof(flac_index_magic)) != 0) ||
+        (header.version != FLAC_INDEX_VERSION) ||
+        (header.frame_interval == 0) ||
+        (header.file_size != index->file_size) ||
+        (header.file_modification_time != index->file_modification_time) ||
+        (header.audio_data_offset != index->audio_data_offset) ||
+        (header.sample_count != index->sample_count) ||
+        (header.point_count == 0) ||
+        (size != (sizeof(flac_index_header_t) + ((uint64_t)header.point_count * sizeof(flac_index_point_t)))))
+    {
+        return 0;
+    }
+
+    // Points must start at the first frame, and increase in both sample number and offset up to the end of the file
+    const flac_index_point_t* points = (const flac_index_point_t*)(bytes + sizeof(flac_index_header_t));
+    if ((points[0].sample_number != 0) || (points[0].stream_offset != 0))
+    {
+        return 0;
+    }
+    for (uint32_t i = 1; i < header.point_count; i++)
+    {
+        if ((points[i].sample_number <= points[i - 1].sample_number) ||
+            (points[i].stream_offset <= points[i - 1].stream_offset))
+        {
+            return 0;
+        }
+    }
+    if ((index->audio_data_offset + points[header.point_count - 1].stream_offset) >= index->file_size)
+    {
+        return 0;
+    }
+
+    index->points = points;
+    index->point_count = header.point_count;
+    return 1;
+}
+
+// Writes the recorded points to the sidecar. Failing to, e.g. in a read-only folder, only means there's no index next time.
+static void FLACIndexSave(flac_index_t* index)
+{
+    FILE* file = fopen(index->path, "wb");
+    if (file == NULL)
+    {
+        return;
+    }
+
+    flac_index_header_t header;
+    memset(&header, 0, sizeof(flac_index_header_t));
+    memcpy(header.magic, flac_index_magic, sizeof(flac_index_magic));
+    header.version = FLAC_INDEX_VERSION;
+    header.frame_interval = FLAC_INDEX_FRAME_INTERVAL;
+    header.file_size = index->file_size;
+    header.file_modification_time = index->file_modification_time;
+    header.audio_data_offset = index->audio_data_offset;
+    header.sample_count = index->sample_count;
+    header.point_count = index->recorded_point_count;
+    uint8_t written = (fwrite(&header, sizeof(flac_index_header_t), 1, file) == 1) &&
+                      (fwrite(index->recorded_points, sizeof(flac_index_point_t), index->recorded_point_count, file) == index->recorded_point_count);
+    if ((fclose(file) != 0) || (written == 0))
+    {
+        // A partial sidecar would fail FLACIndexCheck() anyway, but there's no reason to leave it around
+        remove(index->path);
+    }
+}
+
+void FLACIndexOpen(flac_index_t* index, const char* flac_file_path, uint64_t audio_data_offset, uint64_t sample_count, uint32_t block_size_min)
+{
+    assert(index != NULL);
+    assert(flac_file_path != NULL);
+
+    size_t flac_file_path_length = strlen(flac_file_path);
+    index->path = (char*)malloc(flac_file_path_length + sizeof(FLAC_INDEX_FILE_EXTENSION));
+    memcpy(index->path, flac_file_path, flac_file_path_length);
+    memcpy(index->path + flac_file_path_length, FLAC_INDEX_FILE_EXTENSION, sizeof(FLAC_INDEX_FILE_EXTENSION));
+    index->file_size = 0;
+    index->file_modification_time = 0;
+    index->audio_data_offset = audio_data_offset;
+    index->sample_count = sample_count;
+    index->points = NULL;
+    index->point_count = 0;
+    index->recording = 0;
+    index->recorded_points = NULL;
+    index->recorded_point_count = 0;
+    index->recorded_point_capacity = 0;
+    index->recorded_frame_count = 0;
+    index->recorded_sample_number = 0;
+    memset(&index->file_map, 0, sizeof(file_map_t));
+
+    // Without the FLAC file's size and last write time a sidecar can neither be checked nor written
+    if (FileGetInfo(flac_file_path, &index->file_size, &index->file_modification_time) == 0)
+    {
+        free(index->path);
+        index->path = NULL;
+        return;
+    }
+
+    if ((FileMap(index->path, &index->file_map) == 1) && (FLACIndexCheck(index) == 0))
+    {
+        FileUnmap(&index->file_map);
+    }
+    FLACIndexRecordStart(index);
+
+    // Room for a point per frame of even the shortest block size, so that recording doesn't allocate while decoding
+    if ((index->recording == 1) && (sample_count != 0) && (block_size_min != 0))
+    {
+        uint64_t frame_count_max = (sample_count + block_size_min - 1) / block_size_min;
+        uint64_t point_count_max = ((frame_count_max + FLAC_INDEX_FRAME_INTERVAL - 1) / FLAC_INDEX_FRAME_INTERVAL);
+        if (point_count_max > FLAC_INDEX_RECORD_CAPACITY_MAX)
+        {
+            point_count_max = FLAC_INDEX_RECORD_CAPACITY_MAX;
+        }
+        index->recorded_point_capacity = (uint32_t)point_count_max;
+        index->recorded_points = (flac_index_point_t*)malloc(index->recorded_point_capacity * sizeof(flac_index_point_t));
+    }
+}
+
+void FLACIndexRecordStart(flac_index_t* index)
+{
+    assert(index != NULL);
+
+    index->recording = (index->path != NULL) && (index->point_count == 0);
+    index->recorded_point_count = 0;
+    index->recorded_frame_count = 0;
+    index->recorded_sample_number = 0;
+}
+
+void FLACIndexRecordFrame(flac_index_t* index, uint64_t sample_number, uint32_t sample_count, uint64_t stream_offset)
+{
+    assert(index != NULL);
+
+    if (index->recording == 0)
+    {
+        return;
+    }
+    if (sample_number != index->recorded_sample_number)
+    {
+        // A frame was skipped
+        index->recording = 0;
+        return;
+    }
+
+    if ((index->recorded_frame_count % FLAC_INDEX_FRAME_INTERVAL) == 0)
+    {
+        // Only grows past what FLACIndexOpen() allocated if the stream's length isn't known, or it has a great many frames
+        if (index->recorded_point_count == index->recorded_point_capacity)
+        {
+            index->recorded_point_capacity = (index->recorded_point_capacity == 0) ? 1024 : (2 * index->recorded_point_capacity);
+            index->recorded_points = (flac_index_point_t*)realloc(index->recorded_points, index->recorded_point_capacity * sizeof(flac_index_point_t));
+        }
+        index->recorded_points[index->recorded_point_count].sample_number = sample_number;
+        index->recorded_points[index->recorded_point_count].stream_offset = stream_offset;
+        index->recorded_point_count++;
+    }
+    index->recorded_frame_count++;
+    index->recorded_sample_number += sample_count;
+}
+
+void FLACIndexRecordFinish(flac_index_t* index)
+{
+    assert(index != NULL);
+
+    // Only a recording of the whole stream is kept, which has to end at the length in STREAMINFO if it is known
+    if ((index->recording == 0) ||
+        (index->recorded_point_count == 0) ||
+        ((index->sample_count != 0) && (index->recorded_sample_number != index->sample_count)))
+    {
+        index->recording = 0;
+        return;
+    }
+    index->recording = 0;
+
+    FLACIndexSave(index);
+    index->points = index->recorded_points;
+    index->point_count = index->recorded_point_count;
+}
+
+uint8_t FLACIndexFind(const flac_index_t* index, uint64_t sample_index, uint64_t* stream_offset_low, uint64_t* stream_offset_high)
+{
+    assert(index != NULL);
+    assert(stream_offset_low != NULL);
+    assert(stream_offset_high != NULL);
+
+    if (index->point_count == 0)
+    {
+        return 0;
+    }
+
+    // First point after the sample, the first point is always sample 0
+    uint32_t low = 0;
+    uint32_t high = index->point_count;
+    while (low < high)
+    {
+        uint32_t middle = low + ((high - low) / 2);
+        if (index->points[middle].sample_number <= sample_index)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    *stream_offset_low = index->points[low - 1].stream_offset;
+    if (low < index->point_count)
+    {
+        *stream_offset_high = index->points[low].stream_offset;
+    }
+
+    return 1;
+}
+
+void FLACIndexFree(flac_index_t* index)
+{
+    assert(index != NULL);
+
+    FileUnmap(&index->file_map);
+    free(index->recorded_points);
+    free(index->path);
+}
\ No newline at end of file
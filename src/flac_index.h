@@ -0,0 +1,104 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLAC_INDEX_H
+#define FLAC_INDEX_H
+
+#include "macros.h"
+#include "windows_file.h"
+
+#include <stdint.h>
+
+#define FLAC_INDEX_FILE_EXTENSION ".bragi-index"
+#define FLAC_INDEX_VERSION 1
+// Frames per index point. With a point for every frame a seek decodes a single frame, and the index is still only 16
+// bytes per frame, a fraction of a percent of the FLAC file.
+#define FLAC_INDEX_FRAME_INTERVAL 1
+// Most points a recording allocates room for up front (16 MB), which only streams of a great many tiny frames come near
+#define FLAC_INDEX_RECORD_CAPACITY_MAX (1024 * 1024)
+
+typedef struct
+{
+    uint64_t sample_number; // First sample in the frame
+    uint64_t stream_offset; // Offset (in bytes) from the first byte of the first frame header to the first byte of the frame's header
+} flac_index_point_t;
+
+/**
+ * The layout of an index file, which is followed by 'point_count' flac_index_point_t sorted by sample number. It is
+ * written in the byte order of the machine, as it is only ever read back by the machine that wrote it.
+ * 
+ * The index belongs to the FLAC file with the same path minus FLAC_INDEX_FILE_EXTENSION, and is only valid for as long as
+ * that file's size and last write time match the ones it was written for.
+*/
+typedef struct
+{
+    byte_t   magic[8]; // "BragiIdx"
+    uint32_t version; // FLAC_INDEX_VERSION
+    uint32_t frame_interval; // Frames per index point
+    uint64_t file_size;
+    uint64_t file_modification_time;
+    uint64_t audio_data_offset; // File offset of the first frame
+    uint64_t sample_count; // From STREAMINFO, 0 if unknown
+    uint32_t point_count;
+    uint32_t reserved;
+} flac_index_header_t;
+
+/**
+ * The frame index of a FLAC stream, kept in a sidecar file next to it so that seeking doesn't have to bisect the file.
+ * 
+ * FLACIndexOpen() maps the sidecar into memory if there is one that is still valid for the FLAC file. A sidecar that is
+ * missing, stale or damaged is ignored, and a new one is recorded the next time the stream is decoded from its first
+ * frame to its last: each decoded frame is passed to FLACIndexRecordFrame(), and FLACIndexRecordFinish() writes the
+ * sidecar once the last frame is reached. Recording stops for good if a frame is skipped, e.g. by a seek or a damaged
+ * frame, until decoding is restarted from the first frame with FLACIndexRecordStart().
+ * 
+ * FLACIndexOpen() allocates the points of a recording for as many frames as 'sample_count' samples in blocks of
+ * 'block_size_min' can make up, so that recording makes no heap allocations while decoding.
+ * 
+ * FLACIndexFind() looks up the two index points around a sample.
+*/
+typedef struct
+{
+    char*                     path; // Of the sidecar
+    uint64_t                  file_size; // Of the FLAC file
+    uint64_t                  file_modification_time;
+    uint64_t                  audio_data_offset;
+    uint64_t                  sample_count;
+
+    // Points of the sidecar if a valid one was mapped, otherwise of the recording once it has finished
+    file_map_t                file_map;
+    const flac_index_point_t* points;
+    uint32_t                  point_count;
+
+    // Recording
+    uint8_t                   recording;
+    flac_index_point_t*       recorded_points;
+    uint32_t                  recorded_point_count;
+    uint32_t                  recorded_point_capacity;
+    uint32_t                  recorded_frame_count;
+    uint64_t                  recorded_sample_number; // First sample of the next frame expected
+} flac_index_t;
+
+void    FLACIndexOpen(flac_index_t* index, const char* flac_file_path, uint64_t audio_data_offset, uint64_t sample_count, uint32_t block_size_min);
+void    FLACIndexRecordStart(flac_index_t* index);
+void    FLACIndexRecordFrame(flac_index_t* index, uint64_t sample_number, uint32_t sample_count, uint64_t stream_offset);
+void    FLACIndexRecordFinish(flac_index_t* index);
+uint8_t FLACIndexFind(const flac_index_t* index, uint64_t sample_index, uint64_t* stream_offset_low, uint64_t* stream_offset_high);
+void    FLACIndexFree(flac_index_t* index);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,375 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpu.h"
+#include "flac.h"
+#include "flac_lpc.h"
+#include "macros.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Orders below this are faster with the unrolled scalar kernels than summing in vectors
+#define FLAC_LPC_SIMD_ORDER_MIN 16
+// The benchmark restores one block of this many 16-bit samples per order and kernel, that many times
+#define FLAC_LPC_BENCHMARK_SAMPLE_COUNT 4096
+#define FLAC_LPC_BENCHMARK_ITERATION_COUNT 200
+
+typedef void (*flac_lpc_restore_kernel_t)(const int32_t* residuals, const int32_t* coefficients, uint32_t shift, uint32_t sample_count, int32_t* samples);
+
+// Calls X(order) for every LPC order
+#define FLAC_LPC_ORDERS(X) \
+    X(1)  X(2)  X(3)  X(4)  X(5)  X(6)  X(7)  X(8)  X(9)  X(10) X(11) X(12) X(13) X(14) X(15) X(16) \
+    X(17) X(18) X(19) X(20) X(21) X(22) X(23) X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) X(32)
+
+// Unrolled multiply-accumulate of the first N taps, 'sum', 'c' and 'history' are declared by FLAC_LPC_RESTORE_KERNEL
+#define FLAC_LPC_TAP(j) sum += (accumulator_t)c[j] * history[-(j) - 1];
+#define FLAC_LPC_TAPS_1  FLAC_LPC_TAP(0)
+#define FLAC_LPC_TAPS_2  FLAC_LPC_TAPS_1  FLAC_LPC_TAP(1)
+#define FLAC_LPC_TAPS_3  FLAC_LPC_TAPS_2  FLAC_LPC_TAP(2)
+#define FLAC_LPC_TAPS_4  FLAC_LPC_TAPS_3  FLAC_LPC_TAP(3)
+#define FLAC_LPC_TAPS_5  FLAC_LPC_TAPS_4  FLAC_LPC_TAP(4)
+#define FLAC_LPC_TAPS_6  FLAC_LPC_TAPS_5  FLAC_LPC_TAP(5)
+#define FLAC_LPC_TAPS_7  FLAC_LPC_TAPS_6  FLAC_LPC_TAP(6)
+#define FLAC_LPC_TAPS_8  FLAC_LPC_TAPS_7  FLAC_LPC_TAP(7)
+#define FLAC_LPC_TAPS_9  FLAC_LPC_TAPS_8  FLAC_LPC_TAP(8)
+#define FLAC_LPC_TAPS_10 FLAC_LPC_TAPS_9  FLAC_LPC_TAP(9)
+#define FLAC_LPC_TAPS_11 FLAC_LPC_TAPS_10 FLAC_LPC_TAP(10)
+#define FLAC_LPC_TAPS_12 FLAC_LPC_TAPS_11 FLAC_LPC_TAP(11)
+#define FLAC_LPC_TAPS_13 FLAC_LPC_TAPS_12 FLAC_LPC_TAP(12)
+#define FLAC_LPC_TAPS_14 FLAC_LPC_TAPS_13 FLAC_LPC_TAP(13)
+#define FLAC_LPC_TAPS_15 FLAC_LPC_TAPS_14 FLAC_LPC_TAP(14)
+#define FLAC_LPC_TAPS_16 FLAC_LPC_TAPS_15 FLAC_LPC_TAP(15)
+#define FLAC_LPC_TAPS_17 FLAC_LPC_TAPS_16 FLAC_LPC_TAP(16)
+#define FLAC_LPC_TAPS_18 FLAC_LPC_TAPS_17 FLAC_LPC_TAP(17)
+#define FLAC_LPC_TAPS_19 FLAC_LPC_TAPS_18 FLAC_LPC_TAP(18)
+#define FLAC_LPC_TAPS_20 FLAC_LPC_TAPS_19 FLAC_LPC_TAP(19)
+#define FLAC_LPC_TAPS_21 FLAC_LPC_TAPS_20 FLAC_LPC_TAP(20)
+#define FLAC_LPC_TAPS_22 FLAC_LPC_TAPS_21 FLAC_LPC_TAP(21)
+#define FLAC_LPC_TAPS_23 FLAC_LPC_TAPS_22 FLAC_LPC_TAP(22)
+#define FLAC_LPC_TAPS_24 FLAC_LPC_TAPS_23 FLAC_LPC_TAP(23)
+#define FLAC_LPC_TAPS_25 FLAC_LPC_TAPS_24 FLAC_LPC_TAP(24)
+#define FLAC_LPC_TAPS_26 FLAC_LPC_TAPS_25 FLAC_LPC_TAP(25)
+#define FLAC_LPC_TAPS_27 FLAC_LPC_TAPS_26 FLAC_LPC_TAP(26)
+#define FLAC_LPC_TAPS_28 FLAC_LPC_TAPS_27 FLAC_LPC_TAP(27)
+#define FLAC_LPC_TAPS_29 FLAC_LPC_TAPS_28 FLAC_LPC_TAP(28)
+#define FLAC_LPC_TAPS_30 FLAC_LPC_TAPS_29 FLAC_LPC_TAP(29)
+#define FLAC_LPC_TAPS_31 FLAC_LPC_TAPS_30 FLAC_LPC_TAP(30)
+#define FLAC_LPC_TAPS_32 FLAC_LPC_TAPS_31 FLAC_LPC_TAP(31)
+
+// Defines a kernel for one order and accumulator width
+// The coefficients are copied to a local array, as stores to 'samples' could otherwise alias them and force a reload per tap
+#define FLAC_LPC_RESTORE_KERNEL(name, accumulator_type, order) \
+static void name(const int32_t* residuals, const int32_t* coefficients, uint32_t shift, uint32_t sample_count, int32_t* samples) \
+{ \
+    typedef accumulator_type accumulator_t; \
+    int32_t c[order]; \
+    memcpy(c, coefficients, sizeof(c)); \
+    for (uint32_t i = order; i < sample_count; i++) \
+    { \
+        const int32_t* history = samples + i; \
+        accumulator_t sum = 0; \
+        FLAC_LPC_TAPS_##order \
+        samples[i] = residuals[i - order] + (int32_t)(sum >> shift); \
+    } \
+}
+
+#define FLAC_LPC_RESTORE_KERNELS(order) \
+    FLAC_LPC_RESTORE_KERNEL(FLACLPCRestore32Order##order, int32_t, order) \
+    FLAC_LPC_RESTORE_KERNEL(FLACLPCRestore64Order##order, int64_t, order)
+FLAC_LPC_ORDERS(FLAC_LPC_RESTORE_KERNELS)
+
+#define FLAC_LPC_RESTORE_32_KERNEL_ENTRY(order) FLACLPCRestore32Order##order,
+#define FLAC_LPC_RESTORE_64_KERNEL_ENTRY(order) FLACLPCRestore64Order##order,
+// Indexed by order
+static const flac_lpc_restore_kernel_t flac_lpc_restore_32_kernels[FLAC_MAX_LPC_ORDER + 1] = { NULL, FLAC_LPC_ORDERS(FLAC_LPC_RESTORE_32_KERNEL_ENTRY) };
+static const flac_lpc_restore_kernel_t flac_lpc_restore_64_kernels[FLAC_MAX_LPC_ORDER + 1] = { NULL, FLAC_LPC_ORDERS(FLAC_LPC_RESTORE_64_KERNEL_ENTRY) };
+
+#ifdef CPU_X86
+// The recursion makes each sample depend on the one before it, so the SIMD kernels can't vectorize a single prediction
+// without stalling on the sample just stored. Instead they restore W samples at a time (W being the vector width):
+// for output i + m, the taps j >= m only reach samples before i, so those partial sums are computed for all W outputs
+// at once by broadcasting samples[i - t - 1] and multiplying with coefficients[t + m] in lane m. The remaining taps
+// j < m reach samples restored within the same group and are added in scalar.
+// Coefficients beyond the order are zero, so no lane needs masking. The partial sums wrap in 32 bits, which is harmless
+// as the full sum fits in 32 bits.
+TARGET_SSE41 static void FLACLPCRestore32SSE41(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t sample_count, int32_t* samples)
+{
+    int32_t padded_coefficients[FLAC_MAX_LPC_ORDER + 4] = { 0 };
+    memcpy(padded_coefficients, coefficients, order * sizeof(int32_t));
+
+    uint32_t i = order;
+    for (; (i + 4) <= sample_count; i += 4)
+    {
+        __m128i sum = _mm_setzero_si128();
+        for (uint32_t t = 0; t < order; t++)
+        {
+            __m128i history = _mm_set1_epi32(samples[i - t - 1]);
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(history, _mm_loadu_si128((const __m128i*)(padded_coefficients + t))));
+        }
+        int32_t partial_sums[4];
+        _mm_storeu_si128((__m128i*)partial_sums, sum);
+        for (uint32_t m = 0; m < 4; m++)
+        {
+            int32_t partial_sum = partial_sums[m];
+            uint32_t near_tap_count = (m < order) ? m : order;
+            for (uint32_t j = 0; j < near_tap_count; j++)
+            {
+                partial_sum += coefficients[j] * samples[i + m - j - 1];
+            }
+            samples[i + m] = residuals[i + m - order] + (partial_sum >> shift);
+        }
+    }
+
+    // Restore the remaining samples with the scalar kernel, offsetting the arrays so that sample 'i' is its first predicted sample
+    flac_lpc_restore_32_kernels[order](residuals + (i - order), coefficients, shift, sample_count - (i - order), samples + (i - order));
+}
+
+TARGET_AVX2 static void FLACLPCRestore32AVX2(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t sample_count, int32_t* samples)
+{
+    int32_t padded_coefficients[FLAC_MAX_LPC_ORDER + 8] = { 0 };
+    memcpy(padded_coefficients, coefficients, order * sizeof(int32_t));
+
+    uint32_t i = order;
+    for (; (i + 8) <= sample_count; i += 8)
+    {
+        __m256i sum = _mm256_setzero_si256();
+        for (uint32_t t = 0; t < order; t++)
+        {
+            __m256i history = _mm256_set1_epi32(samples[i - t - 1]);
+            sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(history, _mm256_loadu_si256((const __m256i*)(padded_coefficients + t))));
+        }
+        int32_t partial_sums[8];
+        _mm256_storeu_si256((__m256i*)partial_sums, sum);
+        for (uint32_t m = 0; m < 8; m++)
+        {
+            int32_t partial_sum = partial_sums[m];
+            uint32_t near_tap_count = (m < order) ? m : order;
+            for (uint32_t j = 0; j < near_tap_count; j++)
+            {
+                partial_sum += coefficients[j] * samples[i + m - j - 1];
+            }
+            samples[i + m] = residuals[i + m - order] + (partial_sum >> shift);
+        }
+    }
+
+    // Restore the remaining samples with the scalar kernel, offsetting the arrays so that sample 'i' is its first predicted sample
+    flac_lpc_restore_32_kernels[order](residuals + (i - order), coefficients, shift, sample_count - (i - order), samples + (i - order));
+}
+#endif
+
+void FLACLPCRestore(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t precision, uint32_t bits_per_sample, uint32_t sample_count, int32_t* samples)
+{
+    assert((order > 0) && (order <= FLAC_MAX_LPC_ORDER));
+    assert(order <= sample_count);
+
+    // Each product is below 2^(bits_per_sample - 1) * 2^(precision - 1) in magnitude, so the sum of 'order' of them
+    // is below 2^(bits_per_sample + precision + floor(log2(order)) - 1), which fits in an int32_t if that exponent is at most 31
+    uint32_t order_log2 = 63 - CountLeadingZeros64(order);
+    if ((bits_per_sample + precision + order_log2) <= 32)
+    {
+#ifdef CPU_X86
+        if (order >= FLAC_LPC_SIMD_ORDER_MIN)
+        {
+            const cpu_features_t* cpu_features = CPUGetFeatures();
+            if (cpu_features->avx2)
+            {
+                FLACLPCRestore32AVX2(residuals, coefficients, order, shift, sample_count, samples);
+                return;
+            }
+            if (cpu_features->sse41)
+            {
+                FLACLPCRestore32SSE41(residuals, coefficients, order, shift, sample_count, samples);
+                return;
+            }
+        }
+#endif
+        flac_lpc_restore_32_kernels[order](residuals, coefficients, shift, sample_count, samples);
+    }
+    else
+    {
+        flac_lpc_restore_64_kernels[order](residuals, coefficients, shift, sample_count, samples);
+    }
+}
+
+void FLACLPCRestoreReference(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t sample_count, int32_t* samples)
+{
+    for (uint32_t i = order; i < sample_count; i++)
+    {
+        int64_t sum = 0;
+        for (uint32_t j = 0; j < order; j++)
+        {
+            sum += (int64_t)coefficients[j] * (int64_t)samples[i - j - 1];
+        }
+        samples[i] = residuals[i - order] + (int32_t)(sum >> shift);
+    }
+}
+
+typedef enum
+{
+    FLAC_LPC_BENCHMARK_KERNEL_REFERENCE,
+    FLAC_LPC_BENCHMARK_KERNEL_ORDER_32, // Specialized for the order, summing in 32 bits
+    FLAC_LPC_BENCHMARK_KERNEL_ORDER_64, // Specialized for the order, summing in 64 bits
+    FLAC_LPC_BENCHMARK_KERNEL_SSE41,
+    FLAC_LPC_BENCHMARK_KERNEL_AVX2,
+    FLAC_LPC_BENCHMARK_KERNEL_COUNT
+} flac_lpc_benchmark_kernel_e;
+
+static const char* flac_lpc_benchmark_kernel_names[FLAC_LPC_BENCHMARK_KERNEL_COUNT] = { "Reference", "Order 32", "Order 64", "SSE4.1", "AVX2" };
+
+// Returns 1 if the kernel can run on this CPU
+static uint8_t FLACLPCBenchmarkHasKernel(flac_lpc_benchmark_kernel_e kernel)
+{
+#ifdef CPU_X86
+    const cpu_features_t* cpu_features = CPUGetFeatures();
+    if (kernel == FLAC_LPC_BENCHMARK_KERNEL_SSE41)
+    {
+        return cpu_features->sse41;
+    }
+    if (kernel == FLAC_LPC_BENCHMARK_KERNEL_AVX2)
+    {
+        return cpu_features->avx2;
+    }
+    return 1;
+#else
+    return (kernel < FLAC_LPC_BENCHMARK_KERNEL_SSE41);
+#endif
+}
+
+static void FLACLPCBenchmarkRestore(flac_lpc_benchmark_kernel_e kernel, const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t sample_count, int32_t* samples)
+{
+    switch (kernel)
+    {
+        case FLAC_LPC_BENCHMARK_KERNEL_REFERENCE: { FLACLPCRestoreReference(residuals, coefficients, order, shift, sample_count, samples); } break;
+        case FLAC_LPC_BENCHMARK_KERNEL_ORDER_32: { flac_lpc_restore_32_kernels[order](residuals, coefficients, shift, sample_count, samples); } break;
+        case FLAC_LPC_BENCHMARK_KERNEL_ORDER_64: { flac_lpc_restore_64_kernels[order](residuals, coefficients, shift, sample_count, samples); } break;
+#ifdef CPU_X86
+        case FLAC_LPC_BENCHMARK_KERNEL_SSE41: { FLACLPCRestore32SSE41(residuals, coefficients, order, shift, sample_count, samples); } break;
+        case FLAC_LPC_BENCHMARK_KERNEL_AVX2: { FLACLPCRestore32AVX2(residuals, coefficients, order, shift, sample_count, samples); } break;
+#endif
+        default: { assert(0); } break;
+    }
+}
+
+uint32_t FLACLPCBenchmark(void)
+{
+    // 16-bit samples: a few tones and noise, which every order is then fitted to
+    static int32_t signal[FLAC_LPC_BENCHMARK_SAMPLE_COUNT];
+    static int32_t residuals[FLAC_LPC_BENCHMARK_SAMPLE_COUNT];
+    static int32_t samples[FLAC_LPC_BENCHMARK_SAMPLE_COUNT];
+    uint32_t random = 0x9E3779B9u;
+    int32_t low_passed_noise = 0;
+    for (uint32_t i = 0; i < FLAC_LPC_BENCHMARK_SAMPLE_COUNT; i++)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        low_passed_noise += (((int32_t)(random & 0x3FFF) - 0x2000) - low_passed_noise) / 4;
+        // Triangle waves of two periods, to stay in integers
+        int32_t triangle_a = (int32_t)(i % 200);
+        triangle_a = (triangle_a < 100) ? triangle_a : (200 - triangle_a);
+        int32_t triangle_b = (int32_t)(i % 37);
+        triangle_b = (triangle_b < 18) ? triangle_b : (37 - triangle_b);
+        signal[i] = ((triangle_a - 50) * 300) + ((triangle_b - 9) * 400) + low_passed_noise;
+    }
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    uint32_t mismatch_count = 0;
+
+    printf("Million samples restored per second (%u 16-bit samples per block), '!' where a kernel differs from the reference\n", FLAC_LPC_BENCHMARK_SAMPLE_COUNT);
+    printf("%-6s", "Order");
+    for (uint32_t kernel = 0; kernel < FLAC_LPC_BENCHMARK_KERNEL_COUNT; kernel++)
+    {
+        printf(" %10s", flac_lpc_benchmark_kernel_names[kernel]);
+    }
+    printf(" %8s\n", "Speedup");
+    for (uint32_t order = 1; order <= FLAC_MAX_LPC_ORDER; order++)
+    {
+        // The largest coefficient precision that still lets the 32-bit kernels sum 16-bit samples, as in FLACLPCRestore()
+        uint32_t order_log2 = 63 - CountLeadingZeros64(order);
+        uint32_t precision = 32 - 16 - order_log2;
+        precision = (precision > 15) ? 15 : precision;
+        uint32_t shift = precision - 1;
+        int32_t coefficients[FLAC_MAX_LPC_ORDER];
+        for (uint32_t j = 0; j < order; j++)
+        {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+            // Taper off with distance, as an encoder's coefficients do, keeping them within 'precision' bits
+            int32_t coefficient_max = ((0x1 << (precision - 1)) - 1) / (int32_t)(j + 1);
+            coefficients[j] = (int32_t)(random % (uint32_t)((coefficient_max * 2) + 1)) - coefficient_max;
+        }
+        // Residuals that restore 'signal' exactly, so the samples never grow past 16 bits
+        for (uint32_t i = order; i < FLAC_LPC_BENCHMARK_SAMPLE_COUNT; i++)
+        {
+            int64_t sum = 0;
+            for (uint32_t j = 0; j < order; j++)
+            {
+                sum += (int64_t)coefficients[j] * (int64_t)signal[i - j - 1];
+            }
+            residuals[i - order] = signal[i] - (int32_t)(sum >> shift);
+        }
+
+        printf("%-6u", order);
+        uint8_t mismatch = 0;
+        double reference_rate = 0.0;
+        double best_rate = 0.0;
+        for (uint32_t kernel = 0; kernel < FLAC_LPC_BENCHMARK_KERNEL_COUNT; kernel++)
+        {
+            if (FLACLPCBenchmarkHasKernel((flac_lpc_benchmark_kernel_e)kernel) == 0)
+            {
+                printf(" %10s", "-");
+                continue;
+            }
+            memcpy(samples, signal, order * sizeof(int32_t));
+            memset(samples + order, 0, (FLAC_LPC_BENCHMARK_SAMPLE_COUNT - order) * sizeof(int32_t));
+            QueryPerformanceCounter(&timer_start);
+            for (uint32_t i = 0; i < FLAC_LPC_BENCHMARK_ITERATION_COUNT; i++)
+            {
+                FLACLPCBenchmarkRestore((flac_lpc_benchmark_kernel_e)kernel, residuals, coefficients, order, shift, FLAC_LPC_BENCHMARK_SAMPLE_COUNT, samples);
+            }
+            QueryPerformanceCounter(&timer_end);
+            double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+            double rate = (elapsed_seconds > 0.0) ? ((double)FLAC_LPC_BENCHMARK_SAMPLE_COUNT * FLAC_LPC_BENCHMARK_ITERATION_COUNT / elapsed_seconds / 1000000.0) : 0.0;
+            uint8_t kernel_mismatch = (memcmp(samples, signal, sizeof(signal)) != 0);
+            printf(" %9.1f%c", rate, (kernel_mismatch == 1) ? '!' : ' ');
+            mismatch |= kernel_mismatch;
+            if (kernel == FLAC_LPC_BENCHMARK_KERNEL_REFERENCE)
+            {
+                reference_rate = rate;
+            }
+            else if (rate > best_rate)
+            {
+                best_rate = rate;
+            }
+        }
+        // Of the fastest kernel over the reference
+        printf(" %7.2fx\n", (reference_rate > 0.0) ? (best_rate / reference_rate) : 0.0);
+        mismatch_count += mismatch;
+    }
+
+    printf("Mismatches: %u\n", mismatch_count);
+    return mismatch_count;
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLAC_LPC_H
+#define FLAC_LPC_H
+
+#include <stdint.h>
+
+/**
+ * Restores the samples of an LPC subframe from its residuals, predicting each sample from the 'order' samples before it:
+ * 
+ *   samples[i] = residuals[i - order] + ((coefficients[0] * samples[i - 1] + ... + coefficients[order - 1] * samples[i - order]) >> shift)
+ * 
+ * The first 'order' samples must already hold the warm-up samples. 'bits_per_sample' and 'precision' are the subframe's
+ * sample size and quantized coefficient precision, which decide whether the prediction can be summed in 32 bits.
+ * 
+ * FLACLPCRestore() dispatches to a kernel specialized for the order, and to SSE4.1/AVX2 kernels when the CPU has them.
+ * FLACLPCRestoreReference() is the plain 64-bit loop the kernels must match.
+ * 
+ * FLACLPCBenchmark() restores a block of 16-bit samples for every order with the reference and each kernel the CPU has,
+ * checks that they all give the same samples, and prints how many samples per second each one restores, and the speedup
+ * of the fastest kernel over the reference.
+ * Returns number of orders where a kernel gave different samples
+*/
+void FLACLPCRestore(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t precision, uint32_t bits_per_sample, uint32_t sample_count, int32_t* samples);
+void FLACLPCRestoreReference(const int32_t* residuals, const int32_t* coefficients, uint32_t order, uint32_t shift, uint32_t sample_count, int32_t* samples);
+uint32_t FLACLPCBenchmark(void);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,619 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpu.h"
+#include "flac_output.h"
+#include "macros.h"
+
+#include <assert.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+/**
+ * Each output sample to 16 bits is computed as:
+ * 
+ *   output = saturate(((sample << shift_left) + noise + round) >> shift_right)
+ * 
+ * where only one of the shifts is non-zero. Reducing to 16 bits rounds to nearest, and if dithered, 'noise' is the
+ * difference of two uniform random numbers of 'shift_right' bits, which has a triangular distribution over +-1 LSB of
+ * the output. Both numbers come from the halves of one xorshift32 step.
+*/
+typedef struct
+{
+    uint32_t shift_left;
+    uint32_t shift_right;
+    int32_t  round;
+    uint32_t noise_shift; // Shifts a 16-bit random number down to 'shift_right' bits
+} flac_output_int16_params_t;
+
+static flac_output_int16_params_t FLACOutputInt16Params(uint32_t bits_per_sample)
+{
+    flac_output_int16_params_t params = { 0, 0, 0, 16 };
+    if (bits_per_sample > 16)
+    {
+        params.shift_right = bits_per_sample - 16;
+        params.round = 1 << (params.shift_right - 1);
+        params.noise_shift = 16 - params.shift_right;
+    }
+    else
+    {
+        params.shift_left = 16 - bits_per_sample;
+    }
+    return params;
+}
+
+static inline uint32_t FLACDitherNext(uint32_t* state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void FLACDitherInit(flac_dither_t* dither)
+{
+    assert(dither != NULL);
+
+    // Any non-zero seeds will do, as long as they differ between lanes
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        dither->state[i] = 0x9E3779B9u * (i + 1);
+    }
+}
+
+// Undoes the decorrelation of one stereo sample
+static inline void FLACStereoSample(flac_stereo_e stereo, int32_t channel_0, int32_t channel_1, int32_t* left, int32_t* right)
+{
+    switch (stereo)
+    {
+        // LEFT = LEFT, RIGHT = LEFT - DIFF
+        case FLAC_STEREO_LEFT_DIFF:
+        {
+            *left = channel_0;
+            *right = channel_0 - channel_1;
+        } break;
+
+        // LEFT = RIGHT + DIFF, RIGHT = RIGHT
+        case FLAC_STEREO_DIFF_RIGHT:
+        {
+            *left = channel_1 + channel_0;
+            *right = channel_1;
+        } break;
+
+        // MID lost the lowest bit of LEFT + RIGHT, which is also the lowest bit of DIFF = LEFT - RIGHT, so
+        //  LEFT  = ((MID << 1) + DIFF) >> 1
+        //  RIGHT = ((MID << 1) - DIFF) >> 1
+        // with the bit restored
+        case FLAC_STEREO_MID_DIFF:
+        {
+            int32_t mid = (int32_t)(((uint32_t)channel_0 << 1) | (uint32_t)(channel_1 & 1));
+            *left = (mid + channel_1) >> 1;
+            *right = (mid - channel_1) >> 1;
+        } break;
+
+        default:
+        {
+            *left = channel_0;
+            *right = channel_1;
+        } break;
+    }
+}
+
+static inline int32_t FLACOutputLoadSample(const int32_t* const* channels, flac_stereo_e stereo, uint32_t channel, uint32_t index)
+{
+    if (stereo == FLAC_STEREO_INDEPENDENT)
+    {
+        return channels[channel][index];
+    }
+    int32_t left, right;
+    FLACStereoSample(stereo, channels[0][index], channels[1][index], &left, &right);
+    return (channel == 0) ? left : right;
+}
+
+// Converts samples [first_sample, sample_count) one at a time, for the channel counts and tails the SIMD kernels don't handle
+static void FLACOutputInt16Scalar(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, const flac_output_int16_params_t* params, uint32_t first_sample, uint32_t sample_count, flac_dither_t* dither, int16_t* output)
+{
+    output += first_sample * channel_count;
+    for (uint32_t i = first_sample; i < sample_count; i++)
+    {
+        for (uint32_t channel = 0; channel < channel_count; channel++)
+        {
+            int32_t sample = FLACOutputLoadSample(channels, stereo, channel, i) << params->shift_left;
+            if ((dither != NULL) && (params->shift_right > 0))
+            {
+                uint32_t random = FLACDitherNext(&dither->state[0]);
+                sample += (int32_t)((random & 0xFFFF) >> params->noise_shift) - (int32_t)((random >> 16) >> params->noise_shift);
+            }
+            sample = (sample + params->round) >> params->shift_right;
+            if (sample > INT16_MAX)
+            {
+                sample = INT16_MAX;
+            }
+            else if (sample < INT16_MIN)
+            {
+                sample = INT16_MIN;
+            }
+            *output = (int16_t)sample;
+            output++;
+        }
+    }
+}
+
+static void FLACOutputInt32Scalar(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t shift_left, uint32_t first_sample, uint32_t sample_count, int32_t* output)
+{
+    output += first_sample * channel_count;
+    for (uint32_t i = first_sample; i < sample_count; i++)
+    {
+        for (uint32_t channel = 0; channel < channel_count; channel++)
+        {
+            *output = (int32_t)((uint32_t)FLACOutputLoadSample(channels, stereo, channel, i) << shift_left);
+            output++;
+        }
+    }
+}
+
+static void FLACOutputFloat32Scalar(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, float scale, uint32_t first_sample, uint32_t sample_count, float* output)
+{
+    output += first_sample * channel_count;
+    for (uint32_t i = first_sample; i < sample_count; i++)
+    {
+        for (uint32_t channel = 0; channel < channel_count; channel++)
+        {
+            *output = (float)FLACOutputLoadSample(channels, stereo, channel, i) * scale;
+            output++;
+        }
+    }
+}
+
+#ifdef CPU_X86
+// The SIMD kernels convert whole vectors of samples of mono or stereo streams, and return how many samples they converted.
+// Stereo samples are decorrelated in registers, and interleaved by unpacking the left and right vectors into (left, right) pairs.
+TARGET_SSE2 static inline void FLACStereoDecorrelateSSE2(flac_stereo_e stereo, __m128i* channel_0, __m128i* channel_1)
+{
+    switch (stereo)
+    {
+        case FLAC_STEREO_LEFT_DIFF:
+        {
+            *channel_1 = _mm_sub_epi32(*channel_0, *channel_1);
+        } break;
+
+        case FLAC_STEREO_DIFF_RIGHT:
+        {
+            *channel_0 = _mm_add_epi32(*channel_1, *channel_0);
+        } break;
+
+        case FLAC_STEREO_MID_DIFF:
+        {
+            __m128i mid = _mm_or_si128(_mm_slli_epi32(*channel_0, 1), _mm_and_si128(*channel_1, _mm_set1_epi32(1)));
+            *channel_0 = _mm_srai_epi32(_mm_add_epi32(mid, *channel_1), 1);
+            *channel_1 = _mm_srai_epi32(_mm_sub_epi32(mid, *channel_1), 1);
+        } break;
+
+        default: {} break;
+    }
+}
+
+TARGET_SSE2 static inline __m128i FLACDitherNoiseSSE2(__m128i* state, __m128i noise_shift)
+{
+    __m128i x = *state;
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+    x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+    x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+    *state = x;
+    __m128i random_low = _mm_srl_epi32(_mm_and_si128(x, _mm_set1_epi32(0xFFFF)), noise_shift);
+    __m128i random_high = _mm_srl_epi32(_mm_srli_epi32(x, 16), noise_shift);
+    return _mm_sub_epi32(random_low, random_high);
+}
+
+TARGET_SSE2 static inline __m128i FLACOutputPrepareInt16SSE2(__m128i samples, __m128i shift_left, __m128i shift_right, __m128i round, __m128i* dither_state, __m128i noise_shift)
+{
+    samples = _mm_sll_epi32(samples, shift_left);
+    if (dither_state != NULL)
+    {
+        samples = _mm_add_epi32(samples, FLACDitherNoiseSSE2(dither_state, noise_shift));
+    }
+    return _mm_sra_epi32(_mm_add_epi32(samples, round), shift_right);
+}
+
+TARGET_SSE2 static uint32_t FLACOutputInt16SSE2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, const flac_output_int16_params_t* params, uint32_t sample_count, flac_dither_t* dither, int16_t* output)
+{
+    __m128i shift_left = _mm_cvtsi32_si128((int)params->shift_left);
+    __m128i shift_right = _mm_cvtsi32_si128((int)params->shift_right);
+    __m128i round = _mm_set1_epi32(params->round);
+    __m128i noise_shift = _mm_cvtsi32_si128((int)params->noise_shift);
+    __m128i dither_state_vector = _mm_setzero_si128();
+    __m128i* dither_state = NULL;
+    if ((dither != NULL) && (params->shift_right > 0))
+    {
+        dither_state_vector = _mm_loadu_si128((const __m128i*)dither->state);
+        dither_state = &dither_state_vector;
+    }
+
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            __m128i samples_0 = FLACOutputPrepareInt16SSE2(_mm_loadu_si128((const __m128i*)(channels[0] + i)), shift_left, shift_right, round, dither_state, noise_shift);
+            __m128i samples_1 = FLACOutputPrepareInt16SSE2(_mm_loadu_si128((const __m128i*)(channels[0] + i + 4)), shift_left, shift_right, round, dither_state, noise_shift);
+            _mm_storeu_si128((__m128i*)(output + i), _mm_packs_epi32(samples_0, samples_1));
+        }
+    }
+    else
+    {
+        for (; (i + 4) <= sample_count; i += 4)
+        {
+            __m128i left = _mm_loadu_si128((const __m128i*)(channels[0] + i));
+            __m128i right = _mm_loadu_si128((const __m128i*)(channels[1] + i));
+            FLACStereoDecorrelateSSE2(stereo, &left, &right);
+            left = FLACOutputPrepareInt16SSE2(left, shift_left, shift_right, round, dither_state, noise_shift);
+            right = FLACOutputPrepareInt16SSE2(right, shift_left, shift_right, round, dither_state, noise_shift);
+            _mm_storeu_si128((__m128i*)(output + (i * 2)), _mm_packs_epi32(_mm_unpacklo_epi32(left, right), _mm_unpackhi_epi32(left, right)));
+        }
+    }
+
+    if (dither_state != NULL)
+    {
+        _mm_storeu_si128((__m128i*)dither->state, dither_state_vector);
+    }
+    return i;
+}
+
+TARGET_SSE2 static uint32_t FLACOutputInt32SSE2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t shift_left, uint32_t sample_count, int32_t* output)
+{
+    __m128i shift = _mm_cvtsi32_si128((int)shift_left);
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 4) <= sample_count; i += 4)
+        {
+            _mm_storeu_si128((__m128i*)(output + i), _mm_sll_epi32(_mm_loadu_si128((const __m128i*)(channels[0] + i)), shift));
+        }
+    }
+    else
+    {
+        for (; (i + 4) <= sample_count; i += 4)
+        {
+            __m128i left = _mm_loadu_si128((const __m128i*)(channels[0] + i));
+            __m128i right = _mm_loadu_si128((const __m128i*)(channels[1] + i));
+            FLACStereoDecorrelateSSE2(stereo, &left, &right);
+            left = _mm_sll_epi32(left, shift);
+            right = _mm_sll_epi32(right, shift);
+            _mm_storeu_si128((__m128i*)(output + (i * 2)), _mm_unpacklo_epi32(left, right));
+            _mm_storeu_si128((__m128i*)(output + (i * 2) + 4), _mm_unpackhi_epi32(left, right));
+        }
+    }
+    return i;
+}
+
+TARGET_SSE2 static uint32_t FLACOutputFloat32SSE2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, float scale, uint32_t sample_count, float* output)
+{
+    __m128 scale_vector = _mm_set1_ps(scale);
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 4) <= sample_count; i += 4)
+        {
+            _mm_storeu_ps(output + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(channels[0] + i))), scale_vector));
+        }
+    }
+    else
+    {
+        for (; (i + 4) <= sample_count; i += 4)
+        {
+            __m128i left_samples = _mm_loadu_si128((const __m128i*)(channels[0] + i));
+            __m128i right_samples = _mm_loadu_si128((const __m128i*)(channels[1] + i));
+            FLACStereoDecorrelateSSE2(stereo, &left_samples, &right_samples);
+            __m128 left = _mm_mul_ps(_mm_cvtepi32_ps(left_samples), scale_vector);
+            __m128 right = _mm_mul_ps(_mm_cvtepi32_ps(right_samples), scale_vector);
+            _mm_storeu_ps(output + (i * 2), _mm_unpacklo_ps(left, right));
+            _mm_storeu_ps(output + (i * 2) + 4, _mm_unpackhi_ps(left, right));
+        }
+    }
+    return i;
+}
+
+// The AVX2 unpacks work within each 128-bit half, so the stereo kernels put the halves back in order with a permute.
+TARGET_AVX2 static inline void FLACStereoDecorrelateAVX2(flac_stereo_e stereo, __m256i* channel_0, __m256i* channel_1)
+{
+    switch (stereo)
+    {
+        case FLAC_STEREO_LEFT_DIFF:
+        {
+            *channel_1 = _mm256_sub_epi32(*channel_0, *channel_1);
+        } break;
+
+        case FLAC_STEREO_DIFF_RIGHT:
+        {
+            *channel_0 = _mm256_add_epi32(*channel_1, *channel_0);
+        } break;
+
+        case FLAC_STEREO_MID_DIFF:
+        {
+            __m256i mid = _mm256_or_si256(_mm256_slli_epi32(*channel_0, 1), _mm256_and_si256(*channel_1, _mm256_set1_epi32(1)));
+            *channel_0 = _mm256_srai_epi32(_mm256_add_epi32(mid, *channel_1), 1);
+            *channel_1 = _mm256_srai_epi32(_mm256_sub_epi32(mid, *channel_1), 1);
+        } break;
+
+        default: {} break;
+    }
+}
+
+TARGET_AVX2 static inline __m256i FLACDitherNoiseAVX2(__m256i* state, __m128i noise_shift)
+{
+    __m256i x = *state;
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 13));
+    x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 17));
+    x = _mm256_xor_si256(x, _mm256_slli_epi32(x, 5));
+    *state = x;
+    __m256i random_low = _mm256_srl_epi32(_mm256_and_si256(x, _mm256_set1_epi32(0xFFFF)), noise_shift);
+    __m256i random_high = _mm256_srl_epi32(_mm256_srli_epi32(x, 16), noise_shift);
+    return _mm256_sub_epi32(random_low, random_high);
+}
+
+TARGET_AVX2 static inline __m256i FLACOutputPrepareInt16AVX2(__m256i samples, __m128i shift_left, __m128i shift_right, __m256i round, __m256i* dither_state, __m128i noise_shift)
+{
+    samples = _mm256_sll_epi32(samples, shift_left);
+    if (dither_state != NULL)
+    {
+        samples = _mm256_add_epi32(samples, FLACDitherNoiseAVX2(dither_state, noise_shift));
+    }
+    return _mm256_sra_epi32(_mm256_add_epi32(samples, round), shift_right);
+}
+
+TARGET_AVX2 static uint32_t FLACOutputInt16AVX2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, const flac_output_int16_params_t* params, uint32_t sample_count, flac_dither_t* dither, int16_t* output)
+{
+    __m128i shift_left = _mm_cvtsi32_si128((int)params->shift_left);
+    __m128i shift_right = _mm_cvtsi32_si128((int)params->shift_right);
+    __m256i round = _mm256_set1_epi32(params->round);
+    __m128i noise_shift = _mm_cvtsi32_si128((int)params->noise_shift);
+    __m256i dither_state_vector = _mm256_setzero_si256();
+    __m256i* dither_state = NULL;
+    if ((dither != NULL) && (params->shift_right > 0))
+    {
+        dither_state_vector = _mm256_loadu_si256((const __m256i*)dither->state);
+        dither_state = &dither_state_vector;
+    }
+
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 16) <= sample_count; i += 16)
+        {
+            __m256i samples_0 = FLACOutputPrepareInt16AVX2(_mm256_loadu_si256((const __m256i*)(channels[0] + i)), shift_left, shift_right, round, dither_state, noise_shift);
+            __m256i samples_1 = FLACOutputPrepareInt16AVX2(_mm256_loadu_si256((const __m256i*)(channels[0] + i + 8)), shift_left, shift_right, round, dither_state, noise_shift);
+            // The pack interleaves the halves of its inputs, 0 2 1 3 puts them back in order
+            __m256i packed = _mm256_packs_epi32(samples_0, samples_1);
+            _mm256_storeu_si256((__m256i*)(output + i), _mm256_permute4x64_epi64(packed, 0xD8));
+        }
+    }
+    else
+    {
+        // Within each half, the pack gives 4 left samples followed by the 4 right samples, which the shuffle pairs up
+        __m256i interleave = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+                                              0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            __m256i left = _mm256_loadu_si256((const __m256i*)(channels[0] + i));
+            __m256i right = _mm256_loadu_si256((const __m256i*)(channels[1] + i));
+            FLACStereoDecorrelateAVX2(stereo, &left, &right);
+            left = FLACOutputPrepareInt16AVX2(left, shift_left, shift_right, round, dither_state, noise_shift);
+            right = FLACOutputPrepareInt16AVX2(right, shift_left, shift_right, round, dither_state, noise_shift);
+            _mm256_storeu_si256((__m256i*)(output + (i * 2)), _mm256_shuffle_epi8(_mm256_packs_epi32(left, right), interleave));
+        }
+    }
+
+    if (dither_state != NULL)
+    {
+        _mm256_storeu_si256((__m256i*)dither->state, dither_state_vector);
+    }
+    return i;
+}
+
+TARGET_AVX2 static uint32_t FLACOutputInt32AVX2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t shift_left, uint32_t sample_count, int32_t* output)
+{
+    __m128i shift = _mm_cvtsi32_si128((int)shift_left);
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            _mm256_storeu_si256((__m256i*)(output + i), _mm256_sll_epi32(_mm256_loadu_si256((const __m256i*)(channels[0] + i)), shift));
+        }
+    }
+    else
+    {
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            __m256i left = _mm256_loadu_si256((const __m256i*)(channels[0] + i));
+            __m256i right = _mm256_loadu_si256((const __m256i*)(channels[1] + i));
+            FLACStereoDecorrelateAVX2(stereo, &left, &right);
+            left = _mm256_sll_epi32(left, shift);
+            right = _mm256_sll_epi32(right, shift);
+            __m256i pairs_low = _mm256_unpacklo_epi32(left, right); // Pairs 0 1 | 4 5
+            __m256i pairs_high = _mm256_unpackhi_epi32(left, right); // Pairs 2 3 | 6 7
+            _mm256_storeu_si256((__m256i*)(output + (i * 2)), _mm256_permute2x128_si256(pairs_low, pairs_high, 0x20));
+            _mm256_storeu_si256((__m256i*)(output + (i * 2) + 8), _mm256_permute2x128_si256(pairs_low, pairs_high, 0x31));
+        }
+    }
+    return i;
+}
+
+TARGET_AVX2 static uint32_t FLACOutputFloat32AVX2(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, float scale, uint32_t sample_count, float* output)
+{
+    __m256 scale_vector = _mm256_set1_ps(scale);
+    uint32_t i = 0;
+    if (channel_count == 1)
+    {
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            _mm256_storeu_ps(output + i, _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(channels[0] + i))), scale_vector));
+        }
+    }
+    else
+    {
+        for (; (i + 8) <= sample_count; i += 8)
+        {
+            __m256i left_samples = _mm256_loadu_si256((const __m256i*)(channels[0] + i));
+            __m256i right_samples = _mm256_loadu_si256((const __m256i*)(channels[1] + i));
+            FLACStereoDecorrelateAVX2(stereo, &left_samples, &right_samples);
+            __m256 left = _mm256_mul_ps(_mm256_cvtepi32_ps(left_samples), scale_vector);
+            __m256 right = _mm256_mul_ps(_mm256_cvtepi32_ps(right_samples), scale_vector);
+            __m256 pairs_low = _mm256_unpacklo_ps(left, right); // Pairs 0 1 | 4 5
+            __m256 pairs_high = _mm256_unpackhi_ps(left, right); // Pairs 2 3 | 6 7
+            _mm256_storeu_ps(output + (i * 2), _mm256_permute2f128_ps(pairs_low, pairs_high, 0x20));
+            _mm256_storeu_ps(output + (i * 2) + 8, _mm256_permute2f128_ps(pairs_low, pairs_high, 0x31));
+        }
+    }
+    return i;
+}
+
+TARGET_SSE2 static uint32_t FLACStereoDecorrelateInPlaceSSE2(flac_stereo_e stereo, uint32_t sample_count, int32_t* channel_0, int32_t* channel_1)
+{
+    uint32_t i = 0;
+    for (; (i + 4) <= sample_count; i += 4)
+    {
+        __m128i samples_0 = _mm_loadu_si128((const __m128i*)(channel_0 + i));
+        __m128i samples_1 = _mm_loadu_si128((const __m128i*)(channel_1 + i));
+        FLACStereoDecorrelateSSE2(stereo, &samples_0, &samples_1);
+        _mm_storeu_si128((__m128i*)(channel_0 + i), samples_0);
+        _mm_storeu_si128((__m128i*)(channel_1 + i), samples_1);
+    }
+    return i;
+}
+
+TARGET_AVX2 static uint32_t FLACStereoDecorrelateInPlaceAVX2(flac_stereo_e stereo, uint32_t sample_count, int32_t* channel_0, int32_t* channel_1)
+{
+    uint32_t i = 0;
+    for (; (i + 8) <= sample_count; i += 8)
+    {
+        __m256i samples_0 = _mm256_loadu_si256((const __m256i*)(channel_0 + i));
+        __m256i samples_1 = _mm256_loadu_si256((const __m256i*)(channel_1 + i));
+        FLACStereoDecorrelateAVX2(stereo, &samples_0, &samples_1);
+        _mm256_storeu_si256((__m256i*)(channel_0 + i), samples_0);
+        _mm256_storeu_si256((__m256i*)(channel_1 + i), samples_1);
+    }
+    return i;
+}
+#endif
+
+void FLACOutputInt16(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, flac_dither_t* dither, int16_t* output)
+{
+    assert(channels != NULL);
+    assert((stereo == FLAC_STEREO_INDEPENDENT) || (channel_count == 2));
+    assert((bits_per_sample >= 4) && (bits_per_sample <= 24));
+    assert(output != NULL);
+
+    flac_output_int16_params_t params = FLACOutputInt16Params(bits_per_sample);
+    uint32_t i = 0;
+#ifdef CPU_X86
+    if (channel_count <= 2)
+    {
+        if (CPUGetFeatures()->avx2)
+        {
+            i = FLACOutputInt16AVX2(channels, channel_count, stereo, &params, sample_count, dither, output);
+        }
+        else
+        {
+            i = FLACOutputInt16SSE2(channels, channel_count, stereo, &params, sample_count, dither, output);
+        }
+    }
+#endif
+    FLACOutputInt16Scalar(channels, channel_count, stereo, &params, i, sample_count, dither, output);
+}
+
+void FLACOutputInt32(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, int32_t* output)
+{
+    assert(channels != NULL);
+    assert((stereo == FLAC_STEREO_INDEPENDENT) || (channel_count == 2));
+    assert((bits_per_sample >= 4) && (bits_per_sample <= 32));
+    assert(output != NULL);
+
+    uint32_t shift_left = 32 - bits_per_sample;
+    uint32_t i = 0;
+#ifdef CPU_X86
+    if (channel_count <= 2)
+    {
+        if (CPUGetFeatures()->avx2)
+        {
+            i = FLACOutputInt32AVX2(channels, channel_count, stereo, shift_left, sample_count, output);
+        }
+        else
+        {
+            i = FLACOutputInt32SSE2(channels, channel_count, stereo, shift_left, sample_count, output);
+        }
+    }
+#endif
+    FLACOutputInt32Scalar(channels, channel_count, stereo, shift_left, i, sample_count, output);
+}
+
+void FLACOutputFloat32(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, float* output)
+{
+    assert(channels != NULL);
+    assert((stereo == FLAC_STEREO_INDEPENDENT) || (channel_count == 2));
+    assert((bits_per_sample >= 4) && (bits_per_sample <= 24)); // Larger samples don't fit exactly in a float
+    assert(output != NULL);
+
+    float scale = 1.0f / (float)(1u << (bits_per_sample - 1));
+    uint32_t i = 0;
+#ifdef CPU_X86
+    if (channel_count <= 2)
+    {
+        if (CPUGetFeatures()->avx2)
+        {
+            i = FLACOutputFloat32AVX2(channels, channel_count, stereo, scale, sample_count, output);
+        }
+        else
+        {
+            i = FLACOutputFloat32SSE2(channels, channel_count, stereo, scale, sample_count, output);
+        }
+    }
+#endif
+    FLACOutputFloat32Scalar(channels, channel_count, stereo, scale, i, sample_count, output);
+}
+
+void FLACStereoDecorrelate(flac_stereo_e stereo, uint32_t sample_count, int32_t* channel_0, int32_t* channel_1)
+{
+    assert(channel_0 != NULL);
+    assert(channel_1 != NULL);
+
+    if (stereo == FLAC_STEREO_INDEPENDENT)
+    {
+        return;
+    }
+
+    uint32_t i = 0;
+#ifdef CPU_X86
+    if (CPUGetFeatures()->avx2)
+    {
+        i = FLACStereoDecorrelateInPlaceAVX2(stereo, sample_count, channel_0, channel_1);
+    }
+    else
+    {
+        i = FLACStereoDecorrelateInPlaceSSE2(stereo, sample_count, channel_0, channel_1);
+    }
+#endif
+    for (; i < sample_count; i++)
+    {
+        FLACStereoSample(stereo, channel_0[i], channel_1[i], &channel_0[i], &channel_1[i]);
+    }
+}
\ No newline at end of file
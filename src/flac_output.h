@@ -0,0 +1,62 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef FLAC_OUTPUT_H
+#define FLAC_OUTPUT_H
+
+#include <stdint.h>
+
+// Random number generators for TPDF dither, one per SIMD lane
+typedef struct
+{
+    uint32_t state[8];
+} flac_dither_t;
+
+// Inter-channel decorrelation of a stereo frame, undone while converting it to the output format
+typedef enum
+{
+    FLAC_STEREO_INDEPENDENT = 0,
+    FLAC_STEREO_LEFT_DIFF = 1, // Channel 0 is left, channel 1 is left - right
+    FLAC_STEREO_DIFF_RIGHT = 2, // Channel 0 is left - right, channel 1 is right
+    FLAC_STEREO_MID_DIFF = 3 // Channel 0 is (left + right) >> 1, channel 1 is left - right
+} flac_stereo_e;
+
+/**
+ * Convert 'sample_count' samples of each of 'channel_count' planar channels of 'bits_per_sample' bits, and interleave them
+ * into 'output' in the sample format the sink plays back:
+ * 
+ *  - FLACOutputInt16() shifts the samples to 16 bits. Samples of more than 16 bits are rounded, after adding TPDF dither
+ *    of +-1 LSB of the output if 'dither' isn't NULL, and saturated.
+ *  - FLACOutputInt32() shifts the samples into the most significant bits, e.g. 24-bit samples into 24-in-32.
+ *  - FLACOutputFloat32() scales the samples to [-1, 1) with a single multiply by the reciprocal of full scale.
+ * 
+ * Stereo channels are decorrelated according to 'stereo' in the same pass, straight from the decoded subframes, so no
+ * intermediate buffer is written. 'bits_per_sample' is that of the output channels, not of a side channel.
+ * 
+ * Mono and stereo are converted by SSE2 kernels, and AVX2 kernels when the CPU has them. Other channel counts are converted
+ * one sample at a time.
+ * 
+ * FLACStereoDecorrelate() undoes the decorrelation in place instead, for consumers of planar samples.
+*/
+void FLACDitherInit(flac_dither_t* dither);
+void FLACOutputInt16(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, flac_dither_t* dither, int16_t* output);
+void FLACOutputInt32(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, int32_t* output);
+void FLACOutputFloat32(const int32_t* const* channels, uint32_t channel_count, flac_stereo_e stereo, uint32_t bits_per_sample, uint32_t sample_count, float* output);
+void FLACStereoDecorrelate(flac_stereo_e stereo, uint32_t sample_count, int32_t* channel_0, int32_t* channel_1);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "index.h"
+#include "playlist.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint32_t IndexPlaylist(char* playlist_file_path)
+{
+    assert(playlist_file_path != NULL);
+
+    playlist_t playlist;
+    PlaylistInit(&playlist);
+    playlist_error_e playlist_error = PlaylistLoad(playlist_file_path, &playlist);
+    switch (playlist_error)
+    {
+        case PLAYLIST_ERROR_NO: {} break;
+
+        case PLAYLIST_ERROR_UNABLE_TO_OPEN_FILE:
+        {
+            printf("Unable to open playlist: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        case PLAYLIST_ERROR_EMPTY:
+        {
+            printf("Playlist file is empty: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid error returned from PlaylistLoad()\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        } break;
+    }
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+
+    uint32_t indexed_count = 0;
+    uint32_t up_to_date_count = 0;
+    uint32_t error_count = 0;
+    uint32_t skipped_count = 0;
+    for (uint64_t i = 0; i < playlist.song_count; i++)
+    {
+        song_t* song = &playlist.songs[i];
+        if (song->song_type != SONG_TYPE_FLAC)
+        {
+            skipped_count++;
+            continue;
+        }
+        // Virtual tracks of a file share its path, and the file is indexed once for its first track
+        if ((i > 0) && (song->song_path_offset == playlist.songs[i - 1].song_path_offset))
+        {
+            continue;
+        }
+
+        if (FLACLoadHeader(song) != SONG_ERROR_NO)
+        {
+            printf("ERROR     %s\n", song->song_path_offset);
+            error_count++;
+            continue;
+        }
+
+        // A valid sidecar is mapped when the file is opened
+        if (song->flac->index.point_count > 0)
+        {
+            up_to_date_count++;
+        }
+        else if (FLACBuildIndex(song->flac) == 1)
+        {
+            indexed_count++;
+        }
+        else
+        {
+            // Frame headers are damaged or missing, so the frames can't all be found without decoding them
+            printf("FAILED    %s\n", song->song_path_offset);
+            error_count++;
+        }
+        SongFreeAudioData(song);
+    }
+
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+    PlaylistFree(&playlist);
+
+    printf("\n");
+    printf("Indexed:        %u\n", indexed_count);
+    printf("Up to date:     %u\n", up_to_date_count);
+    printf("Errors:         %u\n", error_count);
+    printf("Skipped:        %u (not FLAC)\n", skipped_count);
+    printf("Time:           %.2f s\n", elapsed_seconds);
+
+    return error_count;
+}
\ No newline at end of file
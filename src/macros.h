@@ -22,9 +22,44 @@
 #include <stdint.h>
 
 #ifdef _MSC_VER
+#include <intrin.h>
+#include <stdlib.h>
 #define PACK( __Declaration__ ) __pragma( pack(push, 1) ) __Declaration__ __pragma( pack(pop))
+#define BYTE_SWAP_64(value) _byteswap_uint64(value)
+// MSVC allows any instruction set's intrinsics in any function
+#define TARGET_SSE2
+#define TARGET_SSE41
+#define TARGET_AVX2
+#define TARGET_PCLMUL
+#else
+#define BYTE_SWAP_64(value) __builtin_bswap64(value)
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_PCLMUL __attribute__((target("sse4.1,pclmul")))
 #endif
 
+// Number of 0-bits above the most significant 1-bit, 'value' must not be 0
+static inline uint32_t CountLeadingZeros64(uint64_t value)
+{
+#if defined(_MSC_VER) && defined(_M_IX86)
+    // No 64-bit bit scan on 32-bit x86
+    unsigned long index;
+    if (_BitScanReverse(&index, (unsigned long)(value >> 32)))
+    {
+        return 31 - (uint32_t)index;
+    }
+    _BitScanReverse(&index, (unsigned long)value);
+    return 63 - (uint32_t)index;
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, value);
+    return 63 - (uint32_t)index;
+#else
+    return (uint32_t)__builtin_clzll(value);
+#endif
+}
+
 #define ASSERT_NEQUAL(value, expected_value) if (value != expected_value) { printf("ASSERT failed: %s:%u\n", __FILE__, __LINE__); exit(EXIT_FAILURE); }
 #define ASSERT_EQUAL(value, expected_value) if (value == expected_value) { printf("ASSERT failed: %s:%u\n", __FILE__, __LINE__); exit(EXIT_FAILURE); }
 
@@ -16,13 +16,26 @@
  * OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "analyzer.h"
 #include "dft.h"
+#include "fft_vulkan.h"
+#include "flac.h"
+#include "flac_encoder.h"
+#include "flac_lpc.h"
 #include "playlist.h"
 #include "scene_columns.h"
 #include "scene_ui.h"
 #include "sound_player.h"
 // https://nothings.org/stb/font/
 #include "stb_font/stb_font_consolas_24_usascii.inl"
+#include "alloc_test.h"
+#include "decode_benchmark.h"
+#include "index.h"
+#include "probe.h"
+#include "sample_convert.h"
+#include "stream_test.h"
+#include "transcode.h"
+#include "verify.h"
 #include "vulkan_engine.h"
 // https://stackoverflow.com/questions/57137351/line-is-not-constexpr-in-msvc
 //#include "tracy-0.7.8/Tracy.hpp"
@@ -53,6 +66,93 @@ int main(int argc, char** argv)
     HRESULT hres_tmp = EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &devices);
     exit(EXIT_SUCCESS);*/
 
+    // Verify a playlist's FLAC files without opening a window: verify <path to playlist> [thread count]
+    if ((argc >= 3) && (strcmp(argv[1], "verify") == 0))
+    {
+        uint32_t thread_count = 0;
+        if (argc >= 4)
+        {
+            thread_count = (uint32_t)atoi(argv[3]);
+        }
+        uint32_t failed_count = VerifyPlaylist(argv[2], thread_count);
+        return (failed_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // List a playlist's FLAC files from their metadata without opening a window: probe <path to playlist>
+    if ((argc >= 3) && (strcmp(argv[1], "probe") == 0))
+    {
+        uint32_t failed_count = ProbePlaylist(argv[2]);
+        return (failed_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Write the frame index sidecars of a playlist's FLAC files without opening a window: index <path to playlist>
+    if ((argc >= 3) && (strcmp(argv[1], "index") == 0))
+    {
+        uint32_t failed_count = IndexPlaylist(argv[2]);
+        return (failed_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Encode a playlist's WAV files to FLAC without opening a window: transcode <path to playlist> [compression level] [thread count]
+    if ((argc >= 3) && (strcmp(argv[1], "transcode") == 0))
+    {
+        uint32_t level = FLAC_ENCODER_LEVEL_DEFAULT;
+        uint32_t thread_count = 0;
+        if (argc >= 4)
+        {
+            level = (uint32_t)atoi(argv[3]);
+        }
+        if (argc >= 5)
+        {
+            thread_count = (uint32_t)atoi(argv[4]);
+        }
+        uint32_t failed_count = TranscodePlaylist(argv[2], level, thread_count);
+        return (failed_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Check that decoding a FLAC file makes no heap allocations once it has been set up: alloc_test <path to FLAC file>
+    if ((argc >= 3) && (strcmp(argv[1], "alloc_test") == 0))
+    {
+        uint32_t heap_call_count = AllocTestFile(argv[2]);
+        return (heap_call_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Check that pushing a FLAC file into a stream decoder in slices of any size decodes it bit-exact: stream_test <path to FLAC file>
+    if ((argc >= 3) && (strcmp(argv[1], "stream_test") == 0))
+    {
+        uint32_t failed_count = StreamTestFile(argv[2]);
+        return (failed_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Time decoding a FLAC file on every thread count up to the given one: decode_benchmark <path to FLAC file> [max thread count]
+    if ((argc >= 3) && (strcmp(argv[1], "decode_benchmark") == 0))
+    {
+        uint32_t thread_count_max = 0;
+        if (argc >= 4)
+        {
+            thread_count_max = (uint32_t)atoi(argv[3]);
+        }
+        uint32_t mismatch_count = DecodeBenchmarkFile(argv[2], thread_count_max);
+        return (mismatch_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Time the FFT the visualizer computes its bands with against the DFT it replaced: dft_benchmark
+    if ((argc >= 2) && (strcmp(argv[1], "dft_benchmark") == 0))
+    {
+        uint32_t mismatch_count = DFTBenchmark();
+        return (mismatch_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Time the bit reader FLAC residuals are decoded with against the one it replaced: bitreader_benchmark
+    if ((argc >= 2) && (strcmp(argv[1], "bitreader_benchmark") == 0))
+    {
+        uint32_t mismatch_count = FLACBitReaderBenchmark();
+        return (mismatch_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Time the LPC restore kernels for every order, and check them against the reference loop: lpc_benchmark
+    if ((argc >= 2) && (strcmp(argv[1], "lpc_benchmark") == 0))
+    {
+        uint32_t mismatch_count = FLACLPCBenchmark();
+        return (mismatch_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+    // Time the sample format conversion kernels, and check them against each other: convert_benchmark
+    if ((argc >= 2) && (strcmp(argv[1], "convert_benchmark") == 0))
+    {
+        uint32_t mismatch_count = SampleConvertBenchmark();
+        return (mismatch_count == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
     // Name main thread
     wchar_t thread_main_name[] = L"bragi_main_thread";
     HRESULT hres = SetThreadDescription(GetCurrentThread(), thread_main_name);
@@ -93,6 +193,12 @@ int main(int argc, char** argv)
     //////////////
     uint8_t ui_command_line_showing = 0;
     uint8_t viz_enabled = 0;
+    // Visualizer analysis, which is changed between frames
+    uint32_t viz_size = DFTGetN();
+    dft_window_e viz_window = DFTGetWindow();
+    uint32_t viz_hop = STFT_DEFAULT_HOP;
+    uint8_t viz_gpu = 0; // Frames are transformed on the GPU instead of on the analysis thread
+    uint8_t viz_analysis_changed = 0;
 
 
 
@@ -100,8 +206,6 @@ int main(int argc, char** argv)
     //////////////
     // DFT DATA //
     //////////////
-    DWORD dft_previous_frame_sample_position = 0;
-    DWORD dft_current_frame_sample_position = 0;
     // DFT buffers
     VkBuffer* dft_storage_buffers = (VkBuffer*)malloc(VULKAN_MAX_FRAMES_IN_FLIGHT * sizeof(VkBuffer));
     VkDeviceMemory* dft_storage_buffer_memories = (VkDeviceMemory*)malloc(VULKAN_MAX_FRAMES_IN_FLIGHT * sizeof(VkDeviceMemory));
@@ -109,8 +213,8 @@ int main(int argc, char** argv)
     {
         dft_storage_buffers[i] = VK_NULL_HANDLE;
         dft_storage_buffer_memories[i] = VK_NULL_HANDLE;
-        // Initialized to 0
-        VulkanCreateBuffer(&vulkan, NULL, DFT_FREQUENCY_BAND_COUNT * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &dft_storage_buffers[i], &dft_storage_buffer_memories[i], NULL, NULL);
+        // Initialized to 0. The columns, followed by the bands the GPU copies in when it transforms the frames
+        VulkanCreateBuffer(&vulkan, NULL, (FFT_VULKAN_COPIED_BANDS_OFFSET + DFT_MAX_FREQUENCY_BAND_COUNT) * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &dft_storage_buffers[i], &dft_storage_buffer_memories[i], NULL, NULL);
         
         memset(vulkan.vulkan_object_name, 0, 128);
         sprintf(vulkan.vulkan_object_name, "DFT Storage Buffer ");
@@ -121,11 +225,18 @@ int main(int argc, char** argv)
         sprintf(vulkan.vulkan_object_name + 26, "%u", i);
         VulkanSetObjectName(&vulkan, VK_OBJECT_TYPE_DEVICE_MEMORY, (uint64_t)dft_storage_buffer_memories[i], vulkan.vulkan_object_name);
     }
-    HANDLE dft_current_playback_buffer_shared_shared_mutex = CreateMutexA(NULL, FALSE, "CurrentPlaybackBufferMutex");
-    uint64_t dft_current_playback_buffer_shared_size = 8192 * 2; // Same as audio_buffer_size * 2 to have room for a sample-rate converted version of the audio data
-    byte_t* dft_current_playback_buffer_shared = (byte_t*)malloc(dft_current_playback_buffer_shared_size);
-    uint64_t dft_current_playback_buffer_local_size = 0;
-    byte_t* dft_current_playback_buffer_local = (byte_t*)malloc(dft_current_playback_buffer_shared_size);
+    // The GPU can transform the frames instead, as long as it gives the same bands as the CPU. It's set up and checked
+    // the first time it's asked for, and the visualizer stays on the CPU if either fails
+    uint8_t viz_gpu_checked = 0;
+    uint8_t viz_gpu_available = 0;
+    // The bands are computed on a thread of their own from the audio buffers the sound player hands over, and the
+    // latest ones the thread published are uploaded each frame. On the GPU, the latest frame the thread published is
+    // transformed once, and the bands are copied each frame
+    analyzer_t dft_analyzer;
+    AnalyzerStart(&dft_analyzer, viz_enabled, viz_gpu, viz_size, viz_window, viz_hop);
+    uint32_t dft_gpu_publish_count = 0;
+    // Bands the GPU copied into each DFT buffer, which are turned into its columns once that frame is done
+    uint32_t dft_gpu_band_counts[VULKAN_MAX_FRAMES_IN_FLIGHT] = { 0 };
 
 
     // Initialize scenes
@@ -138,6 +249,8 @@ int main(int argc, char** argv)
     sound_player_shuffle_e sound_player_shuffle_state = SOUND_PLAYER_SHUFFLE_NO;
     uint8_t sound_player_loop_state_changed = 0;
     uint8_t sound_player_shuffle_state_changed = 0;
+    uint8_t sound_player_md5_verify_enabled = 0;
+    uint8_t sound_player_md5_verify_enabled_changed = 0;
     char sound_player_playlist_next_file_path[MAX_PATH];
     char sound_player_playlist_current_file_path[MAX_PATH];
     char sound_player_song_playing[MAX_PATH];
@@ -150,14 +263,9 @@ int main(int argc, char** argv)
     memset(sound_player_artist_playing, 0, MAX_PATH);
     memset(sound_player_album_playing, 0, MAX_PATH);
     memset(sound_player_song_info, 0, MAX_PATH);
-    uint16_t sound_player_song_sample_rate = 0;
+    uint32_t sound_player_song_sample_rate = 0;
     uint8_t sound_player_song_channel_count = 0;
-    uint8_t sound_player_song_bps = 0; // Bytes per sample
-    // The largest audio format we support is two-channel 16-bit per sample
-    byte* dft_audio_data = (byte*)malloc(DFT_MAX_WINDOWS * DFT_N * 2 * sizeof(int16_t));
-    uint32_t audio_data_size = 0;
-    int16_t audio_data_bps = 0; // Bytes per sample
-    int16_t audio_data_bytes_per_sample_all_channels = 0;
+    uint8_t sound_player_song_bits_per_sample = 0; // Valid bits, which is less than the container size for e.g. 24-in-32-bit samples
 
 
 
@@ -176,15 +284,14 @@ int main(int argc, char** argv)
     sound_player_shared_data.mutex = CreateMutexA(NULL, FALSE, "SharedDataMutex");
     assert(sound_player_shared_data.mutex != NULL);
     sound_player_shared_data.audio_device = NULL;
-    sound_player_shared_data.current_playback_buffer_mutex = dft_current_playback_buffer_shared_shared_mutex;
-    sound_player_shared_data.current_playback_buffer = dft_current_playback_buffer_shared;
-    sound_player_shared_data.current_playback_buffer_size = 0;
+    sound_player_shared_data.analyzer = &dft_analyzer;
     sound_player_shared_data.song = NULL;
     sound_player_shared_data.event = CreateEventA(NULL, FALSE, FALSE, "SharedDataOperationChangedEvent");
     assert(sound_player_shared_data.event != NULL);
     sound_player_shared_data.ui_next_operation = SOUND_PLAYER_OP_READY;
     sound_player_shared_data.loop_state = SOUND_PLAYER_LOOP_NO;
     sound_player_shared_data.shuffle_state = SOUND_PLAYER_SHUFFLE_NO;
+    sound_player_shared_data.md5_verify_enabled = 0;
     sound_player_shared_data.playlist_current_changed = 0;
     sound_player_shared_data.error_message_changed = 0;
     memset(sound_player_shared_data.playlist_next_file_path, 0, MAX_PATH);
@@ -213,11 +320,8 @@ int main(int argc, char** argv)
         sound_player_loop_state = SOUND_PLAYER_LOOP_NO;
         sound_player_shuffle_state = SOUND_PLAYER_SHUFFLE_NO;
         sound_player_loop_state_changed = 0;
+        sound_player_md5_verify_enabled_changed = 0;
         sound_player_shuffle_state_changed = 0;
-        audio_data_size = 0;
-        audio_data_bps = 0;
-        audio_data_bytes_per_sample_all_channels = 0;
-        dft_current_playback_buffer_local_size = 0;
 
         // 1)
         // Have a look in the OS message queue, and if there's a message:
@@ -393,13 +497,96 @@ int main(int argc, char** argv)
                                 SceneColumnsRecreateFramebuffers(&vulkan);
                                 SceneUIRecreateFramebuffers(&vulkan);
                             }
+                            else if (strcmp(command, "verify_enable") == 0)
+                            {
+                                sound_player_md5_verify_enabled = 1;
+                                sound_player_md5_verify_enabled_changed = 1;
+                            }
+                            else if (strcmp(command, "verify_disable") == 0)
+                            {
+                                sound_player_md5_verify_enabled = 0;
+                                sound_player_md5_verify_enabled_changed = 1;
+                            }
                             else if (strcmp(command, "viz_enable") == 0)
                             {
                                 viz_enabled = 1;
+                                viz_analysis_changed = 1;
                             }
                             else if (strcmp(command, "viz_disable") == 0)
                             {
                                 viz_enabled = 0;
+                                viz_analysis_changed = 1;
+                            }
+                            else if (strcmp(command, "viz_size") == 0)
+                            {
+                                uint32_t size = (argument != NULL) ? (uint32_t)atoi(argument) : 0;
+                                if ((size < DFT_MIN_N) || (size > DFT_MAX_N) || ((size & (size - 1)) != 0))
+                                {
+                                    SceneUIUpdateInfoMessage("Command 'viz_size' requires a power of 2 from 256 to 65536", INFO_SECTION_ROW_ERROR);
+                                    goto reset_sound_player_command;
+                                }
+                                viz_size = size;
+                                viz_analysis_changed = 1;
+                            }
+                            else if (strcmp(command, "viz_window") == 0)
+                            {
+                                uint32_t window = 0;
+                                while ((argument != NULL) && (window < DFT_WINDOW_COUNT) && (strcmp(argument, DFTGetWindowName((dft_window_e)window)) != 0))
+                                {
+                                    window += 1;
+                                }
+                                if ((argument == NULL) || (window == DFT_WINDOW_COUNT))
+                                {
+                                    SceneUIUpdateInfoMessage("Command 'viz_window' requires rectangular, hann, blackman_harris or flat_top", INFO_SECTION_ROW_ERROR);
+                                    goto reset_sound_player_command;
+                                }
+                                viz_window = (dft_window_e)window;
+                                viz_analysis_changed = 1;
+                            }
+                            else if (strcmp(command, "viz_hop") == 0)
+                            {
+                                uint32_t hop = (argument != NULL) ? (uint32_t)atoi(argument) : 0;
+                                if ((hop < STFT_MIN_HOP) || (hop > STFT_MAX_HOP))
+                                {
+                                    SceneUIUpdateInfoMessage("Command 'viz_hop' requires a number of samples from 16 to 16384", INFO_SECTION_ROW_ERROR);
+                                    goto reset_sound_player_command;
+                                }
+                                viz_hop = hop;
+                                viz_analysis_changed = 1;
+                            }
+                            else if (strcmp(command, "viz_device") == 0)
+                            {
+                                if ((argument != NULL) && (strcmp(argument, "cpu") == 0))
+                                {
+                                    viz_gpu = 0;
+                                }
+                                else if ((argument != NULL) && (strcmp(argument, "gpu") == 0))
+                                {
+                                    if (viz_gpu_checked == 0)
+                                    {
+                                        viz_gpu_checked = 1;
+                                        if (FFTVulkanInit(&vulkan) == 1)
+                                        {
+                                            viz_gpu_available = FFTVulkanCheck(&vulkan, dft_storage_buffers[0], dft_storage_buffer_memories[0]);
+                                            if (viz_gpu_available == 0)
+                                            {
+                                                FFTVulkanDestroy(&vulkan);
+                                            }
+                                        }
+                                    }
+                                    if (viz_gpu_available == 0)
+                                    {
+                                        SceneUIUpdateInfoMessage("The GPU could not be set up, or its bands didn't match the cpu's, so the cpu is used", INFO_SECTION_ROW_ERROR);
+                                        goto reset_sound_player_command;
+                                    }
+                                    viz_gpu = 1;
+                                }
+                                else
+                                {
+                                    SceneUIUpdateInfoMessage("Command 'viz_device' requires cpu or gpu", INFO_SECTION_ROW_ERROR);
+                                    goto reset_sound_player_command;
+                                }
+                                viz_analysis_changed = 1;
                             }
                             else if (strcmp(command, "generate_playlist") == 0)
                             {
@@ -556,7 +743,7 @@ reset_sound_player_command:
             strcpy(sound_player_album_playing, sound_player_shared_data.song->album);
             sound_player_song_channel_count = sound_player_shared_data.song->channel_count;
             sound_player_song_sample_rate = sound_player_shared_data.song->sample_rate;
-            sound_player_song_bps = sound_player_shared_data.song->bps;
+            sound_player_song_bits_per_sample = sound_player_shared_data.song->valid_bits_per_sample;
         }
 
         // Store string for error message if changed from sound player
@@ -575,6 +762,11 @@ reset_sound_player_command:
         {
             sound_player_shared_data.shuffle_state = sound_player_shuffle_state;
         }
+        // Update MD5 verification in sound player, which takes effect from the next song
+        if (sound_player_md5_verify_enabled_changed == 1)
+        {
+            sound_player_shared_data.md5_verify_enabled = sound_player_md5_verify_enabled;
+        }
         // Update next operation in sound player
         if (sound_player_ui_next_operation != SOUND_PLAYER_OP_READY)
         {
@@ -592,26 +784,34 @@ reset_sound_player_command:
         }
         SyncReleaseMutex(sound_player_shared_data.mutex, __FILE__, __LINE__);
 
-        // Get and store samples to be used for DFT from sound player
-        if ((viz_enabled == 1) &&
-            (sound_player_shared_data.audio_device != NULL))
+        // Change the visualizer's analysis, which the analysis thread picks up
+        if (viz_analysis_changed == 1)
         {
-            DWORD mutex_locked = SyncTryLockMutex(dft_current_playback_buffer_shared_shared_mutex, 0, __FILE__, __LINE__);
-            if (mutex_locked == WAIT_OBJECT_0)
-            {
-                assert(dft_current_playback_buffer_shared_size >= sound_player_shared_data.current_playback_buffer_size); // Just check that we have enough space
-                dft_current_playback_buffer_local_size = sound_player_shared_data.current_playback_buffer_size;
-                memcpy(dft_current_playback_buffer_local, dft_current_playback_buffer_shared, dft_current_playback_buffer_local_size);
-                SyncReleaseMutex(dft_current_playback_buffer_shared_shared_mutex, __FILE__, __LINE__);
-            }
+            AnalyzerSetSettings(&dft_analyzer, viz_enabled, viz_gpu, viz_size, viz_window, viz_hop);
+            viz_analysis_changed = 0;
+        }
+
+        // Upload the columns of the latest bands the analysis thread published or, when they're computed on the GPU, of
+        // the bands it copied into this frame's buffer the last time it was used
+        const analyzer_spectrum_t* dft_spectrum = NULL;
+        if (viz_enabled == 1)
+        {
+            dft_spectrum = AnalyzerAcquireSpectrum(&dft_analyzer);
         }
-        // Potentially compute DFT
-        if ((viz_enabled == 1) &&
-            (dft_current_playback_buffer_local_size > 0))
+        if ((dft_spectrum != NULL) &&
+            ((dft_spectrum->gpu == 0) || (dft_gpu_band_counts[frame_resource_index] > 0)))
         {
-            float* dft_bands = NULL;
-            VK_CHECK_RES(vkMapMemory(vulkan.device, dft_storage_buffer_memories[frame_resource_index], 0, VK_WHOLE_SIZE, 0, (void**)&dft_bands));
-            DFTComputeRAW(dft_current_playback_buffer_local, (int32_t)(dft_current_playback_buffer_local_size / sound_player_shared_data.song->bps / sound_player_shared_data.song->channel_count), sound_player_shared_data.song->bps, sound_player_shared_data.song->channel_count * sound_player_shared_data.song->bps, dft_bands);
+            float* dft_columns = NULL;
+            VK_CHECK_RES(vkMapMemory(vulkan.device, dft_storage_buffer_memories[frame_resource_index], 0, VK_WHOLE_SIZE, 0, (void**)&dft_columns));
+            if (dft_spectrum->gpu == 0)
+            {
+                DFTComputeColumns(dft_spectrum->bands, dft_spectrum->band_count, dft_columns);
+                dft_gpu_band_counts[frame_resource_index] = 0;
+            }
+            else
+            {
+                DFTComputeColumns(dft_columns + FFT_VULKAN_COPIED_BANDS_OFFSET, dft_gpu_band_counts[frame_resource_index], dft_columns);
+            }
             vkUnmapMemory(vulkan.device, dft_storage_buffer_memories[frame_resource_index]);
         }
 
@@ -658,7 +858,7 @@ reset_sound_player_command:
         SceneUIUpdateInfoMessage(sound_player_album_playing, INFO_SECTION_ROW_ALBUM);
         SceneUIUpdateInfoMessage(_itoa(sound_player_song_channel_count, sound_player_song_info, 10), INFO_SECTION_ROW_CHANNEL_COUNT);
         SceneUIUpdateInfoMessage(_itoa(sound_player_song_sample_rate, sound_player_song_info, 10), INFO_SECTION_ROW_SAMPLE_RATE);
-        SceneUIUpdateInfoMessage(_itoa(sound_player_song_bps * 8, sound_player_song_info, 10), INFO_SECTION_ROW_BITS_PER_SAMPLE);
+        SceneUIUpdateInfoMessage(_itoa(sound_player_song_bits_per_sample, sound_player_song_info, 10), INFO_SECTION_ROW_BITS_PER_SAMPLE);
 
         // 5)
         // Begin
@@ -707,6 +907,17 @@ reset_sound_player_command:
         //    b) Using the correct resources for the current frame (framebuffer corresponding to frame_image_index, and resources corresponding to frame_resource_index)
         if (viz_enabled == 1)
         {
+            // Transform the frame the analysis thread left to the GPU, once per frame it published, and copy the bands
+            // into the buffer the columns are computed from
+            if (dft_spectrum->gpu == 1)
+            {
+                if (dft_spectrum->publish_count != dft_gpu_publish_count)
+                {
+                    FFTVulkanCmdTransform(&vulkan, frame_command_buffer, dft_spectrum->n, dft_spectrum->window, (dft_spectrum->frame_sample_count > 0) ? dft_spectrum->frame : NULL);
+                    dft_gpu_publish_count = dft_spectrum->publish_count;
+                }
+                dft_gpu_band_counts[frame_resource_index] = FFTVulkanCmdCopyBands(&vulkan, frame_command_buffer, dft_storage_buffers[frame_resource_index]);
+            }
             SceneColumnsRender(&vulkan, frame_command_buffer, frame_image_index, frame_resource_index);
         }
 
@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "md5.h"
+
+#include <string.h>
+
+static inline uint32_t MD5RotateLeft(uint32_t value, uint32_t bit_count)
+{
+    return (value << bit_count) | (value >> (32 - bit_count));
+}
+
+static inline uint32_t MD5LoadLittleEndian(const byte_t* bytes)
+{
+    return ((uint32_t)bytes[0]) | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static inline void MD5StoreLittleEndian(byte_t* bytes, uint32_t value)
+{
+    bytes[0] = (byte_t)value;
+    bytes[1] = (byte_t)(value >> 8);
+    bytes[2] = (byte_t)(value >> 16);
+    bytes[3] = (byte_t)(value >> 24);
+}
+
+// The four rounds, each step adds a function of b, c and d, a message word and a constant to a, and rotates it
+#define MD5_ROUND_F(b, c, d) ((d) ^ ((b) & ((c) ^ (d))))
+#define MD5_ROUND_G(b, c, d) ((c) ^ ((d) & ((b) ^ (c))))
+#define MD5_ROUND_H(b, c, d) ((b) ^ (c) ^ (d))
+#define MD5_ROUND_I(b, c, d) ((c) ^ ((b) | ~(d)))
+#define MD5_STEP(function, a, b, c, d, word, constant, rotation) \
+    (a) += function((b), (c), (d)) + (word) + (constant); \
+    (a) = MD5RotateLeft((a), (rotation)) + (b);
+
+// Processes 'block_count' 64-byte blocks
+static void MD5ProcessBlocks(uint32_t state[4], const byte_t* bytes, uint64_t block_count)
+{
+    uint32_t a = state[0];
+    uint32_t b = state[1];
+    uint32_t c = state[2];
+    uint32_t d = state[3];
+    for (uint64_t block = 0; block < block_count; block++)
+    {
+        uint32_t x[16];
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            x[i] = MD5LoadLittleEndian(bytes + (i * 4));
+        }
+        uint32_t a_start = a;
+        uint32_t b_start = b;
+        uint32_t c_start = c;
+        uint32_t d_start = d;
+
+        MD5_STEP(MD5_ROUND_F, a, b, c, d, x[0],  0xD76AA478, 7)
+        MD5_STEP(MD5_ROUND_F, d, a, b, c, x[1],  0xE8C7B756, 12)
+        MD5_STEP(MD5_ROUND_F, c, d, a, b, x[2],  0x242070DB, 17)
+        MD5_STEP(MD5_ROUND_F, b, c, d, a, x[3],  0xC1BDCEEE, 22)
+        MD5_STEP(MD5_ROUND_F, a, b, c, d, x[4],  0xF57C0FAF, 7)
+        MD5_STEP(MD5_ROUND_F, d, a, b, c, x[5],  0x4787C62A, 12)
+        MD5_STEP(MD5_ROUND_F, c, d, a, b, x[6],  0xA8304613, 17)
+        MD5_STEP(MD5_ROUND_F, b, c, d, a, x[7],  0xFD469501, 22)
+        MD5_STEP(MD5_ROUND_F, a, b, c, d, x[8],  0x698098D8, 7)
+        MD5_STEP(MD5_ROUND_F, d, a, b, c, x[9],  0x8B44F7AF, 12)
+        MD5_STEP(MD5_ROUND_F, c, d, a, b, x[10], 0xFFFF5BB1, 17)
+        MD5_STEP(MD5_ROUND_F, b, c, d, a, x[11], 0x895CD7BE, 22)
+        MD5_STEP(MD5_ROUND_F, a, b, c, d, x[12], 0x6B901122, 7)
+        MD5_STEP(MD5_ROUND_F, d, a, b, c, x[13], 0xFD987193, 12)
+        MD5_STEP(MD5_ROUND_F, c, d, a, b, x[14], 0xA679438E, 17)
+        MD5_STEP(MD5_ROUND_F, b, c, d, a, x[15], 0x49B40821, 22)
+
+        MD5_STEP(MD5_ROUND_G, a, b, c, d, x[1],  0xF61E2562, 5)
+        MD5_STEP(MD5_ROUND_G, d, a, b, c, x[6],  0xC040B340, 9)
+        MD5_STEP(MD5_ROUND_G, c, d, a, b, x[11], 0x265E5A51, 14)
+        MD5_STEP(MD5_ROUND_G, b, c, d, a, x[0],  0xE9B6C7AA, 20)
+        MD5_STEP(MD5_ROUND_G, a, b, c, d, x[5],  0xD62F105D, 5)
+        MD5_STEP(MD5_ROUND_G, d, a, b, c, x[10], 0x02441453, 9)
+        MD5_STEP(MD5_ROUND_G, c, d, a, b, x[15], 0xD8A1E681, 14)
+        MD5_STEP(MD5_ROUND_G, b, c, d, a, x[4],  0xE7D3FBC8, 20)
+        MD5_STEP(MD5_ROUND_G, a, b, c, d, x[9],  0x21E1CDE6, 5)
+        MD5_STEP(MD5_ROUND_G, d, a, b, c, x[14], 0xC33707D6, 9)
+        MD5_STEP(MD5_ROUND_G, c, d, a, b, x[3],  0xF4D50D87, 14)
+        MD5_STEP(MD5_ROUND_G, b, c, d, a, x[8],  0x455A14ED, 20)
+        MD5_STEP(MD5_ROUND_G, a, b, c, d, x[13], 0xA9E3E905, 5)
+        MD5_STEP(MD5_ROUND_G, d, a, b, c, x[2],  0xFCEFA3F8, 9)
+        MD5_STEP(MD5_ROUND_G, c, d, a, b, x[7],  0x676F02D9, 14)
+        MD5_STEP(MD5_ROUND_G, b, c, d, a, x[12], 0x8D2A4C8A, 20)
+
+        MD5_STEP(MD5_ROUND_H, a, b, c, d, x[5],  0xFFFA3942, 4)
+        MD5_STEP(MD5_ROUND_H, d, a, b, c, x[8],  0x8771F681, 11)
+        MD5_STEP(MD5_ROUND_H, c, d, a, b, x[11], 0x6D9D6122, 16)
+        MD5_STEP(MD5_ROUND_H, b, c, d, a, x[14], 0xFDE5380C, 23)
+        MD5_STEP(MD5_ROUND_H, a, b, c, d, x[1],  0xA4BEEA44, 4)
+        MD5_STEP(MD5_ROUND_H, d, a, b, c, x[4],  0x4BDECFA9, 11)
+        MD5_STEP(MD5_ROUND_H, c, d, a, b, x[7],  0xF6BB4B60, 16)
+        MD5_STEP(MD5_ROUND_H, b, c, d, a, x[10], 0xBEBFBC70, 23)
+        MD5_STEP(MD5_ROUND_H, a, b, c, d, x[13], 0x289B7EC6, 4)
+        MD5_STEP(MD5_ROUND_H, d, a, b, c, x[0],  0xEAA127FA, 11)
+        MD5_STEP(MD5_ROUND_H, c, d, a, b, x[3],  0xD4EF3085, 16)
+        MD5_STEP(MD5_ROUND_H, b, c, d, a, x[6],  0x04881D05, 23)
+        MD5_STEP(MD5_ROUND_H, a, b, c, d, x[9],  0xD9D4D039, 4)
+        MD5_STEP(MD5_ROUND_H, d, a, b, c, x[12], 0xE6DB99E5, 11)
+        MD5_STEP(MD5_ROUND_H, c, d, a, b, x[15], 0x1FA27CF8, 16)
+        MD5_STEP(MD5_ROUND_H, b, c, d, a, x[2],  0xC4AC5665, 23)
+
+        MD5_STEP(MD5_ROUND_I, a, b, c, d, x[0],  0xF4292244, 6)
+        MD5_STEP(MD5_ROUND_I, d, a, b, c, x[7],  0x432AFF97, 10)
+        MD5_STEP(MD5_ROUND_I, c, d, a, b, x[14], 0xAB9423A7, 15)
+        MD5_STEP(MD5_ROUND_I, b, c, d, a, x[5],  0xFC93A039, 21)
+        MD5_STEP(MD5_ROUND_I, a, b, c, d, x[12], 0x655B59C3, 6)
+        MD5_STEP(MD5_ROUND_I, d, a, b, c, x[3],  0x8F0CCC92, 10)
+        MD5_STEP(MD5_ROUND_I, c, d, a, b, x[10], 0xFFEFF47D, 15)
+        MD5_STEP(MD5_ROUND_I, b, c, d, a, x[1],  0x85845DD1, 21)
+        MD5_STEP(MD5_ROUND_I, a, b, c, d, x[8],  0x6FA87E4F, 6)
+        MD5_STEP(MD5_ROUND_I, d, a, b, c, x[15], 0xFE2CE6E0, 10)
+        MD5_STEP(MD5_ROUND_I, c, d, a, b, x[6],  0xA3014314, 15)
+        MD5_STEP(MD5_ROUND_I, b, c, d, a, x[13], 0x4E0811A1, 21)
+        MD5_STEP(MD5_ROUND_I, a, b, c, d, x[4],  0xF7537E82, 6)
+        MD5_STEP(MD5_ROUND_I, d, a, b, c, x[11], 0xBD3AF235, 10)
+        MD5_STEP(MD5_ROUND_I, c, d, a, b, x[2],  0x2AD7D2BB, 15)
+        MD5_STEP(MD5_ROUND_I, b, c, d, a, x[9],  0xEB86D391, 21)
+
+        a += a_start;
+        b += b_start;
+        c += c_start;
+        d += d_start;
+        bytes += 64;
+    }
+    state[0] = a;
+    state[1] = b;
+    state[2] = c;
+    state[3] = d;
+}
+
+void MD5Init(md5_context_t* context)
+{
+    context->state[0] = 0x67452301;
+    context->state[1] = 0xEFCDAB89;
+    context->state[2] = 0x98BADCFE;
+    context->state[3] = 0x10325476;
+    context->byte_count = 0;
+}
+
+void MD5Update(md5_context_t* context, const byte_t* bytes, uint64_t byte_count)
+{
+    // Complete a partial block from the previous call first
+    uint64_t block_size = context->byte_count % 64;
+    context->byte_count += byte_count;
+    if (block_size > 0)
+    {
+        uint64_t fill_size = 64 - block_size;
+        if (byte_count < fill_size)
+        {
+            memcpy(context->block + block_size, bytes, byte_count);
+            return;
+        }
+        memcpy(context->block + block_size, bytes, fill_size);
+        MD5ProcessBlocks(context->state, context->block, 1);
+        bytes += fill_size;
+        byte_count -= fill_size;
+    }
+
+    // Whole blocks are processed straight from 'bytes'
+    MD5ProcessBlocks(context->state, bytes, byte_count / 64);
+    bytes += byte_count - (byte_count % 64);
+    memcpy(context->block, bytes, byte_count % 64);
+}
+
+void MD5Final(md5_context_t* context, byte_t digest[16])
+{
+    // Pad with a 1-bit and 0-bits up to 8 bytes short of a block, which hold the message length in bits
+    byte_t padding[72];
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    uint64_t bit_count = context->byte_count * 8;
+    uint64_t padding_size = 64 - ((context->byte_count + 8) % 64);
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        padding[padding_size + i] = (byte_t)(bit_count >> (i * 8));
+    }
+    MD5Update(context, padding, padding_size + 8);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        MD5StoreLittleEndian(digest + (i * 4), context->state[i]);
+    }
+}
\ No newline at end of file
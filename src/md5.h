@@ -0,0 +1,38 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef MD5_H
+#define MD5_H
+
+#include "macros.h"
+
+#include <stdint.h>
+
+// https://www.rfc-editor.org/rfc/rfc1321
+typedef struct
+{
+    uint32_t state[4];
+    uint64_t byte_count; // Total bytes added
+    byte_t   block[64]; // Bytes added that don't fill a whole block yet
+} md5_context_t;
+
+void MD5Init(md5_context_t* context);
+void MD5Update(md5_context_t* context, const byte_t* bytes, uint64_t byte_count);
+void MD5Final(md5_context_t* context, byte_t digest[16]);
+
+#endif
\ No newline at end of file
@@ -16,7 +16,10 @@
  * OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "cue.h"
+#include "flac.h"
 #include "playlist.h"
+#include "wav.h"
 
 #include <windows.h>
 
@@ -43,6 +46,181 @@ void PlaylistInit(playlist_t* playlist)
     playlist->current_song_index = 0;
 }
 
+// Songs added to a playlist while it's loaded. The songs' paths are kept as offsets into 'song_paths' until it's done
+// growing.
+typedef struct
+{
+    playlist_t playlist;
+    uint64_t   song_capacity;
+    uint64_t*  song_path_offsets;
+    uint64_t   song_paths_size;
+    uint64_t   song_paths_capacity;
+    uint64_t   last_song_path_offset; // Path added last
+} playlist_builder_t;
+
+static song_type_e PlaylistGetSongType(const char* path)
+{
+    size_t path_length = strlen(path);
+    if ((path_length >= 4) && (strcmp(path + path_length - 4, ".wav") == 0))
+    {
+        return SONG_TYPE_WAV;
+    }
+    if ((path_length >= 5) && (strcmp(path + path_length - 5, ".flac") == 0))
+    {
+        return SONG_TYPE_FLAC;
+    }
+    return SONG_TYPE_INVALID;
+}
+
+// Appends a song in the file at 'path'. Songs in the same file as the song added before them share its path.
+// Returns the song, which is only valid until the next song is added
+static song_t* PlaylistAddSong(playlist_builder_t* builder, const char* path, song_type_e song_type)
+{
+    playlist_t* playlist = &builder->playlist;
+    if (playlist->song_count == builder->song_capacity)
+    {
+        builder->song_capacity = (builder->song_capacity == 0) ? 64 : (2 * builder->song_capacity);
+        playlist->songs = (song_t*)realloc(playlist->songs, builder->song_capacity * sizeof(song_t));
+        builder->song_path_offsets = (uint64_t*)realloc(builder->song_path_offsets, builder->song_capacity * sizeof(uint64_t));
+    }
+
+    if ((builder->song_paths_size == 0) ||
+        (strcmp(playlist->song_paths + builder->last_song_path_offset, path) != 0))
+    {
+        size_t path_size = strlen(path) + 1;
+        if ((builder->song_paths_size + path_size) > builder->song_paths_capacity)
+        {
+            builder->song_paths_capacity = (builder->song_paths_capacity == 0) ? (64 * MAX_PATH) : (2 * builder->song_paths_capacity);
+            playlist->song_paths = (char*)realloc(playlist->song_paths, builder->song_paths_capacity);
+        }
+        memcpy(playlist->song_paths + builder->song_paths_size, path, path_size);
+        builder->last_song_path_offset = builder->song_paths_size;
+        builder->song_paths_size += path_size;
+    }
+
+    song_t* song = &playlist->songs[playlist->song_count];
+    SongInit(song);
+    song->song_path_offset = playlist->song_paths + builder->last_song_path_offset;
+    song->song_type = song_type;
+    builder->song_path_offsets[playlist->song_count] = builder->last_song_path_offset;
+    playlist->song_count++;
+
+    return song;
+}
+
+// A FLAC file with a CUESHEET is added as one song per audio track, and any other file as a single song
+static void PlaylistAddFLAC(playlist_builder_t* builder, const char* path)
+{
+    song_t* song = PlaylistAddSong(builder, path, SONG_TYPE_FLAC);
+    flac_metadata_block_streaminfo_t streaminfo;
+    flac_cuesheet_track_t* cuesheet_tracks = NULL;
+    uint32_t cuesheet_track_count = 0;
+    if (FLACProbe(song, &streaminfo, &cuesheet_tracks, &cuesheet_track_count) != SONG_ERROR_NO)
+    {
+        // Reported once it's played
+        return;
+    }
+    if (cuesheet_tracks == NULL)
+    {
+        return;
+    }
+
+    // The last track is the lead-out, which only marks where the track before it ends
+    song_t file_song = *song;
+    builder->playlist.song_count--;
+    for (uint32_t i = 0; i < (cuesheet_track_count - 1); i++)
+    {
+        if (cuesheet_tracks[i].is_audio == 0)
+        {
+            continue;
+        }
+        song_t* track = PlaylistAddSong(builder, path, SONG_TYPE_FLAC);
+        snprintf(track->title, sizeof(track->title), "Track %02u", cuesheet_tracks[i].number);
+        strcpy(track->artist, file_song.artist);
+        strcpy(track->album, file_song.album);
+        track->track_number = cuesheet_tracks[i].number;
+        track->track_sample_start = cuesheet_tracks[i].sample_number;
+        track->track_sample_end = cuesheet_tracks[i + 1].sample_number;
+    }
+    free(cuesheet_tracks);
+}
+
+// Each audio track of a .cue file is added as a song. Positions in a .cue file are in CD frames, so the sample rate of
+// each file it refers to is read to convert them to samples.
+static void PlaylistAddCue(playlist_builder_t* builder, const char* path)
+{
+    cue_sheet_t cue_sheet;
+    if (CueLoad(path, &cue_sheet) != CUE_ERROR_NO)
+    {
+        printf("Failed to load cue sheet %s\n", path);
+        return;
+    }
+
+    uint32_t sample_rate = 0;
+    for (uint32_t i = 0; i < cue_sheet.track_count; i++)
+    {
+        cue_track_t* cue_track = &cue_sheet.tracks[i];
+        song_type_e song_type = PlaylistGetSongType(cue_track->file_path);
+        if (song_type == SONG_TYPE_INVALID)
+        {
+            printf("Unsupported audio file %s in cue sheet %s\n", cue_track->file_path, path);
+            continue;
+        }
+
+        if ((i == 0) || (strcmp(cue_track->file_path, cue_sheet.tracks[i - 1].file_path) != 0))
+        {
+            song_t file_song;
+            SongInit(&file_song);
+            file_song.song_path_offset = cue_track->file_path;
+            file_song.song_type = song_type;
+            sample_rate = 0;
+            if (song_type == SONG_TYPE_FLAC)
+            {
+                flac_metadata_block_streaminfo_t streaminfo;
+                if (FLACProbe(&file_song, &streaminfo, NULL, NULL) == SONG_ERROR_NO)
+                {
+                    sample_rate = streaminfo.sample_rate;
+                }
+            }
+            else
+            {
+                wav_format_t format;
+                if (WAVProbe(&file_song, &format) == SONG_ERROR_NO)
+                {
+                    sample_rate = format.sample_rate;
+                }
+            }
+        }
+        if (sample_rate == 0)
+        {
+            printf("Failed to open audio file %s in cue sheet %s\n", cue_track->file_path, path);
+            continue;
+        }
+
+        song_t* track = PlaylistAddSong(builder, cue_track->file_path, song_type);
+        if (cue_track->title[0] != '\0')
+        {
+            strcpy(track->title, cue_track->title);
+        }
+        else
+        {
+            snprintf(track->title, sizeof(track->title), "Track %02u", cue_track->number);
+        }
+        if (cue_track->performer[0] != '\0')
+        {
+            strcpy(track->artist, cue_track->performer);
+        }
+        if (cue_sheet.title[0] != '\0')
+        {
+            strcpy(track->album, cue_sheet.title);
+        }
+        track->track_number = cue_track->number;
+        track->track_sample_start = (cue_track->frame_start * sample_rate) / CUE_FRAMES_PER_SECOND;
+        track->track_sample_end = (cue_track->frame_end * sample_rate) / CUE_FRAMES_PER_SECOND;
+    }
+    CueFree(&cue_sheet);
+}
+
 playlist_error_e PlaylistLoad(char* playlist_file_path, playlist_t* playlist)
 {
     assert(playlist != NULL);
@@ -51,8 +229,13 @@ playlist_error_e PlaylistLoad(char* playlist_file_path, playlist_t* playlist)
     assert(playlist->songs_shuffled == NULL);
 
     // Local output value
-    playlist_t playlist_tmp;
-    PlaylistInit(&playlist_tmp);
+    playlist_builder_t builder;
+    PlaylistInit(&builder.playlist);
+    builder.song_capacity = 0;
+    builder.song_path_offsets = NULL;
+    builder.song_paths_size = 0;
+    builder.song_paths_capacity = 0;
+    builder.last_song_path_offset = 0;
     
     FILE* playlist_file = fopen(playlist_file_path, "r");
     if (playlist_file == NULL)
@@ -61,66 +244,45 @@ playlist_error_e PlaylistLoad(char* playlist_file_path, playlist_t* playlist)
         return PLAYLIST_ERROR_UNABLE_TO_OPEN_FILE;
     }
 
-    /** Compute
-     *  - how much memory is needed to store all file names that end with '.wav'
-     *  - number of songs in playlist
-     */
+    // Each line is a '.wav' or '.flac' file, or a '.cue' file whose tracks are added as songs
     char line[MAX_PATH];
-    uint64_t total_memory_required = 0;
     while (fgets(line, MAX_PATH, playlist_file) != NULL)
     {
-        size_t line_length = strlen(line) - 1 + 1; // -1 to truncate new-line, but +1 to include null-terminating
-        if ((strncmp(line + line_length - 5, ".wav", 4) == 0) ||
-            (strncmp(line + line_length - 6, ".flac", 5) == 0))
+        size_t line_length = strcspn(line, "\r\n");
+        line[line_length] = '\0';
+        song_type_e song_type = PlaylistGetSongType(line);
+        if (song_type == SONG_TYPE_WAV)
+        {
+            PlaylistAddSong(&builder, line, SONG_TYPE_WAV);
+        }
+        else if (song_type == SONG_TYPE_FLAC)
         {
-            total_memory_required += line_length;
-            playlist_tmp.song_count++;
+            PlaylistAddFLAC(&builder, line);
+        }
+        else if ((line_length >= 4) && (strcmp(line + line_length - 4, ".cue") == 0))
+        {
+            PlaylistAddCue(&builder, line);
         }
     }
-    if (playlist_tmp.song_count == 0)
+    fclose(playlist_file);
+    if (builder.playlist.song_count == 0)
     {
+        free(builder.song_path_offsets);
+        free(builder.playlist.songs);
+        free(builder.playlist.song_paths);
         return PLAYLIST_ERROR_EMPTY;
     }
 
-    // Allocate memory for playlist
-    playlist_tmp.song_paths = (char*)malloc(total_memory_required);
-    playlist_tmp.songs = (song_t*)malloc(playlist_tmp.song_count * sizeof(song_t));
-    playlist_tmp.songs_shuffled = (song_t*)malloc(playlist_tmp.song_count * sizeof(song_t));
-
-    // Fill playlist song names
-    fseek(playlist_file, 0, SEEK_SET);
-    uint64_t songs_offset = 0;
-    uint64_t current_song_index = 0;
-    // TODO (Daniel): avoid reading from the file again?
-    while (fgets(line, MAX_PATH, playlist_file) != NULL)
+    // The paths are done moving
+    for (uint64_t i = 0; i < builder.playlist.song_count; i++)
     {
-        size_t line_length = strlen(line) - 1 + 1; // -1 to truncate new-line, but +1 to include null-terminating
-        song_type_e song_type = SONG_TYPE_INVALID;
-        if (strncmp(line + line_length - 5, ".wav", 4) == 0)
-        {
-            song_type = SONG_TYPE_WAV;
-        }
-        else if (strncmp(line + line_length - 6, ".flac", 5) == 0)
-        {
-            song_type = SONG_TYPE_FLAC;
-        }
-
-        if (song_type != SONG_TYPE_INVALID)
-        {
-            SongInit(&playlist_tmp.songs[current_song_index]);
-            playlist_tmp.songs[current_song_index].song_path_offset = playlist_tmp.song_paths + songs_offset;
-            memcpy(playlist_tmp.songs[current_song_index].song_path_offset, line, line_length);
-            playlist_tmp.songs[current_song_index].song_path_offset[line_length - 1] = '\0'; // Change final character in line from \n to \0
-            playlist_tmp.songs[current_song_index].song_type = song_type;
-
-            songs_offset += line_length;
-            current_song_index++;
-        }
+        builder.playlist.songs[i].song_path_offset = builder.playlist.song_paths + builder.song_path_offsets[i];
     }
-    fclose(playlist_file);
+    free(builder.song_path_offsets);
+    builder.playlist.songs_shuffled = (song_t*)malloc(builder.playlist.song_count * sizeof(song_t));
 
     // Write output value
-    *playlist = playlist_tmp;
+    *playlist = builder.playlist;
 
     return PLAYLIST_ERROR_NO;
 }
@@ -26,7 +26,7 @@
 
 typedef struct
 {
-    char*    song_paths;
+    char*    song_paths; // Virtual tracks of the same file share the file's path
     song_t*  songs;
     song_t*  songs_shuffled;
     uint64_t song_count;
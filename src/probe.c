@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "playlist.h"
+#include "probe.h"
+#include "wav.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+uint32_t ProbePlaylist(char* playlist_file_path)
+{
+    assert(playlist_file_path != NULL);
+
+    playlist_t playlist;
+    PlaylistInit(&playlist);
+    playlist_error_e playlist_error = PlaylistLoad(playlist_file_path, &playlist);
+    switch (playlist_error)
+    {
+        case PLAYLIST_ERROR_NO: {} break;
+
+        case PLAYLIST_ERROR_UNABLE_TO_OPEN_FILE:
+        {
+            printf("Unable to open playlist: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        case PLAYLIST_ERROR_EMPTY:
+        {
+            printf("Playlist file is empty: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid error returned from PlaylistLoad()\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        } break;
+    }
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+
+    uint32_t probed_count = 0;
+    uint32_t error_count = 0;
+    uint32_t skipped_count = 0;
+    double seconds = 0.0;
+    for (uint64_t i = 0; i < playlist.song_count; i++)
+    {
+        song_t* song = &playlist.songs[i];
+        uint64_t file_sample_count = 0;
+        uint32_t sample_rate = 0;
+        uint32_t bits_per_sample = 0;
+        uint32_t channel_count = 0;
+        song_error_e song_error = SONG_ERROR_NO;
+        if (song->song_type == SONG_TYPE_FLAC)
+        {
+            flac_metadata_block_streaminfo_t streaminfo;
+            song_error = FLACProbe(song, &streaminfo, NULL, NULL);
+            file_sample_count = streaminfo.sample_count;
+            sample_rate = streaminfo.sample_rate;
+            bits_per_sample = streaminfo.bits_per_sample;
+            channel_count = streaminfo.channel_count;
+        }
+        else if (song->song_type == SONG_TYPE_WAV)
+        {
+            wav_format_t format;
+            song_error = WAVProbe(song, &format);
+            uint64_t bytes_per_sample_all_channels = (uint64_t)format.channel_count * (format.bits_per_sample / 8);
+            file_sample_count = (song_error == SONG_ERROR_NO) ? (format.audio_data_size / bytes_per_sample_all_channels) : 0;
+            sample_rate = format.sample_rate;
+            bits_per_sample = format.bits_per_sample;
+            channel_count = format.channel_count;
+        }
+        else
+        {
+            skipped_count++;
+            continue;
+        }
+        if (song_error != SONG_ERROR_NO)
+        {
+            printf("ERROR     %s\n", song->song_path_offset);
+            error_count++;
+            continue;
+        }
+
+        // A sample count of 0 means the length is unknown. A virtual track is only part of the file.
+        uint64_t sample_count = file_sample_count;
+        if (song->track_number != 0)
+        {
+            uint64_t track_sample_end = (song->track_sample_end != 0) ? song->track_sample_end : file_sample_count;
+            sample_count = (track_sample_end > song->track_sample_start) ? (track_sample_end - song->track_sample_start) : 0;
+        }
+        uint64_t song_seconds = (sample_rate > 0) ? (sample_count / sample_rate) : 0;
+        printf("%s - %s [%s] %llu:%02llu, %u Hz, %u-bit, %u channels\n", song->artist, song->title, song->album, (unsigned long long)(song_seconds / 60), (unsigned long long)(song_seconds % 60), sample_rate, bits_per_sample, channel_count);
+        seconds += (sample_rate > 0) ? ((double)sample_count / sample_rate) : 0.0;
+        probed_count++;
+    }
+
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+    PlaylistFree(&playlist);
+
+    printf("\n");
+    printf("Probed:         %u (%.1f hours of audio)\n", probed_count, seconds / 3600.0);
+    printf("Errors:         %u\n", error_count);
+    printf("Skipped:        %u (not FLAC or WAV)\n", skipped_count);
+    printf("Time:           %.2f s\n", elapsed_seconds);
+    if (elapsed_seconds > 0.0)
+    {
+        printf("Throughput:     %.0f files/s\n", (double)probed_count / elapsed_seconds);
+    }
+
+    return error_count;
+}
\ No newline at end of file
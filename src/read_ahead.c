@@ -0,0 +1,310 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "read_ahead.h"
+#include "windows_synchronization.h"
+#include "windows_thread.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Pages of a mapping are touched this far apart to read them into memory
+#define READ_AHEAD_PAGE_SIZE 4096
+
+// Returns 1 if the thread may read block 'block_number', which mustn't be past the end of the file, nor overwrite the
+// slot of a block that is still kept. Must be called with the mutex locked
+static uint8_t ReadAheadMayReadBlock(const read_ahead_t* read_ahead, uint64_t block_number)
+{
+    uint64_t first_kept_block_number = read_ahead->read_offset / READ_AHEAD_BLOCK_SIZE;
+    if (first_kept_block_number > 0)
+    {
+        first_kept_block_number--;
+    }
+
+    return ((block_number * READ_AHEAD_BLOCK_SIZE) < read_ahead->file_size) &&
+           (block_number < first_kept_block_number + READ_AHEAD_BLOCK_COUNT);
+}
+
+static DWORD WINAPI ReadAheadThreadProc(_In_ LPVOID lpParameter)
+{
+    read_ahead_t* read_ahead = (read_ahead_t*)lpParameter;
+
+    SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    while (read_ahead->stop == 0)
+    {
+        uint64_t block_number = read_ahead->next_block_number;
+        if (ReadAheadMayReadBlock(read_ahead, block_number) == 0)
+        {
+            SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+            SyncWaitOnEvent(read_ahead->request_event, INFINITE, __FILE__, __LINE__);
+            SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+            continue;
+        }
+
+        // Claim the block's slot, and read it without holding the mutex
+        uint32_t slot = (uint32_t)(block_number % READ_AHEAD_BLOCK_COUNT);
+        read_ahead_block_t* block = &read_ahead->blocks[slot];
+        block->block_number = block_number;
+        block->ready = 0;
+        uint32_t generation = read_ahead->generation;
+        SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+
+        uint64_t file_offset = block_number * READ_AHEAD_BLOCK_SIZE;
+        uint64_t size = read_ahead->file_size - file_offset;
+        if (size > READ_AHEAD_BLOCK_SIZE)
+        {
+            size = READ_AHEAD_BLOCK_SIZE;
+        }
+        const byte_t* bytes = NULL;
+        if (read_ahead->file_map != NULL)
+        {
+            bytes = read_ahead->file_map->bytes + file_offset;
+            FilePrefetch(read_ahead->file_map, file_offset, size);
+            volatile byte_t touched = 0;
+            for (uint64_t i = 0; i < size; i += READ_AHEAD_PAGE_SIZE)
+            {
+                touched += bytes[i];
+            }
+        }
+        else
+        {
+            byte_t* ring_bytes = read_ahead->ring + ((uint64_t)slot * READ_AHEAD_BLOCK_SIZE);
+            OVERLAPPED overlapped;
+            memset(&overlapped, 0, sizeof(OVERLAPPED));
+            overlapped.Offset = (DWORD)file_offset;
+            overlapped.OffsetHigh = (DWORD)(file_offset >> 32);
+            DWORD size_read = 0;
+            if (ReadFile(read_ahead->file, ring_bytes, (DWORD)size, &size_read, &overlapped) == 0)
+            {
+                // Reading stops at a block that can't be read, as if the file ended there
+                size_read = 0;
+            }
+            bytes = ring_bytes;
+            size = size_read;
+        }
+
+        // A seek while reading means the block may not be wanted anymore, it's read again if it is
+        SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+        if (generation == read_ahead->generation)
+        {
+            block->bytes = bytes;
+            block->size = size;
+            block->ready = 1;
+            read_ahead->next_block_number++;
+            read_ahead->block_read_count++;
+            SyncSetEvent(read_ahead->block_event, __FILE__, __LINE__);
+        }
+    }
+    SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+
+    return EXIT_SUCCESS;
+}
+
+// Waits for the thread to read the block holding 'file_offset', and returns it. Must be called with the mutex locked
+static const read_ahead_block_t* ReadAheadWaitForBlock(read_ahead_t* read_ahead, uint64_t file_offset)
+{
+    uint64_t block_number = file_offset / READ_AHEAD_BLOCK_SIZE;
+    const read_ahead_block_t* block = &read_ahead->blocks[block_number % READ_AHEAD_BLOCK_COUNT];
+    if (((block->ready == 0) || (block->block_number != block_number)) && (read_ahead->waiting_after_seek == 0))
+    {
+        read_ahead->underrun_count++;
+    }
+    read_ahead->waiting_after_seek = 0;
+    while ((block->ready == 0) || (block->block_number != block_number))
+    {
+        SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+        SyncWaitOnEvent(read_ahead->block_event, INFINITE, __FILE__, __LINE__);
+        SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    }
+
+    return block;
+}
+
+uint8_t ReadAheadOpen(read_ahead_t* read_ahead, const char* path, const file_map_t* file_map, uint64_t offset)
+{
+    assert(read_ahead != NULL);
+    assert((path != NULL) || (file_map != NULL));
+
+    read_ahead->file = NULL;
+    read_ahead->file_map = file_map;
+    read_ahead->ring = NULL;
+    if (file_map != NULL)
+    {
+        read_ahead->file_size = file_map->size;
+    }
+    else
+    {
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return 0;
+        }
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file, &file_size) == 0)
+        {
+            CloseHandle(file);
+            return 0;
+        }
+        read_ahead->file = file;
+        read_ahead->file_size = (uint64_t)file_size.QuadPart;
+        read_ahead->ring = (byte_t*)VirtualAlloc(NULL, (SIZE_T)READ_AHEAD_BLOCK_COUNT * READ_AHEAD_BLOCK_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+        if (read_ahead->ring == NULL)
+        {
+            printf("ERROR(%s:%i): Failed to allocate read-ahead buffers\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (uint32_t i = 0; i < READ_AHEAD_BLOCK_COUNT; i++)
+    {
+        read_ahead->blocks[i].bytes = NULL;
+        read_ahead->blocks[i].block_number = UINT64_MAX;
+        read_ahead->blocks[i].size = 0;
+        read_ahead->blocks[i].ready = 0;
+    }
+    read_ahead->read_offset = offset;
+    read_ahead->next_block_number = offset / READ_AHEAD_BLOCK_SIZE;
+    read_ahead->generation = 0;
+    read_ahead->waiting_after_seek = 1;
+    read_ahead->stop = 0;
+    read_ahead->block_read_count = 0;
+    read_ahead->underrun_count = 0;
+    read_ahead->mutex = CreateMutexA(NULL, FALSE, NULL);
+    read_ahead->block_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    read_ahead->request_event = CreateEventA(NULL, FALSE, FALSE, NULL);
+    ThreadCreate(&ReadAheadThreadProc, read_ahead, L"ReadAheadThread", &read_ahead->thread);
+
+    return 1;
+}
+
+uint64_t ReadAheadRead(read_ahead_t* read_ahead, byte_t* output, uint64_t size)
+{
+    assert(read_ahead != NULL);
+    assert(read_ahead->ring != NULL);
+    assert(output != NULL);
+
+    SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    uint64_t block_number_start = read_ahead->read_offset / READ_AHEAD_BLOCK_SIZE;
+    uint64_t size_read = 0;
+    while ((size_read < size) && (read_ahead->read_offset < read_ahead->file_size))
+    {
+        const read_ahead_block_t* block = ReadAheadWaitForBlock(read_ahead, read_ahead->read_offset);
+        uint64_t block_offset = read_ahead->read_offset - (block->block_number * READ_AHEAD_BLOCK_SIZE);
+        if (block_offset >= block->size)
+        {
+            // The block couldn't be read in full
+            break;
+        }
+        uint64_t size_to_copy = block->size - block_offset;
+        if (size_to_copy > size - size_read)
+        {
+            size_to_copy = size - size_read;
+        }
+        memcpy(output + size_read, block->bytes + block_offset, size_to_copy);
+        size_read += size_to_copy;
+        read_ahead->read_offset += size_to_copy;
+    }
+
+    // Moving on to another block frees the slot of the one before it
+    if ((read_ahead->read_offset / READ_AHEAD_BLOCK_SIZE) != block_number_start)
+    {
+        SyncSetEvent(read_ahead->request_event, __FILE__, __LINE__);
+    }
+    SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+
+    return size_read;
+}
+
+const byte_t* ReadAheadMapped(read_ahead_t* read_ahead, uint64_t size)
+{
+    assert(read_ahead != NULL);
+    assert(read_ahead->file_map != NULL);
+    // Must fit in the blocks read ahead of the one being read from
+    assert(size <= (uint64_t)(READ_AHEAD_BLOCK_COUNT - 2) * READ_AHEAD_BLOCK_SIZE);
+    assert(read_ahead->read_offset + size <= read_ahead->file_size);
+
+    SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    uint64_t file_offset = read_ahead->read_offset;
+    uint64_t file_offset_end = file_offset + size;
+    for (uint64_t block_offset = file_offset; block_offset < file_offset_end; block_offset = ((block_offset / READ_AHEAD_BLOCK_SIZE) + 1) * READ_AHEAD_BLOCK_SIZE)
+    {
+        ReadAheadWaitForBlock(read_ahead, block_offset);
+    }
+    read_ahead->read_offset = file_offset_end;
+
+    // Moving on to another block frees the slot of the one before it
+    if ((file_offset_end / READ_AHEAD_BLOCK_SIZE) != (file_offset / READ_AHEAD_BLOCK_SIZE))
+    {
+        SyncSetEvent(read_ahead->request_event, __FILE__, __LINE__);
+    }
+    SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+
+    return read_ahead->file_map->bytes + file_offset;
+}
+
+void ReadAheadSeek(read_ahead_t* read_ahead, uint64_t offset)
+{
+    assert(read_ahead != NULL);
+
+    SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    read_ahead->read_offset = offset;
+    read_ahead->generation++;
+    read_ahead->waiting_after_seek = 1;
+
+    // Blocks already read from the one holding 'offset' onwards don't have to be read again
+    uint64_t block_number = offset / READ_AHEAD_BLOCK_SIZE;
+    while (1)
+    {
+        const read_ahead_block_t* block = &read_ahead->blocks[block_number % READ_AHEAD_BLOCK_COUNT];
+        if ((block->ready == 0) || (block->block_number != block_number))
+        {
+            break;
+        }
+        block_number++;
+    }
+    read_ahead->next_block_number = block_number;
+    SyncSetEvent(read_ahead->request_event, __FILE__, __LINE__);
+    SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+}
+
+void ReadAheadClose(read_ahead_t* read_ahead)
+{
+    assert(read_ahead != NULL);
+
+    SyncLockMutex(read_ahead->mutex, INFINITE, __FILE__, __LINE__);
+    read_ahead->stop = 1;
+    SyncSetEvent(read_ahead->request_event, __FILE__, __LINE__);
+    SyncReleaseMutex(read_ahead->mutex, __FILE__, __LINE__);
+    WaitForSingleObject(read_ahead->thread, INFINITE);
+    CloseHandle(read_ahead->thread);
+    CloseHandle(read_ahead->request_event);
+    CloseHandle(read_ahead->block_event);
+    CloseHandle(read_ahead->mutex);
+    if (read_ahead->ring != NULL)
+    {
+        VirtualFree(read_ahead->ring, 0, MEM_RELEASE);
+        read_ahead->ring = NULL;
+    }
+    if (read_ahead->file != NULL)
+    {
+        CloseHandle(read_ahead->file);
+        read_ahead->file = NULL;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,89 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef READ_AHEAD_H
+#define READ_AHEAD_H
+
+#include "macros.h"
+#include "windows_file.h"
+
+#include <windows.h>
+
+#include <stdint.h>
+
+// Files are read in blocks of this size, at file offsets that are multiples of it
+#define READ_AHEAD_BLOCK_SIZE (1024 * 1024)
+// Blocks in the ring. The block before the one being read from is kept, so the rest are read ahead of it
+#define READ_AHEAD_BLOCK_COUNT 6
+
+typedef struct
+{
+    const byte_t* bytes; // Into the ring, or into the file's mapping
+    uint64_t      block_number; // File offset divided by READ_AHEAD_BLOCK_SIZE
+    uint64_t      size; // Less than READ_AHEAD_BLOCK_SIZE only for the last block of the file
+    uint8_t       ready;
+} read_ahead_block_t;
+
+/**
+ * Reads a file ahead of where it is being read from on a thread of its own, so that decoding and playback only ever get
+ * bytes that are already in memory and never wait on the disk themselves.
+ * 
+ * ReadAheadOpen() starts reading at 'offset'. If 'file_map' is given, the file is read through that mapping of it: the
+ * thread asks for each block with FilePrefetch() and touches all its pages, so that they are in memory before they are
+ * read, and they are then read where they are with ReadAheadMapped(). Otherwise blocks are read into a ring of
+ * READ_AHEAD_BLOCK_COUNT buffers, and copied out of it with ReadAheadRead().
+ * Returns 0 if the file can't be opened
+ * 
+ * ReadAheadRead() copies the next 'size' bytes to 'output', and returns how many there were, fewer only at the end of
+ * the file.
+ * 
+ * ReadAheadMapped() makes sure the next 'size' bytes are in memory, and returns where they are in the mapping. They
+ * stay valid until the file is closed.
+ * 
+ * ReadAheadSeek() makes reading continue from 'offset'. Blocks already read around it are kept.
+ * 
+ * Whenever a read has to wait for the thread to read a block, except for the first block after opening or a seek, it
+ * counts as an underrun. 'underrun_count' staying at 0 means the disk kept up with playback.
+*/
+typedef struct
+{
+    HANDLE             file;
+    const file_map_t*  file_map; // NULL unless the file is read through a mapping of it
+    uint64_t           file_size;
+    byte_t*            ring; // READ_AHEAD_BLOCK_COUNT blocks, NULL when the file is read through a mapping
+    HANDLE             thread;
+    HANDLE             mutex; // Required to be locked before accessing below members
+    HANDLE             block_event; // Set by the thread when it has read a block
+    HANDLE             request_event; // Set when the thread may have another block to read
+    read_ahead_block_t blocks[READ_AHEAD_BLOCK_COUNT];
+    uint64_t           read_offset; // File offset of the next byte to read
+    uint64_t           next_block_number; // Next block for the thread to read
+    uint32_t           generation; // Changed by every seek, so that the thread drops a block it was reading for before it
+    uint8_t            waiting_after_seek; // The next wait for a block isn't an underrun
+    uint8_t            stop;
+    uint32_t           block_read_count;
+    uint32_t           underrun_count;
+} read_ahead_t;
+
+uint8_t       ReadAheadOpen(read_ahead_t* read_ahead, const char* path, const file_map_t* file_map, uint64_t offset);
+uint64_t      ReadAheadRead(read_ahead_t* read_ahead, byte_t* output, uint64_t size);
+const byte_t* ReadAheadMapped(read_ahead_t* read_ahead, uint64_t size);
+void          ReadAheadSeek(read_ahead_t* read_ahead, uint64_t offset);
+void          ReadAheadClose(read_ahead_t* read_ahead);
+
+#endif
\ No newline at end of file
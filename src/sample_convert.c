@@ -0,0 +1,699 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "cpu.h"
+#include "macros.h"
+#include "sample_convert.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef CPU_X86
+#include <immintrin.h>
+#endif
+
+// Samples of every format pass through 32-bit integers with the sample in the most significant bits. Floats are scaled
+// by 2^31, and clamped to the largest float below 2^31 so that converting them can't overflow.
+#define SAMPLE_CONVERT_FLOAT_TO_INT 2147483648.0f
+#define SAMPLE_CONVERT_INT_TO_FLOAT (1.0f / 2147483648.0f)
+#define SAMPLE_CONVERT_FLOAT_MAX 2147483520.0f
+#define SAMPLE_CONVERT_FLOAT_MIN -2147483648.0f
+#define SAMPLE_CONVERT_S24_MAX 0x7FFFFF
+// Planar buffers are (de)interleaved through a block of this many samples on the stack
+#define SAMPLE_CONVERT_BLOCK_SIZE 4096
+// The benchmark converts buffers that fit in the L2 cache, so that it times the kernels rather than memory. The odd size
+// leaves a tail for the scalar code.
+#define SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT ((16 * 1024) + 5)
+#define SAMPLE_CONVERT_BENCHMARK_ITERATION_COUNT 1000
+
+typedef enum
+{
+    SAMPLE_CONVERT_KERNEL_SCALAR = 0,
+    SAMPLE_CONVERT_KERNEL_SSE2 = 1,
+    SAMPLE_CONVERT_KERNEL_AVX2 = 2,
+    SAMPLE_CONVERT_KERNEL_COUNT = 3
+} sample_convert_kernel_e;
+
+static const uint32_t sample_convert_bytes_per_sample[SAMPLE_CONVERT_FORMAT_COUNT] = { 1, 2, 3, 4, 4, 4 };
+static const char* sample_convert_format_names[SAMPLE_CONVERT_FORMAT_COUNT] = { "u8", "s16", "s24", "s24in32", "s32", "f32" };
+static const char* sample_convert_kernel_names[SAMPLE_CONVERT_KERNEL_COUNT] = { "scalar", "sse2", "avx2" };
+
+static inline uint8_t SampleConvertIsCanonical(sample_convert_format_e format)
+{
+    return (format == SAMPLE_CONVERT_FORMAT_F32) || (format == SAMPLE_CONVERT_FORMAT_S16);
+}
+
+static sample_convert_kernel_e SampleConvertBestKernel(void)
+{
+#ifdef CPU_X86
+    if (CPUGetFeatures()->avx2)
+    {
+        return SAMPLE_CONVERT_KERNEL_AVX2;
+    }
+    return SAMPLE_CONVERT_KERNEL_SSE2;
+#else
+    return SAMPLE_CONVERT_KERNEL_SCALAR;
+#endif
+}
+
+// Loads sample 'index' of 'input' into the most significant bits of 32
+static inline int32_t SampleConvertLoadScalar(sample_convert_format_e format, const byte_t* input, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            return (int32_t)((uint32_t)(input[index] ^ 0x80) << 24);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            return (int32_t)((uint32_t)((const uint16_t*)input)[index] << 16);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            const byte_t* sample = input + (index * 3);
+            return (int32_t)(((uint32_t)sample[0] << 8) | ((uint32_t)sample[1] << 16) | ((uint32_t)sample[2] << 24));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            return (int32_t)(((const uint32_t*)input)[index] << 8);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            return ((const int32_t*)input)[index];
+        } break;
+
+        default:
+        {
+            // Written to give the same result as the min/max instructions for NaNs, which clamp them to full scale
+            float sample = ((const float*)input)[index] * SAMPLE_CONVERT_FLOAT_TO_INT;
+            sample = (sample < SAMPLE_CONVERT_FLOAT_MAX) ? sample : SAMPLE_CONVERT_FLOAT_MAX;
+            sample = (sample > SAMPLE_CONVERT_FLOAT_MIN) ? sample : SAMPLE_CONVERT_FLOAT_MIN;
+            return (int32_t)lrintf(sample);
+        } break;
+    }
+}
+
+// Shifts a sample in the most significant bits down by 'shift' bits, rounded to nearest. Only the largest samples round
+// up past the top of the narrower format, so it only needs to be saturated from above.
+static inline int32_t SampleConvertRoundShift(int32_t sample, uint32_t shift)
+{
+    return ((sample >> (shift - 1)) + 1) >> 1;
+}
+
+static inline int32_t SampleConvertMin(int32_t sample, int32_t maximum)
+{
+    return (sample < maximum) ? sample : maximum;
+}
+
+// Stores a sample in the most significant bits of 32 as sample 'index' of 'output'
+static inline void SampleConvertStoreScalar(sample_convert_format_e format, int32_t sample, byte_t* output, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            output[index] = (byte_t)(SampleConvertMin(SampleConvertRoundShift(sample, 24), INT8_MAX) + 128);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            ((int16_t*)output)[index] = (int16_t)SampleConvertMin(SampleConvertRoundShift(sample, 16), INT16_MAX);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            int32_t narrow = SampleConvertMin(SampleConvertRoundShift(sample, 8), SAMPLE_CONVERT_S24_MAX);
+            byte_t* bytes = output + (index * 3);
+            bytes[0] = (byte_t)narrow;
+            bytes[1] = (byte_t)(narrow >> 8);
+            bytes[2] = (byte_t)(narrow >> 16);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            ((int32_t*)output)[index] = SampleConvertMin(SampleConvertRoundShift(sample, 8), SAMPLE_CONVERT_S24_MAX);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            ((int32_t*)output)[index] = sample;
+        } break;
+
+        default:
+        {
+            ((float*)output)[index] = (float)sample * SAMPLE_CONVERT_INT_TO_FLOAT;
+        } break;
+    }
+}
+
+// Converts samples [first_sample, sample_count) one at a time, for the tails the SIMD kernels leave and for other CPUs
+static void SampleConvertScalar(sample_convert_format_e input_format, const byte_t* input, sample_convert_format_e output_format, byte_t* output, uint64_t first_sample, uint64_t sample_count)
+{
+    for (uint64_t i = first_sample; i < sample_count; i++)
+    {
+        SampleConvertStoreScalar(output_format, SampleConvertLoadScalar(input_format, input, i), output, i);
+    }
+}
+
+#ifdef CPU_X86
+// The SIMD kernels load a vector of samples into the most significant bits of 32, and store it in the output format, the
+// same way as the scalar code does. They return how many samples they converted.
+TARGET_SSE2 static inline __m128i SampleConvertRoundShiftSSE2(__m128i samples, int32_t shift)
+{
+    __m128i rounded = _mm_add_epi32(_mm_sra_epi32(samples, _mm_cvtsi32_si128(shift - 1)), _mm_set1_epi32(1));
+    return _mm_srai_epi32(rounded, 1);
+}
+
+// SSE2 has no 32-bit minimum, so it's a compare and a select
+TARGET_SSE2 static inline __m128i SampleConvertMinSSE2(__m128i samples, int32_t maximum)
+{
+    __m128i maximum_vector = _mm_set1_epi32(maximum);
+    __m128i above = _mm_cmpgt_epi32(samples, maximum_vector);
+    return _mm_or_si128(_mm_and_si128(above, maximum_vector), _mm_andnot_si128(above, samples));
+}
+
+TARGET_SSE2 static inline __m128i SampleConvertLoadSSE2(sample_convert_format_e format, const byte_t* input, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            // Flipping the top bit makes the samples signed, and unpacking them above zeros puts them in the top byte
+            int32_t bytes;
+            memcpy(&bytes, input + index, sizeof(bytes));
+            __m128i samples = _mm_xor_si128(_mm_cvtsi32_si128(bytes), _mm_set1_epi8((char)0x80));
+            samples = _mm_unpacklo_epi8(_mm_setzero_si128(), samples);
+            return _mm_unpacklo_epi16(_mm_setzero_si128(), samples);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            return _mm_unpacklo_epi16(_mm_setzero_si128(), _mm_loadl_epi64((const __m128i*)(input + (index * 2))));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            // Without a byte shuffle, the samples are gathered one at a time
+            return _mm_setr_epi32(SampleConvertLoadScalar(format, input, index), SampleConvertLoadScalar(format, input, index + 1),
+                                  SampleConvertLoadScalar(format, input, index + 2), SampleConvertLoadScalar(format, input, index + 3));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            return _mm_slli_epi32(_mm_loadu_si128((const __m128i*)(input + (index * 4))), 8);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            return _mm_loadu_si128((const __m128i*)(input + (index * 4)));
+        } break;
+
+        default:
+        {
+            __m128 samples = _mm_mul_ps(_mm_loadu_ps((const float*)input + index), _mm_set1_ps(SAMPLE_CONVERT_FLOAT_TO_INT));
+            samples = _mm_max_ps(_mm_min_ps(samples, _mm_set1_ps(SAMPLE_CONVERT_FLOAT_MAX)), _mm_set1_ps(SAMPLE_CONVERT_FLOAT_MIN));
+            return _mm_cvtps_epi32(samples);
+        } break;
+    }
+}
+
+TARGET_SSE2 static inline void SampleConvertStoreSSE2(sample_convert_format_e format, __m128i samples, byte_t* output, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            // The packs saturate to the signed range, and flipping the top bit makes the samples unsigned again
+            __m128i packed = _mm_packs_epi32(SampleConvertRoundShiftSSE2(samples, 24), _mm_setzero_si128());
+            packed = _mm_xor_si128(_mm_packs_epi16(packed, packed), _mm_set1_epi8((char)0x80));
+            int32_t bytes = _mm_cvtsi128_si32(packed);
+            memcpy(output + index, &bytes, sizeof(bytes));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            __m128i packed = _mm_packs_epi32(SampleConvertRoundShiftSSE2(samples, 16), _mm_setzero_si128());
+            _mm_storel_epi64((__m128i*)(output + (index * 2)), packed);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            int32_t narrow[4];
+            _mm_storeu_si128((__m128i*)narrow, SampleConvertMinSSE2(SampleConvertRoundShiftSSE2(samples, 8), SAMPLE_CONVERT_S24_MAX));
+            for (uint32_t i = 0; i < 4; i++)
+            {
+                byte_t* bytes = output + ((index + i) * 3);
+                bytes[0] = (byte_t)narrow[i];
+                bytes[1] = (byte_t)(narrow[i] >> 8);
+                bytes[2] = (byte_t)(narrow[i] >> 16);
+            }
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            _mm_storeu_si128((__m128i*)(output + (index * 4)), SampleConvertMinSSE2(SampleConvertRoundShiftSSE2(samples, 8), SAMPLE_CONVERT_S24_MAX));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            _mm_storeu_si128((__m128i*)(output + (index * 4)), samples);
+        } break;
+
+        default:
+        {
+            _mm_storeu_ps((float*)output + index, _mm_mul_ps(_mm_cvtepi32_ps(samples), _mm_set1_ps(SAMPLE_CONVERT_INT_TO_FLOAT)));
+        } break;
+    }
+}
+
+TARGET_SSE2 static uint64_t SampleConvertSSE2(sample_convert_format_e input_format, const byte_t* input, sample_convert_format_e output_format, byte_t* output, uint64_t sample_count)
+{
+    uint64_t i = 0;
+    for (; (i + 4) <= sample_count; i += 4)
+    {
+        SampleConvertStoreSSE2(output_format, SampleConvertLoadSSE2(input_format, input, i), output, i);
+    }
+    return i;
+}
+
+TARGET_AVX2 static inline __m256i SampleConvertRoundShiftAVX2(__m256i samples, int32_t shift)
+{
+    __m256i rounded = _mm256_add_epi32(_mm256_sra_epi32(samples, _mm_cvtsi32_si128(shift - 1)), _mm256_set1_epi32(1));
+    return _mm256_srai_epi32(rounded, 1);
+}
+
+TARGET_AVX2 static inline __m256i SampleConvertLoadAVX2(sample_convert_format_e format, const byte_t* input, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            __m128i bytes = _mm_xor_si128(_mm_loadl_epi64((const __m128i*)(input + index)), _mm_set1_epi8((char)0x80));
+            return _mm256_slli_epi32(_mm256_cvtepi8_epi32(bytes), 24);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            return _mm256_slli_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(input + (index * 2)))), 16);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            // Each half gets 4 samples of 3 bytes, which the shuffle spreads into the top 3 bytes of 4. The second half is
+            // loaded from 12 bytes in, so the load reaches 4 bytes past the 8 samples.
+            const byte_t* bytes = input + (index * 3);
+            __m256i packed = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)bytes)), _mm_loadu_si128((const __m128i*)(bytes + 12)), 1);
+            __m256i spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                              -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+            return _mm256_shuffle_epi8(packed, spread);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            return _mm256_slli_epi32(_mm256_loadu_si256((const __m256i*)(input + (index * 4))), 8);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            return _mm256_loadu_si256((const __m256i*)(input + (index * 4)));
+        } break;
+
+        default:
+        {
+            __m256 samples = _mm256_mul_ps(_mm256_loadu_ps((const float*)input + index), _mm256_set1_ps(SAMPLE_CONVERT_FLOAT_TO_INT));
+            samples = _mm256_max_ps(_mm256_min_ps(samples, _mm256_set1_ps(SAMPLE_CONVERT_FLOAT_MAX)), _mm256_set1_ps(SAMPLE_CONVERT_FLOAT_MIN));
+            return _mm256_cvtps_epi32(samples);
+        } break;
+    }
+}
+
+TARGET_AVX2 static inline void SampleConvertStoreAVX2(sample_convert_format_e format, __m256i samples, byte_t* output, uint64_t index)
+{
+    switch (format)
+    {
+        case SAMPLE_CONVERT_FORMAT_U8:
+        {
+            // Packing the two halves against each other keeps the samples in order
+            samples = SampleConvertRoundShiftAVX2(samples, 24);
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(samples), _mm256_extracti128_si256(samples, 1));
+            packed = _mm_xor_si128(_mm_packs_epi16(packed, packed), _mm_set1_epi8((char)0x80));
+            _mm_storel_epi64((__m128i*)(output + index), packed);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S16:
+        {
+            samples = SampleConvertRoundShiftAVX2(samples, 16);
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(samples), _mm256_extracti128_si256(samples, 1));
+            _mm_storeu_si128((__m128i*)(output + (index * 2)), packed);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24:
+        {
+            // The shuffle gathers the low 3 bytes of each sample into the first 12 bytes of each half. The halves are
+            // stored 12 bytes apart, so the second store reaches 4 bytes past the 8 samples.
+            samples = _mm256_min_epi32(SampleConvertRoundShiftAVX2(samples, 8), _mm256_set1_epi32(SAMPLE_CONVERT_S24_MAX));
+            __m256i gather = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                              0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            __m256i packed = _mm256_shuffle_epi8(samples, gather);
+            byte_t* bytes = output + (index * 3);
+            _mm_storeu_si128((__m128i*)bytes, _mm256_castsi256_si128(packed));
+            _mm_storeu_si128((__m128i*)(bytes + 12), _mm256_extracti128_si256(packed, 1));
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S24_IN_32:
+        {
+            samples = _mm256_min_epi32(SampleConvertRoundShiftAVX2(samples, 8), _mm256_set1_epi32(SAMPLE_CONVERT_S24_MAX));
+            _mm256_storeu_si256((__m256i*)(output + (index * 4)), samples);
+        } break;
+
+        case SAMPLE_CONVERT_FORMAT_S32:
+        {
+            _mm256_storeu_si256((__m256i*)(output + (index * 4)), samples);
+        } break;
+
+        default:
+        {
+            _mm256_storeu_ps((float*)output + index, _mm256_mul_ps(_mm256_cvtepi32_ps(samples), _mm256_set1_ps(SAMPLE_CONVERT_INT_TO_FLOAT)));
+        } break;
+    }
+}
+
+TARGET_AVX2 static uint64_t SampleConvertAVX2(sample_convert_format_e input_format, const byte_t* input, sample_convert_format_e output_format, byte_t* output, uint64_t sample_count)
+{
+    // Packed 24-bit samples are loaded and stored 16 bytes at a time, which reaches 4 bytes past the 8 samples
+    uint64_t reach = ((input_format == SAMPLE_CONVERT_FORMAT_S24) || (output_format == SAMPLE_CONVERT_FORMAT_S24)) ? 10 : 8;
+    uint64_t i = 0;
+    for (; (i + reach) <= sample_count; i += 8)
+    {
+        SampleConvertStoreAVX2(output_format, SampleConvertLoadAVX2(input_format, input, i), output, i);
+    }
+    return i;
+}
+#endif
+
+// Converts 'sample_count' samples without regard to channels, with the SIMD kernel 'kernel' and then the scalar code
+static void SampleConvertSamples(sample_convert_kernel_e kernel, sample_convert_format_e input_format, const byte_t* input, sample_convert_format_e output_format, byte_t* output, uint64_t sample_count)
+{
+    if (input_format == output_format)
+    {
+        memcpy(output, input, sample_count * sample_convert_bytes_per_sample[input_format]);
+        return;
+    }
+
+    uint64_t i = 0;
+#ifdef CPU_X86
+    if (kernel == SAMPLE_CONVERT_KERNEL_AVX2)
+    {
+        i = SampleConvertAVX2(input_format, input, output_format, output, sample_count);
+    }
+    else if (kernel == SAMPLE_CONVERT_KERNEL_SSE2)
+    {
+        i = SampleConvertSSE2(input_format, input, output_format, output, sample_count);
+    }
+#endif
+    SampleConvertScalar(input_format, input, output_format, output, i, sample_count);
+}
+
+// Moves 'frame_count' frames of samples of 'sample_size' bytes (2 or 4) from 'channel_count' planes, which start
+// 'plane_stride' samples apart, to interleaved frames
+static void SampleConvertInterleave(const byte_t* planar, uint64_t plane_stride, byte_t* interleaved, uint32_t channel_count, uint64_t frame_count, uint32_t sample_size)
+{
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        if (sample_size == sizeof(int16_t))
+        {
+            const int16_t* plane = (const int16_t*)planar + (channel * plane_stride);
+            int16_t* frames = (int16_t*)interleaved + channel;
+            for (uint64_t i = 0; i < frame_count; i++)
+            {
+                frames[i * channel_count] = plane[i];
+            }
+        }
+        else
+        {
+            const int32_t* plane = (const int32_t*)planar + (channel * plane_stride);
+            int32_t* frames = (int32_t*)interleaved + channel;
+            for (uint64_t i = 0; i < frame_count; i++)
+            {
+                frames[i * channel_count] = plane[i];
+            }
+        }
+    }
+}
+
+static void SampleConvertDeinterleave(const byte_t* interleaved, byte_t* planar, uint64_t plane_stride, uint32_t channel_count, uint64_t frame_count, uint32_t sample_size)
+{
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        if (sample_size == sizeof(int16_t))
+        {
+            const int16_t* frames = (const int16_t*)interleaved + channel;
+            int16_t* plane = (int16_t*)planar + (channel * plane_stride);
+            for (uint64_t i = 0; i < frame_count; i++)
+            {
+                plane[i] = frames[i * channel_count];
+            }
+        }
+        else
+        {
+            const int32_t* frames = (const int32_t*)interleaved + channel;
+            int32_t* plane = (int32_t*)planar + (channel * plane_stride);
+            for (uint64_t i = 0; i < frame_count; i++)
+            {
+                plane[i] = frames[i * channel_count];
+            }
+        }
+    }
+}
+
+static void SampleConvertWithKernel(sample_convert_kernel_e kernel, sample_convert_format_e input_format, uint8_t input_planar, const byte_t* input, sample_convert_format_e output_format, uint8_t output_planar, byte_t* output, uint32_t channel_count, uint64_t frame_count)
+{
+    // Planes are contiguous, so buffers of the same layout are converted as one run of samples
+    if ((input_planar == output_planar) || (channel_count == 1))
+    {
+        SampleConvertSamples(kernel, input_format, input, output_format, output, frame_count * channel_count);
+        return;
+    }
+
+    // Otherwise blocks of frames are (de)interleaved on whichever side is F32 or S16, before or after being converted
+    byte_t block[SAMPLE_CONVERT_BLOCK_SIZE * sizeof(float)];
+    uint8_t block_is_input = SampleConvertIsCanonical(input_format);
+    uint32_t block_sample_size = sample_convert_bytes_per_sample[block_is_input ? input_format : output_format];
+    uint32_t input_sample_size = sample_convert_bytes_per_sample[input_format];
+    uint32_t output_sample_size = sample_convert_bytes_per_sample[output_format];
+    uint64_t block_frame_count = SAMPLE_CONVERT_BLOCK_SIZE / channel_count;
+    for (uint64_t frame = 0; frame < frame_count; frame += block_frame_count)
+    {
+        uint64_t frames = ((frame_count - frame) < block_frame_count) ? (frame_count - frame) : block_frame_count;
+        if (input_planar == 1)
+        {
+            byte_t* output_frames = output + (frame * channel_count * output_sample_size);
+            if (block_is_input == 1)
+            {
+                SampleConvertInterleave(input + (frame * input_sample_size), frame_count, block, channel_count, frames, block_sample_size);
+                SampleConvertSamples(kernel, input_format, block, output_format, output_frames, frames * channel_count);
+            }
+            else
+            {
+                for (uint32_t channel = 0; channel < channel_count; channel++)
+                {
+                    const byte_t* plane = input + (((channel * frame_count) + frame) * input_sample_size);
+                    SampleConvertSamples(kernel, input_format, plane, output_format, block + (channel * frames * block_sample_size), frames);
+                }
+                SampleConvertInterleave(block, frames, output_frames, channel_count, frames, block_sample_size);
+            }
+        }
+        else
+        {
+            const byte_t* input_frames = input + (frame * channel_count * input_sample_size);
+            if (block_is_input == 1)
+            {
+                SampleConvertDeinterleave(input_frames, block, frames, channel_count, frames, block_sample_size);
+                for (uint32_t channel = 0; channel < channel_count; channel++)
+                {
+                    byte_t* plane = output + (((channel * frame_count) + frame) * output_sample_size);
+                    SampleConvertSamples(kernel, input_format, block + (channel * frames * block_sample_size), output_format, plane, frames);
+                }
+            }
+            else
+            {
+                SampleConvertSamples(kernel, input_format, input_frames, output_format, block, frames * channel_count);
+                SampleConvertDeinterleave(block, output + (frame * output_sample_size), frame_count, channel_count, frames, block_sample_size);
+            }
+        }
+    }
+}
+
+void SampleConvert(sample_convert_format_e input_format, uint8_t input_planar, const void* input, sample_convert_format_e output_format, uint8_t output_planar, void* output, uint32_t channel_count, uint64_t frame_count)
+{
+    assert(input_format < SAMPLE_CONVERT_FORMAT_COUNT);
+    assert(output_format < SAMPLE_CONVERT_FORMAT_COUNT);
+    assert(SampleConvertIsCanonical(input_format) || SampleConvertIsCanonical(output_format));
+    assert(input != NULL);
+    assert(output != NULL);
+    assert((channel_count > 0) && (channel_count <= SAMPLE_CONVERT_BLOCK_SIZE));
+
+    SampleConvertWithKernel(SampleConvertBestKernel(), input_format, input_planar, (const byte_t*)input, output_format, output_planar, (byte_t*)output, channel_count, frame_count);
+}
+
+sample_convert_format_e SampleConvertFormat(uint32_t bps, sample_format_e sample_format)
+{
+    assert((bps >= 1) && (bps <= 4));
+    assert((sample_format == SAMPLE_FORMAT_INT) || (bps == sizeof(float)));
+
+    switch (bps)
+    {
+        case 1: { return SAMPLE_CONVERT_FORMAT_U8; } break;
+        case 2: { return SAMPLE_CONVERT_FORMAT_S16; } break;
+        case 3: { return SAMPLE_CONVERT_FORMAT_S24; } break;
+        default: { return (sample_format == SAMPLE_FORMAT_FLOAT) ? SAMPLE_CONVERT_FORMAT_F32 : SAMPLE_CONVERT_FORMAT_S32; } break;
+    }
+}
+
+uint32_t SampleConvertBytesPerSample(sample_convert_format_e format)
+{
+    assert(format < SAMPLE_CONVERT_FORMAT_COUNT);
+
+    return sample_convert_bytes_per_sample[format];
+}
+
+// Fills 'input' with pseudo-random samples of 'format' over its whole range, with floats reaching past full scale
+static void SampleConvertBenchmarkFill(sample_convert_format_e format, byte_t* input, uint64_t sample_count)
+{
+    uint32_t state = 0x9E3779B9u;
+    for (uint64_t i = 0; i < sample_count; i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        switch (format)
+        {
+            case SAMPLE_CONVERT_FORMAT_U8: { input[i] = (byte_t)state; } break;
+            case SAMPLE_CONVERT_FORMAT_S16: { ((int16_t*)input)[i] = (int16_t)state; } break;
+            case SAMPLE_CONVERT_FORMAT_S24: { memcpy(input + (i * 3), &state, 3); } break;
+            case SAMPLE_CONVERT_FORMAT_S24_IN_32: { ((int32_t*)input)[i] = (int32_t)state >> 8; } break;
+            case SAMPLE_CONVERT_FORMAT_S32: { ((uint32_t*)input)[i] = state; } break;
+            default: { ((float*)input)[i] = (float)(int32_t)state * SAMPLE_CONVERT_INT_TO_FLOAT * 1.125f; } break;
+        }
+    }
+}
+
+// Converts the benchmark buffer 'SAMPLE_CONVERT_BENCHMARK_ITERATION_COUNT' times, and returns millions of samples per second
+static double SampleConvertBenchmarkRun(sample_convert_kernel_e kernel, sample_convert_format_e input_format, uint8_t input_planar, const byte_t* input, sample_convert_format_e output_format, uint8_t output_planar, byte_t* output, uint32_t channel_count)
+{
+    uint64_t frame_count = SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT / channel_count;
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+    for (uint32_t i = 0; i < SAMPLE_CONVERT_BENCHMARK_ITERATION_COUNT; i++)
+    {
+        SampleConvertWithKernel(kernel, input_format, input_planar, input, output_format, output_planar, output, channel_count, frame_count);
+    }
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+    double sample_count = (double)(frame_count * channel_count) * SAMPLE_CONVERT_BENCHMARK_ITERATION_COUNT;
+    return (elapsed_seconds > 0.0) ? (sample_count / elapsed_seconds / 1000000.0) : 0.0;
+}
+
+uint32_t SampleConvertBenchmark(void)
+{
+    // Packed 24-bit samples are read and written a little past the end of a buffer
+    uint64_t buffer_size = (SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT * sizeof(float)) + 16;
+    byte_t* input = (byte_t*)malloc(buffer_size);
+    byte_t* expected = (byte_t*)malloc(buffer_size);
+    byte_t* output = (byte_t*)malloc(buffer_size);
+    sample_convert_kernel_e best_kernel = SampleConvertBestKernel();
+
+    // Every pair with a side in F32 or S16, with each kernel on one interleaved stereo buffer
+    uint32_t mismatch_count = 0;
+    printf("Million samples converted per second, '!' where a kernel differs from converting one sample at a time\n");
+    printf("%-20s", "Interleaved");
+    for (uint32_t kernel = 0; kernel < SAMPLE_CONVERT_KERNEL_COUNT; kernel++)
+    {
+        printf(" %10s", sample_convert_kernel_names[kernel]);
+    }
+    printf("\n");
+    for (uint32_t input_format = 0; input_format < SAMPLE_CONVERT_FORMAT_COUNT; input_format++)
+    {
+        for (uint32_t output_format = 0; output_format < SAMPLE_CONVERT_FORMAT_COUNT; output_format++)
+        {
+            if ((input_format == output_format) ||
+                ((SampleConvertIsCanonical(input_format) == 0) && (SampleConvertIsCanonical(output_format) == 0)))
+            {
+                continue;
+            }
+
+            SampleConvertBenchmarkFill(input_format, input, SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT);
+            SampleConvertScalar(input_format, input, output_format, expected, 0, SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT);
+            uint64_t output_size = SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT * sample_convert_bytes_per_sample[output_format];
+            uint8_t mismatch = 0;
+            printf("%-8s -> %-8s  ", sample_convert_format_names[input_format], sample_convert_format_names[output_format]);
+            for (uint32_t kernel = 0; kernel < SAMPLE_CONVERT_KERNEL_COUNT; kernel++)
+            {
+                if (kernel > (uint32_t)best_kernel)
+                {
+                    printf(" %10s", "-");
+                    continue;
+                }
+                memset(output, 0, buffer_size);
+                double rate = SampleConvertBenchmarkRun((sample_convert_kernel_e)kernel, input_format, 0, input, output_format, 0, output, 1);
+                uint8_t kernel_mismatch = (memcmp(output, expected, output_size) != 0);
+                printf(" %9.1f%c", rate, (kernel_mismatch == 1) ? '!' : ' ');
+                mismatch |= kernel_mismatch;
+            }
+            printf("\n");
+            mismatch_count += mismatch;
+        }
+    }
+
+    // Converting stereo between planar and interleaved with the best kernel, against the scalar code
+    for (uint32_t pass = 0; pass < 2; pass++)
+    {
+        uint8_t input_planar = (pass == 0) ? 1 : 0;
+        printf("\n%-20s %10s\n", (input_planar == 1) ? "Planar->interleaved" : "Interleaved->planar", sample_convert_kernel_names[best_kernel]);
+        for (uint32_t format = 0; format < SAMPLE_CONVERT_FORMAT_COUNT; format++)
+        {
+            sample_convert_format_e input_format = (input_planar == 1) ? (sample_convert_format_e)format : SAMPLE_CONVERT_FORMAT_F32;
+            sample_convert_format_e output_format = (input_planar == 1) ? SAMPLE_CONVERT_FORMAT_F32 : (sample_convert_format_e)format;
+            uint64_t frame_count = SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT / 2;
+            SampleConvertBenchmarkFill(input_format, input, SAMPLE_CONVERT_BENCHMARK_SAMPLE_COUNT);
+            SampleConvertWithKernel(SAMPLE_CONVERT_KERNEL_SCALAR, input_format, input_planar, input, output_format, (uint8_t)(1 - input_planar), expected, 2, frame_count);
+            memset(output, 0, buffer_size);
+            double rate = SampleConvertBenchmarkRun(best_kernel, input_format, input_planar, input, output_format, (uint8_t)(1 - input_planar), output, 2);
+            uint8_t mismatch = (memcmp(output, expected, frame_count * 2 * sample_convert_bytes_per_sample[output_format]) != 0);
+            printf("%-8s -> %-8s   %9.1f%c\n", sample_convert_format_names[input_format], sample_convert_format_names[output_format], rate, (mismatch == 1) ? '!' : ' ');
+            mismatch_count += mismatch;
+        }
+    }
+
+    free(input);
+    free(expected);
+    free(output);
+    printf("Mismatches: %u\n", mismatch_count);
+    return mismatch_count;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef SAMPLE_CONVERT_H
+#define SAMPLE_CONVERT_H
+
+#include "song.h"
+
+#include <stdint.h>
+
+// Formats of a single sample, all little-endian
+typedef enum
+{
+    SAMPLE_CONVERT_FORMAT_U8 = 0, // Unsigned, centered on 128
+    SAMPLE_CONVERT_FORMAT_S16 = 1,
+    SAMPLE_CONVERT_FORMAT_S24 = 2, // Packed into 3 bytes
+    SAMPLE_CONVERT_FORMAT_S24_IN_32 = 3, // In the least significant 24 bits of 4 bytes, sign-extended
+    SAMPLE_CONVERT_FORMAT_S32 = 4, // Also 24-in-32 in the most significant bits, as WAV files and audio devices store it
+    SAMPLE_CONVERT_FORMAT_F32 = 5, // Full scale is [-1, 1)
+    SAMPLE_CONVERT_FORMAT_COUNT = 6
+} sample_convert_format_e;
+
+/**
+ * SampleConvert() converts 'frame_count' frames of 'channel_count' samples from 'input' to 'output'. Either buffer is
+ * interleaved (a frame's samples follow one another), or planar if 'input_planar' or 'output_planar' is 1 (each channel's
+ * samples follow one another, one channel after the other). One of the formats must be SAMPLE_CONVERT_FORMAT_F32 or
+ * SAMPLE_CONVERT_FORMAT_S16, which the rest of the player works in.
+ * 
+ * Integer samples are converted by shifting them into the most significant bits of 32, and back out of them rounded to
+ * nearest and saturated, so converting to a wider format and back gives the same samples. Floats are scaled by 2^31 and
+ * clamped to full scale on the way to integers, and by 2^-31 on the way back. Out of range floats are clipped.
+ * 
+ * Samples are converted by AVX2 kernels when the CPU has them and by SSE2 kernels otherwise (packed 24-bit samples are
+ * shuffled into place by AVX2 only), with the tail of a buffer and other CPUs converted one sample at a time. Planar
+ * buffers are (de)interleaved on the side in F32 or S16, in blocks that stay in the cache.
+ * 
+ * SampleConvertFormat() returns the format of samples of 'bps' bytes, of which 4 bytes are S32 or F32 depending on
+ * 'sample_format'.
+ * 
+ * SampleConvertBytesPerSample() returns the size of a sample of 'format'.
+ * 
+ * SampleConvertBenchmark() converts a buffer between every pair of formats with each kernel the CPU has, checks that they
+ * all give the same samples as converting one at a time, and prints how many samples per second each one converts.
+ * Returns number of pairs where a kernel gave different samples
+*/
+void                    SampleConvert(sample_convert_format_e input_format, uint8_t input_planar, const void* input, sample_convert_format_e output_format, uint8_t output_planar, void* output, uint32_t channel_count, uint64_t frame_count);
+sample_convert_format_e SampleConvertFormat(uint32_t bps, sample_format_e sample_format);
+uint32_t                SampleConvertBytesPerSample(sample_convert_format_e format);
+uint32_t                SampleConvertBenchmark(void);
+
+#endif
\ No newline at end of file
@@ -16,9 +16,12 @@
  * OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "flac.h"
 #include "song.h"
+#include "wav.h"
 
 #include <assert.h>
+#include <stdlib.h>
 
 void SongInit(song_t* song)
 {
@@ -30,11 +33,20 @@ void SongInit(song_t* song)
     song->song_path_offset = NULL;
     //song->audio_data = NULL;
     song->file = NULL;
+    song->flac = NULL;
+    song->wav_source = NULL;
     song->audio_data_size = 0;
+    song->audio_data_offset = 0;
+    song->audio_data_end = 0;
     song->song_type = SONG_TYPE_INVALID;
     song->sample_rate = 0;
     song->channel_count = 0;
     song->bps = 0;
+    song->valid_bits_per_sample = 0;
+    song->sample_format = SAMPLE_FORMAT_INT;
+    song->track_number = 0;
+    song->track_sample_start = 0;
+    song->track_sample_end = 0;
 }
 
 void SongFreeAudioData(song_t* song)
@@ -42,6 +54,84 @@ void SongFreeAudioData(song_t* song)
     assert(song != NULL);
     assert(song->file != NULL);
     
+    if (song->flac != NULL)
+    {
+        FLACFree(song->flac);
+        song->flac = NULL;
+    }
+    if (song->wav_source != NULL)
+    {
+        WAVFree(song->wav_source);
+        song->wav_source = NULL;
+    }
     fclose(song->file);
     song->file = NULL;
+}
+
+void SongMoveAudioData(song_t* song, song_t* song_next)
+{
+    assert(song != NULL);
+    assert(song->file != NULL);
+    assert(song_next != NULL);
+    assert(song_next->file == NULL);
+    assert(song_next->song_type == song->song_type);
+
+    song_next->file = song->file;
+    song_next->flac = song->flac;
+    song_next->wav_source = song->wav_source;
+    song_next->file_size = song->file_size;
+    song_next->audio_data_size = song->audio_data_size;
+    song_next->audio_data_offset = song->audio_data_offset;
+    song_next->audio_data_end = song->audio_data_end;
+    song_next->sample_rate = song->sample_rate;
+    song_next->channel_count = song->channel_count;
+    song_next->bps = song->bps;
+    song_next->valid_bits_per_sample = song->valid_bits_per_sample;
+    song_next->sample_format = song->sample_format;
+    song->file = NULL;
+    song->flac = NULL;
+    song->wav_source = NULL;
+}
+
+uint8_t SongStartTrack(song_t* song)
+{
+    assert(song != NULL);
+    assert(song->file != NULL);
+    assert((song->track_sample_end == 0) || (song->track_sample_end > song->track_sample_start));
+
+    switch (song->song_type)
+    {
+        case SONG_TYPE_WAV:
+        {
+            // Offsets are in the file, whose samples may be converted to another size for playback
+            uint64_t bps_all_channels = (uint64_t)song->wav_source->input_bps * song->channel_count;
+            uint64_t track_offset = song->audio_data_offset + (song->track_sample_start * bps_all_channels);
+            song->audio_data_end = song->audio_data_offset + song->audio_data_size;
+            if ((song->track_sample_end != 0) &&
+                ((song->audio_data_offset + (song->track_sample_end * bps_all_channels)) < song->audio_data_end))
+            {
+                song->audio_data_end = song->audio_data_offset + (song->track_sample_end * bps_all_channels);
+            }
+            if (track_offset >= song->audio_data_end)
+            {
+                return 0;
+            }
+            if (song->wav_source->read_ahead.read_offset != track_offset)
+            {
+                WAVSetReadOffset(song->wav_source, track_offset);
+            }
+            return 1;
+        } break;
+
+        case SONG_TYPE_FLAC:
+        {
+            return FLACSetTrack(song->flac, song->track_sample_start, song->track_sample_end);
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid sound file type %i\n", __FILE__, __LINE__, song->song_type);
+            exit(EXIT_FAILURE);
+        } break;
+    }
 }
\ No newline at end of file
@@ -39,6 +39,15 @@ typedef enum
     SONG_TYPE_FLAC = 2
 } song_type_e;
 
+typedef enum
+{
+    SAMPLE_FORMAT_INT   = 0, // Signed integers (unsigned if 8-bit), with the valid bits in the most significant bits
+    SAMPLE_FORMAT_FLOAT = 1  // 32-bit floats in [-1, 1)
+} sample_format_e;
+
+struct flac_t;
+struct wav_source_t;
+
 // TODO (Daniel): split so that each song in a playlist doesn't require this much memory (wasteful/thrashy)
 typedef struct
 {
@@ -48,15 +57,37 @@ typedef struct
     char* song_path_offset; // Not allocated, just an offset into an array
     //byte_t* audio_data;
     FILE* file;
+    struct flac_t* flac; // Only for SONG_TYPE_FLAC
+    struct wav_source_t* wav_source; // Only for SONG_TYPE_WAV
     uint64_t file_size;
     uint64_t audio_data_size;
+    uint64_t audio_data_offset; // File offset of the first byte of audio data, only for SONG_TYPE_WAV
+    uint64_t audio_data_end; // File offset where playback stops, only for SONG_TYPE_WAV
     song_type_e song_type;
-    uint16_t sample_rate;
+    uint32_t sample_rate;
     uint8_t channel_count;
     uint8_t bps; // Bytes per sample
+    uint8_t valid_bits_per_sample;
+    sample_format_e sample_format;
+
+    // A virtual track is one of several songs stored in a single file, e.g. an album ripped to one file with a cue sheet
+    uint8_t track_number; // 0 if the song is the whole file
+    uint64_t track_sample_start; // First sample of the song in the file
+    uint64_t track_sample_end; // Sample after the song's last one, 0 if the song plays to the end of the file
 } song_t;
 
-void SongInit(song_t* song);
-void SongFreeAudioData(song_t* song);
+/**
+ * SongMoveAudioData() hands the open file (and FLAC decoder or WAV mapping) of 'song' over to 'song_next', another song
+ * in the same file, so that changing between virtual tracks of a file doesn't reopen it.
+ * 
+ * SongStartTrack() positions a loaded song at the first sample of its track, and makes playback stop after its last
+ * sample. It only seeks if playback isn't at the first sample already, so a track following the one played back before
+ * it in the file continues without a gap.
+ * Returns 0 if the track lies outside the file's audio data
+*/
+void    SongInit(song_t* song);
+void    SongFreeAudioData(song_t* song);
+void    SongMoveAudioData(song_t* song, song_t* song_next);
+uint8_t SongStartTrack(song_t* song);
 
 #endif
\ No newline at end of file
@@ -16,6 +16,7 @@
  * OR OTHER DEALINGS IN THE SOFTWARE.
 */
 
+#include "analyzer.h"
 #include "audio.h"
 #include "flac.h"
 #include "playlist.h"
@@ -34,7 +35,10 @@ static HANDLE audio_event = NULL;
 #define audio_buffer_size 8192
 static WAVEHDR audio_headers[audio_buffer_count];
 static byte_t audio_buffers[audio_buffer_count][audio_buffer_size];
+static const byte_t* audio_buffer_data[audio_buffer_count]; // Either an audio buffer, or a chunk of a WAV file's mapping
 static uint32_t audio_buffer_data_available_size[audio_buffer_count];
+static uint64_t audio_buffer_positions[audio_buffer_count]; // Sample in the song each audio buffer starts at
+static uint64_t audio_position = 0; // Sample in the song the next audio buffer starts at
 static uint8_t audio_buffer_index = 0;
 
 void CALLBACK waveOutProc(HWAVEOUT hwo, UINT uMsg, DWORD_PTR dwInstance, DWORD_PTR dwParam1, DWORD_PTR dwParam2)
@@ -70,6 +74,98 @@ static byte_t* upsampled_audio_data_with_prefetch_buffer = NULL;
 static byte_t* upsampled_audio_data_filtered = NULL;
 static byte_t* upsampled_audio_data_finals[audio_buffer_count];
 static float slow_down_factor = 1.0f;//0.8f;
+
+// Decodes the next chunk of the current song's audio data into 'output', or for WAV files, which need no decoding, finds it
+// in the file's mapping without copying it unless it has to be converted. Sets 'data' to point to the chunk
+static uint32_t SoundPlayerLoadData(playback_data_t* playback_data, uint64_t output_size, byte_t* output, const byte_t** data)
+{
+    switch (playback_data->song_type)
+    {
+        case SONG_TYPE_WAV:
+        {
+            return WAVLoadData(playback_data, output_size, output, data);
+        } break;
+
+        case SONG_TYPE_FLAC:
+        {
+            *data = output;
+            return FLACLoadData(playback_data, output_size, output);
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid sound file type %i\n", __FILE__, __LINE__, playback_data->song_type);
+            exit(EXIT_FAILURE);
+        } break;
+    }
+}
+
+// Prints whether reading a song's file kept ahead of playing it back, which it did if playback never had to wait for it
+static void SoundPlayerReportReadAhead(const song_t* song)
+{
+    const read_ahead_t* read_ahead = NULL;
+    if (song->flac != NULL)
+    {
+        read_ahead = &song->flac->read_ahead;
+    }
+    else if (song->wav_source != NULL)
+    {
+        read_ahead = &song->wav_source->read_ahead;
+    }
+    if (read_ahead != NULL)
+    {
+        printf("Read ahead %u blocks of %s with %u underruns\n", read_ahead->block_read_count, song->song_path_offset, read_ahead->underrun_count);
+    }
+}
+
+// FLAC files with more than 16 bits per sample are played back at full resolution if the audio device supports it,
+// first as 24-in-32-bit integers and then as 32-bit floats, and otherwise dithered down to 16 bits
+static void SoundPlayerPickFLACOutputFormat(song_t* song)
+{
+    if (song->flac->streaminfo.bits_per_sample <= 16)
+    {
+        return;
+    }
+
+    WAVEFORMATEXTENSIBLE format;
+    FLACSetOutputFormat(song, SAMPLE_FORMAT_INT, sizeof(int32_t));
+    AudioFormatCreate(song->sample_rate, song->channel_count, song->bps, song->valid_bits_per_sample, song->sample_format, &format);
+    if (AudioDeviceSupportsPlayback(&format) == 1)
+    {
+        return;
+    }
+
+    FLACSetOutputFormat(song, SAMPLE_FORMAT_FLOAT, sizeof(float));
+    AudioFormatCreate(song->sample_rate, song->channel_count, song->bps, song->valid_bits_per_sample, song->sample_format, &format);
+    if (AudioDeviceSupportsPlayback(&format) == 1)
+    {
+        return;
+    }
+
+    FLACSetOutputFormat(song, SAMPLE_FORMAT_INT, sizeof(int16_t));
+}
+
+// WAV files are played back in their own format if the audio device supports it, and are otherwise converted to 32-bit
+// floats, or failing that to 16 bits
+static void SoundPlayerPickWAVOutputFormat(song_t* song)
+{
+    WAVEFORMATEXTENSIBLE format;
+    AudioFormatCreate(song->sample_rate, song->channel_count, song->bps, song->valid_bits_per_sample, song->sample_format, &format);
+    if (AudioDeviceSupportsPlayback(&format) == 1)
+    {
+        return;
+    }
+
+    WAVSetOutputFormat(song, SAMPLE_FORMAT_FLOAT, sizeof(float));
+    AudioFormatCreate(song->sample_rate, song->channel_count, song->bps, song->valid_bits_per_sample, song->sample_format, &format);
+    if (AudioDeviceSupportsPlayback(&format) == 1)
+    {
+        return;
+    }
+
+    WAVSetOutputFormat(song, SAMPLE_FORMAT_INT, sizeof(int16_t));
+}
+
 DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
 {
     // Cast input pointer
@@ -78,7 +174,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
     // Windows audio device data
     HWAVEOUT* windows_audio_device = &shared_data->audio_device;
     WAVEOUTCAPS windows_audio_device_capabilities;
-    WAVEFORMATEX windows_audio_device_format;
+    WAVEFORMATEXTENSIBLE windows_audio_device_format;
     WAVEHDR windows_audio_device_wave_header;
     windows_audio_device_wave_header.lpData = NULL;
     windows_audio_device_wave_header.dwFlags = 0;
@@ -114,6 +210,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
     callback_data.event = shared_data->event;
     callback_data.callback_count_atomic = 0;
     sound_player_operation_e sound_player_next_operation = SOUND_PLAYER_OP_READY;
+    uint8_t song_finished = 0; // The sound player asked for the next song, as the current one has been played back to its end
 
     // Loop
     while (1)
@@ -134,6 +231,8 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
         {
             // Regardless of the result of handling the UI thread's next operation it will be reset
             shared_data->ui_next_operation = SOUND_PLAYER_OP_READY;
+            uint8_t song_current_finished = song_finished;
+            song_finished = 0;
 
             // Local variables
             song_t* song_current = shared_data->song;
@@ -142,6 +241,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
             song_error_e song_error = SONG_ERROR_NO;
             uint8_t operation_success = 0;
             uint8_t load_initial_chunks = 0;
+            char* song_md5_mismatch_path = NULL;
 
             // Handle next operation
             switch (ui_next_operation)
@@ -204,12 +304,20 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                         case SONG_TYPE_WAV:
                         {
                             song_error = WAVLoadHeader(song_next);
+                            if (song_error == SONG_ERROR_NO)
+                            {
+                                SoundPlayerPickWAVOutputFormat(song_next);
+                            }
                         } break;
 
                         case SONG_TYPE_FLAC:
                         {
-                            assert(0);
-                            //song_error = FLACLoad(song_next);
+                            song_error = FLACLoadHeader(song_next);
+                            if (song_error == SONG_ERROR_NO)
+                            {
+                                song_next->flac->md5_verify_enabled = shared_data->md5_verify_enabled;
+                                SoundPlayerPickFLACOutputFormat(song_next);
+                            }
                         } break;
 
                         default:
@@ -218,6 +326,12 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                             exit(EXIT_FAILURE);
                         }
                     }
+                    if ((song_error == SONG_ERROR_NO) &&
+                        (SongStartTrack(song_next) == 0))
+                    {
+                        SongFreeAudioData(song_next);
+                        song_error = SONG_ERROR_INVALID_FILE;
+                    }
                     switch (song_error)
                     {
                         case SONG_ERROR_NO: {} break;
@@ -250,9 +364,10 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                     }
 
                     // 3) Pick audio device WAVE_MAPPER, and check that it can play the next WAV file's format
-                    if (AudioDeviceSupportsPlayback(song_next->sample_rate, song_next->bps, song_next->channel_count) == 0)
+                    AudioFormatCreate(song_next->sample_rate, song_next->channel_count, song_next->bps, song_next->valid_bits_per_sample, song_next->sample_format, &windows_audio_device_format);
+                    if (AudioDeviceSupportsPlayback(&windows_audio_device_format) == 0)
                     {
-                        sprintf(shared_data->error_message, "Unsupported audio format:\n\tSample rate: %i\n\tBits per sample: %i", song_next->sample_rate, song_next->bps * 8);
+                        sprintf(shared_data->error_message, "Unsupported audio format:\n\tSample rate: %i\n\tBits per sample: %i", song_next->sample_rate, song_next->valid_bits_per_sample);
                         shared_data->error_message_changed = 1;
 
                         // Loading of sound file was complete, but playback isn't supported.
@@ -263,13 +378,6 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                         PlaylistInit(&playlist_next);
                         break;
                     }
-                    windows_audio_device_format.wFormatTag = WAVE_FORMAT_PCM;
-                    windows_audio_device_format.nChannels = song_next->channel_count;
-                    windows_audio_device_format.nSamplesPerSec = song_next->sample_rate;
-                    windows_audio_device_format.nAvgBytesPerSec = (song_next->sample_rate * song_next->channel_count * song_next->bps);
-                    windows_audio_device_format.nBlockAlign = (song_next->channel_count * song_next->bps);
-                    windows_audio_device_format.wBitsPerSample = song_next->bps * 8;
-                    windows_audio_device_format.cbSize = 0;
 
                     // 4) If audio device is already open, close it
                     if (*windows_audio_device != NULL)
@@ -278,7 +386,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                     }
 
                     // 5) Open audio device with current settings
-                    AudioOpen(windows_audio_device, &windows_audio_device_format, (DWORD_PTR)&waveOutProc, (DWORD_PTR)&callback_data);
+                    AudioOpen(windows_audio_device, &windows_audio_device_format.Format, (DWORD_PTR)&waveOutProc, (DWORD_PTR)&callback_data);
 
                     // Reaching this point means there were no errors
                     operation_success = 1;
@@ -309,6 +417,18 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                 {
                     assert(playlist_current.songs != NULL);
 
+                    // The current song has been verified if it was played back to the end
+                    if ((song_current != NULL) &&
+                        (song_current->flac != NULL) &&
+                        (song_current->flac->md5_result == FLAC_MD5_RESULT_MISMATCH))
+                    {
+                        song_md5_mismatch_path = song_current->song_path_offset;
+                    }
+                    if (song_current != NULL)
+                    {
+                        SoundPlayerReportReadAhead(song_current);
+                    }
+
                     // 1) Select next sound file to play
                     // TODO: this case could be optimized
                     /*if ((shared_data->loop_state == SOUND_PLAYER_LOOP_SINGLE) ||
@@ -341,18 +461,70 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                         song_next = &playlist_current.songs[playlist_current.current_song_index];
                     }
 
+                    // A song in the same file as the current one, e.g. the next track of an album ripped to a single file, keeps
+                    // the file and decoder open and seeks to its track. The audio device stays open, as the format is the same.
+                    if ((song_current != NULL) &&
+                        (song_next->song_type == song_current->song_type) &&
+                        (strcmp(song_next->song_path_offset, song_current->song_path_offset) == 0))
+                    {
+                        if (song_next != song_current)
+                        {
+                            SongMoveAudioData(song_current, song_next);
+                        }
+                        if (SongStartTrack(song_next) == 0)
+                        {
+                            sprintf(shared_data->error_message, "Not a proper audio file: %s", song_next->song_path_offset);
+                            shared_data->error_message_changed = 1;
+                            if (song_next != song_current)
+                            {
+                                SongMoveAudioData(song_next, song_current);
+                            }
+                            break;
+                        }
+
+                        if (song_current_finished == 1)
+                        {
+                            // The current track has been played back to its end, so the next track is loaded into the
+                            // audio buffers as they finish playing back, right after the buffers already queued
+                            playback_data.audio_data_end = song_next->audio_data_end;
+                        }
+                        else
+                        {
+                            // Skipping to the next track drops what's left of the current one
+                            AudioReset(*windows_audio_device, audio_headers, audio_buffer_count);
+                            load_initial_chunks = 1;
+                            callback_count_overruled = 1;
+                        }
+
+                        // Reaching this point means there were no errors
+                        operation_success = 1;
+                        sound_player_operation_overruled = 1;
+
+                        // Update current song
+                        shared_data->song = song_next;
+                        break;
+                    }
+
                     // 3) Load sound file
                     switch (song_next->song_type)
                     {
                         case SONG_TYPE_WAV:
                         {
                             song_error = WAVLoadHeader(song_next);
+                            if (song_error == SONG_ERROR_NO)
+                            {
+                                SoundPlayerPickWAVOutputFormat(song_next);
+                            }
                         } break;
 
                         case SONG_TYPE_FLAC:
                         {
-                            assert(0);
-                            //song_error = FLACLoad(song_next);
+                            song_error = FLACLoadHeader(song_next);
+                            if (song_error == SONG_ERROR_NO)
+                            {
+                                song_next->flac->md5_verify_enabled = shared_data->md5_verify_enabled;
+                                SoundPlayerPickFLACOutputFormat(song_next);
+                            }
                         } break;
 
                         default:
@@ -361,6 +533,12 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                             exit(EXIT_FAILURE);
                         }
                     }
+                    if ((song_error == SONG_ERROR_NO) &&
+                        (SongStartTrack(song_next) == 0))
+                    {
+                        SongFreeAudioData(song_next);
+                        song_error = SONG_ERROR_INVALID_FILE;
+                    }
                     switch (song_error)
                     {
                         case SONG_ERROR_NO: {} break;
@@ -391,9 +569,10 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                     }
 
                     // 4) Pick audio device WAVE_MAPPER, and check that it can play the next WAV file's format
-                    if (AudioDeviceSupportsPlayback(song_next->sample_rate, song_next->bps, song_next->channel_count) == 0)
+                    AudioFormatCreate(song_next->sample_rate, song_next->channel_count, song_next->bps, song_next->valid_bits_per_sample, song_next->sample_format, &windows_audio_device_format);
+                    if (AudioDeviceSupportsPlayback(&windows_audio_device_format) == 0)
                     {
-                        sprintf(shared_data->error_message, "Unsupported audio format:\n\tSample rate: %i\n\tBits per sample: %i", song_next->sample_rate, song_next->bps * 8);
+                        sprintf(shared_data->error_message, "Unsupported audio format:\n\tSample rate: %i\n\tBits per sample: %i", song_next->sample_rate, song_next->valid_bits_per_sample);
                         shared_data->error_message_changed = 1;
 
                         // Loading of WAV file was complete, but playback isn't supported.
@@ -401,18 +580,11 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                         SongFreeAudioData(song_next);
                         break;
                     }
-                    windows_audio_device_format.wFormatTag = WAVE_FORMAT_PCM;
-                    windows_audio_device_format.nChannels = song_next->channel_count;
-                    windows_audio_device_format.nSamplesPerSec = song_next->sample_rate;
-                    windows_audio_device_format.nAvgBytesPerSec = song_next->sample_rate * song_next->channel_count * song_next->bps;
-                    windows_audio_device_format.nBlockAlign = song_next->channel_count * song_next->bps; // If wFormatTag is WAVE_FORMAT_PCM or WAVE_FORMAT_EXTENSIBLE, nBlockAlign must be equal to the product of nChannels and wBitsPerSample divided by 8 (bits per byte).
-                    windows_audio_device_format.wBitsPerSample = song_next->bps * 8;
-                    windows_audio_device_format.cbSize = 0;
 
                     // 6) Play next sound file
                     assert(windows_audio_device != NULL);
                     AudioClose(*windows_audio_device, audio_headers, audio_buffer_count);
-                    AudioOpen(windows_audio_device, &windows_audio_device_format, (DWORD_PTR)&waveOutProc, (DWORD_PTR)&callback_data);
+                    AudioOpen(windows_audio_device, &windows_audio_device_format.Format, (DWORD_PTR)&waveOutProc, (DWORD_PTR)&callback_data);
 
                     // Reaching this point means there were no errors
                     operation_success = 1;
@@ -475,13 +647,20 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                 shared_data->error_message[0] = '\0';
                 shared_data->error_message_changed = 1;
             }
+            if (song_md5_mismatch_path != NULL)
+            {
+                snprintf(shared_data->error_message, MAX_PATH, "MD5 mismatch: %s", song_md5_mismatch_path);
+                shared_data->error_message_changed = 1;
+            }
 
             // If the operation was handled successfully and the operation was either PLAY, NEXT or PREVIOUS
             // we want to
             //  1) reset the callback counter, so that we only start loading in new chunks when the initial chunks of the new songs start to finish playback
             //  2) reset the event, so that if the callback has signaled the event while we were handling the operation, we ignore that signal as we're loading
             //     in new initial chunks, and reset the callback counter
+            // unless playback continues into the next track of the same file without loading initial chunks
             if ((operation_success == 1) &&
+                (load_initial_chunks == 1) &&
                 ((ui_next_operation == SOUND_PLAYER_OP_PLAY) || (ui_next_operation == SOUND_PLAYER_OP_NEXT) || (ui_next_operation == SOUND_PLAYER_OP_PREVIOUS)))
             {
                 InterlockedExchange((volatile LONG*)&callback_data.callback_count_atomic, 0);
@@ -509,11 +688,16 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
 
                 // Set playback data
                 playback_data.audio_device = shared_data->audio_device;
+                playback_data.song_type = shared_data->song->song_type;
                 playback_data.file = shared_data->song->file;
+                playback_data.flac = shared_data->song->flac;
+                playback_data.wav_source = shared_data->song->wav_source;
                 playback_data.file_size = shared_data->song->file_size;
+                playback_data.audio_data_end = shared_data->song->audio_data_end;
                 playback_data.sample_rate = shared_data->song->sample_rate;
                 playback_data.channel_count = shared_data->song->channel_count;
                 playback_data.bps = shared_data->song->bps;
+                playback_data.sample_format = shared_data->song->sample_format;
 
                 // Check if any buffers already exists, and if so, free them
                 if (filter != NULL)
@@ -560,10 +744,13 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
 
                 // Preload first N-1 audio_buffers
                 audio_buffer_index = 0;
+                audio_position = 0;
                 for (uint32_t i = 0; i < audio_buffer_count - 1; i++)
                 {
                     // Load audio data
-                    audio_buffer_data_available_size[audio_buffer_index] = WAVLoadData(&playback_data, audio_buffer_size, audio_buffers[audio_buffer_index]);
+                    audio_buffer_data_available_size[audio_buffer_index] = SoundPlayerLoadData(&playback_data, audio_buffer_size, audio_buffers[audio_buffer_index], &audio_buffer_data[audio_buffer_index]);
+                    audio_buffer_positions[audio_buffer_index] = audio_position;
+                    audio_position += audio_buffer_data_available_size[audio_buffer_index] / bps_all_channels;
 
                     // Ensure there's audio data
                     if (audio_buffer_data_available_size[audio_buffer_index] == 0)
@@ -575,7 +762,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                     {
                         // Perform sample-rate conversion
                         uint32_t sample_count_all_channels = audio_buffer_data_available_size[audio_buffer_index] / bps;
-                        uint32_t sample_count_output_all_channels = SampleRateConvert(input_rate, output_rate, L, M, slow_down_factor, sample_count_all_channels, bps, channel_count, audio_buffers[audio_buffer_index], upsampled_audio_data, prefetch_buffer, filter_length, filter, upsampled_audio_data_with_prefetch_buffer, upsampled_audio_data_filtered, upsampled_audio_data_finals[audio_buffer_index]);
+                        uint32_t sample_count_output_all_channels = SampleRateConvert(input_rate, output_rate, L, M, slow_down_factor, sample_count_all_channels, bps, channel_count, audio_buffer_data[audio_buffer_index], upsampled_audio_data, prefetch_buffer, filter_length, filter, upsampled_audio_data_with_prefetch_buffer, upsampled_audio_data_filtered, upsampled_audio_data_finals[audio_buffer_index]);
                         audio_headers[audio_buffer_index].lpData = (LPSTR)upsampled_audio_data_finals[audio_buffer_index];
                         audio_headers[audio_buffer_index].dwBufferLength = sample_count_output_all_channels * bps;
                         audio_headers[audio_buffer_index].dwBytesRecorded = 0;
@@ -585,7 +772,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
                     }
                     else
                     {
-                        audio_headers[audio_buffer_index].lpData = (LPSTR)audio_buffers[audio_buffer_index];
+                        audio_headers[audio_buffer_index].lpData = (LPSTR)audio_buffer_data[audio_buffer_index];
                         audio_headers[audio_buffer_index].dwBufferLength = audio_buffer_data_available_size[audio_buffer_index];
                         audio_headers[audio_buffer_index].dwBytesRecorded = 0;
                         audio_headers[audio_buffer_index].dwUser = NULL;
@@ -615,6 +802,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
 
                 shared_data->ui_next_operation = sound_player_next_operation;
                 sound_player_next_operation = SOUND_PLAYER_OP_READY;
+                song_finished = 1;
                 callback_count_overruled = 1;
                 SyncSetEvent(shared_data->event, __FILE__, __LINE__);
             }
@@ -629,7 +817,9 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
             (callback_count > 0))
         {
             // Load next chunk of audio file
-            audio_buffer_data_available_size[audio_buffer_index] = WAVLoadData(&playback_data, audio_buffer_size, audio_buffers[audio_buffer_index]);
+            audio_buffer_data_available_size[audio_buffer_index] = SoundPlayerLoadData(&playback_data, audio_buffer_size, audio_buffers[audio_buffer_index], &audio_buffer_data[audio_buffer_index]);
+            audio_buffer_positions[audio_buffer_index] = audio_position;
+            audio_position += audio_buffer_data_available_size[audio_buffer_index] / bps_all_channels;
 
             // No more data to play back
             if (audio_buffer_data_available_size[audio_buffer_index] == 0)
@@ -644,7 +834,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
             {
                 // Perform sample-rate conversion
                 uint32_t sample_count_all_channels = audio_buffer_data_available_size[audio_buffer_index] / bps;
-                uint32_t sample_count_output_all_channels = SampleRateConvert(input_rate, output_rate, L, M, slow_down_factor, sample_count_all_channels, bps, channel_count, audio_buffers[audio_buffer_index], upsampled_audio_data, prefetch_buffer, filter_length, filter, upsampled_audio_data_with_prefetch_buffer, upsampled_audio_data_filtered, upsampled_audio_data_finals[audio_buffer_index]);
+                uint32_t sample_count_output_all_channels = SampleRateConvert(input_rate, output_rate, L, M, slow_down_factor, sample_count_all_channels, bps, channel_count, audio_buffer_data[audio_buffer_index], upsampled_audio_data, prefetch_buffer, filter_length, filter, upsampled_audio_data_with_prefetch_buffer, upsampled_audio_data_filtered, upsampled_audio_data_finals[audio_buffer_index]);
 
                 // Send audio data to audio device
                 audio_headers[audio_buffer_index].lpData = (LPSTR)upsampled_audio_data_finals[audio_buffer_index];
@@ -657,7 +847,7 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
             else
             {
                 // Send audio data to audio device
-                audio_headers[audio_buffer_index].lpData = (LPSTR)audio_buffers[audio_buffer_index];
+                audio_headers[audio_buffer_index].lpData = (LPSTR)audio_buffer_data[audio_buffer_index];
                 audio_headers[audio_buffer_index].dwBufferLength = audio_buffer_data_available_size[audio_buffer_index];
                 audio_headers[audio_buffer_index].dwBytesRecorded = 0;
                 audio_headers[audio_buffer_index].dwUser = NULL;
@@ -674,12 +864,9 @@ DWORD WINAPI SoundPlayerThreadProc(_In_ LPVOID lpParameter)
             res_mmresult = waveOutUnprepareHeader(playback_data.audio_device, &audio_headers[audio_buffer_index], sizeof(WAVEHDR));
             assert(res_mmresult == MMSYSERR_NOERROR);
 
-            // Update playback buffer
-            SyncLockMutex(shared_data->current_playback_buffer_mutex, INFINITE, __FILE__, __LINE__);
+            // Hand the audio buffer that starts playing back over to the analysis thread, which never waits
             uint8_t audio_buffer_index_next = (audio_buffer_index + 1) % audio_buffer_count;
-            memcpy(shared_data->current_playback_buffer, audio_buffers[audio_buffer_index_next], audio_buffer_data_available_size[audio_buffer_index_next]);
-            shared_data->current_playback_buffer_size = audio_buffer_data_available_size[audio_buffer_index_next];
-            SyncReleaseMutex(shared_data->current_playback_buffer_mutex, __FILE__, __LINE__);
+            AnalyzerPush(shared_data->analyzer, audio_buffer_positions[audio_buffer_index_next], playback_data.sample_rate, playback_data.channel_count, playback_data.bps, playback_data.sample_format, audio_buffer_data[audio_buffer_index_next], audio_buffer_data_available_size[audio_buffer_index_next]);
 
             // Decrement atomic counter
             InterlockedDecrement((volatile LONG*)&callback_data.callback_count_atomic);
@@ -47,6 +47,8 @@ typedef enum
     SOUND_PLAYER_SHUFFLE_RANDOM = 1
 } sound_player_shuffle_e;
 
+struct analyzer_t;
+
 // TODO (Daniel): pack properly
 typedef struct
 {
@@ -58,25 +60,29 @@ typedef struct
     HWAVEOUT                 audio_device;
     sound_player_loop_e      loop_state;
     sound_player_shuffle_e   shuffle_state;
+    uint8_t                  md5_verify_enabled; // Verify FLAC files against their MD5 signature while playing them back
     uint8_t                  playlist_current_changed;
     uint8_t                  error_message_changed;
     char                     playlist_next_file_path[MAX_PATH];
     char                     playlist_current_file_path[MAX_PATH];
     char                     error_message[MAX_PATH];
 
-    HANDLE                   current_playback_buffer_mutex; // Required to be locked before accessing below members
-    byte_t*                  current_playback_buffer;
-    uint64_t                 current_playback_buffer_size;
+    struct analyzer_t*       analyzer; // Audio buffers are pushed to it as they start playing back
 } sound_player_shared_data_t;
 
 typedef struct
 {
     HWAVEOUT                  audio_device;
+    song_type_e               song_type;
     FILE*                     file;
+    struct flac_t*            flac; // Only for SONG_TYPE_FLAC
+    struct wav_source_t*      wav_source; // Only for SONG_TYPE_WAV
     uint64_t                  file_size;
+    uint64_t                  audio_data_end; // File offset where playback stops, only for SONG_TYPE_WAV
     uint32_t                  sample_rate;
     uint8_t                   channel_count;
     uint8_t                   bps; // Bytes per sample
+    sample_format_e           sample_format;
 } playback_data_t;
 
 typedef struct
@@ -0,0 +1,198 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "stft.h"
+#include "dft.h"
+#include "sample_convert.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Samples are converted to floats in blocks of this many per channel, for as many channels as an audio device is opened with
+#define STFT_CONVERT_BLOCK_SIZE 1024
+#define STFT_MAX_CHANNEL_COUNT 8
+
+uint8_t STFTInit(stft_t* stft, uint32_t hop)
+{
+    stft->history = (float*)malloc(STFT_HISTORY_SIZE * sizeof(float));
+    stft->frame = (float*)malloc(DFT_MAX_N * sizeof(float));
+    stft->magnitudes = (float*)malloc(DFT_MAX_FREQUENCY_BAND_COUNT * sizeof(float));
+    stft->magnitudes_max = (float*)malloc(DFT_MAX_FREQUENCY_BAND_COUNT * sizeof(float));
+    stft->bands = (float*)malloc(DFT_MAX_FREQUENCY_BAND_COUNT * sizeof(float));
+    if ((stft->history == NULL) || (stft->frame == NULL) || (stft->magnitudes == NULL) || (stft->magnitudes_max == NULL) || (stft->bands == NULL))
+    {
+        STFTFree(stft);
+        return 0;
+    }
+    stft->history_start = 0;
+    stft->history_end = 0;
+    stft->frame_end = 0;
+    stft->hop = hop;
+    STFTClearBands(stft);
+
+    return 1;
+}
+
+void STFTPush(stft_t* stft, uint64_t position, const byte_t* audio_data, uint32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, sample_format_e sample_format)
+{
+    static float stft_samples[STFT_CONVERT_BLOCK_SIZE * STFT_MAX_CHANNEL_COUNT];
+    uint32_t channel_count = bytes_per_sample_all_channels / bps;
+    assert((channel_count > 0) && (channel_count <= STFT_MAX_CHANNEL_COUNT));
+    sample_convert_format_e convert_format = SampleConvertFormat(bps, sample_format);
+
+    // Playback didn't continue where the history ends, so the history starts over
+    if (position != stft->history_end)
+    {
+        stft->history_start = position;
+        stft->history_end = position;
+        stft->frame_end = position;
+    }
+
+    // Converted to planar floats a block at a time, and the first two channels averaged into the ring
+    const uint64_t history_mask = STFT_HISTORY_SIZE - 1;
+    uint32_t sample_index = 0;
+    while (sample_index < sample_count)
+    {
+        uint32_t block_size = sample_count - sample_index;
+        if (block_size > STFT_CONVERT_BLOCK_SIZE)
+        {
+            block_size = STFT_CONVERT_BLOCK_SIZE;
+        }
+        SampleConvert(convert_format, 0, audio_data + ((uint64_t)sample_index * bytes_per_sample_all_channels), SAMPLE_CONVERT_FORMAT_F32, 1, stft_samples, channel_count, block_size);
+        const float* samples_left = stft_samples;
+        const float* samples_right = (channel_count > 1) ? (stft_samples + block_size) : stft_samples;
+        for (uint32_t n = 0; n < block_size; n++)
+        {
+            stft->history[(stft->history_end + n) & history_mask] = (samples_left[n] + samples_right[n]) * 0.5f; // / 2.0f
+        }
+        stft->history_end += block_size;
+        sample_index += block_size;
+    }
+}
+
+// Returns the number of frames that end after the last computed one and up to 'position', skipping all but the
+// DFT_MAX_WINDOWS latest
+static uint64_t STFTCountFrames(stft_t* stft, uint64_t position)
+{
+    // Frames can't end after the samples pushed so far
+    if (position > stft->history_end)
+    {
+        position = stft->history_end;
+    }
+    if (position < stft->frame_end + stft->hop)
+    {
+        return 0;
+    }
+    uint64_t frame_count = (position - stft->frame_end) / stft->hop;
+    if (frame_count > DFT_MAX_WINDOWS)
+    {
+        // Skip the frames that were due before the latest ones
+        stft->frame_end += (frame_count - DFT_MAX_WINDOWS) * stft->hop;
+        frame_count = DFT_MAX_WINDOWS;
+    }
+    return frame_count;
+}
+
+// Copies the 'n' samples of the frame ending at 'frame_end' out of the ring into 'frame'. Samples from before the history
+// restarted, or that have been overwritten in the ring, are silence
+static void STFTLoadFrame(stft_t* stft, uint32_t n)
+{
+    const uint64_t history_mask = STFT_HISTORY_SIZE - 1;
+    uint64_t valid_start = stft->history_start;
+    if ((stft->history_end > STFT_HISTORY_SIZE) && (stft->history_end - STFT_HISTORY_SIZE > valid_start))
+    {
+        valid_start = stft->history_end - STFT_HISTORY_SIZE;
+    }
+
+    // Copy the frame out of the ring in order, in up to two pieces if it wraps around
+    uint64_t copy_start = (stft->frame_end > n) ? (stft->frame_end - n) : 0;
+    if (copy_start < valid_start)
+    {
+        copy_start = (valid_start < stft->frame_end) ? valid_start : stft->frame_end;
+    }
+    uint32_t zero_count = n - (uint32_t)(stft->frame_end - copy_start);
+    uint32_t copy_count = n - zero_count;
+    uint32_t ring_index = (uint32_t)(copy_start & history_mask);
+    uint32_t copy_count_first = ((ring_index + copy_count) > STFT_HISTORY_SIZE) ? (STFT_HISTORY_SIZE - ring_index) : copy_count;
+    memset(stft->frame, 0, zero_count * sizeof(float));
+    memcpy(stft->frame + zero_count, stft->history + ring_index, copy_count_first * sizeof(float));
+    memcpy(stft->frame + zero_count + copy_count_first, stft->history, (copy_count - copy_count_first) * sizeof(float));
+}
+
+uint32_t STFTCompute(stft_t* stft, uint64_t position)
+{
+    uint64_t frame_count = STFTCountFrames(stft, position);
+    if (frame_count == 0)
+    {
+        return 0;
+    }
+
+    const uint32_t n = DFTGetN();
+    const uint32_t frequency_band_count = DFTGetFrequencyBandCount();
+    memset(stft->magnitudes_max, 0, frequency_band_count * sizeof(float));
+    for (uint64_t i = 0; i < frame_count; i++)
+    {
+        stft->frame_end += stft->hop;
+        STFTLoadFrame(stft, n);
+        DFTComputeMagnitudes(stft->frame, stft->magnitudes);
+        for (uint32_t k = 0; k < frequency_band_count; k++)
+        {
+            if (stft->magnitudes[k] > stft->magnitudes_max[k])
+            {
+                stft->magnitudes_max[k] = stft->magnitudes[k];
+            }
+        }
+    }
+    DFTUpdateBands(stft->bands, stft->magnitudes_max);
+
+    return (uint32_t)frame_count;
+}
+
+uint32_t STFTLoadLatestFrame(stft_t* stft, uint64_t position)
+{
+    uint64_t frame_count = STFTCountFrames(stft, position);
+    if (frame_count == 0)
+    {
+        return 0;
+    }
+
+    stft->frame_end += frame_count * stft->hop;
+    STFTLoadFrame(stft, DFTGetN());
+
+    return (uint32_t)frame_count;
+}
+
+void STFTClearBands(stft_t* stft)
+{
+    memset(stft->bands, 0, DFT_MAX_FREQUENCY_BAND_COUNT * sizeof(float));
+}
+
+void STFTFree(stft_t* stft)
+{
+    free(stft->history);
+    free(stft->frame);
+    free(stft->magnitudes);
+    free(stft->magnitudes_max);
+    free(stft->bands);
+    stft->history = NULL;
+    stft->frame = NULL;
+    stft->magnitudes = NULL;
+    stft->magnitudes_max = NULL;
+    stft->bands = NULL;
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STFT_H
+#define STFT_H
+
+#include "macros.h"
+#include "song.h"
+
+#include <stdint.h>
+
+// Samples kept in the history, a power of 2 with room for the largest window and the chunk pushed after it
+#define STFT_HISTORY_SIZE 131072
+// Bounds and default of the number of samples between the ends of two frames
+#define STFT_MIN_HOP 16
+#define STFT_MAX_HOP 16384
+#define STFT_DEFAULT_HOP 128
+
+/**
+ * Short-time Fourier transform over a stream of samples: frames of DFTGetN() samples end every 'hop' samples, so that
+ * consecutive frames overlap, and each frame is computed once, when playback reaches its end.
+ * 
+ * STFTInit() allocates the history and the bands, which start at 0. Returns 0 if out of memory
+ * 
+ * STFTPush() appends 'sample_count' samples of 'audio_data', in the song's format, to the history, averaged over the
+ * first two channels. 'position' is the sample in the song the first of them is. If it isn't the sample after the last
+ * one pushed, because playback moved to another song or skipped a chunk, the history restarts at 'position' and the
+ * samples before it are silence.
+ * 
+ * STFTCompute() computes the frames that end after the last computed one and up to 'position', which is usually the
+ * sample being played back, and moves 'bands' towards the loudest magnitudes of those frames. At most DFT_MAX_WINDOWS
+ * of the latest frames are computed if playback got further ahead, and nothing is if no frame ended since the last call.
+ * Returns the number of frames computed
+ * 
+ * STFTLoadLatestFrame() moves past the same frames as STFTCompute() would, but only copies the samples of the latest one
+ * to 'frame' instead of computing them, for the transform to be done elsewhere. 'bands' are left as they are.
+ * Returns the number of frames moved past, 0 if 'frame' wasn't loaded
+ * 
+ * STFTClearBands() sets the bands back to 0, for when DFTSetAnalysis() changed their count.
+ * 
+ * STFTFree() frees the history and the bands.
+*/
+typedef struct
+{
+    float*   history; // STFT_HISTORY_SIZE mono samples, as a ring indexed by their position modulo the size
+    uint64_t history_start; // Position of the first sample pushed since the history restarted
+    uint64_t history_end; // Position after the last sample pushed
+    uint64_t frame_end; // Position after the last sample of the last computed frame
+    uint32_t hop;
+    float*   frame; // DFT_MAX_N samples of a frame in order
+    float*   magnitudes; // DFT_MAX_FREQUENCY_BAND_COUNT
+    float*   magnitudes_max; // Loudest magnitudes of the frames computed in one call
+    float*   bands; // DFT_MAX_FREQUENCY_BAND_COUNT, of which DFTGetFrequencyBandCount() are used
+} stft_t;
+
+uint8_t  STFTInit(stft_t* stft, uint32_t hop);
+void     STFTPush(stft_t* stft, uint64_t position, const byte_t* audio_data, uint32_t sample_count, int16_t bps, int16_t bytes_per_sample_all_channels, sample_format_e sample_format);
+uint32_t STFTCompute(stft_t* stft, uint64_t position);
+uint32_t STFTLoadLatestFrame(stft_t* stft, uint64_t position);
+void     STFTClearBands(stft_t* stft);
+void     STFTFree(stft_t* stft);
+
+#endif
\ No newline at end of file
@@ -0,0 +1,226 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "md5.h"
+#include "sound_player.h"
+#include "stream_test.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_TEST_RANDOM_SEED 0x9E3779B9u
+
+typedef struct
+{
+    const char* name;
+    uint32_t    slice_size_max; // Slices are of random sizes from 1 to this
+} stream_test_slicing_t;
+
+static const stream_test_slicing_t stream_test_slicings[] =
+{
+    { "1 byte",      1 },
+    { "1-64 bytes",  64 },
+    { "1-64 KB",     64 * 1024 }
+};
+
+typedef struct
+{
+    flac_stream_t*  stream;
+    playback_data_t playback_data; // Of the reference, which is decoded with FLACLoadData() as 24-in-32 bit samples
+    int32_t*        frame_samples; // A frame output by the stream, interleaved in the same way as the reference
+    int32_t*        reference_samples;
+    byte_t*         md5_buffer;
+    md5_context_t   md5_context;
+    uint64_t        frame_count;
+    uint64_t        mismatch_count; // Frames that don't match the reference
+} stream_test_data_t;
+
+static inline uint32_t StreamTestRandom(uint32_t* state)
+{
+    // xorshift32
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+// Compares a frame output by the stream against the next samples of the reference, and hashes it
+static void StreamTestFrameCallback(const flac_frame_decoder_t* frame_decoder, void* callback_data)
+{
+    stream_test_data_t* data = (stream_test_data_t*)callback_data;
+    const flac_metadata_block_streaminfo_t* streaminfo = &data->stream->streaminfo;
+    uint32_t channel_count = streaminfo->channel_count;
+    uint32_t sample_count = frame_decoder->frame_header.block_size_inter_channel_sampels;
+    if (data->frame_samples == NULL)
+    {
+        // STREAMINFO is known by the time the first frame is output
+        uint64_t sample_capacity = (uint64_t)streaminfo->block_size_max * channel_count;
+        data->frame_samples = (int32_t*)malloc(sample_capacity * sizeof(int32_t));
+        data->reference_samples = (int32_t*)malloc(sample_capacity * sizeof(int32_t));
+        data->md5_buffer = (byte_t*)malloc(sample_capacity * sizeof(int32_t));
+    }
+
+    const int32_t* channels[FLAC_MAX_CHANNEL_COUNT];
+    for (uint32_t channel = 0; channel < channel_count; channel++)
+    {
+        channels[channel] = frame_decoder->subframes[channel].samples;
+    }
+    FLACOutputInt32(channels, channel_count, frame_decoder->stereo, streaminfo->bits_per_sample, sample_count, data->frame_samples);
+
+    uint64_t frame_size = (uint64_t)sample_count * channel_count * sizeof(int32_t);
+    uint64_t reference_size = 0;
+    while (reference_size < frame_size)
+    {
+        uint32_t size = FLACLoadData(&data->playback_data, frame_size - reference_size, (byte_t*)data->reference_samples + reference_size);
+        if (size == 0)
+        {
+            break;
+        }
+        reference_size += size;
+    }
+    if ((reference_size != frame_size) || (memcmp(data->frame_samples, data->reference_samples, frame_size) != 0))
+    {
+        if (data->mismatch_count < 8)
+        {
+            printf("MISMATCH  frame %llu at sample %llu\n", (unsigned long long)data->frame_count, (unsigned long long)frame_decoder->frame_header.sample_number);
+        }
+        data->mismatch_count++;
+    }
+
+    // Hashed the way the MD5 signature is computed: as signed little-endian integers of the fewest whole bytes that fit
+    uint32_t shift = 32 - streaminfo->bits_per_sample;
+    uint32_t bytes_per_sample = (streaminfo->bits_per_sample + 7) / 8;
+    byte_t* bytes = data->md5_buffer;
+    for (uint64_t i = 0; i < (uint64_t)sample_count * channel_count; i++)
+    {
+        uint32_t sample = (uint32_t)(data->frame_samples[i] >> shift);
+        for (uint32_t byte = 0; byte < bytes_per_sample; byte++)
+        {
+            bytes[byte] = (byte_t)(sample >> (byte * 8));
+        }
+        bytes += bytes_per_sample;
+    }
+    MD5Update(&data->md5_context, data->md5_buffer, (uint64_t)(bytes - data->md5_buffer));
+    data->frame_count++;
+}
+
+// Pushes the whole file into a stream in slices of random sizes up to 'slice_size_max'
+// Returns 1 if every frame matched the reference and the MD5 signature
+static uint8_t StreamTestSlicing(char* file_path, const stream_test_slicing_t* slicing, uint32_t* random)
+{
+    song_t song;
+    SongInit(&song);
+    song.song_path_offset = file_path;
+    song.song_type = SONG_TYPE_FLAC;
+    if (FLACLoadHeader(&song) != SONG_ERROR_NO)
+    {
+        printf("Unable to load FLAC file: %s\n", file_path);
+        return 0;
+    }
+    FLACSetOutputFormat(&song, SAMPLE_FORMAT_INT, sizeof(int32_t));
+    FILE* file = fopen(file_path, "rb");
+    if (file == NULL)
+    {
+        printf("Unable to open FLAC file: %s\n", file_path);
+        SongFreeAudioData(&song);
+        return 0;
+    }
+
+    flac_stream_t stream;
+    stream_test_data_t data = { 0 };
+    data.stream = &stream;
+    data.playback_data.song_type = song.song_type;
+    data.playback_data.file = song.file;
+    data.playback_data.flac = song.flac;
+    data.playback_data.file_size = song.file_size;
+    data.playback_data.sample_rate = song.sample_rate;
+    data.playback_data.channel_count = song.channel_count;
+    data.playback_data.bps = song.bps;
+    data.playback_data.sample_format = song.sample_format;
+    MD5Init(&data.md5_context);
+    FLACStreamInit(&stream, &StreamTestFrameCallback, &data);
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+    byte_t* slice = (byte_t*)malloc(slicing->slice_size_max);
+    while (1)
+    {
+        uint32_t slice_size = 1 + (StreamTestRandom(random) % slicing->slice_size_max);
+        size_t size_read = fread(slice, 1, slice_size, file);
+        if (size_read == 0)
+        {
+            break;
+        }
+        if (FLACStreamPush(&stream, slice, size_read) == FLAC_STREAM_STATE_ERROR)
+        {
+            break;
+        }
+    }
+    flac_stream_state_e state = FLACStreamFinish(&stream);
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+
+    // Every sample of the reference has to have been output by the stream
+    int32_t reference_sample[FLAC_MAX_CHANNEL_COUNT];
+    uint8_t reference_finished = (FLACLoadData(&data.playback_data, sizeof(int32_t) * song.channel_count, (byte_t*)reference_sample) == 0);
+    byte_t md5[16];
+    byte_t no_md5[16] = { 0 };
+    MD5Final(&data.md5_context, md5);
+    uint8_t has_md5 = (memcmp(stream.streaminfo.md5, no_md5, 16) != 0);
+    uint8_t md5_matches = (has_md5 == 0) || (memcmp(md5, stream.streaminfo.md5, 16) == 0);
+    printf("%-16s %llu frames, %llu mismatched, %s, MD5 %s, %.1f MB/s\n", slicing->name, (unsigned long long)data.frame_count, (unsigned long long)data.mismatch_count,
+           (state != FLAC_STREAM_STATE_FINISHED) ? "stream ERROR" : ((reference_finished == 1) ? "complete" : "INCOMPLETE"),
+           (has_md5 == 0) ? "not in file" : ((md5_matches == 1) ? "match" : "MISMATCH"),
+           (elapsed_seconds > 0.0) ? ((double)song.file_size / (1024.0 * 1024.0) / elapsed_seconds) : 0.0);
+
+    free(slice);
+    free(data.frame_samples);
+    free(data.reference_samples);
+    free(data.md5_buffer);
+    FLACStreamFree(&stream);
+    fclose(file);
+    SongFreeAudioData(&song);
+
+    return (state == FLAC_STREAM_STATE_FINISHED) && (data.mismatch_count == 0) && (reference_finished == 1) && (md5_matches == 1);
+}
+
+uint32_t StreamTestFile(char* file_path)
+{
+    assert(file_path != NULL);
+
+    uint32_t random = STREAM_TEST_RANDOM_SEED;
+    uint32_t failed_count = 0;
+    printf("File:           %s\n", file_path);
+    for (uint32_t i = 0; i < sizeof(stream_test_slicings) / sizeof(stream_test_slicings[0]); i++)
+    {
+        if (StreamTestSlicing(file_path, &stream_test_slicings[i], &random) == 0)
+        {
+            failed_count++;
+        }
+    }
+
+    return failed_count;
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef STREAM_TEST_H
+#define STREAM_TEST_H
+
+#include <stdint.h>
+
+/**
+ * Checks that a FLAC file decoded through FLACStreamPush() is bit-exact no matter how its bytes are sliced.
+ * 
+ * The file is pushed in 1-byte slices, then in slices of random sizes up to 64 bytes, and then up to 64 KB. Each frame
+ * output by the stream is compared against the same samples decoded from the file with FLACLoadData(), and the MD5 of all
+ * of them against the signature in STREAMINFO. The random sizes come from a fixed seed, so a failure can be reproduced.
+ * 
+ * Returns number of slicings that didn't decode to the same samples
+*/
+uint32_t StreamTestFile(char* file_path);
+
+#endif
\ No newline at end of file
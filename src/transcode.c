@@ -0,0 +1,254 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "flac_encoder.h"
+#include "playlist.h"
+#include "transcode.h"
+#include "wav.h"
+#include "windows_file.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Returns the path of the FLAC file for 'wav_path', which must be freed
+static char* TranscodeOutputPath(const char* wav_path)
+{
+    const char* extension = strrchr(wav_path, '.');
+    uint64_t base_length = (extension != NULL) ? (uint64_t)(extension - wav_path) : strlen(wav_path);
+    char* flac_path = (char*)malloc(base_length + sizeof(".flac"));
+    memcpy(flac_path, wav_path, base_length);
+    memcpy(flac_path + base_length, ".flac", sizeof(".flac"));
+    return flac_path;
+}
+
+uint32_t TranscodePlaylist(char* playlist_file_path, uint32_t level, uint32_t thread_count)
+{
+    assert(playlist_file_path != NULL);
+
+    if (level > FLAC_ENCODER_LEVEL_MAX)
+    {
+        printf("Compression level must be %u-%u\n", FLAC_ENCODER_LEVEL_MIN, FLAC_ENCODER_LEVEL_MAX);
+        return 1;
+    }
+
+    playlist_t playlist;
+    PlaylistInit(&playlist);
+    playlist_error_e playlist_error = PlaylistLoad(playlist_file_path, &playlist);
+    switch (playlist_error)
+    {
+        case PLAYLIST_ERROR_NO: {} break;
+
+        case PLAYLIST_ERROR_UNABLE_TO_OPEN_FILE:
+        {
+            printf("Unable to open playlist: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        case PLAYLIST_ERROR_EMPTY:
+        {
+            printf("Playlist file is empty: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid error returned from PlaylistLoad()\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        } break;
+    }
+
+    // One thread per logical processor keeps all cores encoding
+    if (thread_count == 0)
+    {
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        thread_count = system_info.dwNumberOfProcessors;
+    }
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+
+    uint32_t converted_count = 0;
+    uint32_t existing_count = 0;
+    uint32_t error_count = 0;
+    uint32_t skipped_count = 0;
+    uint64_t input_byte_count = 0;
+    uint64_t output_byte_count = 0;
+    double seconds = 0.0;
+    double encode_seconds = 0.0; // Spent in FLACEncode() on the files that were converted
+    for (uint64_t i = 0; i < playlist.song_count; i++)
+    {
+        song_t* song = &playlist.songs[i];
+        if (song->song_type != SONG_TYPE_WAV)
+        {
+            skipped_count++;
+            continue;
+        }
+        // Virtual tracks of a file share its path, and the file is encoded once for its first track
+        if ((i > 0) && (song->song_path_offset == playlist.songs[i - 1].song_path_offset))
+        {
+            continue;
+        }
+
+        char* flac_path = TranscodeOutputPath(song->song_path_offset);
+        uint64_t flac_file_size = 0;
+        uint64_t flac_modification_time = 0;
+        if (FileGetInfo(flac_path, &flac_file_size, &flac_modification_time) == 1)
+        {
+            existing_count++;
+            free(flac_path);
+            continue;
+        }
+
+        // The header tells where the samples are, which are then read straight from the mapping of the file it sets up
+        if (WAVLoadHeader(song) != SONG_ERROR_NO)
+        {
+            printf("ERROR     %s\n", song->song_path_offset);
+            error_count++;
+            free(flac_path);
+            continue;
+        }
+        // FLAC only holds integer samples
+        if (song->sample_format != SAMPLE_FORMAT_INT)
+        {
+            SongFreeAudioData(song);
+            skipped_count++;
+            free(flac_path);
+            continue;
+        }
+        const file_map_t wav_map = song->wav_source->file_map;
+        uint64_t audio_data_size = song->audio_data_size;
+        if (song->audio_data_offset + audio_data_size > wav_map.size)
+        {
+            // Truncated file
+            audio_data_size = (wav_map.size > song->audio_data_offset) ? wav_map.size - song->audio_data_offset : 0;
+        }
+        flac_encoder_input_t input;
+        input.sample_rate = song->sample_rate;
+        input.channel_count = song->channel_count;
+        input.bits_per_sample = song->bps * 8;
+        input.sample_count = (song->channel_count > 0) ? audio_data_size / ((uint64_t)song->channel_count * song->bps) : 0;
+        input.samples = wav_map.bytes + song->audio_data_offset;
+
+        FILE* flac_file = fopen(flac_path, "wb");
+        flac_encoder_error_e encoder_error = FLAC_ENCODER_ERROR_UNABLE_TO_WRITE;
+        uint64_t flac_size = 0;
+        LARGE_INTEGER encode_start, encode_end;
+        QueryPerformanceCounter(&encode_start);
+        encode_end = encode_start;
+        if (flac_file != NULL)
+        {
+            encoder_error = FLACEncode(&input, level, thread_count, flac_file, &flac_size);
+            QueryPerformanceCounter(&encode_end);
+            if (fclose(flac_file) != 0)
+            {
+                encoder_error = FLAC_ENCODER_ERROR_UNABLE_TO_WRITE;
+            }
+        }
+        SongFreeAudioData(song);
+        switch (encoder_error)
+        {
+            case FLAC_ENCODER_ERROR_NO: {} break;
+
+            case FLAC_ENCODER_ERROR_UNSUPPORTED_FORMAT:
+            {
+                printf("FORMAT    %s (%u channels, %u-bit, %u Hz)\n", song->song_path_offset, input.channel_count, input.bits_per_sample, input.sample_rate);
+            } break;
+
+            case FLAC_ENCODER_ERROR_UNABLE_TO_WRITE:
+            {
+                printf("WRITE     %s\n", flac_path);
+            } break;
+
+            default:
+            {
+                printf("%s:%i Invalid error returned from FLACEncode()\n", __FILE__, __LINE__);
+                exit(EXIT_FAILURE);
+            } break;
+        }
+
+        // Decode what was written, which must give back the samples the MD5 signature was computed from
+        uint8_t is_converted = (encoder_error == FLAC_ENCODER_ERROR_NO);
+        if (is_converted == 1)
+        {
+            song_t flac_song;
+            SongInit(&flac_song);
+            flac_song.song_path_offset = flac_path;
+            flac_song.song_type = SONG_TYPE_FLAC;
+            flac_md5_result_e md5_result = FLAC_MD5_RESULT_MISMATCH;
+            if (FLACLoadHeader(&flac_song) == SONG_ERROR_NO)
+            {
+                md5_result = FLACVerifyMD5(flac_song.flac);
+                SongFreeAudioData(&flac_song);
+            }
+            if (md5_result != FLAC_MD5_RESULT_MATCH)
+            {
+                printf("MISMATCH  %s\n", flac_path);
+                is_converted = 0;
+            }
+        }
+
+        if (is_converted == 1)
+        {
+            converted_count++;
+            input_byte_count += audio_data_size;
+            output_byte_count += flac_size;
+            seconds += (double)input.sample_count / input.sample_rate;
+            encode_seconds += (double)(encode_end.QuadPart - encode_start.QuadPart) / (double)timer_frequency.QuadPart;
+        }
+        else
+        {
+            remove(flac_path);
+            error_count++;
+        }
+        free(flac_path);
+    }
+
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+    PlaylistFree(&playlist);
+
+    printf("\n");
+    printf("Threads:        %u\n", thread_count);
+    printf("Level:          %u\n", level);
+    printf("Converted:      %u\n", converted_count);
+    printf("Existing:       %u (FLAC file already there)\n", existing_count);
+    printf("Errors:         %u\n", error_count);
+    printf("Skipped:        %u (not WAV, or float samples)\n", skipped_count);
+    if (input_byte_count > 0)
+    {
+        printf("Size:           %.1f MB -> %.1f MB (%.1f%%)\n", (double)input_byte_count / (1024.0 * 1024.0), (double)output_byte_count / (1024.0 * 1024.0), 100.0 * (double)output_byte_count / (double)input_byte_count);
+    }
+    printf("Time:           %.2f s\n", elapsed_seconds);
+    if (elapsed_seconds > 0.0)
+    {
+        printf("Throughput:     %.1f MB/s, %.1fx real-time (encoded and verified)\n", (double)input_byte_count / (1024.0 * 1024.0) / elapsed_seconds, seconds / elapsed_seconds);
+    }
+    if (encode_seconds > 0.0)
+    {
+        printf("Encoding:       %.1f MB/s of input, %.1fx real-time (FLACEncode() alone, %.2f s)\n", (double)input_byte_count / (1024.0 * 1024.0) / encode_seconds, seconds / encode_seconds, encode_seconds);
+    }
+
+    return error_count;
+}
\ No newline at end of file
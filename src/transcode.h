@@ -0,0 +1,36 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stdint.h>
+
+/**
+ * Encodes every WAV file in a playlist to a FLAC file next to it, with the same name and a .flac extension. Files that
+ * already have one are left alone.
+ * 
+ * Files are encoded one at a time, each by FLACEncode() at compression 'level' on 'thread_count' threads. A
+ * 'thread_count' of 0 starts one thread per logical processor. Every FLAC file is then decoded and checked against its
+ * MD5 signature, and removed if it doesn't match.
+ * 
+ * Returns number of files that couldn't be encoded or failed verification
+*/
+uint32_t TranscodePlaylist(char* playlist_file_path, uint32_t level, uint32_t thread_count);
+
+#endif
\ No newline at end of file
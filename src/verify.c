@@ -0,0 +1,208 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "flac.h"
+#include "playlist.h"
+#include "verify.h"
+#include "windows_thread.h"
+
+#include <windows.h>
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Totals of the files verified by one thread, summed once all threads are done
+typedef struct
+{
+    uint32_t match_count;
+    uint32_t mismatch_count;
+    uint32_t no_signature_count;
+    uint32_t error_count; // Files that couldn't be opened or decoded
+    uint32_t skipped_count; // Files that aren't FLAC
+    uint64_t byte_count; // Size of all files read
+    double   seconds; // Duration of the audio in all files
+} verify_totals_t;
+
+typedef struct
+{
+    playlist_t*      playlist;
+    volatile LONG    next_song_index; // Number of files claimed by threads
+    verify_totals_t* thread_totals; // One per thread
+    volatile LONG    thread_index; // Number of threads that have claimed their totals
+} verify_data_t;
+
+static DWORD WINAPI VerifyThreadProc(_In_ LPVOID lpParameter)
+{
+    verify_data_t* verify_data = (verify_data_t*)lpParameter;
+    verify_totals_t* totals = &verify_data->thread_totals[InterlockedIncrement(&verify_data->thread_index) - 1];
+    while (1)
+    {
+        uint64_t song_index = (uint64_t)(InterlockedIncrement(&verify_data->next_song_index) - 1);
+        if (song_index >= verify_data->playlist->song_count)
+        {
+            break;
+        }
+
+        song_t* song = &verify_data->playlist->songs[song_index];
+        if (song->song_type != SONG_TYPE_FLAC)
+        {
+            totals->skipped_count++;
+            continue;
+        }
+        // Virtual tracks of a file share its path, and the file is verified once for its first track
+        if ((song_index > 0) && (song->song_path_offset == verify_data->playlist->songs[song_index - 1].song_path_offset))
+        {
+            continue;
+        }
+        if (FLACLoadHeader(song) != SONG_ERROR_NO)
+        {
+            printf("ERROR     %s\n", song->song_path_offset);
+            totals->error_count++;
+            continue;
+        }
+
+        flac_md5_result_e md5_result = FLACVerifyMD5(song->flac);
+        switch (md5_result)
+        {
+            case FLAC_MD5_RESULT_MATCH:
+            {
+                totals->match_count++;
+            } break;
+
+            case FLAC_MD5_RESULT_MISMATCH:
+            {
+                printf("MISMATCH  %s\n", song->song_path_offset);
+                totals->mismatch_count++;
+            } break;
+
+            case FLAC_MD5_RESULT_NO_SIGNATURE:
+            {
+                printf("NO MD5    %s\n", song->song_path_offset);
+                totals->no_signature_count++;
+            } break;
+
+            default:
+            {
+                printf("%s:%i Invalid result returned from FLACVerifyMD5()\n", __FILE__, __LINE__);
+                exit(EXIT_FAILURE);
+            } break;
+        }
+        totals->byte_count += song->flac->file_size;
+        totals->seconds += (double)song->flac->streaminfo.sample_count / song->flac->streaminfo.sample_rate;
+        SongFreeAudioData(song);
+    }
+
+    return 0;
+}
+
+uint32_t VerifyPlaylist(char* playlist_file_path, uint32_t thread_count)
+{
+    assert(playlist_file_path != NULL);
+
+    playlist_t playlist;
+    PlaylistInit(&playlist);
+    playlist_error_e playlist_error = PlaylistLoad(playlist_file_path, &playlist);
+    switch (playlist_error)
+    {
+        case PLAYLIST_ERROR_NO: {} break;
+
+        case PLAYLIST_ERROR_UNABLE_TO_OPEN_FILE:
+        {
+            printf("Unable to open playlist: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        case PLAYLIST_ERROR_EMPTY:
+        {
+            printf("Playlist file is empty: %s\n", playlist_file_path);
+            return 1;
+        } break;
+
+        default:
+        {
+            printf("%s:%i Invalid error returned from PlaylistLoad()\n", __FILE__, __LINE__);
+            exit(EXIT_FAILURE);
+        } break;
+    }
+
+    // One thread per logical processor keeps all cores decoding, while the others wait on the disk
+    if (thread_count == 0)
+    {
+        SYSTEM_INFO system_info;
+        GetSystemInfo(&system_info);
+        thread_count = system_info.dwNumberOfProcessors;
+    }
+    if (thread_count > playlist.song_count)
+    {
+        thread_count = (uint32_t)playlist.song_count;
+    }
+
+    LARGE_INTEGER timer_frequency, timer_start, timer_end;
+    QueryPerformanceFrequency(&timer_frequency);
+    QueryPerformanceCounter(&timer_start);
+
+    verify_data_t verify_data;
+    verify_data.playlist = &playlist;
+    verify_data.next_song_index = 0;
+    verify_data.thread_totals = (verify_totals_t*)calloc(thread_count, sizeof(verify_totals_t));
+    verify_data.thread_index = 0;
+    HANDLE* threads = (HANDLE*)malloc(thread_count * sizeof(HANDLE));
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        ThreadCreate(&VerifyThreadProc, &verify_data, L"VerifyThread", &threads[i]);
+    }
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        WaitForSingleObject(threads[i], INFINITE);
+        CloseHandle(threads[i]);
+    }
+    free(threads);
+
+    QueryPerformanceCounter(&timer_end);
+    double elapsed_seconds = (double)(timer_end.QuadPart - timer_start.QuadPart) / (double)timer_frequency.QuadPart;
+
+    verify_totals_t totals = { 0 };
+    for (uint32_t i = 0; i < thread_count; i++)
+    {
+        totals.match_count += verify_data.thread_totals[i].match_count;
+        totals.mismatch_count += verify_data.thread_totals[i].mismatch_count;
+        totals.no_signature_count += verify_data.thread_totals[i].no_signature_count;
+        totals.error_count += verify_data.thread_totals[i].error_count;
+        totals.skipped_count += verify_data.thread_totals[i].skipped_count;
+        totals.byte_count += verify_data.thread_totals[i].byte_count;
+        totals.seconds += verify_data.thread_totals[i].seconds;
+    }
+    free(verify_data.thread_totals);
+    PlaylistFree(&playlist);
+
+    printf("\n");
+    printf("Threads:        %u\n", thread_count);
+    printf("Verified:       %u\n", totals.match_count);
+    printf("Mismatched:     %u\n", totals.mismatch_count);
+    printf("No MD5:         %u\n", totals.no_signature_count);
+    printf("Errors:         %u\n", totals.error_count);
+    printf("Skipped:        %u (not FLAC)\n", totals.skipped_count);
+    printf("Time:           %.2f s\n", elapsed_seconds);
+    if (elapsed_seconds > 0.0)
+    {
+        printf("Throughput:     %.1f MB/s, %.1fx real-time\n", (double)totals.byte_count / (1024.0 * 1024.0) / elapsed_seconds, totals.seconds / elapsed_seconds);
+    }
+
+    return totals.mismatch_count + totals.error_count;
+}
\ No newline at end of file
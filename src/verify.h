@@ -0,0 +1,34 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdint.h>
+
+/**
+ * Verifies every FLAC file in a playlist against the MD5 signature in its STREAMINFO, without playing it back.
+ * 
+ * Files are decoded on 'thread_count' threads, one file per thread at a time, with each thread claiming the next file
+ * in the playlist once it's done with the previous one. A 'thread_count' of 0 starts one thread per logical processor.
+ * 
+ * Returns number of files that failed verification or couldn't be decoded
+*/
+uint32_t VerifyPlaylist(char* playlist_file_path, uint32_t thread_count);
+
+#endif
\ No newline at end of file
@@ -24,108 +24,547 @@
 #include <stdlib.h>
 #include <string.h>
 
-song_error_e WAVLoadHeader(song_t* song)
+// Copies a text tag of at most 'length' bytes to 'value', stopping at a null, and truncating it if it doesn't fit. An
+// empty tag leaves 'value' as it is.
+static void WAVLoadTag(const byte_t* text, uint64_t length, char* value, uint64_t value_size)
 {
-    assert(song != NULL);
-    assert(song->song_path_offset != NULL);
-    //assert(song->audio_data == NULL);
+    uint64_t text_length = 0;
+    while ((text_length < length) && (text[text_length] != '\0'))
+    {
+        text_length++;
+    }
+    if (text_length == 0)
+    {
+        return;
+    }
+    if (text_length >= value_size)
+    {
+        text_length = value_size - 1;
+    }
+    memcpy(value, text, text_length);
+    value[text_length] = '\0'; // Null-terminate
+}
 
-    // Open WAV file
-    FILE* wav_file = fopen(song->song_path_offset, "rb");
-    if (wav_file == NULL)
+// The subchunks of a 'LIST' chunk of type 'INFO', after the type. Each is an ID, a size and a null-terminated string.
+// A subchunk that claims more bytes than the list has ends it.
+static void WAVLoadInfoList(const byte_t* bytes, uint64_t size, song_t* song)
+{
+    uint64_t offset = 0;
+    while (offset + WAV_CHUNK_HEADER_SIZE <= size)
     {
-        printf("Failed to open %s : \"%s\"\n", song->song_path_offset, strerror(errno));
-        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+        const byte_t* subchunk_id = bytes + offset;
+        uint32_t subchunk_size = *((uint32_t*)(bytes + offset + 4));
+        if (subchunk_size > size - offset - WAV_CHUNK_HEADER_SIZE)
+        {
+            return;
+        }
+        const byte_t* text = bytes + offset + WAV_CHUNK_HEADER_SIZE;
+        if (memcmp(subchunk_id, "INAM", 4) == 0)
+        {
+            WAVLoadTag(text, subchunk_size, song->title, sizeof(song->title));
+        }
+        else if (memcmp(subchunk_id, "IART", 4) == 0)
+        {
+            WAVLoadTag(text, subchunk_size, song->artist, sizeof(song->artist));
+        }
+        else if (memcmp(subchunk_id, "IPRD", 4) == 0)
+        {
+            WAVLoadTag(text, subchunk_size, song->album, sizeof(song->album));
+        }
+        offset += WAV_CHUNK_HEADER_SIZE + subchunk_size + (subchunk_size & 1);
     }
+}
 
-    // Determine WAV file size
-    fseek(wav_file, 0, SEEK_END);
-    long wav_file_size = ftell(wav_file);
-    fseek(wav_file, 0, SEEK_SET);
+// Sizes in ID3v2 headers (and ID3v2.4 frame headers) are big-endian with 7 bits per byte
+static uint32_t WAVUnpackSyncsafe(const byte_t* bytes)
+{
+    return ((uint32_t)(bytes[0] & 0x7F) << 21) | ((uint32_t)(bytes[1] & 0x7F) << 14) | ((uint32_t)(bytes[2] & 0x7F) << 7) | (uint32_t)(bytes[3] & 0x7F);
+}
 
-    // Read in WAV file header
-    wav_header_packed_t wav_header_packed;
-    fread((void*)(&wav_header_packed), sizeof(wav_header_packed_t), 1, wav_file);
+// Appends 'code_point' to 'value' as UTF-8 if all of it fits before the null terminator
+// Returns 0 if it didn't fit
+static uint8_t WAVAppendUTF8(uint32_t code_point, char* value, uint64_t value_size, uint64_t* value_length)
+{
+    byte_t utf8[4];
+    uint32_t utf8_length = 0;
+    if (code_point < 0x80)
+    {
+        utf8[utf8_length++] = (byte_t)code_point;
+    }
+    else if (code_point < 0x800)
+    {
+        utf8[utf8_length++] = (byte_t)(0xC0 | (code_point >> 6));
+        utf8[utf8_length++] = (byte_t)(0x80 | (code_point & 0x3F));
+    }
+    else if (code_point < 0x10000)
+    {
+        utf8[utf8_length++] = (byte_t)(0xE0 | (code_point >> 12));
+        utf8[utf8_length++] = (byte_t)(0x80 | ((code_point >> 6) & 0x3F));
+        utf8[utf8_length++] = (byte_t)(0x80 | (code_point & 0x3F));
+    }
+    else
+    {
+        utf8[utf8_length++] = (byte_t)(0xF0 | (code_point >> 18));
+        utf8[utf8_length++] = (byte_t)(0x80 | ((code_point >> 12) & 0x3F));
+        utf8[utf8_length++] = (byte_t)(0x80 | ((code_point >> 6) & 0x3F));
+        utf8[utf8_length++] = (byte_t)(0x80 | (code_point & 0x3F));
+    }
+    if (*value_length + utf8_length >= value_size)
+    {
+        return 0;
+    }
+    memcpy(value + *value_length, utf8, utf8_length);
+    *value_length += utf8_length;
+    return 1;
+}
+
+// Text frames start with a byte giving their encoding: 0 = ISO-8859-1, 1 = UTF-16 with a byte order mark, 2 = UTF-16BE
+// and 3 = UTF-8. The text is converted to UTF-8, like tags of FLAC files, up to its first null.
+static void WAVLoadID3TextFrame(const byte_t* bytes, uint64_t size, char* value, uint64_t value_size)
+{
+    if (size < 1)
+    {
+        return;
+    }
+    byte_t encoding = bytes[0];
+    const byte_t* text = bytes + 1;
+    uint64_t text_size = size - 1;
 
-    // Find 'data' chunk in WAV file
-    uint8_t found_data_subchunk = 0;
-    uint32_t data_subchunk_size = 0;
-    int32_t index = sizeof(wav_header_packed_t);
-    char subchunk_id[4];
-    while (index < wav_file_size)
+    if (encoding == 3)
     {
-        // The next 4 bytes are always the subchunk's ID
-        fread(subchunk_id, 4, 1, wav_file);
-        
-        // The next 4 bytes are always the subchunk's size
-        uint32_t subchunk_size;
-        fread(&subchunk_size, 4, 1, wav_file);
+        WAVLoadTag(text, text_size, value, value_size);
+        return;
+    }
 
-        // Determine where this subchunk ends
-        if (strncmp(subchunk_id, "data", 4) == 0)
+    char converted[MAX_PATH];
+    uint64_t converted_length = 0;
+    if (value_size > sizeof(converted))
+    {
+        value_size = sizeof(converted);
+    }
+    if (encoding == 0)
+    {
+        for (uint64_t i = 0; (i < text_size) && (text[i] != 0); i++)
         {
-            found_data_subchunk = 1;
-            data_subchunk_size = subchunk_size;
-            break;
+            if (WAVAppendUTF8(text[i], converted, value_size, &converted_length) == 0)
+            {
+                break;
+            }
         }
-        else if (strncmp(subchunk_id, "JUNK", 4) == 0)
+    }
+    else if ((encoding == 1) || (encoding == 2))
+    {
+        uint8_t big_endian = (encoding == 2);
+        if ((encoding == 1) && (text_size >= 2))
+        {
+            big_endian = (text[0] == 0xFE) && (text[1] == 0xFF);
+            text += 2;
+            text_size -= 2;
+        }
+        for (uint64_t i = 0; i + 1 < text_size; i += 2)
+        {
+            uint32_t code_point = big_endian ? (((uint32_t)text[i] << 8) | text[i + 1]) : (((uint32_t)text[i + 1] << 8) | text[i]);
+            if (code_point == 0)
+            {
+                break;
+            }
+            // A surrogate pair makes up a code point above U+FFFF
+            if ((code_point >= 0xD800) && (code_point < 0xDC00) && (i + 3 < text_size))
+            {
+                uint32_t low = big_endian ? (((uint32_t)text[i + 2] << 8) | text[i + 3]) : (((uint32_t)text[i + 3] << 8) | text[i + 2]);
+                if ((low >= 0xDC00) && (low < 0xE000))
+                {
+                    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+                    i += 2;
+                }
+            }
+            if (WAVAppendUTF8(code_point, converted, value_size, &converted_length) == 0)
+            {
+                break;
+            }
+        }
+    }
+    WAVLoadTag((const byte_t*)converted, converted_length, value, value_size);
+}
+
+// An 'id3 ' chunk holds an ID3v2 tag. Only ID3v2.3 and ID3v2.4 are read, ID3v2.2 has different frame IDs. Tags and
+// frames that are unsynchronised, compressed or encrypted are skipped, as nearly no tagger writes them.
+static void WAVLoadID3(const byte_t* bytes, uint64_t size, song_t* song)
+{
+    if ((size < 10) || (memcmp(bytes, "ID3", 3) != 0))
+    {
+        return;
+    }
+    byte_t version = bytes[3];
+    byte_t flags = bytes[5];
+    if (((version != 3) && (version != 4)) || ((flags & 0x80) != 0))
+    {
+        return;
+    }
+    uint64_t end = 10 + (uint64_t)WAVUnpackSyncsafe(bytes + 6);
+    if (end > size)
+    {
+        end = size;
+    }
+
+    uint64_t offset = 10;
+    if ((flags & 0x40) != 0)
+    {
+        // The extended header's size includes itself in ID3v2.4, but not in ID3v2.3
+        if (offset + 4 > end)
+        {
+            return;
+        }
+        if (version == 4)
+        {
+            offset += WAVUnpackSyncsafe(bytes + offset);
+        }
+        else
+        {
+            offset += 4 + (((uint32_t)bytes[offset] << 24) | ((uint32_t)bytes[offset + 1] << 16) | ((uint32_t)bytes[offset + 2] << 8) | (uint32_t)bytes[offset + 3]);
+        }
+    }
+
+    while (offset + 10 <= end)
+    {
+        const byte_t* frame_id = bytes + offset;
+        if (frame_id[0] == 0)
+        {
+            // Padding
+            return;
+        }
+        const byte_t* frame_size_bytes = bytes + offset + 4;
+        uint64_t frame_size = (version == 4) ? WAVUnpackSyncsafe(frame_size_bytes) : (((uint32_t)frame_size_bytes[0] << 24) | ((uint32_t)frame_size_bytes[1] << 16) | ((uint32_t)frame_size_bytes[2] << 8) | (uint32_t)frame_size_bytes[3]);
+        if (frame_size > end - offset - 10)
+        {
+            return;
+        }
+        const byte_t* frame = bytes + offset + 10;
+        byte_t frame_format_flags = bytes[offset + 9];
+        if (frame_format_flags == 0)
+        {
+            if (memcmp(frame_id, "TIT2", 4) == 0)
+            {
+                WAVLoadID3TextFrame(frame, frame_size, song->title, sizeof(song->title));
+            }
+            else if (memcmp(frame_id, "TPE1", 4) == 0)
+            {
+                WAVLoadID3TextFrame(frame, frame_size, song->artist, sizeof(song->artist));
+            }
+            else if (memcmp(frame_id, "TALB", 4) == 0)
+            {
+                WAVLoadID3TextFrame(frame, frame_size, song->album, sizeof(song->album));
+            }
+        }
+        offset += 10 + frame_size;
+    }
+}
+
+// Reads the window from 'offset'
+// Returns number of bytes read, fewer than WAV_HEADER_WINDOW_SIZE only at the end of the file
+static uint64_t WAVReadWindow(FILE* file, uint64_t offset, byte_t* window)
+{
+    if (_fseeki64(file, (int64_t)offset, SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    return fread(window, 1, WAV_HEADER_WINDOW_SIZE, file);
+}
+
+// Walks the chunks of a WAV file in memory, reading them through a window that is only moved when a chunk that's needed
+// isn't in it. Unknown chunks are skipped. Once both 'fmt ' and 'data' have been found, the walk only goes on to look for
+// tags after the samples, and stops at the end of the RIFF chunk.
+// Returns SONG_ERROR_NO if both 'fmt ' and 'data' were found
+static song_error_e WAVLoadChunks(FILE* file, song_t* song, wav_format_t* format)
+{
+    uint8_t load_tags = (song->track_number == 0);
+    byte_t* window = (byte_t*)malloc(WAV_HEADER_WINDOW_SIZE);
+    uint64_t window_offset = 0;
+    uint64_t window_size = WAVReadWindow(file, 0, window);
+    if ((window_size < WAV_RIFF_HEADER_SIZE) ||
+        (memcmp(window, "RIFF", 4) != 0) ||
+        (memcmp(window + 8, "WAVE", 4) != 0))
+    {
+        free(window);
+        return SONG_ERROR_INVALID_FILE;
+    }
+    // Some writers leave the size at 0 when they can't seek back to fill it in
+    uint64_t riff_end = 8 + (uint64_t)*((uint32_t*)(window + 4));
+    if (riff_end <= WAV_RIFF_HEADER_SIZE)
+    {
+        riff_end = UINT64_MAX;
+    }
+
+    uint8_t found_fmt = 0;
+    uint8_t found_data = 0;
+    uint64_t offset = WAV_RIFF_HEADER_SIZE;
+    while ((offset + WAV_CHUNK_HEADER_SIZE <= riff_end) &&
+           ((found_fmt == 0) || (found_data == 0) || (load_tags == 1)))
+    {
+        if (offset + WAV_CHUNK_HEADER_SIZE > window_offset + window_size)
         {
-            if (subchunk_size % 2 != 0)
+            if (window_size < WAV_HEADER_WINDOW_SIZE)
+            {
+                // The window already reaches the end of the file
+                break;
+            }
+            window_offset = offset;
+            window_size = WAVReadWindow(file, window_offset, window);
+            if (window_size < WAV_CHUNK_HEADER_SIZE)
             {
-                subchunk_size += 1;
+                break;
             }
         }
-        else if (strncmp(subchunk_id, "LIST", 4) == 0)
-        {}
-        else if (strncmp(subchunk_id, "Fake", 4) == 0)
-        {}
+        const byte_t* chunk = window + (offset - window_offset);
+        uint32_t chunk_size = *((uint32_t*)(chunk + 4));
+        uint64_t chunk_data_offset = offset + WAV_CHUNK_HEADER_SIZE;
+
+        if (memcmp(chunk, "data", 4) == 0)
+        {
+            // The samples are never read here
+            found_data = 1;
+            format->audio_data_offset = chunk_data_offset;
+            format->audio_data_size = chunk_size;
+        }
         else
         {
-            printf("WAV subchunk type '%s' not supported\n", subchunk_id);
-            assert(0);
+            uint8_t is_fmt = (memcmp(chunk, "fmt ", 4) == 0);
+            uint8_t is_list = (memcmp(chunk, "LIST", 4) == 0);
+            uint8_t is_id3 = (memcmp(chunk, "id3 ", 4) == 0) || (memcmp(chunk, "ID3 ", 4) == 0);
+            if (((is_fmt == 1) || ((load_tags == 1) && ((is_list == 1) || (is_id3 == 1)))) &&
+                (chunk_size <= WAV_HEADER_WINDOW_SIZE - WAV_CHUNK_HEADER_SIZE))
+            {
+                if (chunk_data_offset + chunk_size > window_offset + window_size)
+                {
+                    window_offset = offset;
+                    window_size = WAVReadWindow(file, window_offset, window);
+                    if (window_size < WAV_CHUNK_HEADER_SIZE + chunk_size)
+                    {
+                        // Truncated file
+                        break;
+                    }
+                    chunk = window;
+                }
+                const byte_t* chunk_data = chunk + WAV_CHUNK_HEADER_SIZE;
+                if ((is_fmt == 1) && (chunk_size >= 16))
+                {
+                    found_fmt = 1;
+                    format->audio_format = *((uint16_t*)(chunk_data));
+                    format->channel_count = *((uint16_t*)(chunk_data + 2));
+                    format->sample_rate = *((uint32_t*)(chunk_data + 4));
+                    format->bits_per_sample = *((uint16_t*)(chunk_data + 14));
+                    format->valid_bits_per_sample = format->bits_per_sample;
+                    // WAVEFORMATEXTENSIBLE follows with its extension size, the valid bits per sample, the channel mask and
+                    // the subformat, a GUID that starts with the format tag it stands for
+                    if ((format->audio_format == WAVE_FORMAT_EXTENSIBLE) && (chunk_size >= 40))
+                    {
+                        format->valid_bits_per_sample = *((uint16_t*)(chunk_data + 18));
+                        format->audio_format = *((uint16_t*)(chunk_data + 24));
+                    }
+                }
+                else if ((is_list == 1) && (chunk_size >= 4) && (memcmp(chunk_data, "INFO", 4) == 0))
+                {
+                    WAVLoadInfoList(chunk_data + 4, chunk_size - 4, song);
+                }
+                else if (is_id3 == 1)
+                {
+                    WAVLoadID3(chunk_data, chunk_size, song);
+                }
+            }
         }
-        fseek(wav_file, subchunk_size, SEEK_CUR);
 
-        index += 4 + 4 + subchunk_size;
+        offset = chunk_data_offset + chunk_size + (chunk_size & 1);
     }
+    free(window);
 
-    // Verify WAV file
-    if ((strncmp(wav_header_packed.chunk_id, "RIFF", 4) != 0) ||
-        (strncmp(wav_header_packed.chunk_format, "WAVE", 4) != 0) ||
-        (strncmp(wav_header_packed.subchunk1_id, "fmt ", 4) != 0) ||
-        (found_data_subchunk == 0))
+    if ((found_fmt == 0) ||
+        (found_data == 0) ||
+        (format->channel_count == 0))
+    {
+        return SONG_ERROR_INVALID_FILE;
+    }
+    // Only sample formats that can be converted for playback
+    uint8_t is_pcm = (format->audio_format == WAVE_FORMAT_PCM) &&
+                     ((format->bits_per_sample == 8) || (format->bits_per_sample == 16) || (format->bits_per_sample == 24) || (format->bits_per_sample == 32));
+    uint8_t is_float = (format->audio_format == WAVE_FORMAT_IEEE_FLOAT) && (format->bits_per_sample == 32);
+    if (((is_pcm == 0) && (is_float == 0)) ||
+        (format->valid_bits_per_sample == 0) ||
+        (format->valid_bits_per_sample > format->bits_per_sample))
+    {
+        return SONG_ERROR_INVALID_FILE;
+    }
+    return SONG_ERROR_NO;
+}
+
+// Fills in the format of 'song' from 'format'
+static void WAVSetSongFormat(song_t* song, const wav_format_t* format)
+{
+    song->sample_rate = format->sample_rate;
+    song->channel_count = (uint8_t)format->channel_count;
+    song->bps = (uint8_t)(format->bits_per_sample / 8);
+    song->valid_bits_per_sample = (uint8_t)format->valid_bits_per_sample;
+    song->sample_format = (format->audio_format == WAVE_FORMAT_IEEE_FLOAT) ? SAMPLE_FORMAT_FLOAT : SAMPLE_FORMAT_INT;
+}
+
+song_error_e WAVProbe(song_t* song, wav_format_t* format)
+{
+    assert(song != NULL);
+    assert(song->song_path_offset != NULL);
+    assert(format != NULL);
+
+    FILE* wav_file = fopen(song->song_path_offset, "rb");
+    if (wav_file == NULL)
+    {
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+    // Reads are few and already sized, so the FILE doesn't need a buffer of its own
+    setvbuf(wav_file, NULL, _IONBF, 0);
+
+    song_error_e song_error = WAVLoadChunks(wav_file, song, format);
+    fclose(wav_file);
+    if (song_error != SONG_ERROR_NO)
+    {
+        return song_error;
+    }
+
+    WAVSetSongFormat(song, format);
+    return SONG_ERROR_NO;
+}
+
+song_error_e WAVLoadHeader(song_t* song)
+{
+    assert(song != NULL);
+    assert(song->song_path_offset != NULL);
+    //assert(song->audio_data == NULL);
+
+    // Open WAV file
+    FILE* wav_file = fopen(song->song_path_offset, "rb");
+    if (wav_file == NULL)
+    {
+        printf("Failed to open %s : \"%s\"\n", song->song_path_offset, strerror(errno));
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+    setvbuf(wav_file, NULL, _IONBF, 0);
+
+    // Find the format and the samples, and read tags
+    wav_format_t format;
+    if (WAVLoadChunks(wav_file, song, &format) != SONG_ERROR_NO)
     {
         fclose(wav_file);
         return SONG_ERROR_INVALID_FILE;
     }
-    
+
+    // Samples are played back from a mapping of the file
+    wav_source_t* wav_source = (wav_source_t*)malloc(sizeof(wav_source_t));
+    if (FileMap(song->song_path_offset, &wav_source->file_map) == 0)
+    {
+        free(wav_source);
+        fclose(wav_file);
+        return SONG_ERROR_UNABLE_TO_OPEN_FILE;
+    }
+    uint64_t file_size = wav_source->file_map.size;
+    if (format.audio_data_offset > file_size)
+    {
+        FileUnmap(&wav_source->file_map);
+        free(wav_source);
+        fclose(wav_file);
+        return SONG_ERROR_INVALID_FILE;
+    }
+    // Truncated file
+    uint64_t audio_data_size = format.audio_data_size;
+    if (audio_data_size > file_size - format.audio_data_offset)
+    {
+        audio_data_size = file_size - format.audio_data_offset;
+    }
+    ReadAheadOpen(&wav_source->read_ahead, NULL, &wav_source->file_map, format.audio_data_offset);
+    WAVSetSongFormat(song, &format);
+    wav_source->input_bps = song->bps;
+    wav_source->input_format = SampleConvertFormat(song->bps, song->sample_format);
+    wav_source->output_format = wav_source->input_format;
+
     // Assign WAV info and data to song
     song->file = wav_file;
-    song->file_size = wav_file_size;
-    song->audio_data_size = data_subchunk_size;
-    song->sample_rate = wav_header_packed.sample_rate;
-    song->channel_count = wav_header_packed.channel_count;
-    song->bps = wav_header_packed.bits_per_sample / 8;
+    song->wav_source = wav_source;
+    song->file_size = file_size;
+    song->audio_data_size = audio_data_size;
+    song->audio_data_offset = format.audio_data_offset;
+    song->audio_data_end = format.audio_data_offset + audio_data_size;
 
     return SONG_ERROR_NO;
 }
 
-uint32_t WAVLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output)
+void WAVSetOutputFormat(song_t* song, sample_format_e sample_format, uint8_t bps)
+{
+    assert(song != NULL);
+    assert(song->wav_source != NULL);
+    assert(((sample_format == SAMPLE_FORMAT_INT) && (bps == sizeof(int16_t))) ||
+           ((sample_format == SAMPLE_FORMAT_FLOAT) && (bps == sizeof(float))));
+
+    wav_source_t* wav_source = song->wav_source;
+    wav_source->output_format = SampleConvertFormat(bps, sample_format);
+    song->bps = bps;
+    song->sample_format = sample_format;
+    if (sample_format == SAMPLE_FORMAT_FLOAT)
+    {
+        song->valid_bits_per_sample = 32;
+    }
+    else if (song->valid_bits_per_sample > (bps * 8))
+    {
+        song->valid_bits_per_sample = bps * 8;
+    }
+}
+
+uint32_t WAVLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output, const byte_t** data)
 {
     assert(audio_thread_data != NULL);
+    assert(audio_thread_data->wav_source != NULL);
+    assert(audio_thread_data->audio_data_end <= audio_thread_data->wav_source->file_map.size);
     assert(output_size > 0);
-    assert(output != NULL);
-
-    // Determine how much to read
-    long file_offset = ftell(audio_thread_data->file);
-    long remaining_bytes = audio_thread_data->file_size - file_offset;
-    long size_to_read = remaining_bytes < output_size ? remaining_bytes : output_size;
-    uint32_t total_bytes_per_sample_all_channels = audio_thread_data->bps * audio_thread_data->channel_count;
-    uint32_t total_samples_that_fit = size_to_read / total_bytes_per_sample_all_channels;
-    size_to_read = total_samples_that_fit * audio_thread_data->channel_count * audio_thread_data->bps;
-    
-    // Read
-    fread(output, size_to_read, 1, audio_thread_data->file);
-
-    return size_to_read;
+    assert(data != NULL);
+
+    wav_source_t* wav_source = audio_thread_data->wav_source;
+
+    // Determine how much to play back, as many samples of all channels as fit in 'output_size' bytes once converted
+    uint64_t remaining_bytes = 0;
+    if (wav_source->read_ahead.read_offset < audio_thread_data->audio_data_end)
+    {
+        remaining_bytes = audio_thread_data->audio_data_end - wav_source->read_ahead.read_offset;
+    }
+    uint32_t input_bytes_per_sample_all_channels = wav_source->input_bps * audio_thread_data->channel_count;
+    uint32_t output_bytes_per_sample_all_channels = audio_thread_data->bps * audio_thread_data->channel_count;
+    uint64_t total_samples_that_fit = output_size / output_bytes_per_sample_all_channels;
+    if (total_samples_that_fit > remaining_bytes / input_bytes_per_sample_all_channels)
+    {
+        total_samples_that_fit = remaining_bytes / input_bytes_per_sample_all_channels;
+    }
+
+    const byte_t* samples = ReadAheadMapped(&wav_source->read_ahead, total_samples_that_fit * input_bytes_per_sample_all_channels);
+    if (wav_source->input_format == wav_source->output_format)
+    {
+        *data = samples;
+    }
+    else
+    {
+        assert(output != NULL);
+        SampleConvert(wav_source->input_format, 0, samples, wav_source->output_format, 0, output, audio_thread_data->channel_count, total_samples_that_fit);
+        *data = output;
+    }
+
+    return (uint32_t)(total_samples_that_fit * output_bytes_per_sample_all_channels);
+}
+
+void WAVSetReadOffset(wav_source_t* wav_source, uint64_t offset)
+{
+    assert(wav_source != NULL);
+
+    ReadAheadSeek(&wav_source->read_ahead, offset);
+}
+
+void WAVFree(wav_source_t* wav_source)
+{
+    assert(wav_source != NULL);
+
+    ReadAheadClose(&wav_source->read_ahead);
+    FileUnmap(&wav_source->file_map);
+    free(wav_source);
 }
\ No newline at end of file
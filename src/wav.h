@@ -20,40 +20,35 @@
 #define WAV_H
 
 #include "macros.h"
+#include "read_ahead.h"
+#include "sample_convert.h"
 #include "song.h"
 #include "windows_audio.h"
+#include "windows_file.h"
 
 #include <stdint.h>
 
 // http://soundfile.sapp.org/doc/WaveFormat/
 // https://www.daubnet.com/en/file-format-riff
-PACK
-(
-typedef struct
-{
-    char    chunk_id[4]; // Must equal 'RIFF'
-    int32_t chunk_size;
-    char    chunk_format[4]; // Must equal 'WAVE'
-
-    char    subchunk1_id[4]; // Must equal 'fmt '
-    int32_t subchunk1_size;
-    int16_t audio_format; // Must equal 1 == PCM
-    int16_t channel_count;
-    int32_t sample_rate;
-    int32_t bytes_per_second; // sample_rate * channel_count * (bits_per_sample / 8)
-    int16_t bytes_per_sample_all_channels; // channel_count * (bits_per_sample / 8)
-    int16_t bits_per_sample; // Either 8 or 16
-} wav_header_packed_t
-);
+// A WAV file is a RIFF header ('RIFF', size, 'WAVE') followed by chunks of an ID, a size and that many bytes (plus a
+// padding byte if the size is odd), in any order. Only 'fmt ' and 'data' are required.
+#define WAV_RIFF_HEADER_SIZE 12
+#define WAV_CHUNK_HEADER_SIZE 8
+// Header chunks are read through a window of this size. Files with their tags before the samples, or none after them,
+// only take one read.
+#define WAV_HEADER_WINDOW_SIZE (64 * 1024)
 
-PACK
-(
+// What the chunks of a WAV file say about its samples
 typedef struct
 {
-    char    subchunk2_id[4]; // Must equal 'data'
-    int32_t subchunk2_size; // sample_count * channel_count * (bits_per_sample / 8) = total_sample_data_size
-} wav_subchunk_header_packed_t
-);
+    uint16_t audio_format; // WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT, also when the 'fmt ' chunk is WAVE_FORMAT_EXTENSIBLE
+    uint16_t channel_count;
+    uint32_t sample_rate;
+    uint16_t bits_per_sample; // Size of each sample, 8, 16, 24 or 32
+    uint16_t valid_bits_per_sample; // Bits of each sample in use, which only WAVE_FORMAT_EXTENSIBLE can make fewer
+    uint64_t audio_data_offset; // File offset of the first sample
+    uint64_t audio_data_size; // As the 'data' chunk claims, which may be more than the file has
+} wav_format_t;
 
 // TODO (Daniel): pack properly
 typedef struct
@@ -66,7 +61,42 @@ typedef struct
     uint8_t bps; // Bytes per sample
 } wav_t;
 
+// A WAV file being played back, which is mapped into memory so that its samples can be handed to the audio device as is,
+// or converted if the audio device can't play them back
+typedef struct wav_source_t
+{
+    file_map_t              file_map;
+    read_ahead_t            read_ahead; // Reads the mapping ahead of playback, its 'read_offset' is the file offset of the next chunk
+    uint8_t                 input_bps; // Bytes per sample in the file, while the song's 'bps' is that of playback
+    sample_convert_format_e input_format;
+    sample_convert_format_e output_format;
+} wav_source_t;
+
+/**
+ * WAVProbe() reads a WAV file's format into 'format', and its title, artist and album into 'song', without setting it up
+ * for playback. Tags are read from a 'LIST' chunk of type 'INFO' (INAM, IART and IPRD) and from an 'id3 ' chunk (TIT2,
+ * TPE1 and TALB of ID3v2.3 or ID3v2.4); if a file has both, the one that comes last wins. Chunks that aren't needed are
+ * skipped without reading them. Like FLAC, tags aren't read into a virtual track ('song->track_number' isn't 0).
+ * The 'fmt ' chunk may be WAVE_FORMAT_PCM, WAVE_FORMAT_IEEE_FLOAT or WAVE_FORMAT_EXTENSIBLE of either subformat, with
+ * samples of 8, 16, 24 or 32 bits (32 for floats).
+ * Returns SONG_ERROR_NO if the file has both a 'fmt ' and a 'data' chunk, in a format that can be played back
+ * 
+ * WAVLoadHeader() does the same, and maps the file into memory. The song is played back in the format of the file, unless
+ * WAVSetOutputFormat() sets it to 16-bit integers or 32-bit floats, which are converted to while loading the samples.
+ * 
+ * WAVLoadData() doesn't copy the next chunk of at most 'output_size' bytes, but sets 'data' to point to it inside the
+ * mapping, which stays valid until the song's audio data is freed. The mapping is read into memory ahead of playback on a
+ * thread of its own, so that playing back straight from it doesn't stall on disk. If the samples need to be converted,
+ * they're converted into 'output' instead, which 'data' then points to.
+ * Returns the size of the chunk in the output format, 0 at the end of the audio data
+ * 
+ * WAVSetReadOffset() makes playback continue from 'offset'
+*/
+song_error_e WAVProbe(song_t* song, wav_format_t* format);
 song_error_e WAVLoadHeader(song_t* song);
-uint32_t     WAVLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output);
+void         WAVSetOutputFormat(song_t* song, sample_format_e sample_format, uint8_t bps);
+uint32_t     WAVLoadData(playback_data_t* audio_thread_data, uint64_t output_size, byte_t* output, const byte_t** data);
+void         WAVSetReadOffset(wav_source_t* wav_source, uint64_t offset);
+void         WAVFree(wav_source_t* wav_source);
 
 #endif WAV_H
\ No newline at end of file
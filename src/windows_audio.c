@@ -23,18 +23,58 @@
 #include <assert.h>
 #include <stdio.h>
 
+// KSDATAFORMAT_SUBTYPE_PCM and KSDATAFORMAT_SUBTYPE_IEEE_FLOAT, defined here to not depend on ksmedia.h and its GUID definitions
+static const GUID audio_subformat_pcm = { 0x00000001, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+static const GUID audio_subformat_float = { 0x00000003, 0x0000, 0x0010, { 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 } };
+
+// Speaker positions of 1 to 8 channels, in the channel order shared by FLAC and WAVE_FORMAT_EXTENSIBLE
+static const DWORD audio_channel_masks[9] =
+{
+    0,
+    0x4,   // Front center
+    0x3,   // Front left, front right
+    0x7,   // + front center
+    0x33,  // Front left, front right, back left, back right
+    0x37,  // Front left, front right, front center, back left, back right
+    0x3F,  // Front left, front right, front center, low frequency, back left, back right
+    0x70F, // Front left, front right, front center, low frequency, back center, side left, side right
+    0x63F  // Front left, front right, front center, low frequency, back left, back right, side left, side right
+};
+
+// https://docs.microsoft.com/en-us/windows/win32/api/mmreg/ns-mmreg-waveformatextensible
+void AudioFormatCreate(uint32_t sample_rate, uint8_t channel_count, uint8_t bps, uint8_t valid_bits_per_sample, sample_format_e sample_format, WAVEFORMATEXTENSIBLE* format)
+{
+    assert((channel_count > 0) && (channel_count <= 8));
+    assert(format != NULL);
+
+    format->Format.wFormatTag = WAVE_FORMAT_PCM;
+    format->Format.nChannels = channel_count;
+    format->Format.nSamplesPerSec = sample_rate;
+    format->Format.nAvgBytesPerSec = channel_count * sample_rate * bps;
+    format->Format.nBlockAlign = channel_count * bps; // If wFormatTag is WAVE_FORMAT_PCM or WAVE_FORMAT_EXTENSIBLE, nBlockAlign must be equal to the product of nChannels and wBitsPerSample divided by 8 (bits per byte).
+    format->Format.wBitsPerSample = bps * 8;
+    format->Format.cbSize = 0; // Ignored so long as wFormatTag == WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
+
+    // Plain PCM can only describe integer samples of at most 16 bits, that use all their bits, in mono or stereo
+    if ((sample_format != SAMPLE_FORMAT_INT) ||
+        (bps > 2) ||
+        (valid_bits_per_sample != (bps * 8)) ||
+        (channel_count > 2))
+    {
+        format->Format.wFormatTag = WAVE_FORMAT_EXTENSIBLE;
+        format->Format.cbSize = sizeof(WAVEFORMATEXTENSIBLE) - sizeof(WAVEFORMATEX);
+        format->Samples.wValidBitsPerSample = valid_bits_per_sample;
+        format->dwChannelMask = audio_channel_masks[channel_count];
+        format->SubFormat = (sample_format == SAMPLE_FORMAT_FLOAT) ? audio_subformat_float : audio_subformat_pcm;
+    }
+}
+
 // https://docs.microsoft.com/en-us/windows/win32/multimedia/determining-nonstandard-format-support
-uint8_t AudioDeviceSupportsPlayback(uint32_t sample_rate, uint8_t bps, uint8_t channel_count)
+uint8_t AudioDeviceSupportsPlayback(const WAVEFORMATEXTENSIBLE* format)
 {
-    WAVEFORMATEX format;
-    format.wFormatTag = WAVE_FORMAT_PCM;
-    format.nChannels = channel_count;
-    format.nSamplesPerSec = sample_rate;
-    format.nAvgBytesPerSec = channel_count * sample_rate * bps;
-    format.nBlockAlign = channel_count * bps;
-    format.wBitsPerSample = bps * 8;
-    format.cbSize = 0; // Ignored so long as wFormatTag == WAVE_FORMAT_PCM or WAVE_FORMAT_IEEE_FLOAT
-    MMRESULT res = waveOutOpen(NULL, WAVE_MAPPER, &format, NULL, NULL, WAVE_FORMAT_QUERY);
+    assert(format != NULL);
+
+    MMRESULT res = waveOutOpen(NULL, WAVE_MAPPER, &format->Format, NULL, NULL, WAVE_FORMAT_QUERY);
     if (res != MMSYSERR_NOERROR)
     {
         return 0;
@@ -75,7 +115,7 @@ void AudioGetPlaybackPosition(HWAVEOUT device, LPMMTIME playback_position)
     assert(res_mmresult == MMSYSERR_NOERROR);
 }
 
-void AudioClose(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count)
+void AudioReset(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count)
 {
     assert(device != NULL);
     assert(headers != NULL);
@@ -109,8 +149,13 @@ void AudioClose(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count)
             assert(res_mmresult == MMSYSERR_NOERROR);
         }
     }
+}
+
+void AudioClose(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count)
+{
+    AudioReset(device, headers, header_count);
 
     // Close audio device
-    res_mmresult = waveOutClose(device);
+    MMRESULT res_mmresult = waveOutClose(device);
     assert(res_mmresult == MMSYSERR_NOERROR);
 }
\ No newline at end of file
@@ -23,12 +23,15 @@
 #include "sound_player.h"
 
 #include <windows.h>
+#include <mmreg.h>
 
-uint8_t AudioDeviceSupportsPlayback(uint32_t sample_rate, uint8_t bps, uint8_t channel_count);
+void    AudioFormatCreate(uint32_t sample_rate, uint8_t channel_count, uint8_t bps, uint8_t valid_bits_per_sample, sample_format_e sample_format, WAVEFORMATEXTENSIBLE* format);
+uint8_t AudioDeviceSupportsPlayback(const WAVEFORMATEXTENSIBLE* format);
 void    AudioOpen(LPHWAVEOUT device, LPCWAVEFORMATEX device_format, DWORD_PTR callback, DWORD_PTR shared_data);
 void    AudioPause(HWAVEOUT device);
 void    AudioResume(HWAVEOUT device);
 void    AudioGetPlaybackPosition(HWAVEOUT device, LPMMTIME playback_position);
+void    AudioReset(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count);
 void    AudioClose(HWAVEOUT device, LPWAVEHDR headers, uint8_t header_count);
 
 #endif
\ No newline at end of file
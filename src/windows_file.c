@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "windows_file.h"
+
+#include <assert.h>
+
+uint8_t FileGetInfo(const char* path, uint64_t* size, uint64_t* modification_time)
+{
+    assert(path != NULL);
+    assert(size != NULL);
+    assert(modification_time != NULL);
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes;
+    if (GetFileAttributesExA(path, GetFileExInfoStandard, &attributes) == 0)
+    {
+        return 0;
+    }
+    *size = ((uint64_t)attributes.nFileSizeHigh << 32) | (uint64_t)attributes.nFileSizeLow;
+    *modification_time = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | (uint64_t)attributes.ftLastWriteTime.dwLowDateTime;
+
+    return 1;
+}
+
+uint8_t FileMap(const char* path, file_map_t* file_map)
+{
+    assert(path != NULL);
+    assert(file_map != NULL);
+
+    file_map->file = NULL;
+    file_map->mapping = NULL;
+    file_map->bytes = NULL;
+    file_map->size = 0;
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+    LARGE_INTEGER file_size;
+    if ((GetFileSizeEx(file, &file_size) == 0) || (file_size.QuadPart == 0))
+    {
+        CloseHandle(file);
+        return 0;
+    }
+
+    // A mapping of an empty file can't be created, hence the check above
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL)
+    {
+        CloseHandle(file);
+        return 0;
+    }
+    const byte_t* bytes = (const byte_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (bytes == NULL)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return 0;
+    }
+
+    file_map->file = file;
+    file_map->mapping = mapping;
+    file_map->bytes = bytes;
+    file_map->size = (uint64_t)file_size.QuadPart;
+
+    return 1;
+}
+
+void FileUnmap(file_map_t* file_map)
+{
+    assert(file_map != NULL);
+
+    if (file_map->bytes != NULL)
+    {
+        UnmapViewOfFile(file_map->bytes);
+        CloseHandle(file_map->mapping);
+        CloseHandle(file_map->file);
+    }
+    file_map->file = NULL;
+    file_map->mapping = NULL;
+    file_map->bytes = NULL;
+    file_map->size = 0;
+}
+
+void FilePrefetch(const file_map_t* file_map, uint64_t offset, uint64_t size)
+{
+    assert(file_map != NULL);
+    assert(file_map->bytes != NULL);
+
+    if (offset >= file_map->size)
+    {
+        return;
+    }
+    if (size > file_map->size - offset)
+    {
+        size = file_map->size - offset;
+    }
+
+    WIN32_MEMORY_RANGE_ENTRY range;
+    range.VirtualAddress = (PVOID)(file_map->bytes + offset);
+    range.NumberOfBytes = (SIZE_T)size;
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
\ No newline at end of file
@@ -0,0 +1,49 @@
+/**
+ * Copyright (c) 2022 - 2022, Daniel Fedai Larsen.
+ *
+ * All rights reserved.
+ * 
+ * Permission to use, copy, modify, and distribute this software for any purpose
+ * with or without fee is hereby granted, provided that the above copyright
+ * notice and this permission notice appear in all copies.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT OF THIRD PARTY RIGHTS. IN
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+ * OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+ * OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef WINDOWS_FILE_H
+#define WINDOWS_FILE_H
+
+#include "macros.h"
+
+#include <windows.h>
+
+// A whole file mapped read-only into memory
+typedef struct
+{
+    HANDLE        file;
+    HANDLE        mapping;
+    const byte_t* bytes;
+    uint64_t      size;
+} file_map_t;
+
+/**
+ * FileGetInfo() gets the size and last write time (in 100 ns intervals since 1601) of a file without opening it.
+ * FileMap() maps a whole file into memory, which must not be empty. Pages are only read from disk once they are touched.
+ * 
+ * Both return 0 if the file doesn't exist or can't be read
+ * 
+ * FilePrefetch() asks the OS to read 'size' bytes of a mapped file from 'offset' into memory in the background, so that
+ * touching them later doesn't stall on disk. It's only a hint, and is ignored if it fails
+*/
+uint8_t FileGetInfo(const char* path, uint64_t* size, uint64_t* modification_time);
+uint8_t FileMap(const char* path, file_map_t* file_map);
+void    FileUnmap(file_map_t* file_map);
+void    FilePrefetch(const file_map_t* file_map, uint64_t offset, uint64_t size);
+
+#endif
\ No newline at end of file
@@ -80,4 +80,24 @@ void SyncResetEvent(HANDLE event, const char* calle_file, int calle_line_number)
         printf("%s:%i Failed to reset Event\n", calle_file, calle_line_number);
         exit(EXIT_FAILURE);
     }
+}
+
+void SyncReleaseSemaphore(HANDLE semaphore, LONG release_count, const char* calle_file, int calle_line_number)
+{
+    BOOL res = ReleaseSemaphore(semaphore, release_count, NULL);
+    if (res == 0)
+    {
+        printf("%s:%i Failed to release Semaphore\n", calle_file, calle_line_number);
+        exit(EXIT_FAILURE);
+    }
+}
+
+void SyncWaitOnSemaphore(HANDLE semaphore, DWORD wait_time_ms, const char* calle_file, int calle_line_number)
+{
+    DWORD res = WaitForSingleObject(semaphore, wait_time_ms);
+    if (res != WAIT_OBJECT_0)
+    {
+        printf("%s:%i Failed to wait on Semaphore\n", calle_file, calle_line_number);
+        exit(EXIT_FAILURE);
+    }
 }
\ No newline at end of file
@@ -27,5 +27,7 @@ void SyncReleaseMutex(HANDLE mutex, const char* calle_file, int calle_line_numbe
 void SyncSetEvent(HANDLE event, const char* calle_file, int calle_line_number);
 void SyncWaitOnEvent(HANDLE event, DWORD wait_time_ms, const char* calle_file, int calle_line_number);
 void SyncResetEvent(HANDLE event, const char* calle_file, int calle_line_number);
+void SyncReleaseSemaphore(HANDLE semaphore, LONG release_count, const char* calle_file, int calle_line_number);
+void SyncWaitOnSemaphore(HANDLE semaphore, DWORD wait_time_ms, const char* calle_file, int calle_line_number);
 
 #endif
\ No newline at end of file